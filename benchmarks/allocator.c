@@ -0,0 +1,110 @@
+#define _GNU_SOURCE
+
+#include "lib/scheduler.h"
+#include "benchmarks/utils.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define MIN_CAPACITY (1UL << 12)
+#define MAX_CAPACITY (1UL << 20)
+#define MAX_POLLS    8
+#define NUM_TESTS    4
+
+struct test_config {
+    char const *allocator_name;
+    struct llcm_allocator allocator;
+    size_t capacity;
+};
+
+struct test_result {
+    uint64_t init_nanos;
+    uint64_t poll_cycles;
+    uint64_t poll_nanos;
+};
+
+struct routine_state {
+    uint64_t num_polls;
+};
+
+void routine_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct routine_state *state = arg0;
+    if (++state->num_polls == MAX_POLLS) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+// a full scheduler whose routines are scattered over a large array, so nearly every poll
+// touches a different page of the routine array and of the queue array
+struct test_result big_scheduler_test(struct test_config config) {
+    struct timespec ts_start;
+    struct timespec ts_end;
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init_with_custom_allocate(&scheduler, config.capacity, config.allocator);
+    size_t const routines_size = sizeof(struct llcm_routine) * config.capacity;
+    size_t const states_size = sizeof(struct routine_state) * config.capacity;
+    struct llcm_routine *routines = llcm_allocator_allocate(
+        config.allocator, LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE, routines_size);
+    struct routine_state *states = llcm_allocator_allocate(
+        config.allocator, LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE, states_size);
+    memset(routines, 0, routines_size);
+    memset(states, 0, states_size);
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+    uint64_t const init_nanos = diff_timespec(&ts_end, &ts_start);
+
+    // schedule in a pseudo random order, an odd stride over a power of two visits every index
+    uint64_t const stride = (config.capacity / 2 + 12345) | 1;
+    for (uint64_t i = 0; i < config.capacity; i++) {
+        uint64_t const index = (i * stride) & (config.capacity - 1);
+        llcm_routine_init(&routines[index], routine_poll, &states[index]);
+        if (!llcm_scheduler_try_schedule_routine(&scheduler, &routines[index])) {
+            exit(1);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    uint64_t const cycle_start = rdtsc();
+    while (llcm_scheduler_poll(&scheduler, NULL)) {
+    }
+    uint64_t const cycle_end = rdtsc();
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+
+    llcm_allocator_free(config.allocator, states, states_size);
+    llcm_allocator_free(config.allocator, routines, routines_size);
+    llcm_scheduler_uninit(&scheduler);
+    return (struct test_result){.init_nanos = init_nanos,
+                                .poll_cycles = cycle_end - cycle_start,
+                                .poll_nanos = diff_timespec(&ts_end, &ts_start)};
+}
+
+void aggregate_test(struct test_config config) {
+    struct test_result total = {.init_nanos = 0, .poll_cycles = 0, .poll_nanos = 0};
+    for (int i = 0; i < NUM_TESTS; i++) {
+        struct test_result const current_test_result = big_scheduler_test(config);
+        total.init_nanos += current_test_result.init_nanos;
+        total.poll_cycles += current_test_result.poll_cycles;
+        total.poll_nanos += current_test_result.poll_nanos;
+    }
+    double const num_polls = (double) NUM_TESTS * config.capacity * MAX_POLLS;
+    printf("allocator(%s) capacity(%lu) init took micros(%lf) polls took cycles(%lf) nanos(%lf)\n",
+           config.allocator_name, config.capacity, total.init_nanos / (NUM_TESTS * 1000.0),
+           total.poll_cycles / num_polls, total.poll_nanos / num_polls);
+}
+
+int main() {
+    thread_perf_mode_main_thread_init();
+    printf("running with polls(%d) per routine\n", MAX_POLLS);
+    for (size_t capacity = MIN_CAPACITY; capacity <= MAX_CAPACITY; capacity *= 16) {
+        aggregate_test((struct test_config){.allocator_name = "default",
+                                            .allocator = llcm_allocator_create_default(),
+                                            .capacity = capacity});
+        aggregate_test((struct test_config){.allocator_name = "hugepage",
+                                            .allocator = llcm_allocator_create_hugepage(),
+                                            .capacity = capacity});
+        aggregate_test((struct test_config){
+            .allocator_name = "numa_local",
+            .allocator = llcm_allocator_create_numa(LLCM_ALLOCATOR_NUMA_NODE_LOCAL),
+            .capacity = capacity});
+    }
+}
@@ -1,6 +1,7 @@
 #define _GNU_SOURCE
 
 #include "lib/concurrent_queue.h"
+#include "lib/segmented_queue.h"
 #include "benchmarks/utils.h"
 
 #include <pthread.h>
@@ -11,10 +12,13 @@
 #define NUM_TESTS           10
 #define DUMMY_ELEMENT       ((void *) 1)
 #define WARMUP_AND_WINDDOWN (MAX_SEQUENCE * 2 + 100000UL)
+#define MAX_BATCH_SIZE      64
 
 struct test_config {
     size_t num_threads;
     size_t num_elements;
+    size_t batch_size;
+    unsigned flags;
 };
 
 struct test_result {
@@ -31,48 +35,54 @@ struct thread_args {
     struct test_result result;
 };
 
+// moves num_moves elements through the queue, batch_size elements at a time
+void run_sequence(struct llcm_concurrent_queue *queue, size_t batch_size, uint64_t num_moves) {
+    void *batch[MAX_BATCH_SIZE];
+    uint64_t num_moved = 0;
+    while (num_moved < num_moves) {
+        if (1 == batch_size) {
+            void *pop_result = NULL;
+            while (NULL == pop_result) {
+                pop_result = llcm_concurrent_queue_try_pop(queue);
+            }
+            llcm_concurrent_queue_push(queue, pop_result);
+            num_moved++;
+        } else {
+            size_t num_popped = 0;
+            while (0 == num_popped) {
+                num_popped = llcm_concurrent_queue_try_pop_n(queue, batch, batch_size);
+            }
+            llcm_concurrent_queue_push_n(queue, batch, num_popped);
+            num_moved += num_popped;
+        }
+    }
+}
+
 void *thread_exec(void *arg0) {
     // init
     struct thread_args *thread_args = arg0;
     thread_perf_mode_init(thread_args->tid);
     struct llcm_concurrent_queue *queue = thread_args->queue;
     uint64_t const *start_barrier = thread_args->start_barrier;
+    size_t const batch_size = thread_args->config->batch_size;
     __atomic_fetch_add(thread_args->num_threads_ready, 1, __ATOMIC_SEQ_CST);
     while (__atomic_load_n(start_barrier, __ATOMIC_SEQ_CST) == 0) {
     }
 
     // benchmark
-    for (int i = 0; i < WARMUP_AND_WINDDOWN; i++) {
-        void *pop_result = NULL;
-        while (NULL == pop_result) {
-            pop_result = llcm_concurrent_queue_try_pop(queue);
-        }
-        llcm_concurrent_queue_push(queue, pop_result);
-    }
+    run_sequence(queue, batch_size, WARMUP_AND_WINDDOWN);
     __asm__ __volatile__("" ::: "memory");
     struct timespec ts_start;
     clock_gettime(CLOCK_MONOTONIC, &ts_start);
     uint64_t const cycle_start = rdtsc();
     __asm__ __volatile__("" ::: "memory");
-    for (int i = 0; i < MAX_SEQUENCE; i++) {
-        void *pop_result = NULL;
-        while (NULL == pop_result) {
-            pop_result = llcm_concurrent_queue_try_pop(queue);
-        }
-        llcm_concurrent_queue_push(queue, pop_result);
-    }
+    run_sequence(queue, batch_size, MAX_SEQUENCE);
     __asm__ __volatile__("" ::: "memory");
     uint64_t const cycle_end = rdtsc();
     struct timespec ts_end;
     clock_gettime(CLOCK_MONOTONIC, &ts_end);
     __asm__ __volatile__("" ::: "memory");
-    for (int i = 0; i < WARMUP_AND_WINDDOWN; i++) {
-        void *pop_result = NULL;
-        while (NULL == pop_result) {
-            pop_result = llcm_concurrent_queue_try_pop(queue);
-        }
-        llcm_concurrent_queue_push(queue, pop_result);
-    }
+    run_sequence(queue, batch_size, WARMUP_AND_WINDDOWN);
 
     thread_args->result = (struct test_result){.cycles = cycle_end - cycle_start,
                                                .nanos = diff_timespec(&ts_end, &ts_start)};
@@ -84,7 +94,8 @@ struct test_result multithreaded_test(struct test_config config) {
     struct llcm_concurrent_queue queue;
     alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_threads_ready = 0;
     alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t start_barrier = 0;
-    llcm_concurrent_queue_init(&queue, config.num_elements);
+    llcm_concurrent_queue_init_with_flags(&queue, config.num_elements, config.flags,
+                                          llcm_allocator_create_default());
     llcm_concurrent_queue_try_reserve_size_before_push(&queue, config.num_elements);
     for (size_t i = 0; i < config.num_elements; i++) {
         llcm_concurrent_queue_push(&queue, DUMMY_ELEMENT);
@@ -141,18 +152,188 @@ void aggregate_test(struct test_config config) {
         (double) total.cycles / (NUM_TESTS * MAX_SEQUENCE * config.num_threads);
     double const nanos_per_iteration =
         (double) total.nanos / (NUM_TESTS * MAX_SEQUENCE * config.num_threads);
-    printf("threads(%lu) elements(%lu) took cycles(%lf) nanos(%lf)\n", config.num_threads,
-           config.num_elements, cycles_per_iteration, nanos_per_iteration);
+    char const *layout =
+        config.flags & LLCM_CONCURRENT_QUEUE_COMPACT_LAYOUT ? "compact" : "padded";
+    printf("threads(%lu) elements(%lu) batch(%lu) layout(%s) took cycles(%lf) nanos(%lf)\n",
+           config.num_threads, config.num_elements, config.batch_size, layout,
+           cycles_per_iteration, nanos_per_iteration);
+}
+
+struct variant_config {
+    char const *name;
+    unsigned flags;
+    size_t num_producers;
+    size_t num_consumers;
+    // a llcm_segmented_queue with segments of the capacity instead of one ring
+    bool segmented;
+};
+
+struct variant_thread_args {
+    struct llcm_concurrent_queue *queue;
+    struct llcm_segmented_queue *segmented_queue;
+    uint64_t *num_threads_ready;
+    uint64_t const *start_barrier;
+    int tid;
+    bool is_producer;
+    uint64_t num_elements;
+};
+
+void *variant_thread_exec(void *arg0) {
+    struct variant_thread_args *args = arg0;
+    thread_perf_mode_init(args->tid);
+    struct llcm_concurrent_queue *queue = args->queue;
+    __atomic_fetch_add(args->num_threads_ready, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(args->start_barrier, __ATOMIC_SEQ_CST) == 0) {
+    }
+
+    struct llcm_segmented_queue *segmented_queue = args->segmented_queue;
+    for (uint64_t i = 0; i < args->num_elements; i++) {
+        if (NULL != segmented_queue && args->is_producer) {
+            llcm_segmented_queue_push(segmented_queue, DUMMY_ELEMENT);
+        } else if (NULL != segmented_queue) {
+            while (NULL == llcm_segmented_queue_try_pop(segmented_queue)) {
+            }
+        } else if (args->is_producer) {
+            while (!llcm_concurrent_queue_try_reserve_size_before_push(queue, 1)) {
+            }
+            llcm_concurrent_queue_push(queue, DUMMY_ELEMENT);
+        } else {
+            void *pop_result = NULL;
+            while (NULL == pop_result) {
+                pop_result = llcm_concurrent_queue_try_pop(queue);
+            }
+            llcm_concurrent_queue_unreserve_size_after_pop(queue, 1);
+        }
+    }
+    return NULL;
+}
+
+// producers push MAX_SEQUENCE elements each, consumers split them evenly
+struct test_result variant_test(struct variant_config config, size_t capacity) {
+    struct llcm_concurrent_queue queue;
+    struct llcm_segmented_queue segmented_queue;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_threads_ready = 0;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t start_barrier = 0;
+    if (config.segmented) {
+        llcm_segmented_queue_init_with_flags(&segmented_queue, capacity, config.flags,
+                                             llcm_allocator_create_default());
+    } else {
+        llcm_concurrent_queue_init_with_flags(&queue, capacity, config.flags,
+                                              llcm_allocator_create_default());
+    }
+
+    size_t const num_threads = config.num_producers + config.num_consumers;
+    uint64_t const total_elements = MAX_SEQUENCE * config.num_producers;
+    pthread_t threads[num_threads];
+    struct variant_thread_args thread_args[num_threads];
+    for (size_t tid = 0; tid < num_threads; tid++) {
+        bool const is_producer = tid < config.num_producers;
+        thread_args[tid] = (struct variant_thread_args){
+            .queue = &queue,
+            .segmented_queue = config.segmented ? &segmented_queue : NULL,
+            .num_threads_ready = &num_threads_ready,
+            .start_barrier = &start_barrier,
+            .tid = tid,
+            .is_producer = is_producer,
+            .num_elements = is_producer ? MAX_SEQUENCE : total_elements / config.num_consumers,
+        };
+        int rc = pthread_create(&threads[tid], NULL, variant_thread_exec, &thread_args[tid]);
+        if (rc != 0) {
+            exit(1);
+        }
+    }
+    while (__atomic_load_n(&num_threads_ready, __ATOMIC_SEQ_CST) != num_threads) {
+    }
+    struct timespec ts_start;
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    uint64_t const cycle_start = rdtsc();
+    __atomic_store_n(&start_barrier, 1, __ATOMIC_SEQ_CST);
+    for (size_t tid = 0; tid < num_threads; tid++) {
+        pthread_join(threads[tid], NULL);
+    }
+    uint64_t const cycle_end = rdtsc();
+    struct timespec ts_end;
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+    if (config.segmented) {
+        llcm_segmented_queue_uninit(&segmented_queue);
+    } else {
+        llcm_concurrent_queue_uninit(&queue);
+    }
+
+    return (struct test_result){.cycles = cycle_end - cycle_start,
+                                .nanos = diff_timespec(&ts_end, &ts_start)};
+}
+
+void aggregate_variant_test(struct variant_config config, size_t capacity) {
+    struct test_result total = {
+        .cycles = 0,
+        .nanos = 0,
+    };
+    for (int i = 0; i < NUM_TESTS; i++) {
+        struct test_result const current_test_result = variant_test(config, capacity);
+        total.cycles += current_test_result.cycles;
+        total.nanos += current_test_result.nanos;
+    }
+    uint64_t const num_elements = NUM_TESTS * MAX_SEQUENCE * config.num_producers;
+    printf("variant(%s) producers(%lu) consumers(%lu) capacity(%lu) took cycles(%lf) "
+           "nanos(%lf)\n",
+           config.name, config.num_producers, config.num_consumers, capacity,
+           (double) total.cycles / num_elements, (double) total.nanos / num_elements);
 }
 
 int main() {
     thread_perf_mode_main_thread_init();
     printf("running with iterations(%lu)\n", MAX_SEQUENCE);
-    for (int num_threads = 1; num_threads <= 4; num_threads *= 2) {
-        for (size_t num_elements = num_threads; num_elements <= num_threads * 8;
-             num_elements *= 2) {
-            aggregate_test(
-                (struct test_config){.num_threads = num_threads, .num_elements = num_elements});
+    for (size_t batch_size = 1; batch_size <= MAX_BATCH_SIZE; batch_size *= 8) {
+        for (int num_threads = 1; num_threads <= 4; num_threads *= 2) {
+            for (size_t num_elements = num_threads * batch_size;
+                 num_elements <= num_threads * batch_size * 8; num_elements *= 2) {
+                aggregate_test((struct test_config){.num_threads = num_threads,
+                                                    .num_elements = num_elements,
+                                                    .batch_size = batch_size,
+                                                    .flags = 0});
+            }
+        }
+    }
+
+    // full rings, so the memory footprint of each layout shows up in the cache misses
+    for (size_t capacity = 64; capacity <= (1UL << 20); capacity *= 16) {
+        for (int num_threads = 1; num_threads <= 4; num_threads *= 2) {
+            aggregate_test((struct test_config){.num_threads = num_threads,
+                                                .num_elements = capacity,
+                                                .batch_size = 1,
+                                                .flags = 0});
+            aggregate_test((struct test_config){.num_threads = num_threads,
+                                                .num_elements = capacity,
+                                                .batch_size = 1,
+                                                .flags = LLCM_CONCURRENT_QUEUE_COMPACT_LAYOUT});
+        }
+    }
+
+    // each specialized variant next to mpmc with the same thread counts
+    unsigned const spsc =
+        LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER | LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER;
+    struct variant_config const variant_configs[] = {
+        {.name = "mpmc", .flags = 0, .num_producers = 1, .num_consumers = 1},
+        {.name = "spsc", .flags = spsc, .num_producers = 1, .num_consumers = 1},
+        {.name = "mpmc", .flags = 0, .num_producers = 2, .num_consumers = 1},
+        {.name = "mpsc", .flags = LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER, .num_producers = 2,
+         .num_consumers = 1},
+        {.name = "mpmc", .flags = 0, .num_producers = 1, .num_consumers = 2},
+        {.name = "spmc", .flags = LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER, .num_producers = 1,
+         .num_consumers = 2},
+        // the unbounded queue against the bounded ring, its pops only pay extra per segment
+        {.name = "segmented mpmc", .flags = 0, .num_producers = 1, .num_consumers = 1,
+         .segmented = true},
+        {.name = "segmented mpmc", .flags = 0, .num_producers = 1, .num_consumers = 2,
+         .segmented = true},
+        {.name = "segmented mpmc", .flags = 0, .num_producers = 2, .num_consumers = 2,
+         .segmented = true},
+        {.name = "mpmc", .flags = 0, .num_producers = 2, .num_consumers = 2},
+    };
+    for (size_t capacity = 64; capacity <= 4096; capacity *= 64) {
+        for (size_t i = 0; i < sizeof(variant_configs) / sizeof(variant_configs[0]); i++) {
+            aggregate_variant_test(variant_configs[i], capacity);
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,157 @@
+#define _GNU_SOURCE
+
+#include "lib/reservation_cache.h"
+#include "benchmarks/utils.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#define CAPACITY      1024
+#define NUM_OPS       2000000UL
+#define NUM_TESTS     5
+#define MAX_THREADS   8
+#define HOLD_SIZE     8
+#define DUMMY_ELEMENT ((void *) 1)
+
+enum test_mode {
+    // every thread reserves HOLD_SIZE entries one at a time and then releases them, like a poller
+    // moving routines between schedulers. nothing but the reservation counter is touched
+    TEST_MODE_RESERVE_RELEASE,
+    // half the threads reserve and push, the other half pop and release, so write_counter and
+    // read_counter are contended as well
+    TEST_MODE_PRODUCE_CONSUME,
+};
+
+char const *test_mode_names[] = {"reserve_release", "produce_consume"};
+
+struct test_state {
+    enum test_mode mode;
+    struct llcm_concurrent_queue queue;
+    struct llcm_reservation_cache cache;
+    bool sharded;
+    uint64_t *num_threads_ready;
+    uint64_t const *start_barrier;
+};
+
+struct thread_args {
+    struct test_state *state;
+    int tid;
+    bool is_producer;
+    uint64_t nanos;
+};
+
+bool try_reserve(struct test_state *state, size_t num_entries) {
+    if (state->sharded) {
+        return llcm_reservation_cache_try_reserve(&state->cache, num_entries);
+    }
+    return llcm_concurrent_queue_try_reserve_size_before_push(&state->queue, num_entries);
+}
+
+void unreserve(struct test_state *state, size_t num_entries) {
+    if (state->sharded) {
+        llcm_reservation_cache_unreserve(&state->cache, num_entries);
+        return;
+    }
+    llcm_concurrent_queue_unreserve_size_after_pop(&state->queue, num_entries);
+}
+
+void run_ops(struct thread_args *args) {
+    struct test_state *state = args->state;
+    if (TEST_MODE_RESERVE_RELEASE == state->mode) {
+        for (uint64_t i = 0; i < NUM_OPS; i += HOLD_SIZE) {
+            for (size_t j = 0; j < HOLD_SIZE; j++) {
+                while (!try_reserve(state, 1)) {
+                }
+            }
+            for (size_t j = 0; j < HOLD_SIZE; j++) {
+                unreserve(state, 1);
+            }
+        }
+        return;
+    }
+    for (uint64_t i = 0; i < NUM_OPS; i++) {
+        if (args->is_producer) {
+            while (!try_reserve(state, 1)) {
+            }
+            llcm_concurrent_queue_push(&state->queue, DUMMY_ELEMENT);
+        } else {
+            while (NULL == llcm_concurrent_queue_try_pop(&state->queue)) {
+            }
+            unreserve(state, 1);
+        }
+    }
+}
+
+void *thread_exec(void *arg0) {
+    struct thread_args *args = arg0;
+    thread_perf_mode_init(args->tid);
+    __atomic_fetch_add(args->state->num_threads_ready, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(args->state->start_barrier, __ATOMIC_SEQ_CST) == 0) {
+    }
+    struct timespec ts_start;
+    struct timespec ts_end;
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    run_ops(args);
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+    args->nanos = diff_timespec(&ts_end, &ts_start);
+    return NULL;
+}
+
+// average nanos per reservation and release pair of one thread
+double multithreaded_test(enum test_mode mode, size_t num_threads, bool sharded) {
+    static struct test_state state;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_threads_ready = 0;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t start_barrier = 0;
+    state = (struct test_state){.mode = mode,
+                                .sharded = sharded,
+                                .num_threads_ready = &num_threads_ready,
+                                .start_barrier = &start_barrier};
+    llcm_concurrent_queue_init(&state.queue, CAPACITY);
+    if (sharded) {
+        llcm_reservation_cache_init(&state.cache, &state.queue, num_threads, 0,
+                                    llcm_allocator_create_default());
+    }
+    pthread_t threads[MAX_THREADS];
+    struct thread_args args[MAX_THREADS];
+    for (size_t tid = 0; tid < num_threads; tid++) {
+        args[tid] = (struct thread_args){.state = &state, .tid = tid, .is_producer = tid % 2 == 0};
+        if (0 != pthread_create(&threads[tid], NULL, thread_exec, &args[tid])) {
+            exit(1);
+        }
+    }
+    while (__atomic_load_n(&num_threads_ready, __ATOMIC_SEQ_CST) != num_threads) {
+    }
+    __atomic_store_n(&start_barrier, 1, __ATOMIC_SEQ_CST);
+    uint64_t nanos = 0;
+    for (size_t tid = 0; tid < num_threads; tid++) {
+        pthread_join(threads[tid], NULL);
+        nanos += args[tid].nanos;
+    }
+    if (sharded) {
+        llcm_reservation_cache_uninit(&state.cache);
+    }
+    llcm_concurrent_queue_uninit(&state.queue);
+    return (double) nanos / (num_threads * NUM_OPS);
+}
+
+int main() {
+    thread_perf_mode_main_thread_init();
+    printf("running with ops(%lu) capacity(%d)\n", NUM_OPS, CAPACITY);
+    for (enum test_mode mode = TEST_MODE_RESERVE_RELEASE; mode <= TEST_MODE_PRODUCE_CONSUME;
+         mode++) {
+        // produce_consume pairs every producer with a consumer
+        size_t const min_threads = TEST_MODE_PRODUCE_CONSUME == mode ? 2 : 1;
+        for (size_t num_threads = min_threads; num_threads <= MAX_THREADS; num_threads *= 2) {
+            double global_nanos = 0;
+            double sharded_nanos = 0;
+            for (int i = 0; i < NUM_TESTS; i++) {
+                global_nanos += multithreaded_test(mode, num_threads, false);
+                sharded_nanos += multithreaded_test(mode, num_threads, true);
+            }
+            printf("mode(%s) threads(%zu) global counter took nanos(%lf) sharded took nanos(%lf)\n",
+                   test_mode_names[mode], num_threads, global_nanos / NUM_TESTS,
+                   sharded_nanos / NUM_TESTS);
+        }
+    }
+}
@@ -0,0 +1,138 @@
+#define _GNU_SOURCE
+
+#include "lib/channel.h"
+#include "lib/scheduler.h"
+#include "benchmarks/utils.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define NUM_ROUND_TRIPS 1000000UL
+#define NUM_TESTS       5
+#define MAX_BACKGROUND  256
+
+// a request response chain between two routines over channels, on a scheduler shared with
+// background routines that requeue themselves on every poll
+struct ping_pong_state {
+    struct llcm_channel requests;
+    struct llcm_channel replies;
+    uint64_t num_round_trips;
+    bool awaiting_reply;
+    bool done;
+    uint64_t num_background_polls;
+};
+
+void ping_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct ping_pong_state *state = arg0;
+    for (;;) {
+        if (state->awaiting_reply) {
+            if (NULL == llcm_channel_receive(&state->replies, handle)) {
+                return;
+            }
+            state->awaiting_reply = false;
+            if (++state->num_round_trips == NUM_ROUND_TRIPS) {
+                state->done = true;
+                llcm_exec_handle_cancel_routine(handle);
+                return;
+            }
+        }
+        if (!llcm_channel_send(&state->requests, (void *) 1, handle)) {
+            return;
+        }
+        state->awaiting_reply = true;
+    }
+}
+
+void pong_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct ping_pong_state *state = arg0;
+    void *request;
+    while (NULL != (request = llcm_channel_receive(&state->requests, handle))) {
+        if (!llcm_channel_send(&state->replies, request, handle)) {
+            exit(1);
+        }
+    }
+    if (state->done) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+void background_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct ping_pong_state *state = arg0;
+    state->num_background_polls++;
+    if (state->done) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+// nanos per round trip, and background polls per round trip to show the chain does not starve
+// them
+double ping_pong_test(uint64_t run_next_limit, size_t num_background,
+                      double *background_polls_per_round_trip) {
+    struct llcm_scheduler_config config = llcm_scheduler_config_create_default(MAX_BACKGROUND + 2);
+    config.queue_flags = LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER;
+    config.run_next_limit = run_next_limit;
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init_with_config(&scheduler, config, llcm_allocator_create_default());
+    static struct ping_pong_state state;
+    state = (struct ping_pong_state){.awaiting_reply = false};
+    llcm_channel_init(&state.requests, 1);
+    llcm_channel_init(&state.replies, 1);
+    struct llcm_routine ping = {.poll = ping_poll, .arg0 = &state};
+    struct llcm_routine pong = {.poll = pong_poll, .arg0 = &state};
+    static struct llcm_routine background[MAX_BACKGROUND];
+    for (size_t i = 0; i < num_background; i++) {
+        llcm_routine_init(&background[i], background_poll, &state);
+        if (!llcm_scheduler_try_schedule_routine(&scheduler, &background[i])) {
+            exit(1);
+        }
+    }
+    // pong parks on the empty requests first
+    if (!llcm_scheduler_try_schedule_routine(&scheduler, &pong) ||
+        !llcm_scheduler_try_schedule_routine(&scheduler, &ping)) {
+        exit(1);
+    }
+
+    struct timespec ts_start;
+    struct timespec ts_end;
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    while (!state.done) {
+        llcm_scheduler_poll(&scheduler, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+    while (llcm_scheduler_poll(&scheduler, NULL)) {
+    }
+    // pong is parked again, wake it to let it see done
+    if (!llcm_channel_try_send(&state.requests, (void *) 1)) {
+        exit(1);
+    }
+    while (llcm_scheduler_poll(&scheduler, NULL)) {
+    }
+    *background_polls_per_round_trip = (double) state.num_background_polls / NUM_ROUND_TRIPS;
+    llcm_channel_uninit(&state.requests);
+    llcm_channel_uninit(&state.replies);
+    llcm_scheduler_uninit(&scheduler);
+    return (double) diff_timespec(&ts_end, &ts_start) / NUM_ROUND_TRIPS;
+}
+
+int main() {
+    thread_perf_mode_main_thread_init();
+    printf("running with round_trips(%lu)\n", NUM_ROUND_TRIPS);
+    size_t const background_counts[] = {0, 8, 64, MAX_BACKGROUND};
+    uint64_t const run_next_limits[] = {0, LLCM_SCHEDULER_DEFAULT_RUN_NEXT_LIMIT};
+    for (size_t i = 0; i < sizeof(background_counts) / sizeof(background_counts[0]); i++) {
+        for (size_t j = 0; j < sizeof(run_next_limits) / sizeof(run_next_limits[0]); j++) {
+            double round_trip_nanos = 0;
+            double background_polls = 0;
+            for (int k = 0; k < NUM_TESTS; k++) {
+                double background_polls_per_round_trip;
+                round_trip_nanos += ping_pong_test(run_next_limits[j], background_counts[i],
+                                                   &background_polls_per_round_trip);
+                background_polls += background_polls_per_round_trip;
+            }
+            printf("background(%zu) run_next_limit(%lu) round trip took nanos(%lf) background "
+                   "polls per round trip(%lf)\n",
+                   background_counts[i], run_next_limits[j], round_trip_nanos / NUM_TESTS,
+                   background_polls / NUM_TESTS);
+        }
+    }
+}
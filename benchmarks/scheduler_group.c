@@ -0,0 +1,150 @@
+#define _GNU_SOURCE
+
+#include "lib/scheduler_group.h"
+#include "benchmarks/utils.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#define NUM_ROUTINES     1024
+#define MAX_POLLS        1000UL
+#define WORK_ITERATIONS  200
+#define NUM_TESTS        10
+#define MAX_NUM_WORKERS  4
+
+struct test_config {
+    size_t num_workers;
+    bool steal;
+};
+
+struct test_result {
+    uint64_t cycles;
+    uint64_t nanos;
+};
+
+struct routine_state {
+    uint64_t num_polls;
+};
+
+// a fixed amount of work per poll, requeues itself until MAX_POLLS
+void routine_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct routine_state *state = arg0;
+    for (int i = 0; i < WORK_ITERATIONS; i++) {
+        __asm__ __volatile__("" ::: "memory");
+    }
+    if (++state->num_polls == MAX_POLLS) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+struct thread_args {
+    struct llcm_scheduler_group *group;
+    struct test_config const *config;
+    uint64_t *num_threads_ready;
+    uint64_t const *start_barrier;
+    uint64_t *num_finished_polls;
+    int tid;
+};
+
+void *thread_exec(void *arg0) {
+    struct thread_args *thread_args = arg0;
+    thread_perf_mode_init(thread_args->tid);
+    struct llcm_scheduler_group *group = thread_args->group;
+    struct llcm_scheduler *scheduler = llcm_scheduler_group_get_scheduler(group, thread_args->tid);
+    bool const steal = thread_args->config->steal;
+    __atomic_fetch_add(thread_args->num_threads_ready, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(thread_args->start_barrier, __ATOMIC_SEQ_CST) == 0) {
+    }
+
+    uint64_t local_num_polls = 0;
+    while (__atomic_load_n(thread_args->num_finished_polls, __ATOMIC_RELAXED) !=
+           NUM_ROUTINES * MAX_POLLS) {
+        bool const polled = steal ? llcm_scheduler_group_poll(group, thread_args->tid, NULL)
+                                  : llcm_scheduler_poll(scheduler, NULL);
+        local_num_polls += polled;
+        // publish progress in chunks, and whenever this worker runs out of work
+        if (local_num_polls == 64 || (!polled && 0 != local_num_polls)) {
+            __atomic_fetch_add(thread_args->num_finished_polls, local_num_polls, __ATOMIC_RELAXED);
+            local_num_polls = 0;
+        }
+    }
+    return NULL;
+}
+
+// every routine starts on worker 0, the remaining workers only help by stealing
+struct test_result imbalanced_test(struct test_config config) {
+    struct llcm_scheduler_group group;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_threads_ready = 0;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t start_barrier = 0;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_finished_polls = 0;
+    llcm_scheduler_group_init(&group, config.num_workers, NUM_ROUTINES);
+
+    struct routine_state states[NUM_ROUTINES];
+    struct llcm_routine routines[NUM_ROUTINES];
+    for (size_t i = 0; i < NUM_ROUTINES; i++) {
+        states[i] = (struct routine_state){.num_polls = 0};
+        llcm_routine_init(&routines[i], routine_poll, &states[i]);
+        if (!llcm_scheduler_try_schedule_routine(llcm_scheduler_group_get_scheduler(&group, 0),
+                                                 &routines[i])) {
+            exit(1);
+        }
+    }
+
+    pthread_t threads[MAX_NUM_WORKERS];
+    struct thread_args thread_args[MAX_NUM_WORKERS];
+    for (size_t tid = 0; tid < config.num_workers; tid++) {
+        thread_args[tid] = (struct thread_args){
+            .group = &group,
+            .config = &config,
+            .num_threads_ready = &num_threads_ready,
+            .start_barrier = &start_barrier,
+            .num_finished_polls = &num_finished_polls,
+            .tid = tid,
+        };
+        int rc = pthread_create(&threads[tid], NULL, thread_exec, &thread_args[tid]);
+        if (rc != 0) {
+            exit(1);
+        }
+    }
+    while (__atomic_load_n(&num_threads_ready, __ATOMIC_SEQ_CST) != config.num_workers) {
+    }
+    struct timespec ts_start;
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    uint64_t const cycle_start = rdtsc();
+    __atomic_store_n(&start_barrier, 1, __ATOMIC_SEQ_CST);
+    for (size_t tid = 0; tid < config.num_workers; tid++) {
+        pthread_join(threads[tid], NULL);
+    }
+    uint64_t const cycle_end = rdtsc();
+    struct timespec ts_end;
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+    llcm_scheduler_group_uninit(&group);
+
+    return (struct test_result){.cycles = cycle_end - cycle_start,
+                                .nanos = diff_timespec(&ts_end, &ts_start)};
+}
+
+void aggregate_test(struct test_config config) {
+    struct test_result total = {
+        .cycles = 0,
+        .nanos = 0,
+    };
+    for (int i = 0; i < NUM_TESTS; i++) {
+        struct test_result const current_test_result = imbalanced_test(config);
+        total.cycles += current_test_result.cycles;
+        total.nanos += current_test_result.nanos;
+    }
+    double const num_polls = (double) NUM_TESTS * NUM_ROUTINES * MAX_POLLS;
+    printf("workers(%lu) steal(%d) took cycles(%lf) nanos(%lf) per poll\n", config.num_workers,
+           config.steal, total.cycles / num_polls, total.nanos / num_polls);
+}
+
+int main() {
+    thread_perf_mode_main_thread_init();
+    printf("running with routines(%d) polls(%lu)\n", NUM_ROUTINES, MAX_POLLS);
+    for (size_t num_workers = 1; num_workers <= MAX_NUM_WORKERS; num_workers *= 2) {
+        aggregate_test((struct test_config){.num_workers = num_workers, .steal = false});
+        aggregate_test((struct test_config){.num_workers = num_workers, .steal = true});
+    }
+}
@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+
+#include "lib/shm_queue.h"
+#include "benchmarks/utils.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CAPACITY         1024
+#define NUM_ROUND_TRIPS  1000000UL
+#define NUM_MESSAGES     10000000UL
+#define NUM_TESTS        5
+#define SHM_QUEUE_NAME   "llcm_shm_queue_benchmark"
+
+// a feed handler process sending to a strategy process, which replies on a second channel. the
+// shm queues stand in for the sockets the two would use otherwise
+enum channel_kind {
+    CHANNEL_KIND_SHM_QUEUE,
+    CHANNEL_KIND_SHM_QUEUE_SPSC,
+    CHANNEL_KIND_SOCKET,
+};
+
+char const *channel_kind_names[] = {"shm_queue", "shm_queue_spsc", "unix_socket"};
+
+struct channel {
+    enum channel_kind kind;
+    struct llcm_shm_queue queue;
+    int fd;
+};
+
+struct channels {
+    struct channel request;
+    struct channel reply;
+    // the socket ends of the strategy process, each process closes the ends it does not use
+    int other_fds[2];
+};
+
+void send_value(struct channel *channel, uint64_t value) {
+    if (CHANNEL_KIND_SOCKET == channel->kind) {
+        if (sizeof(value) != write(channel->fd, &value, sizeof(value))) {
+            exit(1);
+        }
+        return;
+    }
+    while (!llcm_shm_queue_try_reserve_size_before_push(&channel->queue, 1)) {
+    }
+    llcm_shm_queue_push(&channel->queue, value);
+}
+
+uint64_t receive_value(struct channel *channel) {
+    uint64_t value = 0;
+    if (CHANNEL_KIND_SOCKET == channel->kind) {
+        // a stream socket, one read may return part of a value
+        size_t num_read = 0;
+        while (num_read < sizeof(value)) {
+            ssize_t const result =
+                read(channel->fd, (char *) &value + num_read, sizeof(value) - num_read);
+            if (result <= 0) {
+                exit(1);
+            }
+            num_read += result;
+        }
+        return value;
+    }
+    while (!llcm_shm_queue_try_pop(&channel->queue, &value)) {
+    }
+    llcm_shm_queue_unreserve_size_after_pop(&channel->queue, 1);
+    return value;
+}
+
+void close_channel(struct channel *channel) {
+    if (CHANNEL_KIND_SOCKET == channel->kind) {
+        close(channel->fd);
+    } else {
+        llcm_shm_queue_close(&channel->queue);
+    }
+}
+
+// the request queue is opened by name like an unrelated process would, the reply queue is an
+// anonymous memfd passed on by fork
+void create_channels(struct channels *channels, enum channel_kind kind) {
+    *channels = (struct channels){.request = {.kind = kind}, .reply = {.kind = kind}};
+    if (CHANNEL_KIND_SOCKET == kind) {
+        int request_fds[2];
+        int reply_fds[2];
+        if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, request_fds) ||
+            0 != socketpair(AF_UNIX, SOCK_STREAM, 0, reply_fds)) {
+            exit(1);
+        }
+        channels->request.fd = request_fds[0];
+        channels->reply.fd = reply_fds[0];
+        channels->other_fds[0] = request_fds[1];
+        channels->other_fds[1] = reply_fds[1];
+        return;
+    }
+    unsigned const flags = CHANNEL_KIND_SHM_QUEUE_SPSC == kind
+                               ? LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER |
+                                     LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER
+                               : 0;
+    llcm_shm_queue_unlink(SHM_QUEUE_NAME);
+    if (!llcm_shm_queue_create(&channels->request.queue, SHM_QUEUE_NAME, CAPACITY, flags) ||
+        !llcm_shm_queue_create(&channels->reply.queue, NULL, CAPACITY, flags)) {
+        exit(1);
+    }
+}
+
+// the view of the strategy process, the request and reply ends swapped
+void open_other_channels(struct channels *channels, struct channels *other) {
+    *other = (struct channels){.request = {.kind = channels->request.kind},
+                               .reply = {.kind = channels->reply.kind}};
+    if (CHANNEL_KIND_SOCKET == channels->request.kind) {
+        close(channels->request.fd);
+        close(channels->reply.fd);
+        other->request.fd = channels->other_fds[0];
+        other->reply.fd = channels->other_fds[1];
+        return;
+    }
+    int const reply_fd = dup(llcm_shm_queue_get_fd(&channels->reply.queue));
+    llcm_shm_queue_close(&channels->request.queue);
+    llcm_shm_queue_close(&channels->reply.queue);
+    if (!llcm_shm_queue_open(&other->request.queue, SHM_QUEUE_NAME) ||
+        !llcm_shm_queue_open_fd(&other->reply.queue, reply_fd)) {
+        exit(1);
+    }
+}
+
+void close_channels(struct channels *channels) {
+    close_channel(&channels->request);
+    close_channel(&channels->reply);
+    if (CHANNEL_KIND_SOCKET != channels->request.kind) {
+        llcm_shm_queue_unlink(SHM_QUEUE_NAME);
+    }
+}
+
+// echoes every request in round trip mode, or acknowledges the last message in one way mode
+void run_strategy_process(struct channels *channels, bool round_trip) {
+    thread_perf_mode_init(0);
+    struct channels other;
+    open_other_channels(channels, &other);
+    if (round_trip) {
+        for (uint64_t i = 0; i < NUM_ROUND_TRIPS; i++) {
+            send_value(&other.reply, receive_value(&other.request));
+        }
+    } else {
+        uint64_t checksum = 0;
+        for (uint64_t i = 0; i < NUM_MESSAGES; i++) {
+            checksum += receive_value(&other.request);
+        }
+        send_value(&other.reply, checksum);
+    }
+    close_channel(&other.request);
+    close_channel(&other.reply);
+    _exit(0);
+}
+
+// nanos per round trip, or per message one way
+double two_process_test(enum channel_kind kind, bool round_trip) {
+    struct channels channels;
+    create_channels(&channels, kind);
+    pid_t const pid = fork();
+    if (pid < 0) {
+        exit(1);
+    }
+    if (0 == pid) {
+        run_strategy_process(&channels, round_trip);
+    }
+    if (CHANNEL_KIND_SOCKET == kind) {
+        close(channels.other_fds[0]);
+        close(channels.other_fds[1]);
+    }
+    // the first round trip waits for the strategy process to start
+    send_value(&channels.request, 0);
+    uint64_t const num_values = round_trip ? NUM_ROUND_TRIPS : NUM_MESSAGES;
+    uint64_t checksum = 0;
+    struct timespec ts_start;
+    struct timespec ts_end;
+    if (round_trip) {
+        if (0 != receive_value(&channels.reply)) {
+            exit(1);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (uint64_t i = 1; i < num_values; i++) {
+            send_value(&channels.request, i);
+            checksum += receive_value(&channels.reply);
+        }
+    } else {
+        clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (uint64_t i = 1; i < num_values; i++) {
+            send_value(&channels.request, i);
+            checksum += i;
+        }
+        if (checksum != receive_value(&channels.reply)) {
+            exit(1);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+    int status;
+    if (pid != waitpid(pid, &status, 0) || !WIFEXITED(status) || 0 != WEXITSTATUS(status)) {
+        exit(1);
+    }
+    __asm__ __volatile__("" ::"r"(checksum));
+    close_channels(&channels);
+    return (double) diff_timespec(&ts_end, &ts_start) / (num_values - 1);
+}
+
+int main() {
+    thread_perf_mode_main_thread_init();
+    printf("running with round_trips(%lu) messages(%lu) capacity(%d)\n", NUM_ROUND_TRIPS,
+           NUM_MESSAGES, CAPACITY);
+    for (enum channel_kind kind = CHANNEL_KIND_SHM_QUEUE; kind <= CHANNEL_KIND_SOCKET; kind++) {
+        double round_trip_nanos = 0;
+        double one_way_nanos = 0;
+        for (int i = 0; i < NUM_TESTS; i++) {
+            round_trip_nanos += two_process_test(kind, true);
+            one_way_nanos += two_process_test(kind, false);
+        }
+        printf("channel(%s) round trip took nanos(%lf) one way message took nanos(%lf)\n",
+               channel_kind_names[kind], round_trip_nanos / NUM_TESTS, one_way_nanos / NUM_TESTS);
+    }
+}
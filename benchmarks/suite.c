@@ -0,0 +1,617 @@
+#define _GNU_SOURCE
+
+#include "lib/histogram.h"
+#include "lib/scheduler.h"
+#include "benchmarks/utils.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_NUM_THREADS 64
+
+enum output_format { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON };
+
+struct suite_config {
+    // queue, scheduler, migration or all
+    char const *bench;
+    // llcm, mutex_condvar, naive or all, only for the queue bench
+    char const *impl;
+    // 0 sweeps a few symmetric and asymmetric pairs
+    size_t num_producers;
+    size_t num_consumers;
+    size_t num_workers;
+    uint64_t num_ops;
+    size_t capacity;
+    size_t num_routines;
+    size_t num_repeats;
+    enum output_format format;
+    bool pin;
+};
+
+struct bench_result {
+    char const *bench;
+    char const *impl;
+    size_t num_producers;
+    size_t num_consumers;
+    size_t num_workers;
+    size_t run;
+    uint64_t num_ops;
+    uint64_t nanos;
+    // in nanos
+    struct llcm_histogram_summary latency;
+};
+
+// shared by every thread of one run, each counter on its own line
+struct run_sync {
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_threads_ready;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t start_barrier;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_done;
+};
+
+void run_sync_wait_for_start(struct run_sync *sync, int tid, bool pin) {
+    if (pin) {
+        thread_perf_mode_init(tid);
+    }
+    __atomic_fetch_add(&sync->num_threads_ready, 1, __ATOMIC_SEQ_CST);
+    while (0 == __atomic_load_n(&sync->start_barrier, __ATOMIC_SEQ_CST)) {
+    }
+}
+
+// releases the threads once all are ready, returns the start time
+struct timespec run_sync_start(struct run_sync *sync, size_t num_threads) {
+    while (__atomic_load_n(&sync->num_threads_ready, __ATOMIC_SEQ_CST) != num_threads) {
+    }
+    struct timespec ts_start;
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    __atomic_store_n(&sync->start_barrier, 1, __ATOMIC_SEQ_CST);
+    return ts_start;
+}
+
+void histogram_summary_to_nanos(struct llcm_histogram const *histogram,
+                                struct llcm_histogram_summary *summary) {
+    llcm_histogram_get_summary(histogram, summary);
+    summary->p50 = llcm_tsc_ticks_to_nanos(summary->p50);
+    summary->p99 = llcm_tsc_ticks_to_nanos(summary->p99);
+    summary->p999 = llcm_tsc_ticks_to_nanos(summary->p999);
+    summary->max = llcm_tsc_ticks_to_nanos(summary->max);
+}
+
+/* output */
+
+void print_header(enum output_format format) {
+    if (FORMAT_CSV == format) {
+        printf("bench,impl,producers,consumers,workers,run,ops,nanos,mops_per_sec,p50_ns,p99_ns,"
+               "p999_ns,max_ns\n");
+    } else if (FORMAT_JSON == format) {
+        printf("[");
+    }
+}
+
+void print_result(enum output_format format, struct bench_result const *result, bool first) {
+    double const mops_per_sec = result->num_ops * 1000.0 / result->nanos;
+    struct llcm_histogram_summary const *latency = &result->latency;
+    switch (format) {
+    case FORMAT_TEXT:
+        printf("bench(%s) impl(%s) producers(%lu) consumers(%lu) workers(%lu) run(%lu) ops(%lu) "
+               "mops_per_sec(%.3f) p50_ns(%lu) p99_ns(%lu) p999_ns(%lu) max_ns(%lu)\n",
+               result->bench, result->impl, result->num_producers, result->num_consumers,
+               result->num_workers, result->run, result->num_ops, mops_per_sec, latency->p50,
+               latency->p99, latency->p999, latency->max);
+        break;
+    case FORMAT_CSV:
+        printf("%s,%s,%lu,%lu,%lu,%lu,%lu,%lu,%.3f,%lu,%lu,%lu,%lu\n", result->bench,
+               result->impl, result->num_producers, result->num_consumers, result->num_workers,
+               result->run, result->num_ops, result->nanos, mops_per_sec, latency->p50,
+               latency->p99, latency->p999, latency->max);
+        break;
+    case FORMAT_JSON:
+        printf("%s\n{\"bench\":\"%s\",\"impl\":\"%s\",\"producers\":%lu,\"consumers\":%lu,"
+               "\"workers\":%lu,\"run\":%lu,\"ops\":%lu,\"nanos\":%lu,\"mops_per_sec\":%.3f,"
+               "\"p50_ns\":%lu,\"p99_ns\":%lu,\"p999_ns\":%lu,\"max_ns\":%lu}",
+               first ? "" : ",", result->bench, result->impl, result->num_producers,
+               result->num_consumers, result->num_workers, result->run, result->num_ops,
+               result->nanos, mops_per_sec, latency->p50, latency->p99, latency->p999,
+               latency->max);
+        break;
+    }
+    fflush(stdout);
+}
+
+void print_footer(enum output_format format) {
+    if (FORMAT_JSON == format) {
+        printf("\n]\n");
+    }
+}
+
+/* queues, every value is the rdtsc of its push so consumers measure end to end latency */
+
+struct queue_impl {
+    char const *name;
+    void *(*create)(size_t capacity);
+    void (*destroy)(void *queue);
+    // both wait until they succeed
+    void (*push)(void *queue, void *value);
+    void *(*pop)(void *queue);
+};
+
+void *llcm_queue_create(size_t capacity) {
+    struct llcm_concurrent_queue *queue = malloc(sizeof(*queue));
+    llcm_concurrent_queue_init(queue, capacity);
+    return queue;
+}
+
+void llcm_queue_destroy(void *queue) {
+    llcm_concurrent_queue_uninit(queue);
+    free(queue);
+}
+
+void llcm_queue_push(void *queue, void *value) {
+    while (!llcm_concurrent_queue_try_reserve_size_before_push(queue, 1)) {
+        llcm_cpu_relax();
+    }
+    llcm_concurrent_queue_push(queue, value);
+}
+
+void *llcm_queue_pop(void *queue) {
+    void *value;
+    while (NULL == (value = llcm_concurrent_queue_try_pop(queue))) {
+        llcm_cpu_relax();
+    }
+    llcm_concurrent_queue_unreserve_size_after_pop(queue, 1);
+    return value;
+}
+
+// a ring guarded by one lock, either a mutex with condition variables or a spinlock
+struct locked_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint32_t spinlock;
+    void **values;
+    size_t capacity;
+    size_t head;
+    size_t size;
+};
+
+void *locked_queue_create(size_t capacity) {
+    struct locked_queue *queue = aligned_alloc(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE,
+                                               sizeof(struct locked_queue));
+    memset(queue, 0, sizeof(*queue));
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    queue->values = malloc(capacity * sizeof(void *));
+    queue->capacity = capacity;
+    return queue;
+}
+
+void locked_queue_destroy(void *arg) {
+    struct locked_queue *queue = arg;
+    pthread_mutex_destroy(&queue->mutex);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->values);
+    free(queue);
+}
+
+void mutex_condvar_queue_push(void *arg, void *value) {
+    struct locked_queue *queue = arg;
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->size == queue->capacity) {
+        pthread_cond_wait(&queue->not_full, &queue->mutex);
+    }
+    queue->values[(queue->head + queue->size++) % queue->capacity] = value;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+void *mutex_condvar_queue_pop(void *arg) {
+    struct locked_queue *queue = arg;
+    pthread_mutex_lock(&queue->mutex);
+    while (0 == queue->size) {
+        pthread_cond_wait(&queue->not_empty, &queue->mutex);
+    }
+    void *value = queue->values[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->size--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->mutex);
+    return value;
+}
+
+void naive_queue_lock(struct locked_queue *queue) {
+    while (__atomic_exchange_n(&queue->spinlock, 1, __ATOMIC_ACQUIRE)) {
+        llcm_cpu_relax();
+    }
+}
+
+void naive_queue_unlock(struct locked_queue *queue) {
+    __atomic_store_n(&queue->spinlock, 0, __ATOMIC_RELEASE);
+}
+
+void naive_queue_push(void *arg, void *value) {
+    struct locked_queue *queue = arg;
+    for (;;) {
+        naive_queue_lock(queue);
+        if (queue->size != queue->capacity) {
+            queue->values[(queue->head + queue->size++) % queue->capacity] = value;
+            naive_queue_unlock(queue);
+            return;
+        }
+        naive_queue_unlock(queue);
+        llcm_cpu_relax();
+    }
+}
+
+void *naive_queue_pop(void *arg) {
+    struct locked_queue *queue = arg;
+    for (;;) {
+        naive_queue_lock(queue);
+        if (0 != queue->size) {
+            void *value = queue->values[queue->head];
+            queue->head = (queue->head + 1) % queue->capacity;
+            queue->size--;
+            naive_queue_unlock(queue);
+            return value;
+        }
+        naive_queue_unlock(queue);
+        llcm_cpu_relax();
+    }
+}
+
+struct queue_impl const queue_impls[] = {
+    {"llcm", llcm_queue_create, llcm_queue_destroy, llcm_queue_push, llcm_queue_pop},
+    {"mutex_condvar", locked_queue_create, locked_queue_destroy, mutex_condvar_queue_push,
+     mutex_condvar_queue_pop},
+    {"naive", locked_queue_create, locked_queue_destroy, naive_queue_push, naive_queue_pop},
+};
+
+struct queue_thread_args {
+    struct queue_impl const *impl;
+    void *queue;
+    struct run_sync *sync;
+    struct suite_config const *config;
+    uint64_t num_ops;
+    // only for consumers
+    struct llcm_histogram latency;
+    int tid;
+};
+
+void *producer_exec(void *arg0) {
+    struct queue_thread_args *args = arg0;
+    run_sync_wait_for_start(args->sync, args->tid, args->config->pin);
+    for (uint64_t i = 0; i < args->num_ops; i++) {
+        args->impl->push(args->queue, (void *) llcm_rdtsc());
+    }
+    return NULL;
+}
+
+void *consumer_exec(void *arg0) {
+    struct queue_thread_args *args = arg0;
+    run_sync_wait_for_start(args->sync, args->tid, args->config->pin);
+    for (uint64_t i = 0; i < args->num_ops; i++) {
+        uint64_t const push_tsc = (uint64_t) args->impl->pop(args->queue);
+        uint64_t const now_tsc = llcm_rdtsc();
+        llcm_histogram_record(&args->latency, now_tsc > push_tsc ? now_tsc - push_tsc : 0);
+    }
+    return NULL;
+}
+
+struct bench_result queue_bench(struct suite_config const *config,
+                                struct queue_impl const *impl, size_t num_producers,
+                                size_t num_consumers) {
+    // every consumer pops exactly its share, so the blocking baselines always finish
+    uint64_t const ops_per_consumer = config->num_ops / num_consumers;
+    uint64_t const num_ops = ops_per_consumer * num_consumers;
+    void *queue = impl->create(config->capacity);
+    struct run_sync sync = {0};
+    size_t const num_threads = num_producers + num_consumers;
+    pthread_t threads[MAX_NUM_THREADS];
+    struct queue_thread_args args[MAX_NUM_THREADS];
+    for (size_t tid = 0; tid < num_threads; tid++) {
+        bool const producer = tid < num_producers;
+        uint64_t thread_num_ops = ops_per_consumer;
+        if (producer) {
+            thread_num_ops = num_ops / num_producers + (tid < num_ops % num_producers);
+        }
+        args[tid] = (struct queue_thread_args){.impl = impl,
+                                               .queue = queue,
+                                               .sync = &sync,
+                                               .config = config,
+                                               .num_ops = thread_num_ops,
+                                               .tid = tid};
+        llcm_histogram_init(&args[tid].latency, llcm_allocator_create_default());
+        int rc = pthread_create(&threads[tid], NULL, producer ? producer_exec : consumer_exec,
+                                &args[tid]);
+        if (rc != 0) {
+            exit(1);
+        }
+    }
+    struct timespec const ts_start = run_sync_start(&sync, num_threads);
+    for (size_t tid = 0; tid < num_threads; tid++) {
+        pthread_join(threads[tid], NULL);
+    }
+    struct timespec ts_end;
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+
+    struct bench_result result = {.bench = "queue",
+                                  .impl = impl->name,
+                                  .num_producers = num_producers,
+                                  .num_consumers = num_consumers,
+                                  .num_ops = num_ops,
+                                  .nanos = diff_timespec(&ts_end, &ts_start)};
+    for (size_t tid = 1; tid < num_threads; tid++) {
+        llcm_histogram_merge(&args[0].latency, &args[tid].latency);
+    }
+    histogram_summary_to_nanos(&args[0].latency, &result.latency);
+    for (size_t tid = 0; tid < num_threads; tid++) {
+        llcm_histogram_uninit(&args[tid].latency);
+    }
+    impl->destroy(queue);
+    return result;
+}
+
+/* schedulers */
+
+struct routine_state {
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_polls;
+    uint64_t max_polls;
+    uint64_t *num_done;
+    // the routine moves to the next scheduler on every poll when there is more than one
+    struct llcm_scheduler *schedulers;
+    size_t num_schedulers;
+    size_t next_scheduler;
+};
+
+void routine_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct routine_state *state = arg0;
+    if (++state->num_polls == state->max_polls) {
+        __atomic_fetch_add(state->num_done, 1, __ATOMIC_RELAXED);
+        llcm_exec_handle_cancel_routine(handle);
+        return;
+    }
+    if (state->num_schedulers > 1) {
+        state->next_scheduler = (state->next_scheduler + 1) % state->num_schedulers;
+        llcm_exec_handle_try_switch_scheduler(handle, &state->schedulers[state->next_scheduler]);
+    }
+}
+
+struct worker_args {
+    struct llcm_scheduler *scheduler;
+    struct run_sync *sync;
+    struct suite_config const *config;
+    int tid;
+};
+
+void *worker_exec(void *arg0) {
+    struct worker_args *args = arg0;
+    run_sync_wait_for_start(args->sync, args->tid, args->config->pin);
+    uint64_t const num_routines = args->config->num_routines;
+    while (__atomic_load_n(&args->sync->num_done, __ATOMIC_RELAXED) != num_routines) {
+        llcm_scheduler_poll(args->scheduler, NULL);
+    }
+    return NULL;
+}
+
+// every worker polls one shared scheduler, or with migrate its own scheduler while routines
+// hop between all of them
+struct bench_result scheduler_bench(struct suite_config const *config, bool migrate) {
+    size_t const num_workers = config->num_workers;
+    size_t const num_schedulers = migrate ? num_workers : 1;
+    uint64_t const max_polls = config->num_ops / config->num_routines;
+    struct run_sync sync = {0};
+
+    struct llcm_scheduler_config scheduler_config =
+        llcm_scheduler_config_create_default(config->num_routines);
+    scheduler_config.record_latency = true;
+    struct llcm_scheduler *schedulers = aligned_alloc(
+        LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE, num_schedulers * sizeof(struct llcm_scheduler));
+    for (size_t i = 0; i < num_schedulers; i++) {
+        llcm_scheduler_init_with_config(&schedulers[i], scheduler_config,
+                                        llcm_allocator_create_default());
+    }
+    struct routine_state *states =
+        aligned_alloc(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE,
+                      config->num_routines * sizeof(struct routine_state));
+    struct llcm_routine *routines = malloc(config->num_routines * sizeof(struct llcm_routine));
+    for (size_t i = 0; i < config->num_routines; i++) {
+        states[i] = (struct routine_state){.max_polls = max_polls,
+                                           .num_done = &sync.num_done,
+                                           .schedulers = schedulers,
+                                           .num_schedulers = num_schedulers,
+                                           .next_scheduler = i % num_schedulers};
+        llcm_routine_init(&routines[i], routine_poll, &states[i]);
+        if (!llcm_scheduler_try_schedule_routine(&schedulers[i % num_schedulers], &routines[i])) {
+            exit(1);
+        }
+    }
+
+    pthread_t threads[MAX_NUM_THREADS];
+    struct worker_args args[MAX_NUM_THREADS];
+    for (size_t tid = 0; tid < num_workers; tid++) {
+        args[tid] = (struct worker_args){.scheduler = &schedulers[tid % num_schedulers],
+                                         .sync = &sync,
+                                         .config = config,
+                                         .tid = tid};
+        int rc = pthread_create(&threads[tid], NULL, worker_exec, &args[tid]);
+        if (rc != 0) {
+            exit(1);
+        }
+    }
+    struct timespec const ts_start = run_sync_start(&sync, num_workers);
+    for (size_t tid = 0; tid < num_workers; tid++) {
+        pthread_join(threads[tid], NULL);
+    }
+    struct timespec ts_end;
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+
+    struct bench_result result = {.bench = migrate ? "migration" : "scheduler",
+                                  .impl = "llcm",
+                                  .num_workers = num_workers,
+                                  .num_ops = max_polls * config->num_routines,
+                                  .nanos = diff_timespec(&ts_end, &ts_start)};
+    // schedule to run latency, across every scheduler
+    for (size_t i = 1; i < num_schedulers; i++) {
+        llcm_histogram_merge(llcm_scheduler_get_schedule_latency(&schedulers[0]),
+                             llcm_scheduler_get_schedule_latency(&schedulers[i]));
+    }
+    histogram_summary_to_nanos(llcm_scheduler_get_schedule_latency(&schedulers[0]),
+                               &result.latency);
+    for (size_t i = 0; i < num_schedulers; i++) {
+        llcm_scheduler_uninit(&schedulers[i]);
+    }
+    free(routines);
+    free(states);
+    free(schedulers);
+    return result;
+}
+
+/* driver */
+
+void usage(char const *program) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --bench queue|scheduler|migration|all  (all)\n"
+            "  --impl llcm|mutex_condvar|naive|all    queue implementation (all)\n"
+            "  --producers N --consumers N            queue threads, 0 sweeps (0)\n"
+            "  --workers N                            scheduler polling threads, migration needs\n"
+            "                                         at least 2 (2)\n"
+            "  --ops N                                values or polls per run (1000000)\n"
+            "  --capacity N                           queue capacity (1024)\n"
+            "  --routines N                           scheduler routines (256)\n"
+            "  --repeat N                             runs per configuration (3)\n"
+            "  --format text|csv|json                 (text)\n"
+            "  --no-pin                               do not pin threads to cores\n",
+            program);
+    exit(2);
+}
+
+uint64_t parse_number(char const *program, char const *arg) {
+    char *end;
+    uint64_t const value = strtoull(arg, &end, 10);
+    if ('\0' == *arg || '\0' != *end) {
+        usage(program);
+    }
+    return value;
+}
+
+struct suite_config parse_args(int argc, char **argv) {
+    struct suite_config config = {.bench = "all",
+                                  .impl = "all",
+                                  .num_producers = 0,
+                                  .num_consumers = 0,
+                                  .num_workers = 2,
+                                  .num_ops = 1000000,
+                                  .capacity = 1024,
+                                  .num_routines = 256,
+                                  .num_repeats = 3,
+                                  .format = FORMAT_TEXT,
+                                  .pin = true};
+    for (int i = 1; i < argc; i++) {
+        char const *option = argv[i];
+        if (0 == strcmp(option, "--no-pin")) {
+            config.pin = false;
+            continue;
+        }
+        if (i + 1 == argc) {
+            usage(argv[0]);
+        }
+        char const *value = argv[++i];
+        if (0 == strcmp(option, "--bench")) {
+            config.bench = value;
+        } else if (0 == strcmp(option, "--impl")) {
+            config.impl = value;
+        } else if (0 == strcmp(option, "--producers")) {
+            config.num_producers = parse_number(argv[0], value);
+        } else if (0 == strcmp(option, "--consumers")) {
+            config.num_consumers = parse_number(argv[0], value);
+        } else if (0 == strcmp(option, "--workers")) {
+            config.num_workers = parse_number(argv[0], value);
+        } else if (0 == strcmp(option, "--ops")) {
+            config.num_ops = parse_number(argv[0], value);
+        } else if (0 == strcmp(option, "--capacity")) {
+            config.capacity = parse_number(argv[0], value);
+        } else if (0 == strcmp(option, "--routines")) {
+            config.num_routines = parse_number(argv[0], value);
+        } else if (0 == strcmp(option, "--repeat")) {
+            config.num_repeats = parse_number(argv[0], value);
+        } else if (0 == strcmp(option, "--format")) {
+            if (0 == strcmp(value, "text")) {
+                config.format = FORMAT_TEXT;
+            } else if (0 == strcmp(value, "csv")) {
+                config.format = FORMAT_CSV;
+            } else if (0 == strcmp(value, "json")) {
+                config.format = FORMAT_JSON;
+            } else {
+                usage(argv[0]);
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+    // producers and consumers are either both given or both swept
+    bool const valid_queue_threads =
+        (0 == config.num_producers) == (0 == config.num_consumers) &&
+        config.num_producers + config.num_consumers <= MAX_NUM_THREADS;
+    if (!valid_queue_threads || 0 == config.num_workers || config.num_workers > MAX_NUM_THREADS ||
+        0 == config.capacity || 0 == config.num_routines || config.num_ops < config.num_routines) {
+        usage(argv[0]);
+    }
+    return config;
+}
+
+bool selected(char const *option, char const *name) {
+    return 0 == strcmp(option, "all") || 0 == strcmp(option, name);
+}
+
+int main(int argc, char **argv) {
+    struct suite_config const config = parse_args(argc, argv);
+    if (config.pin) {
+        thread_perf_mode_main_thread_init();
+    }
+    // calibrate before any timed run
+    llcm_tsc_calibrate();
+
+    // producers:consumers pairs swept when none are given
+    size_t const sweep[][2] = {{1, 1}, {2, 2}, {4, 1}, {1, 4}};
+    size_t const num_pairs = 0 == config.num_producers ? sizeof(sweep) / sizeof(sweep[0]) : 1;
+    bool first = true;
+    print_header(config.format);
+    for (size_t run = 0; run < config.num_repeats; run++) {
+        if (selected(config.bench, "queue")) {
+            for (size_t i = 0; i < sizeof(queue_impls) / sizeof(queue_impls[0]); i++) {
+                if (!selected(config.impl, queue_impls[i].name)) {
+                    continue;
+                }
+                for (size_t pair = 0; pair < num_pairs; pair++) {
+                    size_t const num_producers =
+                        0 == config.num_producers ? sweep[pair][0] : config.num_producers;
+                    size_t const num_consumers =
+                        0 == config.num_consumers ? sweep[pair][1] : config.num_consumers;
+                    struct bench_result result =
+                        queue_bench(&config, &queue_impls[i], num_producers, num_consumers);
+                    result.run = run;
+                    print_result(config.format, &result, first);
+                    first = false;
+                }
+            }
+        }
+        if (selected(config.bench, "scheduler")) {
+            struct bench_result result = scheduler_bench(&config, false);
+            result.run = run;
+            print_result(config.format, &result, first);
+            first = false;
+        }
+        // routines need a second scheduler to move to, each polled by its own worker
+        if (selected(config.bench, "migration") && config.num_workers > 1) {
+            struct bench_result result = scheduler_bench(&config, true);
+            result.run = run;
+            print_result(config.format, &result, first);
+            first = false;
+        }
+    }
+    print_footer(config.format);
+}
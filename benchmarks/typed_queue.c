@@ -0,0 +1,247 @@
+#define _GNU_SOURCE
+
+#include "lib/typed_queue.h"
+#include "benchmarks/utils.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#define CAPACITY     1024
+#define NUM_MESSAGES 10000000UL
+#define NUM_TESTS    5
+
+// a typical 48 byte market data message
+struct message {
+    uint64_t sequence;
+    uint64_t instrument;
+    double price;
+    uint64_t quantity;
+    uint64_t timestamp;
+    uint64_t flags;
+};
+
+LLCM_DEFINE_QUEUE(message_queue, struct message, CAPACITY)
+LLCM_DEFINE_QUEUE_WITH_FLAGS(spsc_message_queue, struct message, CAPACITY,
+                             LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER |
+                                 LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER)
+LLCM_DEFINE_QUEUE(u64_queue, uint64_t, CAPACITY)
+
+enum queue_kind {
+    // void * queue carrying pointers into a message pool, the usual way to pass structs
+    QUEUE_KIND_GENERIC_POOL,
+    QUEUE_KIND_GENERIC_POOL_SPSC,
+    QUEUE_KIND_TYPED_INLINE,
+    QUEUE_KIND_TYPED_INLINE_SPSC,
+    // pointer sized payloads, only the folded mask and array differ
+    QUEUE_KIND_GENERIC_U64,
+    QUEUE_KIND_TYPED_U64,
+};
+
+char const *queue_kind_names[] = {"generic_pool", "generic_pool_spsc", "typed_inline",
+                                  "typed_inline_spsc", "generic_u64", "typed_u64"};
+
+struct test_state {
+    enum queue_kind kind;
+    struct llcm_concurrent_queue generic;
+    struct message *pool;
+    void *typed;
+    size_t typed_size;
+    uint64_t checksum;
+    uint64_t *num_threads_ready;
+    uint64_t const *start_barrier;
+};
+
+struct message create_message(uint64_t sequence) {
+    return (struct message){.sequence = sequence,
+                            .instrument = sequence & 255,
+                            .price = (double) sequence,
+                            .quantity = 100,
+                            .timestamp = sequence,
+                            .flags = 0};
+}
+
+// the pool slot of a sequence number is free again once its reservation was released, as long as
+// there is a single producer and a single consumer
+void produce(struct test_state *state, uint64_t sequence) {
+    struct message const message = create_message(sequence);
+    switch (state->kind) {
+    case QUEUE_KIND_GENERIC_POOL:
+    case QUEUE_KIND_GENERIC_POOL_SPSC:
+        while (!llcm_concurrent_queue_try_reserve_size_before_push(&state->generic, 1)) {
+        }
+        state->pool[sequence & (CAPACITY - 1)] = message;
+        llcm_concurrent_queue_push(&state->generic, &state->pool[sequence & (CAPACITY - 1)]);
+        break;
+    case QUEUE_KIND_TYPED_INLINE:
+        while (!message_queue_try_reserve_size_before_push(state->typed, 1)) {
+        }
+        message_queue_push(state->typed, &message);
+        break;
+    case QUEUE_KIND_TYPED_INLINE_SPSC:
+        while (!spsc_message_queue_try_reserve_size_before_push(state->typed, 1)) {
+        }
+        spsc_message_queue_push(state->typed, &message);
+        break;
+    case QUEUE_KIND_GENERIC_U64:
+        while (!llcm_concurrent_queue_try_reserve_size_before_push(&state->generic, 1)) {
+        }
+        llcm_concurrent_queue_push(&state->generic, (void *) (sequence + 1));
+        break;
+    case QUEUE_KIND_TYPED_U64:
+        while (!u64_queue_try_reserve_size_before_push(state->typed, 1)) {
+        }
+        u64_queue_push(state->typed, &sequence);
+        break;
+    }
+}
+
+// spins until a message arrives, returns part of it so the read can not be optimized out
+uint64_t consume(struct test_state *state) {
+    struct message message;
+    uint64_t value = 0;
+    switch (state->kind) {
+    case QUEUE_KIND_GENERIC_POOL:
+    case QUEUE_KIND_GENERIC_POOL_SPSC: {
+        struct message *pointer = NULL;
+        while (NULL == (pointer = llcm_concurrent_queue_try_pop(&state->generic))) {
+        }
+        message = *pointer;
+        llcm_concurrent_queue_unreserve_size_after_pop(&state->generic, 1);
+        return message.sequence + message.quantity;
+    }
+    case QUEUE_KIND_TYPED_INLINE:
+        while (!message_queue_try_pop(state->typed, &message)) {
+        }
+        message_queue_unreserve_size_after_pop(state->typed, 1);
+        return message.sequence + message.quantity;
+    case QUEUE_KIND_TYPED_INLINE_SPSC:
+        while (!spsc_message_queue_try_pop(state->typed, &message)) {
+        }
+        spsc_message_queue_unreserve_size_after_pop(state->typed, 1);
+        return message.sequence + message.quantity;
+    case QUEUE_KIND_GENERIC_U64: {
+        void *pointer = NULL;
+        while (NULL == (pointer = llcm_concurrent_queue_try_pop(&state->generic))) {
+        }
+        llcm_concurrent_queue_unreserve_size_after_pop(&state->generic, 1);
+        return (uint64_t) pointer;
+    }
+    case QUEUE_KIND_TYPED_U64:
+        while (!u64_queue_try_pop(state->typed, &value)) {
+        }
+        u64_queue_unreserve_size_after_pop(state->typed, 1);
+        return value;
+    }
+    return 0;
+}
+
+void init_state(struct test_state *state, enum queue_kind kind) {
+    struct llcm_allocator const allocator = llcm_allocator_create_default();
+    *state = (struct test_state){.kind = kind};
+    unsigned const spsc_flags =
+        LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER | LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER;
+    llcm_concurrent_queue_init_with_flags(
+        &state->generic, CAPACITY, QUEUE_KIND_GENERIC_POOL_SPSC == kind ? spsc_flags : 0,
+        allocator);
+    state->pool = llcm_allocator_allocate(allocator, LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE,
+                                          sizeof(struct message) * CAPACITY);
+    size_t typed_alignment = alignof(struct message_queue);
+    state->typed_size = sizeof(struct message_queue);
+    if (QUEUE_KIND_TYPED_INLINE_SPSC == kind) {
+        typed_alignment = alignof(struct spsc_message_queue);
+        state->typed_size = sizeof(struct spsc_message_queue);
+    } else if (QUEUE_KIND_TYPED_U64 == kind) {
+        typed_alignment = alignof(struct u64_queue);
+        state->typed_size = sizeof(struct u64_queue);
+    }
+    state->typed = llcm_allocator_allocate(allocator, typed_alignment, state->typed_size);
+    if (QUEUE_KIND_TYPED_INLINE == kind) {
+        message_queue_init(state->typed);
+    } else if (QUEUE_KIND_TYPED_INLINE_SPSC == kind) {
+        spsc_message_queue_init(state->typed);
+    } else if (QUEUE_KIND_TYPED_U64 == kind) {
+        u64_queue_init(state->typed);
+    }
+}
+
+void uninit_state(struct test_state *state) {
+    struct llcm_allocator const allocator = llcm_allocator_create_default();
+    llcm_allocator_free(allocator, state->typed, state->typed_size);
+    llcm_allocator_free(allocator, state->pool, sizeof(struct message) * CAPACITY);
+    llcm_concurrent_queue_uninit(&state->generic);
+}
+
+// push and pop on one thread, the pure per operation cost without any cache line transfers
+double single_thread_test(enum queue_kind kind) {
+    struct test_state state;
+    init_state(&state, kind);
+    struct timespec ts_start;
+    struct timespec ts_end;
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    for (uint64_t i = 0; i < NUM_MESSAGES; i++) {
+        produce(&state, i);
+        state.checksum += consume(&state);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+    __asm__ __volatile__("" ::"r"(state.checksum));
+    uninit_state(&state);
+    return (double) diff_timespec(&ts_end, &ts_start) / NUM_MESSAGES;
+}
+
+void *producer_exec(void *arg0) {
+    struct test_state *state = arg0;
+    thread_perf_mode_init(0);
+    __atomic_fetch_add(state->num_threads_ready, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(state->start_barrier, __ATOMIC_SEQ_CST) == 0) {
+    }
+    for (uint64_t i = 0; i < NUM_MESSAGES; i++) {
+        produce(state, i);
+    }
+    return NULL;
+}
+
+// one producer thread and one consumer thread, every message crosses cores
+double two_thread_test(enum queue_kind kind) {
+    struct test_state state;
+    init_state(&state, kind);
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_threads_ready = 0;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t start_barrier = 0;
+    state.num_threads_ready = &num_threads_ready;
+    state.start_barrier = &start_barrier;
+    pthread_t producer;
+    if (0 != pthread_create(&producer, NULL, producer_exec, &state)) {
+        exit(1);
+    }
+    while (__atomic_load_n(&num_threads_ready, __ATOMIC_SEQ_CST) != 1) {
+    }
+    struct timespec ts_start;
+    struct timespec ts_end;
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    __atomic_store_n(&start_barrier, 1, __ATOMIC_SEQ_CST);
+    for (uint64_t i = 0; i < NUM_MESSAGES; i++) {
+        state.checksum += consume(&state);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+    pthread_join(producer, NULL);
+    __asm__ __volatile__("" ::"r"(state.checksum));
+    uninit_state(&state);
+    return (double) diff_timespec(&ts_end, &ts_start) / NUM_MESSAGES;
+}
+
+int main() {
+    thread_perf_mode_main_thread_init();
+    printf("running with messages(%lu) capacity(%d) message_size(%lu)\n", NUM_MESSAGES, CAPACITY,
+           sizeof(struct message));
+    for (enum queue_kind kind = QUEUE_KIND_GENERIC_POOL; kind <= QUEUE_KIND_TYPED_U64; kind++) {
+        double single_thread_nanos = 0;
+        double two_thread_nanos = 0;
+        for (int i = 0; i < NUM_TESTS; i++) {
+            single_thread_nanos += single_thread_test(kind);
+            two_thread_nanos += two_thread_test(kind);
+        }
+        printf("queue(%s) single thread took nanos(%lf) two threads took nanos(%lf)\n",
+               queue_kind_names[kind], single_thread_nanos / NUM_TESTS,
+               two_thread_nanos / NUM_TESTS);
+    }
+}
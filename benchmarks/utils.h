@@ -3,6 +3,8 @@
 #include <stdbool.h>
 #define _GNU_SOURCE
 
+#include "lib/utils.h"
+
 #include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -19,25 +21,15 @@ uint64_t diff_timespec(const struct timespec *, const struct timespec *);
 /* private */
 
 void set_affinity_(int cpu) {
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(cpu, &cpuset);
-
-    pthread_t current_thread = pthread_self();
-    int ret = pthread_setaffinity_np(current_thread, sizeof(cpu_set_t), &cpuset);
-    if (ret != 0) {
-        perror("pthread_setaffinity_np");
+    if (!llcm_thread_set_affinity(cpu)) {
+        fprintf(stderr, "llcm_thread_set_affinity(%d) failed\n", cpu);
         exit(1);
     }
 }
 
 void set_realtime_priority_() {
-    struct sched_param param;
-    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
-
-    int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
-    if (ret != 0) {
-        perror("pthread_setschedparam");
+    if (!llcm_thread_set_realtime_priority()) {
+        fprintf(stderr, "llcm_thread_set_realtime_priority failed\n");
         exit(1);
     }
 }
@@ -0,0 +1,112 @@
+#define _GNU_SOURCE
+
+#include "lib/scheduler.h"
+#include "benchmarks/utils.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#define NUM_SAMPLES         2000
+#define MAX_IDLE_NANOS      200000
+#define PERCENTILES_COUNT   5
+
+struct test_config {
+    char const *name;
+    struct llcm_wait_strategy strategy;
+};
+
+struct routine_state {
+    uint64_t scheduled_tsc;
+    uint64_t polled_tsc;
+    uint64_t is_done;
+};
+
+void routine_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct routine_state *state = arg0;
+    state->polled_tsc = rdtsc();
+    __atomic_store_n(&state->is_done, 1, __ATOMIC_RELEASE);
+    llcm_exec_handle_cancel_routine(handle);
+}
+
+struct thread_args {
+    struct llcm_scheduler *scheduler;
+    struct test_config const *config;
+    uint64_t const *stop;
+};
+
+void *poller_thread_exec(void *arg0) {
+    struct thread_args *args = arg0;
+    thread_perf_mode_init(0);
+    struct llcm_waiter waiter;
+    llcm_waiter_init(&waiter, args->config->strategy);
+    while (0 == __atomic_load_n(args->stop, __ATOMIC_RELAXED)) {
+        llcm_scheduler_poll_or_wait(args->scheduler, NULL, &waiter);
+    }
+    return NULL;
+}
+
+int compare_uint64(void const *lhs, void const *rhs) {
+    uint64_t const a = *(uint64_t const *) lhs;
+    uint64_t const b = *(uint64_t const *) rhs;
+    return (a > b) - (a < b);
+}
+
+// the producer idles for a random time so the poller has a chance to back off, then measures
+// how long the scheduled routine takes to run
+void wake_latency_test(struct test_config config) {
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 4);
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t stop = 0;
+    struct thread_args args = {.scheduler = &scheduler, .config = &config, .stop = &stop};
+    pthread_t thread;
+    if (0 != pthread_create(&thread, NULL, poller_thread_exec, &args)) {
+        exit(1);
+    }
+
+    static uint64_t latencies[NUM_SAMPLES];
+    srand(42);
+    for (size_t i = 0; i < NUM_SAMPLES; i++) {
+        struct timespec const idle = {.tv_sec = 0, .tv_nsec = rand() % MAX_IDLE_NANOS};
+        nanosleep(&idle, NULL);
+
+        struct routine_state state = {.scheduled_tsc = rdtsc(), .polled_tsc = 0, .is_done = 0};
+        struct llcm_routine routine = {.poll = routine_poll, .arg0 = &state};
+        if (!llcm_scheduler_try_schedule_routine(&scheduler, &routine)) {
+            exit(1);
+        }
+        while (0 == __atomic_load_n(&state.is_done, __ATOMIC_ACQUIRE)) {
+        }
+        latencies[i] = llcm_tsc_ticks_to_nanos(state.polled_tsc - state.scheduled_tsc);
+    }
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    // a parked poller wakes up on its own after max_park_nanos
+    pthread_join(thread, NULL);
+    llcm_scheduler_uninit(&scheduler);
+
+    qsort(latencies, NUM_SAMPLES, sizeof(latencies[0]), compare_uint64);
+    double const percentiles[PERCENTILES_COUNT] = {0.5, 0.9, 0.99, 0.999, 1.0};
+    printf("strategy(%s) wake up latency nanos", config.name);
+    for (size_t i = 0; i < PERCENTILES_COUNT; i++) {
+        size_t index = percentiles[i] * NUM_SAMPLES;
+        index = index < NUM_SAMPLES ? index : NUM_SAMPLES - 1;
+        printf(" p%g(%lu)", percentiles[i] * 100, latencies[index]);
+    }
+    printf("\n");
+}
+
+int main() {
+    thread_perf_mode_main_thread_init();
+    llcm_tsc_calibrate();
+    printf("running with samples(%d) max_idle_nanos(%d)\n", NUM_SAMPLES, MAX_IDLE_NANOS);
+    struct test_config const configs[] = {
+        {.name = "spin",
+         .strategy = {.num_spins = UINT32_MAX, .num_yields = 0, .max_park_nanos = 0}},
+        {.name = "yield", .strategy = {.num_spins = 0, .num_yields = 0, .max_park_nanos = 0}},
+        {.name = "park", .strategy = {.num_spins = 0, .num_yields = 0, .max_park_nanos = 1000000}},
+        {.name = "default", .strategy = llcm_wait_strategy_create_default()},
+    };
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        wake_latency_test(configs[i]);
+    }
+}
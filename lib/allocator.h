@@ -1,13 +1,238 @@
 #pragma once
+
+#include "lib/utils.h"
+
+#include <assert.h>
+#include <linux/mempolicy.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 /* public */
 
+// context is passed back to every call, so an allocator can carry state, free also gets the
+// size that was allocated since mmap based allocators need it
 struct llcm_allocator {
-    void *(*allocate)(size_t alignment, size_t size);
-    void (*free)(void *);
+    void *(*allocate)(void *context, size_t alignment, size_t size);
+    void (*free)(void *context, void *pointer, size_t size);
+    void *context;
+};
+
+#define LLCM_ALLOCATOR_PAGE_SIZE     4096
+#define LLCM_ALLOCATOR_HUGEPAGE_SIZE (2UL << 20)
+// any node, the pages are first touched by the allocating thread
+#define LLCM_ALLOCATOR_NUMA_NODE_LOCAL (-1)
+// nodes are passed to mbind in a single unsigned long mask
+#define LLCM_ALLOCATOR_NUMA_MAX_NODES  64
+
+// bump allocator over one up front allocation, free is a no-op and everything is released
+// at once by reset or uninit, allocating is thread safe
+struct llcm_arena {
+    char *base;
+    size_t size;
+    size_t offset;
+    struct llcm_allocator backing;
 };
 
+void *llcm_allocator_allocate(struct llcm_allocator, size_t alignment, size_t size);
+void llcm_allocator_free(struct llcm_allocator, void *pointer, size_t size);
+
+// aligned_alloc and free
+struct llcm_allocator llcm_allocator_create_default(void);
+// allocations of at least half a huge page are mmapped with MAP_HUGETLB, falling back to
+// transparent huge pages with madvise when no huge pages are reserved, smaller ones use the
+// default allocator
+struct llcm_allocator llcm_allocator_create_hugepage(void);
+// page granular mmap bound to node with mbind, or LLCM_ALLOCATOR_NUMA_NODE_LOCAL, the pages
+// are always first touched by the allocating thread so they land on its node if mbind fails.
+// node must be below LLCM_ALLOCATOR_NUMA_MAX_NODES
+struct llcm_allocator llcm_allocator_create_numa(int node);
+struct llcm_allocator llcm_allocator_create_arena(struct llcm_arena *);
+
+// returns false if the backing allocation fails
+bool llcm_arena_init(struct llcm_arena *, size_t size, struct llcm_allocator backing);
+void llcm_arena_uninit(struct llcm_arena *);
+// frees every allocation at once, must not race with allocations
+void llcm_arena_reset(struct llcm_arena *);
+size_t llcm_arena_get_used_size(struct llcm_arena const *);
+
+/* private */
+
+static_assert(sizeof(unsigned long) * 8 == LLCM_ALLOCATOR_NUMA_MAX_NODES, "");
+
+void *llcm_allocator_default_allocate_(void *context, size_t alignment, size_t size);
+void llcm_allocator_default_free_(void *context, void *pointer, size_t size);
+void *llcm_allocator_hugepage_allocate_(void *context, size_t alignment, size_t size);
+void llcm_allocator_hugepage_free_(void *context, void *pointer, size_t size);
+void *llcm_allocator_numa_allocate_(void *context, size_t alignment, size_t size);
+void llcm_allocator_numa_free_(void *context, void *pointer, size_t size);
+void *llcm_allocator_arena_allocate_(void *context, size_t alignment, size_t size);
+void llcm_allocator_arena_free_(void *context, void *pointer, size_t size);
+
+// anonymous private read write mapping, NULL on failure
+void *llcm_allocator_mmap_(size_t size, int extra_flags);
+void llcm_allocator_munmap_(void *pointer, size_t size);
+size_t llcm_allocator_round_up_(size_t size, size_t alignment);
+
+void *llcm_allocator_allocate(struct llcm_allocator allocator, size_t alignment, size_t size) {
+    return allocator.allocate(allocator.context, alignment, size);
+}
+
+void llcm_allocator_free(struct llcm_allocator allocator, void *pointer, size_t size) {
+    allocator.free(allocator.context, pointer, size);
+}
+
 struct llcm_allocator llcm_allocator_create_default(void) {
-    return (struct llcm_allocator){.allocate = aligned_alloc, .free = free};
-}
\ No newline at end of file
+    return (struct llcm_allocator){.allocate = llcm_allocator_default_allocate_,
+                                   .free = llcm_allocator_default_free_,
+                                   .context = NULL};
+}
+
+struct llcm_allocator llcm_allocator_create_hugepage(void) {
+    return (struct llcm_allocator){.allocate = llcm_allocator_hugepage_allocate_,
+                                   .free = llcm_allocator_hugepage_free_,
+                                   .context = NULL};
+}
+
+struct llcm_allocator llcm_allocator_create_numa(int node) {
+    assert(LLCM_ALLOCATOR_NUMA_NODE_LOCAL == node ||
+           (node >= 0 && node < LLCM_ALLOCATOR_NUMA_MAX_NODES));
+    return (struct llcm_allocator){.allocate = llcm_allocator_numa_allocate_,
+                                   .free = llcm_allocator_numa_free_,
+                                   .context = (void *) (intptr_t) node};
+}
+
+struct llcm_allocator llcm_allocator_create_arena(struct llcm_arena *arena) {
+    return (struct llcm_allocator){.allocate = llcm_allocator_arena_allocate_,
+                                   .free = llcm_allocator_arena_free_,
+                                   .context = arena};
+}
+
+bool llcm_arena_init(struct llcm_arena *arena, size_t size, struct llcm_allocator backing) {
+    size_t const mapped_size = llcm_allocator_round_up_(size, LLCM_ALLOCATOR_PAGE_SIZE);
+    arena->base = (char *) llcm_allocator_allocate(backing, LLCM_ALLOCATOR_PAGE_SIZE, mapped_size);
+    arena->size = size;
+    arena->offset = 0;
+    arena->backing = backing;
+    return NULL != arena->base;
+}
+
+void llcm_arena_uninit(struct llcm_arena *arena) {
+    llcm_allocator_free(arena->backing, arena->base,
+                        llcm_allocator_round_up_(arena->size, LLCM_ALLOCATOR_PAGE_SIZE));
+}
+
+void llcm_arena_reset(struct llcm_arena *arena) {
+    __atomic_store_n(&arena->offset, 0, __ATOMIC_RELAXED);
+}
+
+size_t llcm_arena_get_used_size(struct llcm_arena const *arena) {
+    return __atomic_load_n(&arena->offset, __ATOMIC_RELAXED);
+}
+
+void *llcm_allocator_default_allocate_(void *context, size_t alignment, size_t size) {
+    // aligned_alloc wants the size to be a multiple of the alignment
+    return aligned_alloc(alignment, llcm_allocator_round_up_(size, alignment));
+}
+
+void llcm_allocator_default_free_(void *context, void *pointer, size_t size) { free(pointer); }
+
+void *llcm_allocator_hugepage_allocate_(void *context, size_t alignment, size_t size) {
+    if (size < LLCM_ALLOCATOR_HUGEPAGE_SIZE / 2) {
+        return llcm_allocator_default_allocate_(context, alignment, size);
+    }
+    size_t const mapped_size = llcm_allocator_round_up_(size, LLCM_ALLOCATOR_HUGEPAGE_SIZE);
+    void *pointer = llcm_allocator_mmap_(mapped_size, MAP_HUGETLB);
+    if (NULL != pointer) {
+        return pointer;
+    }
+    // no reserved huge pages, map an extra huge page so the range can be trimmed to a huge
+    // page boundary, which transparent huge pages need
+    char *unaligned =
+        (char *) llcm_allocator_mmap_(mapped_size + LLCM_ALLOCATOR_HUGEPAGE_SIZE, 0);
+    if (NULL == unaligned) {
+        return NULL;
+    }
+    char *aligned = (char *) llcm_allocator_round_up_((size_t) unaligned,
+                                                      LLCM_ALLOCATOR_HUGEPAGE_SIZE);
+    if (aligned != unaligned) {
+        llcm_allocator_munmap_(unaligned, aligned - unaligned);
+    }
+    llcm_allocator_munmap_(aligned + mapped_size,
+                           unaligned + LLCM_ALLOCATOR_HUGEPAGE_SIZE - aligned);
+    madvise(aligned, mapped_size, MADV_HUGEPAGE);
+    return aligned;
+}
+
+void llcm_allocator_hugepage_free_(void *context, void *pointer, size_t size) {
+    if (size < LLCM_ALLOCATOR_HUGEPAGE_SIZE / 2) {
+        llcm_allocator_default_free_(context, pointer, size);
+        return;
+    }
+    llcm_allocator_munmap_(pointer, llcm_allocator_round_up_(size, LLCM_ALLOCATOR_HUGEPAGE_SIZE));
+}
+
+void *llcm_allocator_numa_allocate_(void *context, size_t alignment, size_t size) {
+    if (alignment > LLCM_ALLOCATOR_PAGE_SIZE) {
+        return NULL;
+    }
+    size_t const mapped_size = llcm_allocator_round_up_(size, LLCM_ALLOCATOR_PAGE_SIZE);
+    char *pointer = (char *) llcm_allocator_mmap_(mapped_size, 0);
+    if (NULL == pointer) {
+        return NULL;
+    }
+    int const node = (int) (intptr_t) context;
+    if (LLCM_ALLOCATOR_NUMA_NODE_LOCAL != node) {
+        // preferred rather than bound, so a full node spills over instead of failing. the kernel
+        // reads one bit less than maxnode, so it is one past the width of the mask. glibc has no
+        // mbind wrapper, only libnuma does
+        unsigned long const node_mask = 1UL << node;
+        syscall(SYS_mbind, pointer, mapped_size, MPOL_PREFERRED, &node_mask,
+                LLCM_ALLOCATOR_NUMA_MAX_NODES + 1, 0);
+    }
+    for (size_t offset = 0; offset < mapped_size; offset += LLCM_ALLOCATOR_PAGE_SIZE) {
+        pointer[offset] = 0;
+    }
+    return pointer;
+}
+
+void llcm_allocator_numa_free_(void *context, void *pointer, size_t size) {
+    llcm_allocator_munmap_(pointer, llcm_allocator_round_up_(size, LLCM_ALLOCATOR_PAGE_SIZE));
+}
+
+void *llcm_allocator_arena_allocate_(void *context, size_t alignment, size_t size) {
+    struct llcm_arena *arena = context;
+    size_t offset = __atomic_load_n(&arena->offset, __ATOMIC_RELAXED);
+    for (;;) {
+        size_t const aligned_offset =
+            llcm_allocator_round_up_((size_t) arena->base + offset, alignment) -
+            (size_t) arena->base;
+        if (aligned_offset + size > arena->size) {
+            return NULL;
+        }
+        if (__atomic_compare_exchange_n(&arena->offset, &offset, aligned_offset + size, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return arena->base + aligned_offset;
+        }
+    }
+}
+
+void llcm_allocator_arena_free_(void *context, void *pointer, size_t size) {}
+
+void *llcm_allocator_mmap_(size_t size, int extra_flags) {
+    void *pointer =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+    return MAP_FAILED == pointer ? NULL : pointer;
+}
+
+void llcm_allocator_munmap_(void *pointer, size_t size) {
+    munmap(pointer, size);
+}
+
+size_t llcm_allocator_round_up_(size_t size, size_t alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/concurrent_queue.h"
+#include "lib/exec_handle.h"
+#include "lib/scheduler.h"
+#include "lib/utils.h"
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* public */
+
+struct llcm_balancer_config {
+    // how often the queue depths and busy times are sampled
+    uint64_t interval_nanos;
+    // a scheduler starts shedding routines once it has this many more queued than the least
+    // loaded one, and stops once the gap is down to low_watermark. the gap between the two keeps
+    // routines from ping-ponging
+    size_t high_watermark;
+    size_t low_watermark;
+    // a scheduler only sheds if its pollers spent at least this fraction of the last interval
+    // inside polls, 0 balances on queue depth alone
+    double min_busy_fraction;
+};
+
+// moves routines off overloaded schedulers at requeue time. unlike stealing, which only helps an
+// idle scheduler, this also evens out schedulers that are all busy
+struct llcm_balancer {
+    struct llcm_balancer_config config;
+    struct llcm_scheduler *schedulers;
+    size_t num_schedulers;
+    struct llcm_allocator allocator;
+
+    /* private */
+
+    struct llcm_balancer_slot_ *slots_;
+    uint64_t interval_tsc_;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t next_update_tsc_;
+    uint64_t last_update_tsc_;
+    uint32_t updating_;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_migrations_;
+};
+
+struct llcm_balancer_config llcm_balancer_config_create_default(void);
+
+// attaches to every scheduler of the array, e.g. the schedulers of a llcm_scheduler_group, which
+// must not be polled yet
+void llcm_balancer_init(struct llcm_balancer *, struct llcm_scheduler *schedulers,
+                        size_t num_schedulers, struct llcm_balancer_config);
+void llcm_balancer_init_with_custom_allocate(struct llcm_balancer *,
+                                             struct llcm_scheduler *schedulers,
+                                             size_t num_schedulers, struct llcm_balancer_config,
+                                             struct llcm_allocator);
+// detaches from the schedulers, which must not be polled anymore
+void llcm_balancer_uninit(struct llcm_balancer *);
+
+uint64_t llcm_balancer_get_num_migrations(struct llcm_balancer const *);
+// as of the last sample
+bool llcm_balancer_is_shedding(struct llcm_balancer const *, size_t index);
+double llcm_balancer_get_busy_fraction(struct llcm_balancer const *, size_t index);
+
+/* private */
+
+struct llcm_balancer_slot_ {
+    // written by the updater, read by every poller of the scheduler
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint32_t shedding;
+    size_t target;
+    // migrations left until the next sample, so a shedding scheduler never overshoots
+    uint64_t budget;
+    double busy_fraction;
+    // only touched by the updater
+    uint64_t last_busy_tsc;
+    size_t depth;
+};
+
+void llcm_balancer_rebalance_(struct llcm_balancer *, struct llcm_exec_handle *);
+void llcm_balancer_update_(struct llcm_balancer *, uint64_t now_tsc);
+
+struct llcm_balancer_config llcm_balancer_config_create_default(void) {
+    return (struct llcm_balancer_config){.interval_nanos = 100000,
+                                         .high_watermark = 8,
+                                         .low_watermark = 2,
+                                         .min_busy_fraction = 0.5};
+}
+
+void llcm_balancer_init(struct llcm_balancer *balancer, struct llcm_scheduler *schedulers,
+                        size_t num_schedulers, struct llcm_balancer_config config) {
+    llcm_balancer_init_with_custom_allocate(balancer, schedulers, num_schedulers, config,
+                                            llcm_allocator_create_default());
+}
+
+void llcm_balancer_init_with_custom_allocate(struct llcm_balancer *balancer,
+                                             struct llcm_scheduler *schedulers,
+                                             size_t num_schedulers,
+                                             struct llcm_balancer_config config,
+                                             struct llcm_allocator allocator) {
+    assert(num_schedulers >= 1 && config.low_watermark < config.high_watermark);
+    memset(balancer, 0, sizeof(*balancer));
+    balancer->config = config;
+    balancer->schedulers = schedulers;
+    balancer->num_schedulers = num_schedulers;
+    balancer->allocator = allocator;
+    balancer->slots_ =
+        llcm_allocator_allocate(allocator, alignof(struct llcm_balancer_slot_),
+                                sizeof(struct llcm_balancer_slot_) * num_schedulers);
+    assert(NULL != balancer->slots_);
+    balancer->interval_tsc_ = llcm_nanos_to_tsc_ticks(config.interval_nanos);
+    uint64_t const now_tsc = llcm_rdtsc();
+    balancer->last_update_tsc_ = now_tsc;
+    balancer->next_update_tsc_ = now_tsc + balancer->interval_tsc_;
+    for (size_t index = 0; index < num_schedulers; index++) {
+        struct llcm_scheduler *scheduler = &schedulers[index];
+        balancer->slots_[index] = (struct llcm_balancer_slot_){
+            .last_busy_tsc = __atomic_load_n(&scheduler->busy_tsc, __ATOMIC_RELAXED)};
+        scheduler->balancer_index = index;
+        scheduler->rebalance = llcm_balancer_rebalance_;
+        scheduler->balancer = balancer;
+    }
+}
+
+void llcm_balancer_uninit(struct llcm_balancer *balancer) {
+    for (size_t index = 0; index < balancer->num_schedulers; index++) {
+        balancer->schedulers[index].balancer = NULL;
+        balancer->schedulers[index].rebalance = NULL;
+    }
+    llcm_allocator_free(balancer->allocator, balancer->slots_,
+                        sizeof(struct llcm_balancer_slot_) * balancer->num_schedulers);
+}
+
+uint64_t llcm_balancer_get_num_migrations(struct llcm_balancer const *balancer) {
+    return __atomic_load_n(&balancer->num_migrations_, __ATOMIC_RELAXED);
+}
+
+bool llcm_balancer_is_shedding(struct llcm_balancer const *balancer, size_t index) {
+    return __atomic_load_n(&balancer->slots_[index].shedding, __ATOMIC_RELAXED);
+}
+
+double llcm_balancer_get_busy_fraction(struct llcm_balancer const *balancer, size_t index) {
+    double busy_fraction;
+    __atomic_load(&balancer->slots_[index].busy_fraction, &busy_fraction, __ATOMIC_RELAXED);
+    return busy_fraction;
+}
+
+void llcm_balancer_rebalance_(struct llcm_balancer *balancer, struct llcm_exec_handle *handle) {
+    uint64_t const now_tsc = llcm_rdtsc();
+    // whichever poller notices the interval is over samples, the others carry on
+    if (now_tsc >= __atomic_load_n(&balancer->next_update_tsc_, __ATOMIC_RELAXED) &&
+        0 == __atomic_exchange_n(&balancer->updating_, 1, __ATOMIC_ACQUIRE)) {
+        llcm_balancer_update_(balancer, now_tsc);
+        __atomic_store_n(&balancer->next_update_tsc_, now_tsc + balancer->interval_tsc_,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&balancer->updating_, 0, __ATOMIC_RELEASE);
+    }
+
+    struct llcm_balancer_slot_ *slot = &balancer->slots_[handle->scheduler->balancer_index];
+    if (!__atomic_load_n(&slot->shedding, __ATOMIC_RELAXED)) {
+        return;
+    }
+    uint64_t budget = __atomic_load_n(&slot->budget, __ATOMIC_RELAXED);
+    do {
+        if (0 == budget) {
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&slot->budget, &budget, budget - 1, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    struct llcm_scheduler *target =
+        &balancer->schedulers[__atomic_load_n(&slot->target, __ATOMIC_RELAXED)];
+    if (llcm_exec_handle_try_switch_scheduler(handle, target)) {
+        __atomic_fetch_add(&balancer->num_migrations_, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void llcm_balancer_update_(struct llcm_balancer *balancer, uint64_t now_tsc) {
+    uint64_t const elapsed_tsc =
+        now_tsc > balancer->last_update_tsc_ ? now_tsc - balancer->last_update_tsc_ : 1;
+    balancer->last_update_tsc_ = now_tsc;
+    size_t const num_schedulers = balancer->num_schedulers;
+
+    // the least loaded scheduler takes every shed routine, ties go to the least busy one
+    size_t target = 0;
+    size_t target_depth = SIZE_MAX;
+    double target_busy_fraction = 0;
+    for (size_t index = 0; index < num_schedulers; index++) {
+        struct llcm_balancer_slot_ *slot = &balancer->slots_[index];
+        uint64_t const busy_tsc =
+            __atomic_load_n(&balancer->schedulers[index].busy_tsc, __ATOMIC_RELAXED);
+        double busy_fraction = (double) (busy_tsc - slot->last_busy_tsc) / elapsed_tsc;
+        busy_fraction = busy_fraction > 1 ? 1 : busy_fraction;
+        slot->last_busy_tsc = busy_tsc;
+        __atomic_store(&slot->busy_fraction, &busy_fraction, __ATOMIC_RELAXED);
+        size_t const depth = llcm_scheduler_get_num_queued_routines(&balancer->schedulers[index]);
+        slot->depth = depth;
+        bool const less_loaded = depth < target_depth ||
+                                 (depth == target_depth && busy_fraction < target_busy_fraction);
+        if (less_loaded) {
+            target = index;
+            target_depth = depth;
+            target_busy_fraction = busy_fraction;
+        }
+    }
+
+    size_t num_shedding = 0;
+    for (size_t index = 0; index < num_schedulers; index++) {
+        struct llcm_balancer_slot_ *slot = &balancer->slots_[index];
+        size_t const gap = slot->depth - target_depth;
+        bool shedding = __atomic_load_n(&slot->shedding, __ATOMIC_RELAXED);
+        if (shedding) {
+            shedding = gap > balancer->config.low_watermark;
+        } else {
+            shedding = gap >= balancer->config.high_watermark &&
+                       slot->busy_fraction >= balancer->config.min_busy_fraction;
+        }
+        __atomic_store_n(&slot->shedding, shedding, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->budget, 0, __ATOMIC_RELAXED);
+        num_shedding += shedding;
+    }
+    // every shedder moves its share of half its gap, so the target ends up level with them
+    // rather than becoming the most loaded one
+    for (size_t index = 0; index < num_schedulers && 0 != num_shedding; index++) {
+        struct llcm_balancer_slot_ *slot = &balancer->slots_[index];
+        if (!__atomic_load_n(&slot->shedding, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        size_t const gap = slot->depth - target_depth;
+        __atomic_store_n(&slot->target, target, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->budget, gap / 2 / num_shedding, __ATOMIC_RELAXED);
+    }
+}
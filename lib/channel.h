@@ -0,0 +1,194 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/concurrent_queue.h"
+#include "lib/exec_handle.h"
+#include "lib/scheduler.h"
+#include "lib/utils.h"
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* public */
+
+// routines parked on one end of a channel, woken one at a time in the order they parked
+struct llcm_channel_wait_list_ {
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint32_t lock;
+    struct llcm_routine *head;
+    struct llcm_routine *tail;
+};
+
+// a bounded channel of non NULL pointers between routines. a receiver that finds it empty and a
+// sender that finds it full are parked instead of re-polled, and put back onto the scheduler
+// they were polled on by the send or receive that changes that
+struct llcm_channel {
+    struct llcm_concurrent_queue queue;
+
+    /* private */
+
+    struct llcm_channel_wait_list_ receivers_;
+    struct llcm_channel_wait_list_ senders_;
+};
+
+void llcm_channel_init(struct llcm_channel *, size_t capacity);
+void llcm_channel_init_with_custom_allocate(struct llcm_channel *, size_t capacity,
+                                            struct llcm_allocator);
+// no routine may still be parked on the channel
+void llcm_channel_uninit(struct llcm_channel *);
+size_t llcm_channel_get_size(struct llcm_channel const *);
+
+// returns false if the channel is full, then the routine is parked when the current poll returns
+// and polled again once a receive makes room, so it should retry the send. a receiver woken by the
+// send that was parked on the same scheduler is polled next by this thread, see
+// llcm_exec_handle_try_schedule_next
+bool llcm_channel_send(struct llcm_channel *, void *value, struct llcm_exec_handle *);
+// returns NULL if the channel is empty, then the routine is parked when the current poll returns
+// and polled again once a send fills it. a woken sender is polled next like a woken receiver
+void *llcm_channel_receive(struct llcm_channel *, struct llcm_exec_handle *);
+
+// from any thread, never park but still wake parked routines
+bool llcm_channel_try_send(struct llcm_channel *, void *value);
+void *llcm_channel_try_receive(struct llcm_channel *);
+
+/* private */
+
+// handle is NULL outside a poll, then woken routines are queued
+bool llcm_channel_try_send_(struct llcm_channel *, void *value, struct llcm_exec_handle *);
+void *llcm_channel_try_receive_(struct llcm_channel *, struct llcm_exec_handle *);
+bool llcm_channel_try_park_receiver_(void *channel, struct llcm_routine *,
+                                     struct llcm_scheduler *);
+bool llcm_channel_try_park_sender_(void *channel, struct llcm_routine *, struct llcm_scheduler *);
+void llcm_channel_wait_list_push_(struct llcm_channel_wait_list_ *, struct llcm_routine *,
+                                  struct llcm_scheduler *);
+void llcm_channel_wait_list_wake_one_(struct llcm_channel_wait_list_ *, struct llcm_exec_handle *);
+
+void llcm_channel_init(struct llcm_channel *channel, size_t capacity) {
+    llcm_channel_init_with_custom_allocate(channel, capacity, llcm_allocator_create_default());
+}
+
+void llcm_channel_init_with_custom_allocate(struct llcm_channel *channel, size_t capacity,
+                                            struct llcm_allocator allocator) {
+    llcm_concurrent_queue_init_with_custom_allocate(&channel->queue, capacity, allocator);
+    channel->receivers_ = (struct llcm_channel_wait_list_){.head = NULL};
+    channel->senders_ = (struct llcm_channel_wait_list_){.head = NULL};
+}
+
+void llcm_channel_uninit(struct llcm_channel *channel) {
+    llcm_concurrent_queue_uninit(&channel->queue);
+}
+
+size_t llcm_channel_get_size(struct llcm_channel const *channel) {
+    return llcm_concurrent_queue_get_size(&channel->queue);
+}
+
+bool llcm_channel_send(struct llcm_channel *channel, void *value,
+                       struct llcm_exec_handle *handle) {
+    if (llcm_channel_try_send_(channel, value, handle)) {
+        return true;
+    }
+    llcm_exec_handle_park_(handle, llcm_channel_try_park_sender_, channel);
+    return false;
+}
+
+void *llcm_channel_receive(struct llcm_channel *channel, struct llcm_exec_handle *handle) {
+    void *value = llcm_channel_try_receive_(channel, handle);
+    if (NULL == value) {
+        llcm_exec_handle_park_(handle, llcm_channel_try_park_receiver_, channel);
+    }
+    return value;
+}
+
+bool llcm_channel_try_send(struct llcm_channel *channel, void *value) {
+    return llcm_channel_try_send_(channel, value, NULL);
+}
+
+void *llcm_channel_try_receive(struct llcm_channel *channel) {
+    return llcm_channel_try_receive_(channel, NULL);
+}
+
+bool llcm_channel_try_send_(struct llcm_channel *channel, void *value,
+                            struct llcm_exec_handle *handle) {
+    if (!llcm_concurrent_queue_try_reserve_size_before_push(&channel->queue, 1)) {
+        return false;
+    }
+    llcm_concurrent_queue_push(&channel->queue, value);
+    // pairs with the fence in llcm_channel_try_park_receiver_, either the receiver sees the
+    // value or this sees the receiver
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    llcm_channel_wait_list_wake_one_(&channel->receivers_, handle);
+    return true;
+}
+
+void *llcm_channel_try_receive_(struct llcm_channel *channel, struct llcm_exec_handle *handle) {
+    void *value = llcm_concurrent_queue_try_pop(&channel->queue);
+    if (NULL == value) {
+        return NULL;
+    }
+    llcm_concurrent_queue_unreserve_size_after_pop(&channel->queue, 1);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    llcm_channel_wait_list_wake_one_(&channel->senders_, handle);
+    return value;
+}
+
+bool llcm_channel_try_park_receiver_(void *waitable, struct llcm_routine *routine,
+                                     struct llcm_scheduler *scheduler) {
+    struct llcm_channel *channel = waitable;
+    llcm_channel_wait_list_push_(&channel->receivers_, routine, scheduler);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    // a send that raced with the park may have missed it, so wake a receiver on its behalf,
+    // possibly this one
+    if (0 != llcm_concurrent_queue_get_size(&channel->queue)) {
+        llcm_channel_wait_list_wake_one_(&channel->receivers_, NULL);
+    }
+    return true;
+}
+
+bool llcm_channel_try_park_sender_(void *waitable, struct llcm_routine *routine,
+                                   struct llcm_scheduler *scheduler) {
+    struct llcm_channel *channel = waitable;
+    llcm_channel_wait_list_push_(&channel->senders_, routine, scheduler);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&channel->queue.counters.reserved_push_size, __ATOMIC_RELAXED) <
+        llcm_concurrent_queue_get_capacity(&channel->queue)) {
+        llcm_channel_wait_list_wake_one_(&channel->senders_, NULL);
+    }
+    return true;
+}
+
+void llcm_channel_wait_list_push_(struct llcm_channel_wait_list_ *list,
+                                  struct llcm_routine *routine,
+                                  struct llcm_scheduler *scheduler) {
+    routine->wait_next_ = NULL;
+    routine->wait_scheduler_ = scheduler;
+    while (__atomic_exchange_n(&list->lock, 1, __ATOMIC_ACQUIRE)) {
+        llcm_cpu_relax();
+    }
+    if (NULL == list->head) {
+        __atomic_store_n(&list->head, routine, __ATOMIC_RELAXED);
+    } else {
+        list->tail->wait_next_ = routine;
+    }
+    list->tail = routine;
+    __atomic_store_n(&list->lock, 0, __ATOMIC_RELEASE);
+}
+
+void llcm_channel_wait_list_wake_one_(struct llcm_channel_wait_list_ *list,
+                                      struct llcm_exec_handle *handle) {
+    // the common case of nobody parked stays off the lock
+    if (NULL == __atomic_load_n(&list->head, __ATOMIC_RELAXED)) {
+        return;
+    }
+    while (__atomic_exchange_n(&list->lock, 1, __ATOMIC_ACQUIRE)) {
+        llcm_cpu_relax();
+    }
+    struct llcm_routine *routine = list->head;
+    if (NULL != routine) {
+        __atomic_store_n(&list->head, routine->wait_next_, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&list->lock, 0, __ATOMIC_RELEASE);
+    if (NULL != routine) {
+        llcm_scheduler_resume_routine_next_(handle, routine->wait_scheduler_, routine);
+    }
+}
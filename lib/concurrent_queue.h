@@ -1,10 +1,12 @@
 #pragma once
 
 #include "lib/allocator.h"
+#include "lib/stats.h"
 #include "lib/utils.h"
 
 #include <assert.h>
 #include <stdalign.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -14,24 +16,48 @@
 
 #define LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE 64
 
+// init flags, the default is multi producer multi consumer
+#define LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER 0x1u
+#define LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER 0x2u
+// 16 byte entries packed four to a cache line instead of one padded entry per line,
+// consecutive sequence numbers are strided over different lines
+#define LLCM_CONCURRENT_QUEUE_COMPACT_LAYOUT  0x4u
+
 struct llcm_concurrent_queue_entry;
 
+// private, the counters shared with the typed queues and llcm_shm_queue, see below
+struct llcm_concurrent_queue_counters_ {
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) _Atomic uint64_t read_counter;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) _Atomic uint64_t write_counter;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) _Atomic uint64_t reserved_push_size;
+};
+
 struct llcm_concurrent_queue {
     struct llcm_concurrent_queue_entry *array;
     size_t mask;
-    void (*free)(void *);
+    unsigned flags;
+    // physical index = (index & line_mask) << line_entries_shift | index >> line_shift
+    size_t line_mask;
+    unsigned line_shift;
+    unsigned line_entries_shift;
+    unsigned entry_stride_shift;
+    struct llcm_allocator allocator;
 
-    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t read_counter;
-    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t write_counter;
-    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t reserved_push_size;
+    struct llcm_concurrent_queue_counters_ counters;
 };
 
 void llcm_concurrent_queue_init(struct llcm_concurrent_queue *, size_t capacity);
 void llcm_concurrent_queue_init_with_custom_allocate(struct llcm_concurrent_queue *,
                                                      size_t capacity, struct llcm_allocator);
+// with LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER only one thread at a time may push,
+// with LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER only one thread at a time may pop
+void llcm_concurrent_queue_init_with_flags(struct llcm_concurrent_queue *, size_t capacity,
+                                           unsigned flags, struct llcm_allocator);
 void llcm_concurrent_queue_uninit(struct llcm_concurrent_queue *);
 
 size_t llcm_concurrent_queue_get_capacity(struct llcm_concurrent_queue const *);
+// number of pushed entries not yet popped, only a snapshot under concurrent use
+size_t llcm_concurrent_queue_get_size(struct llcm_concurrent_queue const *);
 
 // must reserve available capacity for any new entries to be pushed
 bool llcm_concurrent_queue_try_reserve_size_before_push(struct llcm_concurrent_queue *,
@@ -45,19 +71,78 @@ void llcm_concurrent_queue_push(struct llcm_concurrent_queue *, void *value);
 // returns NULL on failure
 void *llcm_concurrent_queue_try_pop(struct llcm_concurrent_queue *);
 
+// claims num_values consecutive slots with at most one atomic, always succeeds
+void llcm_concurrent_queue_push_n(struct llcm_concurrent_queue *, void *const *values,
+                                  size_t num_values);
+// pops up to max_values entries with at most one CAS, returns the number popped
+size_t llcm_concurrent_queue_try_pop_n(struct llcm_concurrent_queue *, void **values,
+                                       size_t max_values);
+
 /* private */
 
+#define LLCM_CONCURRENT_QUEUE_ENTRY_SIZE_SHIFT 4
+
+// the padded layout spaces entries a cache line apart, the compact layout packs them.
+// aba_counter hands the slot back and forth, a release store of it publishes element to the
+// acquire load of the next owner, so element itself needs no atomics
 struct llcm_concurrent_queue_entry {
-    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) volatile uint64_t aba_counter;
+    alignas(1 << LLCM_CONCURRENT_QUEUE_ENTRY_SIZE_SHIFT) _Atomic uint64_t aba_counter;
     void *element;
 };
-static_assert(sizeof(struct llcm_concurrent_queue_entry) == LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE,
+static_assert(sizeof(struct llcm_concurrent_queue_entry) ==
+                  1 << LLCM_CONCURRENT_QUEUE_ENTRY_SIZE_SHIFT,
               "");
 
+struct llcm_concurrent_queue_entry *llcm_concurrent_queue_get_entry_(
+    struct llcm_concurrent_queue const *, uint64_t counter);
+// multi consumer pop of the entries below a write_counter the caller loaded, for
+// llcm_segmented_queue
+size_t llcm_concurrent_queue_try_pop_n_below_(struct llcm_concurrent_queue *, void **values,
+                                              size_t max_values, uint64_t write_counter);
+
+// the ring itself, which every queue shares. it holds no pointers and works on counters only,
+// each queue maps a counter to its own slot, so the same code runs on a shared memory region
+// that every process maps at a different address
+void llcm_concurrent_queue_counters_init_(struct llcm_concurrent_queue_counters_ *);
+size_t llcm_concurrent_queue_counters_get_size_(struct llcm_concurrent_queue_counters_ const *);
+bool llcm_concurrent_queue_counters_try_reserve_(struct llcm_concurrent_queue_counters_ *,
+                                                 uint64_t capacity, size_t num_new_entries);
+void llcm_concurrent_queue_counters_unreserve_(struct llcm_concurrent_queue_counters_ *,
+                                               size_t num_old_entries);
+// returns the write counter of the first of num_values slots, the caller writes them and then
+// calls llcm_concurrent_queue_counters_end_push_
+uint64_t llcm_concurrent_queue_counters_begin_push_(struct llcm_concurrent_queue_counters_ *,
+                                                    size_t num_values, bool single_producer);
+void llcm_concurrent_queue_counters_end_push_(struct llcm_concurrent_queue_counters_ *,
+                                              uint64_t write_counter, size_t num_values,
+                                              bool single_producer);
+// claims up to max_values slots starting at *read_counter, returns the number claimed
+size_t llcm_concurrent_queue_counters_claim_pop_(struct llcm_concurrent_queue_counters_ *,
+                                                 size_t max_values, bool single_consumer,
+                                                 uint64_t *read_counter);
+// multi consumer only, claims slots below a write_counter the caller loaded
+size_t llcm_concurrent_queue_counters_claim_pop_below_(struct llcm_concurrent_queue_counters_ *,
+                                                       size_t max_values, uint64_t write_counter,
+                                                       uint64_t *read_counter);
+// a slot is handed back and forth through its aba_counter
+void llcm_concurrent_queue_wait_to_write_(_Atomic uint64_t *aba_counter, uint64_t write_counter);
+void llcm_concurrent_queue_publish_write_(_Atomic uint64_t *aba_counter, uint64_t write_counter);
+void llcm_concurrent_queue_wait_to_read_(_Atomic uint64_t *aba_counter, uint64_t read_counter);
+void llcm_concurrent_queue_publish_read_(_Atomic uint64_t *aba_counter, uint64_t read_counter,
+                                         uint64_t capacity);
+
+void llcm_concurrent_queue_write_entry_(struct llcm_concurrent_queue *, uint64_t write_counter,
+                                        void *value);
+void *llcm_concurrent_queue_read_entry_(struct llcm_concurrent_queue *, uint64_t read_counter);
+
 size_t llcm_concurrent_queue_get_capacity(struct llcm_concurrent_queue const *queue) {
     return queue->mask + 1;
 }
 
+size_t llcm_concurrent_queue_get_size(struct llcm_concurrent_queue const *queue) {
+    return llcm_concurrent_queue_counters_get_size_(&queue->counters);
+}
+
 void llcm_concurrent_queue_init(struct llcm_concurrent_queue *queue, size_t capacity) {
     llcm_concurrent_queue_init_with_custom_allocate(queue, capacity,
                                                     llcm_allocator_create_default());
@@ -66,69 +151,263 @@ void llcm_concurrent_queue_init(struct llcm_concurrent_queue *queue, size_t capa
 void llcm_concurrent_queue_init_with_custom_allocate(struct llcm_concurrent_queue *queue,
                                                      size_t capacity,
                                                      struct llcm_allocator allocator) {
+    llcm_concurrent_queue_init_with_flags(queue, capacity, 0, allocator);
+}
+
+void llcm_concurrent_queue_init_with_flags(struct llcm_concurrent_queue *queue, size_t capacity,
+                                           unsigned flags, struct llcm_allocator allocator) {
     memset(queue, 0, sizeof(*queue));
     capacity = llcm_round_up_pow2(capacity);
     if (capacity < 2) {
         capacity = 2;   // capacity must be at least 2 for aba_counter
     }
-    size_t const array_size_bytes = sizeof(struct llcm_concurrent_queue_entry) * capacity;
-    queue->array = (struct llcm_concurrent_queue_entry *) allocator.allocate(
-        sizeof(struct llcm_concurrent_queue_entry), array_size_bytes);
+    unsigned const capacity_shift = __builtin_ctzl(capacity);
+    unsigned const line_shift = __builtin_ctz(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE);
+    if (flags & LLCM_CONCURRENT_QUEUE_COMPACT_LAYOUT) {
+        queue->line_entries_shift = line_shift - LLCM_CONCURRENT_QUEUE_ENTRY_SIZE_SHIFT;
+        if (queue->line_entries_shift > capacity_shift) {
+            queue->line_entries_shift = capacity_shift;
+        }
+        queue->entry_stride_shift = LLCM_CONCURRENT_QUEUE_ENTRY_SIZE_SHIFT;
+    } else {
+        queue->line_entries_shift = 0;
+        queue->entry_stride_shift = line_shift;
+    }
+    queue->line_shift = capacity_shift - queue->line_entries_shift;
+    queue->line_mask = (1ULL << queue->line_shift) - 1;
+    queue->mask = capacity - 1;
+    queue->flags = flags;
+    queue->allocator = allocator;
+
+    size_t const array_size_bytes = capacity << queue->entry_stride_shift;
+    size_t const array_alignment = array_size_bytes < LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE
+                                       ? array_size_bytes
+                                       : LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE;
+    queue->array = (struct llcm_concurrent_queue_entry *) llcm_allocator_allocate(
+        allocator, array_alignment, array_size_bytes);
     memset(queue->array, 0, array_size_bytes);
     for (uint64_t i = 0; i < capacity; i++) {
-        queue->array[i].aba_counter = i;
+        atomic_init(&llcm_concurrent_queue_get_entry_(queue, i)->aba_counter, i);
     }
-    queue->mask = capacity - 1;
-    queue->free = allocator.free;
+    llcm_concurrent_queue_counters_init_(&queue->counters);
 }
 
 void llcm_concurrent_queue_uninit(struct llcm_concurrent_queue *queue) {
-    queue->free(queue->array);
+    llcm_allocator_free(queue->allocator, queue->array,
+                        (queue->mask + 1) << queue->entry_stride_shift);
 }
 
 bool llcm_concurrent_queue_try_reserve_size_before_push(struct llcm_concurrent_queue *queue,
                                                         size_t num_new_entries) {
-    uint64_t const reserved_push_size =
-        __atomic_fetch_add(&queue->reserved_push_size, num_new_entries, __ATOMIC_SEQ_CST);
-    if (reserved_push_size > queue->mask) {
-        __atomic_fetch_sub(&queue->reserved_push_size, num_new_entries, __ATOMIC_SEQ_CST);
-        return false;
-    }
-    return true;
+    return llcm_concurrent_queue_counters_try_reserve_(&queue->counters, queue->mask + 1,
+                                                       num_new_entries);
 }
 
 void llcm_concurrent_queue_unreserve_size_after_pop(struct llcm_concurrent_queue *queue,
                                                     size_t num_old_entries) {
-    __atomic_fetch_sub(&queue->reserved_push_size, num_old_entries, __ATOMIC_SEQ_CST);
+    llcm_concurrent_queue_counters_unreserve_(&queue->counters, num_old_entries);
 }
 
 void llcm_concurrent_queue_push(struct llcm_concurrent_queue *queue, void *value) {
-    uint64_t const reserved_write_counter =
-        __atomic_fetch_add(&queue->write_counter, 1, __ATOMIC_SEQ_CST);
-    struct llcm_concurrent_queue_entry *entry = &queue->array[reserved_write_counter & queue->mask];
-    while (entry->aba_counter != reserved_write_counter) {
+    llcm_concurrent_queue_push_n(queue, &value, 1);
+}
+
+void *llcm_concurrent_queue_try_pop(struct llcm_concurrent_queue *queue) {
+    void *value = NULL;
+    llcm_concurrent_queue_try_pop_n(queue, &value, 1);
+    return value;
+}
+
+void llcm_concurrent_queue_push_n(struct llcm_concurrent_queue *queue, void *const *values,
+                                  size_t num_values) {
+    if (0 == num_values) {
+        return;
+    }
+    bool const single_producer = queue->flags & LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER;
+    uint64_t const write_counter = llcm_concurrent_queue_counters_begin_push_(
+        &queue->counters, num_values, single_producer);
+    for (size_t i = 0; i < num_values; i++) {
+        llcm_concurrent_queue_write_entry_(queue, write_counter + i, values[i]);
+    }
+    llcm_concurrent_queue_counters_end_push_(&queue->counters, write_counter, num_values,
+                                             single_producer);
+}
+
+size_t llcm_concurrent_queue_try_pop_n(struct llcm_concurrent_queue *queue, void **values,
+                                       size_t max_values) {
+    uint64_t read_counter;
+    size_t const num_values = llcm_concurrent_queue_counters_claim_pop_(
+        &queue->counters, max_values, queue->flags & LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER,
+        &read_counter);
+    for (size_t i = 0; i < num_values; i++) {
+        values[i] = llcm_concurrent_queue_read_entry_(queue, read_counter + i);
+    }
+    return num_values;
+}
+
+size_t llcm_concurrent_queue_try_pop_n_below_(struct llcm_concurrent_queue *queue, void **values,
+                                              size_t max_values, uint64_t write_counter) {
+    uint64_t read_counter;
+    size_t const num_values = llcm_concurrent_queue_counters_claim_pop_below_(
+        &queue->counters, max_values, write_counter, &read_counter);
+    for (size_t i = 0; i < num_values; i++) {
+        values[i] = llcm_concurrent_queue_read_entry_(queue, read_counter + i);
     }
+    return num_values;
+}
+
+void llcm_concurrent_queue_write_entry_(struct llcm_concurrent_queue *queue,
+                                        uint64_t write_counter, void *value) {
+    struct llcm_concurrent_queue_entry *entry =
+        llcm_concurrent_queue_get_entry_(queue, write_counter);
+    llcm_concurrent_queue_wait_to_write_(&entry->aba_counter, write_counter);
     entry->element = value;
-    __asm__ __volatile__("" ::: "memory");
-    entry->aba_counter = reserved_write_counter + 1;
+    llcm_concurrent_queue_publish_write_(&entry->aba_counter, write_counter);
 }
 
-void *llcm_concurrent_queue_try_pop(struct llcm_concurrent_queue *queue) {
-    uint64_t const local_write_counter = queue->write_counter;
-    uint64_t *read_ptr = &queue->read_counter;
-    uint64_t local_read_counter = *read_ptr;
-    while (local_read_counter < local_write_counter) {
-        if (__atomic_compare_exchange_n(read_ptr, &local_read_counter, local_read_counter + 1,
-                                        false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
-            struct llcm_concurrent_queue_entry *entry =
-                &queue->array[local_read_counter & queue->mask];
-            while (entry->aba_counter != local_read_counter + 1) {
-            }
-            void *read_value = entry->element;
-            __asm__ __volatile__("" ::: "memory");
-            entry->aba_counter = local_read_counter + queue->mask + 1;
-            return read_value;
+void *llcm_concurrent_queue_read_entry_(struct llcm_concurrent_queue *queue,
+                                        uint64_t read_counter) {
+    struct llcm_concurrent_queue_entry *entry =
+        llcm_concurrent_queue_get_entry_(queue, read_counter);
+    llcm_concurrent_queue_wait_to_read_(&entry->aba_counter, read_counter);
+    void *read_value = entry->element;
+    llcm_concurrent_queue_publish_read_(&entry->aba_counter, read_counter, queue->mask + 1);
+    return read_value;
+}
+
+struct llcm_concurrent_queue_entry *llcm_concurrent_queue_get_entry_(
+    struct llcm_concurrent_queue const *queue, uint64_t counter) {
+    // branch free for both layouts, the padded layout has line_entries_shift == 0 and
+    // line_mask == mask, so the index is unchanged
+    uint64_t const index = counter & queue->mask;
+    uint64_t const physical_index =
+        (index & queue->line_mask) << queue->line_entries_shift | index >> queue->line_shift;
+    return (struct llcm_concurrent_queue_entry *) ((char *) queue->array +
+                                                   (physical_index << queue->entry_stride_shift));
+}
+void llcm_concurrent_queue_counters_init_(struct llcm_concurrent_queue_counters_ *counters) {
+    atomic_init(&counters->read_counter, 0);
+    atomic_init(&counters->write_counter, 0);
+    atomic_init(&counters->reserved_push_size, 0);
+}
+
+size_t llcm_concurrent_queue_counters_get_size_(
+    struct llcm_concurrent_queue_counters_ const *counters) {
+    uint64_t const local_read_counter =
+        atomic_load_explicit(&counters->read_counter, memory_order_relaxed);
+    uint64_t const local_write_counter =
+        atomic_load_explicit(&counters->write_counter, memory_order_relaxed);
+    return local_write_counter > local_read_counter ? local_write_counter - local_read_counter : 0;
+}
+
+bool llcm_concurrent_queue_counters_try_reserve_(struct llcm_concurrent_queue_counters_ *counters,
+                                                 uint64_t capacity, size_t num_new_entries) {
+    // only a count, the slots themselves are handed over through aba_counter
+    uint64_t const reserved_push_size = atomic_fetch_add_explicit(
+        &counters->reserved_push_size, num_new_entries, memory_order_relaxed);
+    if (reserved_push_size + num_new_entries > capacity) {
+        LLCM_STATS_INC_(queue_reserve_failures);
+        atomic_fetch_sub_explicit(&counters->reserved_push_size, num_new_entries,
+                                  memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void llcm_concurrent_queue_counters_unreserve_(struct llcm_concurrent_queue_counters_ *counters,
+                                               size_t num_old_entries) {
+    // release, so whoever sees the size drop also sees what the popped entries' owners did,
+    // e.g. a scheduler drained down to no routines
+    atomic_fetch_sub_explicit(&counters->reserved_push_size, num_old_entries,
+                              memory_order_release);
+}
+
+uint64_t llcm_concurrent_queue_counters_begin_push_(
+    struct llcm_concurrent_queue_counters_ *counters, size_t num_values, bool single_producer) {
+    if (single_producer) {
+        return atomic_load_explicit(&counters->write_counter, memory_order_relaxed);
+    }
+    // seq_cst for llcm_scheduler_park_, which announces itself and then checks the queue while
+    // a schedule call pushes and then checks for parked pollers. it is the same locked add as any
+    // other order on x86
+    return atomic_fetch_add_explicit(&counters->write_counter, num_values, memory_order_seq_cst);
+}
+
+void llcm_concurrent_queue_counters_end_push_(struct llcm_concurrent_queue_counters_ *counters,
+                                              uint64_t write_counter, size_t num_values,
+                                              bool single_producer) {
+    if (single_producer) {
+        // publish write_counter after the entries so consumers never wait on aba_counter
+        atomic_store_explicit(&counters->write_counter, write_counter + num_values,
+                              memory_order_release);
+    }
+}
+
+size_t llcm_concurrent_queue_counters_claim_pop_(struct llcm_concurrent_queue_counters_ *counters,
+                                                 size_t max_values, bool single_consumer,
+                                                 uint64_t *read_counter) {
+    if (!single_consumer) {
+        return llcm_concurrent_queue_counters_claim_pop_below_(
+            counters, max_values,
+            atomic_load_explicit(&counters->write_counter, memory_order_relaxed), read_counter);
+    }
+    uint64_t const local_read_counter =
+        atomic_load_explicit(&counters->read_counter, memory_order_relaxed);
+    uint64_t num_values =
+        atomic_load_explicit(&counters->write_counter, memory_order_acquire) - local_read_counter;
+    if (num_values > max_values) {
+        num_values = max_values;
+    }
+    // producers wait on aba_counter, nobody synchronizes on read_counter
+    atomic_store_explicit(&counters->read_counter, local_read_counter + num_values,
+                          memory_order_relaxed);
+    *read_counter = local_read_counter;
+    return num_values;
+}
+
+size_t llcm_concurrent_queue_counters_claim_pop_below_(
+    struct llcm_concurrent_queue_counters_ *counters, size_t max_values, uint64_t write_counter,
+    uint64_t *read_counter) {
+    // the cas only claims indices, the entries are handed over by aba_counter, and a stale
+    // write_counter only makes the queue look emptier than it is
+    uint64_t local_read_counter =
+        atomic_load_explicit(&counters->read_counter, memory_order_relaxed);
+    while (local_read_counter < write_counter) {
+        uint64_t num_values = write_counter - local_read_counter;
+        if (num_values > max_values) {
+            num_values = max_values;
         }
+        if (atomic_compare_exchange_weak_explicit(&counters->read_counter, &local_read_counter,
+                                                  local_read_counter + num_values,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            *read_counter = local_read_counter;
+            return num_values;
+        }
+        LLCM_STATS_INC_(queue_pop_cas_failures);
+    }
+    return 0;
+}
+
+void llcm_concurrent_queue_wait_to_write_(_Atomic uint64_t *aba_counter, uint64_t write_counter) {
+    // acquire, so the previous owner's read of the slot is done before it is overwritten
+    while (atomic_load_explicit(aba_counter, memory_order_acquire) != write_counter) {
+        LLCM_STATS_INC_(queue_push_aba_spins);
+        llcm_cpu_relax();
     }
-    return NULL;
-}
\ No newline at end of file
+}
+
+void llcm_concurrent_queue_publish_write_(_Atomic uint64_t *aba_counter, uint64_t write_counter) {
+    atomic_store_explicit(aba_counter, write_counter + 1, memory_order_release);
+}
+
+void llcm_concurrent_queue_wait_to_read_(_Atomic uint64_t *aba_counter, uint64_t read_counter) {
+    while (atomic_load_explicit(aba_counter, memory_order_acquire) != read_counter + 1) {
+        LLCM_STATS_INC_(queue_pop_aba_spins);
+        llcm_cpu_relax();
+    }
+}
+
+void llcm_concurrent_queue_publish_read_(_Atomic uint64_t *aba_counter, uint64_t read_counter,
+                                         uint64_t capacity) {
+    atomic_store_explicit(aba_counter, read_counter + capacity, memory_order_release);
+}
@@ -1,8 +1,12 @@
 #pragma once
 
 #include "lib/routine.h"
+#include "lib/stats.h"
+#include "lib/trace.h"
+#include "lib/utils.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /* public */
 
@@ -13,19 +17,52 @@ struct llcm_exec_handle {
     struct llcm_routine *routine;
     struct llcm_scheduler *scheduler;
     void *user_exec_arg;
+
+    /* private */
+
+    // set by llcm_exec_handle_sleep, the routine is requeued this many ticks after the poll
+    uint64_t sleep_tsc_ticks_;
+
+    // set by a routine that waits on something like a llcm_future, once the poll returns
+    // try_park_ hands the routine to the waitable, or fails if it is ready already
+    bool (*try_park_)(void *waitable, struct llcm_routine *, struct llcm_scheduler *);
+    void *park_waitable_;
+
+    // the scheduler being polled, kept after the routine cancelled or switched scheduler
+    struct llcm_scheduler *polling_scheduler_;
+    // polled by this poller right after the current poll returns, it holds a reservation
+    struct llcm_routine *run_next_;
 };
 
 struct llcm_routine *llcm_exec_handle_get_current_routine(struct llcm_exec_handle *);
 void llcm_exec_handle_set_routine(struct llcm_exec_handle *handle, struct llcm_routine *routine);
+// a routine from a llcm_routine_pool goes back to its pool once the current poll returns
 void llcm_exec_handle_cancel_routine(struct llcm_exec_handle *);
 struct llcm_scheduler *llcm_exec_handle_get_current_scheduler(struct llcm_exec_handle *);
+// returns false if the new scheduler is full
 bool llcm_exec_handle_try_switch_scheduler(struct llcm_exec_handle *, struct llcm_scheduler *);
+size_t llcm_exec_handle_get_lane(struct llcm_exec_handle *);
+// the routine is requeued on this lane, clamped to the lanes of the scheduler
+void llcm_exec_handle_set_lane(struct llcm_exec_handle *, size_t lane);
+// requeue the routine after a delay instead of immediately, keeps its capacity reservation
+void llcm_exec_handle_sleep(struct llcm_exec_handle *, uint64_t nanos);
+// schedules a routine onto the polling scheduler to be polled by this thread right after the
+// current poll, ahead of every queued routine. the newest routine runs next, one already in the
+// slot is queued instead. returns false if the scheduler is full
+bool llcm_exec_handle_try_schedule_next(struct llcm_exec_handle *, struct llcm_routine *);
 
 /* private */
 
 // defined in scheduler.h
 bool llcm_scheduler_try_reserve_new_routine_(struct llcm_scheduler *);
 void llcm_scheduler_old_routine_available_(struct llcm_scheduler *);
+void llcm_scheduler_set_run_next_(struct llcm_exec_handle *, struct llcm_routine *);
+
+// parks the routine instead of requeueing it after the current poll, it keeps its reservation
+void llcm_exec_handle_park_(struct llcm_exec_handle *,
+                            bool (*try_park)(void *waitable, struct llcm_routine *,
+                                             struct llcm_scheduler *),
+                            void *waitable);
 
 struct llcm_routine *llcm_exec_handle_get_current_routine(struct llcm_exec_handle *handle) {
     return handle->routine;
@@ -56,5 +93,40 @@ bool llcm_exec_handle_try_switch_scheduler(struct llcm_exec_handle *handle,
     }
     llcm_scheduler_old_routine_available_(handle->scheduler);
     handle->scheduler = new_scheduler;
+    LLCM_STATS_INC_(scheduler_migrations);
+    LLCM_TRACE_(LLCM_TRACE_SWITCHED_SCHEDULER, handle->routine, new_scheduler);
     return true;
-}
\ No newline at end of file
+}
+
+size_t llcm_exec_handle_get_lane(struct llcm_exec_handle *handle) {
+    return handle->routine->lane_;
+}
+
+void llcm_exec_handle_set_lane(struct llcm_exec_handle *handle, size_t lane) {
+    handle->routine->lane_ = lane;
+}
+
+void llcm_exec_handle_sleep(struct llcm_exec_handle *handle, uint64_t nanos) {
+    uint64_t const sleep_tsc_ticks = llcm_nanos_to_tsc_ticks(nanos);
+    handle->sleep_tsc_ticks_ = 0 == sleep_tsc_ticks ? 1 : sleep_tsc_ticks;
+}
+
+bool llcm_exec_handle_try_schedule_next(struct llcm_exec_handle *handle,
+                                        struct llcm_routine *routine) {
+    if (!llcm_scheduler_try_reserve_new_routine_(handle->polling_scheduler_)) {
+        return false;
+    }
+    routine->timer_period_ = 0;
+    routine->lane_ = 0;
+    LLCM_TRACE_(LLCM_TRACE_ROUTINE_SCHEDULED, routine, handle->polling_scheduler_);
+    llcm_scheduler_set_run_next_(handle, routine);
+    return true;
+}
+
+void llcm_exec_handle_park_(struct llcm_exec_handle *handle,
+                            bool (*try_park)(void *waitable, struct llcm_routine *,
+                                             struct llcm_scheduler *),
+                            void *waitable) {
+    handle->try_park_ = try_park;
+    handle->park_waitable_ = waitable;
+}
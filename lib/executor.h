@@ -0,0 +1,378 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/scheduler.h"
+#include "lib/scheduler_group.h"
+#include "lib/utils.h"
+#include "lib/wait_strategy.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* public */
+
+#define LLCM_EXECUTOR_MAX_CPUS 1024
+
+struct llcm_executor_config {
+    size_t num_workers;
+    size_t capacity_per_worker;
+    // pins worker i to cpus[i], NULL leaves the workers unpinned, see
+    // llcm_executor_get_topology_cpus for one cpu per physical core
+    int const *cpus;
+    // runs the workers under SCHED_FIFO at the highest priority, usually needs privileges
+    bool realtime;
+    // idle workers steal from their siblings, a worker left with queued routines after an
+    // iteration wakes one parked sibling to steal them
+    bool steal;
+    // polls per iteration of the hot loop before the hook runs
+    size_t poll_budget;
+    // other hot loop work, called once per iteration on every worker, may be NULL
+    void (*hook)(void *hook_arg, size_t worker_id);
+    void *hook_arg;
+    // how a worker backs off after an iteration that polled nothing
+    struct llcm_wait_strategy wait_strategy;
+};
+
+// cumulative since the worker started, diff two snapshots for a window
+struct llcm_executor_worker_stats {
+    uint64_t num_polls;
+    // time spent in iterations that polled at least one routine
+    uint64_t busy_nanos;
+    uint64_t elapsed_nanos;
+};
+
+// owns a llcm_scheduler_group and one worker thread per scheduler that polls it in a hot loop
+struct llcm_executor {
+    struct llcm_executor_config config;
+    struct llcm_scheduler_group group;
+    struct llcm_allocator allocator;
+    struct llcm_executor_worker_ *workers;
+
+    /* private */
+
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint32_t state_;
+    uint64_t num_workers_ready_;
+};
+
+struct llcm_executor_config llcm_executor_config_create_default(size_t num_workers,
+                                                                size_t capacity_per_worker);
+
+void llcm_executor_init(struct llcm_executor *, struct llcm_executor_config);
+void llcm_executor_init_with_custom_allocate(struct llcm_executor *, struct llcm_executor_config,
+                                             struct llcm_allocator);
+// the workers must be stopped by drain or shutdown first
+void llcm_executor_uninit(struct llcm_executor *);
+
+// starts every worker, or none of them if a thread can not be created, pinned or made realtime
+bool llcm_executor_start(struct llcm_executor *);
+// keeps polling until every routine on every scheduler has cancelled, then stops the workers
+void llcm_executor_drain(struct llcm_executor *);
+// stops the workers after their current iteration, routines left on the schedulers stay there
+void llcm_executor_shutdown(struct llcm_executor *);
+
+struct llcm_scheduler *llcm_executor_get_scheduler(struct llcm_executor *, size_t worker_id);
+void llcm_executor_get_worker_stats(struct llcm_executor const *, size_t worker_id,
+                                    struct llcm_executor_worker_stats *);
+// busy / elapsed since the worker started, in [0, 1]
+double llcm_executor_get_utilization(struct llcm_executor const *, size_t worker_id);
+
+// fills cpus with the first hyperthread of every physical core the calling thread may run on,
+// in ascending order, returns the number of cpus
+size_t llcm_executor_get_topology_cpus(int *cpus, size_t max_cpus);
+
+/* private */
+
+// every cpu the topology walk looks at fits in a cpu_set_t
+static_assert(LLCM_EXECUTOR_MAX_CPUS <= CPU_SETSIZE, "");
+
+enum llcm_executor_state_ {
+    LLCM_EXECUTOR_STATE_STOPPED_,
+    LLCM_EXECUTOR_STATE_STARTING_,
+    LLCM_EXECUTOR_STATE_RUNNING_,
+    LLCM_EXECUTOR_STATE_DRAINING_,
+    LLCM_EXECUTOR_STATE_STOPPING_,
+};
+
+struct llcm_executor_worker_ {
+    struct llcm_executor *executor;
+    pthread_t thread;
+    size_t id;
+    bool setup_failed;
+    // only written by the worker
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_polls;
+    uint64_t busy_tsc;
+    uint64_t start_tsc;
+};
+
+void *llcm_executor_worker_exec_(void *worker);
+bool llcm_executor_setup_thread_(struct llcm_executor_worker_ *);
+bool llcm_executor_is_drained_(struct llcm_executor *);
+// wakes one parked sibling of worker_id if its scheduler has routines left to steal
+void llcm_executor_wake_thief_(struct llcm_executor *, size_t worker_id);
+void llcm_executor_stop_(struct llcm_executor *, enum llcm_executor_state_);
+// reads a single integer from a sysfs file, returns -1 if it is missing
+long llcm_executor_read_sysfs_long_(char const *path);
+
+struct llcm_executor_config llcm_executor_config_create_default(size_t num_workers,
+                                                                size_t capacity_per_worker) {
+    return (struct llcm_executor_config){.num_workers = num_workers,
+                                         .capacity_per_worker = capacity_per_worker,
+                                         .cpus = NULL,
+                                         .realtime = false,
+                                         .steal = true,
+                                         .poll_budget = 64,
+                                         .hook = NULL,
+                                         .hook_arg = NULL,
+                                         .wait_strategy = llcm_wait_strategy_create_default()};
+}
+
+void llcm_executor_init(struct llcm_executor *executor, struct llcm_executor_config config) {
+    llcm_executor_init_with_custom_allocate(executor, config, llcm_allocator_create_default());
+}
+
+void llcm_executor_init_with_custom_allocate(struct llcm_executor *executor,
+                                             struct llcm_executor_config config,
+                                             struct llcm_allocator allocator) {
+    assert(config.num_workers >= 1);
+    memset(executor, 0, sizeof(*executor));
+    executor->config = config;
+    if (0 == executor->config.poll_budget) {
+        executor->config.poll_budget = 1;
+    }
+    executor->allocator = allocator;
+    llcm_scheduler_group_init_with_custom_allocate(&executor->group, config.num_workers,
+                                                   config.capacity_per_worker, allocator);
+    executor->workers = llcm_allocator_allocate(
+        allocator, alignof(struct llcm_executor_worker_),
+        sizeof(struct llcm_executor_worker_) * config.num_workers);
+    assert(NULL != executor->workers);
+    for (size_t worker_id = 0; worker_id < config.num_workers; worker_id++) {
+        executor->workers[worker_id] =
+            (struct llcm_executor_worker_){.executor = executor, .id = worker_id};
+    }
+}
+
+void llcm_executor_uninit(struct llcm_executor *executor) {
+    llcm_allocator_free(executor->allocator, executor->workers,
+                        sizeof(struct llcm_executor_worker_) * executor->config.num_workers);
+    llcm_scheduler_group_uninit(&executor->group);
+}
+
+bool llcm_executor_start(struct llcm_executor *executor) {
+    size_t const num_workers = executor->config.num_workers;
+    __atomic_store_n(&executor->num_workers_ready_, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&executor->state_, LLCM_EXECUTOR_STATE_STARTING_, __ATOMIC_RELEASE);
+    size_t num_started = 0;
+    bool ok = true;
+    for (; num_started < num_workers; num_started++) {
+        struct llcm_executor_worker_ *worker = &executor->workers[num_started];
+        if (0 != pthread_create(&worker->thread, NULL, llcm_executor_worker_exec_, worker)) {
+            ok = false;
+            break;
+        }
+    }
+    // every started worker reports whether its thread setup worked before any of them polls
+    while (__atomic_load_n(&executor->num_workers_ready_, __ATOMIC_ACQUIRE) != num_started) {
+        sched_yield();
+    }
+    for (size_t worker_id = 0; worker_id < num_started; worker_id++) {
+        ok = ok && !executor->workers[worker_id].setup_failed;
+    }
+    __atomic_store_n(&executor->state_,
+                     ok ? LLCM_EXECUTOR_STATE_RUNNING_ : LLCM_EXECUTOR_STATE_STOPPING_,
+                     __ATOMIC_RELEASE);
+    if (!ok) {
+        for (size_t worker_id = 0; worker_id < num_started; worker_id++) {
+            pthread_join(executor->workers[worker_id].thread, NULL);
+        }
+        __atomic_store_n(&executor->state_, LLCM_EXECUTOR_STATE_STOPPED_, __ATOMIC_RELEASE);
+    }
+    return ok;
+}
+
+void llcm_executor_drain(struct llcm_executor *executor) {
+    llcm_executor_stop_(executor, LLCM_EXECUTOR_STATE_DRAINING_);
+}
+
+void llcm_executor_shutdown(struct llcm_executor *executor) {
+    llcm_executor_stop_(executor, LLCM_EXECUTOR_STATE_STOPPING_);
+}
+
+struct llcm_scheduler *llcm_executor_get_scheduler(struct llcm_executor *executor,
+                                                   size_t worker_id) {
+    return llcm_scheduler_group_get_scheduler(&executor->group, worker_id);
+}
+
+void llcm_executor_get_worker_stats(struct llcm_executor const *executor, size_t worker_id,
+                                    struct llcm_executor_worker_stats *stats) {
+    struct llcm_executor_worker_ const *worker = &executor->workers[worker_id];
+    uint64_t const start_tsc = __atomic_load_n(&worker->start_tsc, __ATOMIC_ACQUIRE);
+    uint64_t const now_tsc = llcm_rdtsc();
+    stats->num_polls = __atomic_load_n(&worker->num_polls, __ATOMIC_RELAXED);
+    stats->busy_nanos =
+        llcm_tsc_ticks_to_nanos(__atomic_load_n(&worker->busy_tsc, __ATOMIC_RELAXED));
+    stats->elapsed_nanos =
+        0 == start_tsc || now_tsc < start_tsc ? 0 : llcm_tsc_ticks_to_nanos(now_tsc - start_tsc);
+}
+
+double llcm_executor_get_utilization(struct llcm_executor const *executor, size_t worker_id) {
+    struct llcm_executor_worker_stats stats;
+    llcm_executor_get_worker_stats(executor, worker_id, &stats);
+    if (0 == stats.elapsed_nanos) {
+        return 0;
+    }
+    double const utilization = (double) stats.busy_nanos / stats.elapsed_nanos;
+    return utilization > 1 ? 1 : utilization;
+}
+
+size_t llcm_executor_get_topology_cpus(int *cpus, size_t max_cpus) {
+    cpu_set_t cpuset;
+    if (0 != sched_getaffinity(0, sizeof(cpuset), &cpuset)) {
+        return 0;
+    }
+    // the (package, core) pair of every cpu already picked
+    long packages[LLCM_EXECUTOR_MAX_CPUS];
+    long cores[LLCM_EXECUTOR_MAX_CPUS];
+    size_t num_cpus = 0;
+    for (int cpu = 0; cpu < LLCM_EXECUTOR_MAX_CPUS && num_cpus < max_cpus; cpu++) {
+        if (!CPU_ISSET(cpu, &cpuset)) {
+            continue;
+        }
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id",
+                 cpu);
+        long const package = llcm_executor_read_sysfs_long_(path);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        long const core = llcm_executor_read_sysfs_long_(path);
+        bool sibling = false;
+        // without topology every cpu counts as its own core
+        for (size_t i = 0; i < num_cpus && -1 != core; i++) {
+            sibling = sibling || (packages[i] == package && cores[i] == core);
+        }
+        if (!sibling) {
+            packages[num_cpus] = package;
+            cores[num_cpus] = core;
+            cpus[num_cpus++] = cpu;
+        }
+    }
+    return num_cpus;
+}
+
+void *llcm_executor_worker_exec_(void *arg0) {
+    struct llcm_executor_worker_ *worker = arg0;
+    struct llcm_executor *executor = worker->executor;
+    worker->setup_failed = !llcm_executor_setup_thread_(worker);
+    __atomic_fetch_add(&executor->num_workers_ready_, 1, __ATOMIC_RELEASE);
+    while (LLCM_EXECUTOR_STATE_STARTING_ == __atomic_load_n(&executor->state_, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+
+    struct llcm_executor_config const *config = &executor->config;
+    struct llcm_scheduler *scheduler = llcm_executor_get_scheduler(executor, worker->id);
+    struct llcm_waiter waiter;
+    llcm_waiter_init(&waiter, config->wait_strategy);
+    __atomic_store_n(&worker->start_tsc, llcm_rdtsc(), __ATOMIC_RELEASE);
+    for (;;) {
+        uint32_t const state = __atomic_load_n(&executor->state_, __ATOMIC_ACQUIRE);
+        if (LLCM_EXECUTOR_STATE_STOPPING_ == state ||
+            (LLCM_EXECUTOR_STATE_DRAINING_ == state && llcm_executor_is_drained_(executor))) {
+            break;
+        }
+        uint64_t const iteration_start_tsc = llcm_rdtsc();
+        size_t num_polled = 0;
+        while (num_polled < config->poll_budget &&
+               (config->steal ? llcm_scheduler_group_poll(&executor->group, worker->id, NULL)
+                              : llcm_scheduler_poll(scheduler, NULL))) {
+            num_polled++;
+        }
+        if (0 != num_polled) {
+            uint64_t const busy_tsc = llcm_rdtsc() - iteration_start_tsc;
+            __atomic_store_n(&worker->busy_tsc, worker->busy_tsc + busy_tsc, __ATOMIC_RELAXED);
+            __atomic_store_n(&worker->num_polls, worker->num_polls + num_polled,
+                             __ATOMIC_RELAXED);
+            llcm_waiter_on_productive_poll_(&waiter);
+            if (config->steal) {
+                llcm_executor_wake_thief_(executor, worker->id);
+            }
+        }
+        if (NULL != config->hook) {
+            config->hook(config->hook_arg, worker->id);
+        }
+        if (0 == num_polled) {
+            llcm_scheduler_wait_(scheduler, &waiter);
+        }
+    }
+    return NULL;
+}
+
+bool llcm_executor_setup_thread_(struct llcm_executor_worker_ *worker) {
+    struct llcm_executor_config const *config = &worker->executor->config;
+    if (NULL != config->cpus && !llcm_thread_set_affinity(config->cpus[worker->id])) {
+        return false;
+    }
+    return !config->realtime || llcm_thread_set_realtime_priority();
+}
+
+bool llcm_executor_is_drained_(struct llcm_executor *executor) {
+    // only while draining. it flushes every reservation shard, the drained count has to be exact,
+    // a sum of the shards' tokens read one after another can miss a routine
+    for (size_t worker_id = 0; worker_id < executor->config.num_workers; worker_id++) {
+        struct llcm_scheduler *scheduler = llcm_executor_get_scheduler(executor, worker_id);
+        if (0 != llcm_scheduler_get_num_routines(scheduler)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void llcm_executor_wake_thief_(struct llcm_executor *executor, size_t worker_id) {
+    // a parked worker is otherwise only woken by routines scheduled on its own scheduler. the
+    // next routine is polled here anyway, stealing it would only move it
+    struct llcm_scheduler *scheduler = llcm_executor_get_scheduler(executor, worker_id);
+    if (llcm_scheduler_get_num_queued_routines(scheduler) < 2) {
+        return;
+    }
+    size_t const num_workers = executor->config.num_workers;
+    for (size_t i = 1; i < num_workers; i++) {
+        struct llcm_scheduler *sibling =
+            llcm_executor_get_scheduler(executor, (worker_id + i) % num_workers);
+        // a sibling that parks right after this load is woken after the next iteration
+        if (0 != __atomic_load_n(&sibling->num_parked, __ATOMIC_RELAXED)) {
+            llcm_scheduler_wake_(sibling);
+            return;
+        }
+    }
+}
+
+void llcm_executor_stop_(struct llcm_executor *executor, enum llcm_executor_state_ state) {
+    if (LLCM_EXECUTOR_STATE_STOPPED_ == __atomic_load_n(&executor->state_, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    __atomic_store_n(&executor->state_, state, __ATOMIC_RELEASE);
+    // parked workers would otherwise only notice after max_park_nanos
+    for (size_t worker_id = 0; worker_id < executor->config.num_workers; worker_id++) {
+        llcm_scheduler_wake_(llcm_executor_get_scheduler(executor, worker_id));
+    }
+    for (size_t worker_id = 0; worker_id < executor->config.num_workers; worker_id++) {
+        pthread_join(executor->workers[worker_id].thread, NULL);
+    }
+    __atomic_store_n(&executor->state_, LLCM_EXECUTOR_STATE_STOPPED_, __ATOMIC_RELEASE);
+}
+
+long llcm_executor_read_sysfs_long_(char const *path) {
+    FILE *file = fopen(path, "r");
+    if (NULL == file) {
+        return -1;
+    }
+    long value = -1;
+    if (1 != fscanf(file, "%ld", &value)) {
+        value = -1;
+    }
+    fclose(file);
+    return value;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "lib/concurrent_queue.h"
+#include "lib/exec_handle.h"
+#include "lib/scheduler.h"
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* public */
+
+// a single value set once through a llcm_promise, at most one routine waits on it at a time
+struct llcm_future {
+    /* private */
+
+    // LLCM_FUTURE_PENDING_, LLCM_FUTURE_READY_ or the parked routine
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uintptr_t state_;
+    void *value_;
+    struct llcm_scheduler *waiter_scheduler_;
+};
+
+// the producing end of a future
+struct llcm_promise {
+    struct llcm_future *future;
+};
+
+// also resets a future so it can be reused once nothing waits on it
+void llcm_future_init(struct llcm_future *);
+struct llcm_promise llcm_future_get_promise(struct llcm_future *);
+bool llcm_future_is_ready(struct llcm_future const *);
+// only valid once the future is ready
+void *llcm_future_get_value(struct llcm_future const *);
+
+// returns true if the future is ready, otherwise the routine is parked when the current poll
+// returns, off every queue but holding its reservation, and polled again once it is ready
+bool llcm_future_await(struct llcm_future *, struct llcm_exec_handle *);
+
+// from any thread, pushes a parked routine back onto the scheduler it was polled on
+void llcm_promise_set_value(struct llcm_promise, void *value);
+
+/* private */
+
+#define LLCM_FUTURE_PENDING_ ((uintptr_t) 0)
+#define LLCM_FUTURE_READY_   ((uintptr_t) 1)
+
+bool llcm_future_try_park_(void *future, struct llcm_routine *, struct llcm_scheduler *);
+
+void llcm_future_init(struct llcm_future *future) {
+    future->value_ = NULL;
+    future->waiter_scheduler_ = NULL;
+    __atomic_store_n(&future->state_, LLCM_FUTURE_PENDING_, __ATOMIC_RELEASE);
+}
+
+struct llcm_promise llcm_future_get_promise(struct llcm_future *future) {
+    return (struct llcm_promise){.future = future};
+}
+
+bool llcm_future_is_ready(struct llcm_future const *future) {
+    return LLCM_FUTURE_READY_ == __atomic_load_n(&future->state_, __ATOMIC_ACQUIRE);
+}
+
+void *llcm_future_get_value(struct llcm_future const *future) { return future->value_; }
+
+bool llcm_future_await(struct llcm_future *future, struct llcm_exec_handle *handle) {
+    if (llcm_future_is_ready(future)) {
+        return true;
+    }
+    llcm_exec_handle_park_(handle, llcm_future_try_park_, future);
+    return false;
+}
+
+void llcm_promise_set_value(struct llcm_promise promise, void *value) {
+    struct llcm_future *future = promise.future;
+    future->value_ = value;
+    uintptr_t const state =
+        __atomic_exchange_n(&future->state_, LLCM_FUTURE_READY_, __ATOMIC_ACQ_REL);
+    if (LLCM_FUTURE_PENDING_ != state && LLCM_FUTURE_READY_ != state) {
+        llcm_scheduler_resume_routine_(future->waiter_scheduler_, (struct llcm_routine *) state);
+    }
+}
+
+bool llcm_future_try_park_(void *waitable, struct llcm_routine *routine,
+                           struct llcm_scheduler *scheduler) {
+    struct llcm_future *future = waitable;
+    future->waiter_scheduler_ = scheduler;
+    uintptr_t expected = LLCM_FUTURE_PENDING_;
+    // fails if the promise was fulfilled since the routine checked, then it is requeued
+    return __atomic_compare_exchange_n(&future->state_, &expected, (uintptr_t) routine, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/utils.h"
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* public */
+
+// sub buckets per power of two, values are recorded with at most 1 / 16 relative error
+#define LLCM_HISTOGRAM_SUB_BUCKET_BITS 4
+#define LLCM_HISTOGRAM_NUM_SUB_BUCKETS (1u << LLCM_HISTOGRAM_SUB_BUCKET_BITS)
+// values below LLCM_HISTOGRAM_NUM_SUB_BUCKETS get exact buckets, every larger power of two up to
+// 2^63 gets LLCM_HISTOGRAM_NUM_SUB_BUCKETS linear buckets
+#define LLCM_HISTOGRAM_NUM_BUCKETS                                                                 \
+    ((64 - LLCM_HISTOGRAM_SUB_BUCKET_BITS + 1) * LLCM_HISTOGRAM_NUM_SUB_BUCKETS)
+
+// a log bucketed histogram of uint64_t values, recorded lock free from any number of threads
+struct llcm_histogram {
+    uint64_t *buckets;
+    struct llcm_allocator allocator;
+    alignas(64) uint64_t count;
+    uint64_t max;
+};
+
+// the usual tail percentiles, each the upper bound of the bucket it falls in
+struct llcm_histogram_summary {
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+};
+
+void llcm_histogram_init(struct llcm_histogram *, struct llcm_allocator);
+void llcm_histogram_uninit(struct llcm_histogram *);
+
+void llcm_histogram_record(struct llcm_histogram *, uint64_t value);
+// not atomic with concurrent records, which may land on either side of the reset
+void llcm_histogram_reset(struct llcm_histogram *);
+// adds every value recorded in src to dst, e.g. to combine per thread histograms
+void llcm_histogram_merge(struct llcm_histogram *dst, struct llcm_histogram const *src);
+
+uint64_t llcm_histogram_get_count(struct llcm_histogram const *);
+uint64_t llcm_histogram_get_max(struct llcm_histogram const *);
+// percentile in [0, 100], returns 0 for an empty histogram
+uint64_t llcm_histogram_get_percentile(struct llcm_histogram const *, double percentile);
+void llcm_histogram_get_summary(struct llcm_histogram const *, struct llcm_histogram_summary *);
+
+/* private */
+
+size_t llcm_histogram_get_bucket_index_(uint64_t value);
+uint64_t llcm_histogram_get_bucket_upper_bound_(size_t index);
+
+void llcm_histogram_init(struct llcm_histogram *histogram, struct llcm_allocator allocator) {
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->allocator = allocator;
+    size_t const size = LLCM_HISTOGRAM_NUM_BUCKETS * sizeof(uint64_t);
+    histogram->buckets = llcm_allocator_allocate(allocator, 64, size);
+    assert(NULL != histogram->buckets);
+    memset(histogram->buckets, 0, size);
+}
+
+void llcm_histogram_uninit(struct llcm_histogram *histogram) {
+    llcm_allocator_free(histogram->allocator, histogram->buckets,
+                        LLCM_HISTOGRAM_NUM_BUCKETS * sizeof(uint64_t));
+}
+
+void llcm_histogram_record(struct llcm_histogram *histogram, uint64_t value) {
+    __atomic_fetch_add(&histogram->buckets[llcm_histogram_get_bucket_index_(value)], 1,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    while (value > max && !__atomic_compare_exchange_n(&histogram->max, &max, value, true,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void llcm_histogram_reset(struct llcm_histogram *histogram) {
+    for (size_t i = 0; i < LLCM_HISTOGRAM_NUM_BUCKETS; i++) {
+        __atomic_store_n(&histogram->buckets[i], 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&histogram->count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->max, 0, __ATOMIC_RELAXED);
+}
+
+void llcm_histogram_merge(struct llcm_histogram *dst, struct llcm_histogram const *src) {
+    for (size_t i = 0; i < LLCM_HISTOGRAM_NUM_BUCKETS; i++) {
+        uint64_t const count = __atomic_load_n(&src->buckets[i], __ATOMIC_RELAXED);
+        if (0 != count) {
+            __atomic_fetch_add(&dst->buckets[i], count, __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_fetch_add(&dst->count, llcm_histogram_get_count(src), __ATOMIC_RELAXED);
+    uint64_t const src_max = llcm_histogram_get_max(src);
+    uint64_t max = __atomic_load_n(&dst->max, __ATOMIC_RELAXED);
+    while (src_max > max && !__atomic_compare_exchange_n(&dst->max, &max, src_max, true,
+                                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+uint64_t llcm_histogram_get_count(struct llcm_histogram const *histogram) {
+    return __atomic_load_n(&histogram->count, __ATOMIC_RELAXED);
+}
+
+uint64_t llcm_histogram_get_max(struct llcm_histogram const *histogram) {
+    return __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+}
+
+uint64_t llcm_histogram_get_percentile(struct llcm_histogram const *histogram,
+                                       double percentile) {
+    // sum the buckets instead of trusting count, they may be mid update
+    uint64_t total = 0;
+    for (size_t i = 0; i < LLCM_HISTOGRAM_NUM_BUCKETS; i++) {
+        total += __atomic_load_n(&histogram->buckets[i], __ATOMIC_RELAXED);
+    }
+    if (0 == total) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) (percentile / 100.0 * (double) total + 0.5);
+    rank = 0 == rank ? 1 : rank > total ? total : rank;
+    uint64_t const max = llcm_histogram_get_max(histogram);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LLCM_HISTOGRAM_NUM_BUCKETS; i++) {
+        seen += __atomic_load_n(&histogram->buckets[i], __ATOMIC_RELAXED);
+        if (seen >= rank) {
+            uint64_t const upper_bound = llcm_histogram_get_bucket_upper_bound_(i);
+            return upper_bound < max ? upper_bound : max;
+        }
+    }
+    return max;
+}
+
+void llcm_histogram_get_summary(struct llcm_histogram const *histogram,
+                                struct llcm_histogram_summary *summary) {
+    summary->count = llcm_histogram_get_count(histogram);
+    summary->p50 = llcm_histogram_get_percentile(histogram, 50.0);
+    summary->p99 = llcm_histogram_get_percentile(histogram, 99.0);
+    summary->p999 = llcm_histogram_get_percentile(histogram, 99.9);
+    summary->max = llcm_histogram_get_max(histogram);
+}
+
+size_t llcm_histogram_get_bucket_index_(uint64_t value) {
+    if (value < LLCM_HISTOGRAM_NUM_SUB_BUCKETS) {
+        return value;
+    }
+    // the leading bit picks the power of two, the next SUB_BUCKET_BITS bits the sub bucket
+    unsigned const shift = 63 - __builtin_clzl(value) - LLCM_HISTOGRAM_SUB_BUCKET_BITS;
+    return (shift + 1) * LLCM_HISTOGRAM_NUM_SUB_BUCKETS +
+           ((value >> shift) & (LLCM_HISTOGRAM_NUM_SUB_BUCKETS - 1));
+}
+
+uint64_t llcm_histogram_get_bucket_upper_bound_(size_t index) {
+    if (index < LLCM_HISTOGRAM_NUM_SUB_BUCKETS) {
+        return index;
+    }
+    unsigned const shift = index / LLCM_HISTOGRAM_NUM_SUB_BUCKETS - 1;
+    uint64_t const lower_bound =
+        (uint64_t) (LLCM_HISTOGRAM_NUM_SUB_BUCKETS + index % LLCM_HISTOGRAM_NUM_SUB_BUCKETS)
+        << shift;
+    return lower_bound + ((uint64_t) 1 << shift) - 1;
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/concurrent_queue.h"
+#include "lib/exec_handle.h"
+#include "lib/scheduler.h"
+#include "lib/task_group.h"
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* public */
+
+// how many split off tasks each scheduler may hold on average, a default for max_tasks
+#define LLCM_PARALLEL_FOR_TASKS_PER_SCHEDULER 16
+
+struct llcm_parallel_for_task_;
+
+// runs fn over [begin, end) in chunks of at most grain indices, spread over several schedulers
+// by lazy splitting. a task polls one chunk at a time, and before each chunk hands half of its
+// remaining range to a scheduler with nothing queued, so the range is only cut as finely as
+// idle schedulers ask for
+struct llcm_parallel_for {
+    struct llcm_scheduler *schedulers;
+    size_t num_schedulers;
+    struct llcm_allocator allocator;
+
+    /* private */
+
+    void (*fn_)(void *arg, size_t begin, size_t end);
+    void *arg_;
+    size_t grain_;
+    struct llcm_task_group group_;
+    struct llcm_parallel_for_task_ *tasks_;
+    size_t max_tasks_;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) size_t num_tasks_;
+};
+
+// max_tasks bounds the number of splits of one run, 0 picks
+// num_schedulers * LLCM_PARALLEL_FOR_TASKS_PER_SCHEDULER
+void llcm_parallel_for_init(struct llcm_parallel_for *, struct llcm_scheduler *schedulers,
+                            size_t num_schedulers, size_t max_tasks);
+void llcm_parallel_for_init_with_custom_allocate(struct llcm_parallel_for *,
+                                                 struct llcm_scheduler *schedulers,
+                                                 size_t num_schedulers, size_t max_tasks,
+                                                 struct llcm_allocator);
+// the last run must be done
+void llcm_parallel_for_uninit(struct llcm_parallel_for *);
+
+// starts a run once the previous one is done, fn may be called from any of the schedulers'
+// pollers. returns false if the first task could not be scheduled
+bool llcm_parallel_for_try_start(struct llcm_parallel_for *, size_t begin, size_t end,
+                                 size_t grain, void (*fn)(void *arg, size_t begin, size_t end),
+                                 void *arg);
+// true once fn returned for every chunk
+bool llcm_parallel_for_is_done(struct llcm_parallel_for const *);
+// returns true once the run is done, otherwise parks the routine like llcm_task_group_await
+bool llcm_parallel_for_await(struct llcm_parallel_for *, struct llcm_exec_handle *);
+// number of tasks the last run was split into
+size_t llcm_parallel_for_get_num_tasks(struct llcm_parallel_for const *);
+
+/* private */
+
+struct llcm_parallel_for_task_ {
+    struct llcm_task task;
+    struct llcm_parallel_for *parallel_for;
+    size_t begin;
+    size_t end;
+};
+
+void llcm_parallel_for_poll_(void *task, struct llcm_exec_handle *);
+// claims a task for [begin, end) and spawns it onto the scheduler
+bool llcm_parallel_for_try_spawn_(struct llcm_parallel_for *, struct llcm_scheduler *,
+                                  size_t begin, size_t end);
+// a scheduler other than the polling one with nothing queued, or NULL
+struct llcm_scheduler *llcm_parallel_for_find_idle_scheduler_(struct llcm_parallel_for *,
+                                                              struct llcm_scheduler *polling);
+
+void llcm_parallel_for_init(struct llcm_parallel_for *parallel_for,
+                            struct llcm_scheduler *schedulers, size_t num_schedulers,
+                            size_t max_tasks) {
+    llcm_parallel_for_init_with_custom_allocate(parallel_for, schedulers, num_schedulers,
+                                                max_tasks, llcm_allocator_create_default());
+}
+
+void llcm_parallel_for_init_with_custom_allocate(struct llcm_parallel_for *parallel_for,
+                                                 struct llcm_scheduler *schedulers,
+                                                 size_t num_schedulers, size_t max_tasks,
+                                                 struct llcm_allocator allocator) {
+    assert(num_schedulers >= 1);
+    memset(parallel_for, 0, sizeof(*parallel_for));
+    parallel_for->schedulers = schedulers;
+    parallel_for->num_schedulers = num_schedulers;
+    parallel_for->allocator = allocator;
+    parallel_for->max_tasks_ =
+        0 == max_tasks ? num_schedulers * LLCM_PARALLEL_FOR_TASKS_PER_SCHEDULER : max_tasks;
+    parallel_for->tasks_ = llcm_allocator_allocate(
+        allocator, alignof(struct llcm_parallel_for_task_),
+        sizeof(struct llcm_parallel_for_task_) * parallel_for->max_tasks_);
+    assert(NULL != parallel_for->tasks_);
+    llcm_task_group_init(&parallel_for->group_);
+}
+
+void llcm_parallel_for_uninit(struct llcm_parallel_for *parallel_for) {
+    llcm_allocator_free(parallel_for->allocator, parallel_for->tasks_,
+                        sizeof(struct llcm_parallel_for_task_) * parallel_for->max_tasks_);
+}
+
+bool llcm_parallel_for_try_start(struct llcm_parallel_for *parallel_for, size_t begin,
+                                 size_t end, size_t grain,
+                                 void (*fn)(void *arg, size_t begin, size_t end), void *arg) {
+    assert(llcm_parallel_for_is_done(parallel_for));
+    parallel_for->fn_ = fn;
+    parallel_for->arg_ = arg;
+    parallel_for->grain_ = 0 == grain ? 1 : grain;
+    __atomic_store_n(&parallel_for->num_tasks_, 0, __ATOMIC_RELAXED);
+    if (begin >= end) {
+        return true;
+    }
+    // the first task starts wherever there is the least queued already
+    struct llcm_scheduler *scheduler = &parallel_for->schedulers[0];
+    for (size_t i = 1; i < parallel_for->num_schedulers; i++) {
+        if (llcm_scheduler_get_num_queued_routines(&parallel_for->schedulers[i]) <
+            llcm_scheduler_get_num_queued_routines(scheduler)) {
+            scheduler = &parallel_for->schedulers[i];
+        }
+    }
+    return llcm_parallel_for_try_spawn_(parallel_for, scheduler, begin, end);
+}
+
+bool llcm_parallel_for_is_done(struct llcm_parallel_for const *parallel_for) {
+    return llcm_task_group_is_done(&parallel_for->group_);
+}
+
+bool llcm_parallel_for_await(struct llcm_parallel_for *parallel_for,
+                             struct llcm_exec_handle *handle) {
+    return llcm_task_group_await(&parallel_for->group_, handle);
+}
+
+size_t llcm_parallel_for_get_num_tasks(struct llcm_parallel_for const *parallel_for) {
+    size_t const num_tasks = __atomic_load_n(&parallel_for->num_tasks_, __ATOMIC_RELAXED);
+    return num_tasks < parallel_for->max_tasks_ ? num_tasks : parallel_for->max_tasks_;
+}
+
+void llcm_parallel_for_poll_(void *arg0, struct llcm_exec_handle *handle) {
+    struct llcm_parallel_for_task_ *task = arg0;
+    struct llcm_parallel_for *parallel_for = task->parallel_for;
+    size_t const grain = parallel_for->grain_;
+    // split while some scheduler is idle and more than a chunk is left
+    while (task->end - task->begin > grain) {
+        struct llcm_scheduler *idle =
+            llcm_parallel_for_find_idle_scheduler_(parallel_for, handle->scheduler);
+        if (NULL == idle) {
+            break;
+        }
+        size_t const middle = task->begin + (task->end - task->begin) / 2;
+        if (!llcm_parallel_for_try_spawn_(parallel_for, idle, middle, task->end)) {
+            break;
+        }
+        task->end = middle;
+    }
+    size_t const chunk_end = task->end - task->begin > grain ? task->begin + grain : task->end;
+    parallel_for->fn_(parallel_for->arg_, task->begin, chunk_end);
+    task->begin = chunk_end;
+    if (task->begin == task->end) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+bool llcm_parallel_for_try_spawn_(struct llcm_parallel_for *parallel_for,
+                                  struct llcm_scheduler *scheduler, size_t begin, size_t end) {
+    // claimed slots are never handed back within a run, a failed spawn just stops splitting
+    size_t const index = __atomic_fetch_add(&parallel_for->num_tasks_, 1, __ATOMIC_RELAXED);
+    if (index >= parallel_for->max_tasks_) {
+        return false;
+    }
+    struct llcm_parallel_for_task_ *task = &parallel_for->tasks_[index];
+    task->parallel_for = parallel_for;
+    task->begin = begin;
+    task->end = end;
+    task->task = (struct llcm_task){.poll = llcm_parallel_for_poll_, .arg0 = task};
+    return llcm_task_group_try_spawn(&parallel_for->group_, &task->task, scheduler);
+}
+
+struct llcm_scheduler *llcm_parallel_for_find_idle_scheduler_(
+    struct llcm_parallel_for *parallel_for, struct llcm_scheduler *polling) {
+    // a single scheduler can only gain from splitting if several threads poll it. the search
+    // starts past the polling scheduler, so splits fan out instead of piling onto the first one
+    size_t const num_schedulers = parallel_for->num_schedulers;
+    size_t const polling_index = polling - parallel_for->schedulers;
+    size_t const first = polling_index < num_schedulers ? polling_index + 1 : 0;
+    for (size_t i = 0; i < num_schedulers; i++) {
+        struct llcm_scheduler *scheduler = &parallel_for->schedulers[(first + i) % num_schedulers];
+        if ((scheduler != polling || 1 == num_schedulers) &&
+            0 == llcm_scheduler_get_num_queued_routines(scheduler)) {
+            return scheduler;
+        }
+    }
+    return NULL;
+}
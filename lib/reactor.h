@@ -0,0 +1,146 @@
+#pragma once
+
+#include "lib/concurrent_queue.h"
+#include "lib/exec_handle.h"
+#include "lib/scheduler.h"
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+/* public */
+
+#define LLCM_REACTOR_POLL_BATCH_MAX_SIZE 64
+
+// parks routines on file descriptors and pushes them back onto the scheduler they were polled on
+// once the fd is ready. workers reap it from their hot loop next to the scheduler, e.g. from the
+// hook of a llcm_executor, as llcm_reactor_poll never blocks
+struct llcm_reactor {
+    /* private */
+
+    int epoll_fd_;
+    // routines parked on an fd, lets llcm_reactor_poll skip the syscall when there are none
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_waiting_;
+};
+
+// a non blocking file descriptor that at most one routine waits on at a time
+struct llcm_io {
+    int fd;
+
+    /* private */
+
+    struct llcm_reactor *reactor_;
+    bool registered_;
+    // epoll events the routine waits for and the ones that woke it
+    uint32_t events_;
+    uint32_t ready_events_;
+    struct llcm_routine *routine_;
+    struct llcm_scheduler *scheduler_;
+};
+
+// returns false if the epoll instance can not be created
+bool llcm_reactor_init(struct llcm_reactor *);
+// no routine may still be parked on the reactor
+void llcm_reactor_uninit(struct llcm_reactor *);
+// from any thread, reaps up to LLCM_REACTOR_POLL_BATCH_MAX_SIZE ready fds without blocking and
+// returns the number of routines resumed
+size_t llcm_reactor_poll(struct llcm_reactor *);
+size_t llcm_reactor_get_num_waiting(struct llcm_reactor const *);
+
+void llcm_io_init(struct llcm_io *, struct llcm_reactor *, int fd);
+// removes the fd from the reactor without closing it, no routine may still be parked on it
+void llcm_io_uninit(struct llcm_io *);
+// call after a read or write hit EAGAIN. the routine is parked when the current poll returns and
+// polled again once the fd is ready for any of the epoll events, e.g. EPOLLIN or EPOLLOUT.
+// readiness that arrived in between is not lost, the fd is checked when it is registered
+void llcm_io_await(struct llcm_io *, uint32_t events, struct llcm_exec_handle *);
+// the epoll events that woke the routine, EPOLLERR if the fd could not be watched at all
+uint32_t llcm_io_get_ready_events(struct llcm_io const *);
+
+/* private */
+
+bool llcm_io_try_park_(void *io, struct llcm_routine *, struct llcm_scheduler *);
+
+bool llcm_reactor_init(struct llcm_reactor *reactor) {
+    reactor->epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    reactor->num_waiting_ = 0;
+    return reactor->epoll_fd_ >= 0;
+}
+
+void llcm_reactor_uninit(struct llcm_reactor *reactor) {
+    assert(0 == llcm_reactor_get_num_waiting(reactor));
+    close(reactor->epoll_fd_);
+}
+
+size_t llcm_reactor_poll(struct llcm_reactor *reactor) {
+    if (0 == llcm_reactor_get_num_waiting(reactor)) {
+        return 0;
+    }
+    struct epoll_event events[LLCM_REACTOR_POLL_BATCH_MAX_SIZE];
+    int const num_events =
+        epoll_wait(reactor->epoll_fd_, events, LLCM_REACTOR_POLL_BATCH_MAX_SIZE, 0);
+    if (num_events <= 0) {
+        return 0;
+    }
+    // every fd is armed one shot, so each routine is reported to exactly one poller
+    for (int i = 0; i < num_events; i++) {
+        struct llcm_io *io = events[i].data.ptr;
+        struct llcm_routine *routine = io->routine_;
+        struct llcm_scheduler *scheduler = io->scheduler_;
+        io->ready_events_ = events[i].events;
+        __atomic_fetch_sub(&reactor->num_waiting_, 1, __ATOMIC_RELAXED);
+        // the routine may run and touch io again right after this
+        llcm_scheduler_resume_routine_(scheduler, routine);
+    }
+    return num_events;
+}
+
+size_t llcm_reactor_get_num_waiting(struct llcm_reactor const *reactor) {
+    return __atomic_load_n(&reactor->num_waiting_, __ATOMIC_RELAXED);
+}
+
+void llcm_io_init(struct llcm_io *io, struct llcm_reactor *reactor, int fd) {
+    *io = (struct llcm_io){.fd = fd, .reactor_ = reactor};
+}
+
+void llcm_io_uninit(struct llcm_io *io) {
+    if (io->registered_) {
+        epoll_ctl(io->reactor_->epoll_fd_, EPOLL_CTL_DEL, io->fd, NULL);
+        io->registered_ = false;
+    }
+}
+
+void llcm_io_await(struct llcm_io *io, uint32_t events, struct llcm_exec_handle *handle) {
+    io->events_ = events;
+    io->ready_events_ = 0;
+    llcm_exec_handle_park_(handle, llcm_io_try_park_, io);
+}
+
+uint32_t llcm_io_get_ready_events(struct llcm_io const *io) { return io->ready_events_; }
+
+bool llcm_io_try_park_(void *waitable, struct llcm_routine *routine,
+                       struct llcm_scheduler *scheduler) {
+    struct llcm_io *io = waitable;
+    struct llcm_reactor *reactor = io->reactor_;
+    io->routine_ = routine;
+    io->scheduler_ = scheduler;
+    // counted first so a poller that sees the event also sees a waiter to reap
+    __atomic_fetch_add(&reactor->num_waiting_, 1, __ATOMIC_RELAXED);
+    struct epoll_event event = {.events = io->events_ | EPOLLONESHOT, .data.ptr = io};
+    bool const was_registered = io->registered_;
+    // set before the ctl, once armed the routine may already be resumed and await again
+    io->registered_ = true;
+    // the ctl publishes the routine to whichever thread reaps the event
+    if (0 == epoll_ctl(reactor->epoll_fd_, was_registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                       io->fd, &event)) {
+        return true;
+    }
+    // e.g. a regular file, the routine is requeued and sees the error
+    io->registered_ = was_registered;
+    __atomic_fetch_sub(&reactor->num_waiting_, 1, __ATOMIC_RELAXED);
+    io->ready_events_ = EPOLLERR;
+    return false;
+}
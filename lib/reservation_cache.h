@@ -0,0 +1,187 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/concurrent_queue.h"
+#include "lib/utils.h"
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* public */
+
+#define LLCM_RESERVATION_CACHE_MAX_CHUNK_SIZE 64
+
+struct llcm_reservation_cache_shard_;
+
+// spreads the capacity reservations of a llcm_concurrent_queue over per thread shards. a shard
+// borrows capacity from the queue's reserved_push_size in chunks and hands it out with an
+// uncontended atomic on its own cache line, pops give capacity back to the popping thread's shard,
+// which returns it to the queue in chunks once it holds more than two. threads are spread over
+// the shards round robin, more threads than shards share them.
+//
+// the queue's reserved_push_size still counts every borrowed token, so a push never overflows
+// the ring. a reservation that finds the queue full hands every shard's spare tokens back and
+// retries once, it only fails if the queue is full even then
+struct llcm_reservation_cache {
+    struct llcm_concurrent_queue *queue;
+    size_t num_shards;
+    size_t chunk_size;
+    struct llcm_allocator allocator;
+
+    /* private */
+
+    struct llcm_reservation_cache_shard_ *shards_;
+};
+
+// num_shards is rounded up to a power of two. chunk_size is clamped to
+// 1..LLCM_RESERVATION_CACHE_MAX_CHUNK_SIZE, 0 picks a quarter of each shard's share of the
+// capacity, so the shards can hold at most half the capacity
+void llcm_reservation_cache_init(struct llcm_reservation_cache *, struct llcm_concurrent_queue *,
+                                 size_t num_shards, size_t chunk_size, struct llcm_allocator);
+// hands every cached token back to the queue
+void llcm_reservation_cache_uninit(struct llcm_reservation_cache *);
+
+// the same contract as llcm_concurrent_queue_try_reserve_size_before_push and
+// llcm_concurrent_queue_unreserve_size_after_pop, every reservation of the queue must go through
+// the cache
+bool llcm_reservation_cache_try_reserve(struct llcm_reservation_cache *, size_t num_new_entries);
+void llcm_reservation_cache_unreserve(struct llcm_reservation_cache *, size_t num_old_entries);
+
+// hands every shard's tokens back to the queue, safe from any thread at any time
+void llcm_reservation_cache_flush(struct llcm_reservation_cache *);
+// reserved entries, tokens cached in the shards excluded. never less than the true count, but
+// more while tokens are being borrowed or returned concurrently. it flushes every shard first
+size_t llcm_reservation_cache_get_num_reserved(struct llcm_reservation_cache *);
+
+/* private */
+
+struct llcm_reservation_cache_shard_ {
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) _Atomic uint64_t num_tokens;
+};
+
+// 0 until the thread first touches a cache, then its round robin index + 1
+_Thread_local size_t llcm_reservation_cache_thread_index_ = 0;
+_Atomic size_t llcm_reservation_cache_num_threads_ = 0;
+
+struct llcm_reservation_cache_shard_ *llcm_reservation_cache_get_shard_(
+    struct llcm_reservation_cache *);
+// moves the shard's tokens above keep_tokens back to the queue
+void llcm_reservation_cache_trim_shard_(struct llcm_reservation_cache *,
+                                        struct llcm_reservation_cache_shard_ *,
+                                        uint64_t keep_tokens);
+
+void llcm_reservation_cache_init(struct llcm_reservation_cache *cache,
+                                 struct llcm_concurrent_queue *queue, size_t num_shards,
+                                 size_t chunk_size, struct llcm_allocator allocator) {
+    assert(num_shards >= 1);
+    memset(cache, 0, sizeof(*cache));
+    num_shards = llcm_round_up_pow2(num_shards);
+    cache->queue = queue;
+    cache->num_shards = num_shards;
+    if (0 == chunk_size) {
+        chunk_size = llcm_concurrent_queue_get_capacity(queue) / (4 * num_shards);
+    }
+    if (chunk_size < 1) {
+        chunk_size = 1;
+    } else if (chunk_size > LLCM_RESERVATION_CACHE_MAX_CHUNK_SIZE) {
+        chunk_size = LLCM_RESERVATION_CACHE_MAX_CHUNK_SIZE;
+    }
+    cache->chunk_size = chunk_size;
+    cache->allocator = allocator;
+    cache->shards_ = llcm_allocator_allocate(
+        allocator, alignof(struct llcm_reservation_cache_shard_),
+        sizeof(struct llcm_reservation_cache_shard_) * num_shards);
+    assert(NULL != cache->shards_);
+    for (size_t i = 0; i < num_shards; i++) {
+        atomic_init(&cache->shards_[i].num_tokens, 0);
+    }
+}
+
+void llcm_reservation_cache_uninit(struct llcm_reservation_cache *cache) {
+    llcm_reservation_cache_flush(cache);
+    llcm_allocator_free(cache->allocator, cache->shards_,
+                        sizeof(struct llcm_reservation_cache_shard_) * cache->num_shards);
+}
+
+bool llcm_reservation_cache_try_reserve(struct llcm_reservation_cache *cache,
+                                        size_t num_new_entries) {
+    struct llcm_reservation_cache_shard_ *shard = llcm_reservation_cache_get_shard_(cache);
+    uint64_t num_tokens = atomic_load_explicit(&shard->num_tokens, memory_order_relaxed);
+    while (num_tokens >= num_new_entries) {
+        if (atomic_compare_exchange_weak_explicit(&shard->num_tokens, &num_tokens,
+                                                  num_tokens - num_new_entries,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            return true;
+        }
+    }
+    // borrow a chunk more than needed for the next reservations, the queue counts it first so it
+    // never undercounts what is reserved or cached
+    struct llcm_concurrent_queue *queue = cache->queue;
+    if (llcm_concurrent_queue_try_reserve_size_before_push(queue,
+                                                           num_new_entries + cache->chunk_size)) {
+        atomic_fetch_add_explicit(&shard->num_tokens, cache->chunk_size, memory_order_relaxed);
+        return true;
+    }
+    if (llcm_concurrent_queue_try_reserve_size_before_push(queue, num_new_entries)) {
+        return true;
+    }
+    // the queue looks full, but the tokens may just sit in other shards
+    llcm_reservation_cache_flush(cache);
+    return llcm_concurrent_queue_try_reserve_size_before_push(queue, num_new_entries);
+}
+
+void llcm_reservation_cache_unreserve(struct llcm_reservation_cache *cache,
+                                      size_t num_old_entries) {
+    struct llcm_reservation_cache_shard_ *shard = llcm_reservation_cache_get_shard_(cache);
+    // release like llcm_concurrent_queue_unreserve_size_after_pop, a flush acquires it
+    uint64_t const num_tokens =
+        atomic_fetch_add_explicit(&shard->num_tokens, num_old_entries, memory_order_release) +
+        num_old_entries;
+    if (num_tokens > 2 * cache->chunk_size) {
+        llcm_reservation_cache_trim_shard_(cache, shard, cache->chunk_size);
+    }
+}
+
+void llcm_reservation_cache_flush(struct llcm_reservation_cache *cache) {
+    for (size_t i = 0; i < cache->num_shards; i++) {
+        llcm_reservation_cache_trim_shard_(cache, &cache->shards_[i], 0);
+    }
+}
+
+size_t llcm_reservation_cache_get_num_reserved(struct llcm_reservation_cache *cache) {
+    // tokens only ever reach a shard after the queue counted them and leave it before the queue
+    // drops them, so the queue's count alone never undercounts
+    llcm_reservation_cache_flush(cache);
+    return atomic_load_explicit(&cache->queue->counters.reserved_push_size, memory_order_acquire);
+}
+
+struct llcm_reservation_cache_shard_ *llcm_reservation_cache_get_shard_(
+    struct llcm_reservation_cache *cache) {
+    size_t thread_index = llcm_reservation_cache_thread_index_;
+    if (0 == thread_index) {
+        thread_index = atomic_fetch_add_explicit(&llcm_reservation_cache_num_threads_, 1,
+                                                 memory_order_relaxed) +
+                       1;
+        llcm_reservation_cache_thread_index_ = thread_index;
+    }
+    return &cache->shards_[(thread_index - 1) & (cache->num_shards - 1)];
+}
+
+void llcm_reservation_cache_trim_shard_(struct llcm_reservation_cache *cache,
+                                        struct llcm_reservation_cache_shard_ *shard,
+                                        uint64_t keep_tokens) {
+    uint64_t num_tokens = atomic_load_explicit(&shard->num_tokens, memory_order_relaxed);
+    while (num_tokens > keep_tokens) {
+        if (atomic_compare_exchange_weak_explicit(&shard->num_tokens, &num_tokens, keep_tokens,
+                                                  memory_order_acq_rel, memory_order_relaxed)) {
+            llcm_concurrent_queue_unreserve_size_after_pop(cache->queue,
+                                                           num_tokens - keep_tokens);
+            return;
+        }
+    }
+}
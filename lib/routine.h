@@ -2,11 +2,55 @@
 
 #include "lib/exec_handle.h"
 
+#include <stddef.h>
+#include <stdint.h>
+
 /* public */
 
 struct llcm_exec_handle;
+struct llcm_scheduler;
 
+// initialize with llcm_routine_init before the first schedule, every private field other than
+// release_ is written by the scheduler, timer wheel or channel before it is read
 struct llcm_routine {
     void (*poll)(void *arg0, struct llcm_exec_handle *);
     void *arg0;
+
+    /* private */
+
+    // called once the poll that cancelled the routine has returned, e.g. by a routine pool
+    void (*release_)(struct llcm_routine *);
+
+    // priority lane of the scheduler the routine is queued on
+    size_t lane_;
+    // rdtsc when it was last queued, only set by a scheduler that records latency
+    uint64_t queued_tsc_;
+
+    // only meaningful while the routine waits in a llcm_timer_wheel
+    struct llcm_routine *timer_next_;
+    uint64_t timer_deadline_;
+    uint64_t timer_period_;
+
+    // only meaningful while the routine is parked in the wait list of a llcm_channel
+    struct llcm_routine *wait_next_;
+    struct llcm_scheduler *wait_scheduler_;
 };
+
+// clears the private fields, the routine may be initialized again once it is no longer scheduled
+void llcm_routine_init(struct llcm_routine *, void (*poll)(void *arg0, struct llcm_exec_handle *),
+                       void *arg0);
+
+/* private */
+
+void llcm_routine_release_(struct llcm_routine *);
+
+void llcm_routine_init(struct llcm_routine *routine,
+                       void (*poll)(void *arg0, struct llcm_exec_handle *), void *arg0) {
+    *routine = (struct llcm_routine){.poll = poll, .arg0 = arg0};
+}
+
+void llcm_routine_release_(struct llcm_routine *routine) {
+    if (NULL != routine && NULL != routine->release_) {
+        routine->release_(routine);
+    }
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/concurrent_queue.h"
+#include "lib/exec_handle.h"
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* public */
+
+struct llcm_routine_pool_slab_;
+struct llcm_routine_pool_object_;
+
+// routines with inline user state carved out of cache line aligned slabs. every thread that
+// allocates owns a llcm_routine_pool_cache with a private free list, routines freed by other
+// threads are pushed onto the owner's remote list and taken back all at once
+struct llcm_routine_pool {
+    size_t state_size;
+    size_t object_size;
+    size_t slab_num_routines;
+    struct llcm_allocator allocator;
+    // every slab ever allocated, only released by uninit
+    struct llcm_routine_pool_slab_ *slabs;
+    size_t num_slabs;
+};
+
+// must outlive every routine allocated through it, since remote frees are pushed onto it
+struct llcm_routine_pool_cache {
+    struct llcm_routine_pool *pool;
+    pthread_t thread;
+    struct llcm_routine_pool_object_ *free_list;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) struct llcm_routine_pool_object_ *remote_list;
+};
+
+void llcm_routine_pool_init(struct llcm_routine_pool *, size_t state_size,
+                            size_t slab_num_routines, struct llcm_allocator);
+// releases every slab, routines still in use become invalid
+void llcm_routine_pool_uninit(struct llcm_routine_pool *);
+size_t llcm_routine_pool_get_num_slabs(struct llcm_routine_pool const *);
+
+// binds the cache to the calling thread
+void llcm_routine_pool_cache_init(struct llcm_routine_pool_cache *, struct llcm_routine_pool *);
+
+// arg0 points to state_size bytes of inline state, which is not cleared, returns NULL if a
+// new slab can not be allocated
+struct llcm_routine *llcm_routine_pool_allocate(struct llcm_routine_pool_cache *,
+                                                void (*poll)(void *arg0,
+                                                             struct llcm_exec_handle *));
+// from any thread, the scheduler calls it for a pooled routine that cancels itself
+void llcm_routine_pool_free(struct llcm_routine *);
+
+/* private */
+
+struct llcm_routine_pool_object_ {
+    // first, so a routine pointer is also an object pointer
+    struct llcm_routine routine;
+    struct llcm_routine_pool_cache *owner;
+    struct llcm_routine_pool_object_ *next;
+    alignas(16) unsigned char state[];
+};
+
+// each slab starts with a line that links it into the pool's slab list
+struct llcm_routine_pool_slab_ {
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) struct llcm_routine_pool_slab_ *next;
+};
+
+bool llcm_routine_pool_cache_refill_(struct llcm_routine_pool_cache *);
+
+void llcm_routine_pool_init(struct llcm_routine_pool *pool, size_t state_size,
+                            size_t slab_num_routines, struct llcm_allocator allocator) {
+    memset(pool, 0, sizeof(*pool));
+    pool->state_size = state_size;
+    // whole lines per routine, so neighbouring routines polled on different threads never
+    // share a line
+    pool->object_size =
+        llcm_allocator_round_up_(sizeof(struct llcm_routine_pool_object_) + state_size,
+                                 LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE);
+    pool->slab_num_routines = 0 == slab_num_routines ? 1 : slab_num_routines;
+    pool->allocator = allocator;
+}
+
+void llcm_routine_pool_uninit(struct llcm_routine_pool *pool) {
+    size_t const slab_size =
+        sizeof(struct llcm_routine_pool_slab_) + pool->object_size * pool->slab_num_routines;
+    struct llcm_routine_pool_slab_ *slab = pool->slabs;
+    while (NULL != slab) {
+        struct llcm_routine_pool_slab_ *next = slab->next;
+        llcm_allocator_free(pool->allocator, slab, slab_size);
+        slab = next;
+    }
+}
+
+size_t llcm_routine_pool_get_num_slabs(struct llcm_routine_pool const *pool) {
+    return __atomic_load_n(&pool->num_slabs, __ATOMIC_RELAXED);
+}
+
+void llcm_routine_pool_cache_init(struct llcm_routine_pool_cache *cache,
+                                  struct llcm_routine_pool *pool) {
+    memset(cache, 0, sizeof(*cache));
+    cache->pool = pool;
+    cache->thread = pthread_self();
+}
+
+struct llcm_routine *llcm_routine_pool_allocate(struct llcm_routine_pool_cache *cache,
+                                                void (*poll)(void *arg0,
+                                                             struct llcm_exec_handle *)) {
+    if (NULL == cache->free_list) {
+        // take back every remote free with one exchange
+        cache->free_list = __atomic_exchange_n(&cache->remote_list, NULL, __ATOMIC_ACQUIRE);
+        if (NULL == cache->free_list && !llcm_routine_pool_cache_refill_(cache)) {
+            return NULL;
+        }
+    }
+    struct llcm_routine_pool_object_ *object = cache->free_list;
+    cache->free_list = object->next;
+    llcm_routine_init(&object->routine, poll, object->state);
+    object->routine.release_ = llcm_routine_pool_free;
+    return &object->routine;
+}
+
+void llcm_routine_pool_free(struct llcm_routine *routine) {
+    struct llcm_routine_pool_object_ *object = (struct llcm_routine_pool_object_ *) routine;
+    struct llcm_routine_pool_cache *owner = object->owner;
+    if (pthread_equal(owner->thread, pthread_self())) {
+        object->next = owner->free_list;
+        owner->free_list = object;
+        return;
+    }
+    // the owner only ever exchanges the whole list, so there is no ABA on push
+    object->next = __atomic_load_n(&owner->remote_list, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&owner->remote_list, &object->next, object, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+}
+
+bool llcm_routine_pool_cache_refill_(struct llcm_routine_pool_cache *cache) {
+    struct llcm_routine_pool *pool = cache->pool;
+    size_t const slab_size =
+        sizeof(struct llcm_routine_pool_slab_) + pool->object_size * pool->slab_num_routines;
+    struct llcm_routine_pool_slab_ *slab = llcm_allocator_allocate(
+        pool->allocator, LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE, slab_size);
+    if (NULL == slab) {
+        return false;
+    }
+    slab->next = __atomic_load_n(&pool->slabs, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&pool->slabs, &slab->next, slab, true, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED)) {
+    }
+    __atomic_fetch_add(&pool->num_slabs, 1, __ATOMIC_RELAXED);
+
+    // thread the slab in reverse so routines are handed out in address order
+    char *objects = (char *) (slab + 1);
+    for (size_t i = pool->slab_num_routines; i-- > 0;) {
+        struct llcm_routine_pool_object_ *object =
+            (struct llcm_routine_pool_object_ *) (objects + i * pool->object_size);
+        object->owner = cache;
+        object->next = cache->free_list;
+        cache->free_list = object;
+    }
+    return true;
+}
@@ -2,21 +2,131 @@
 
 #include "lib/concurrent_queue.h"
 #include "lib/exec_handle.h"
+#include "lib/histogram.h"
+#include "lib/reservation_cache.h"
 #include "lib/routine.h"
+#include "lib/segmented_queue.h"
+#include "lib/stats.h"
+#include "lib/timer_wheel.h"
+#include "lib/trace.h"
+#include "lib/utils.h"
+#include "lib/wait_strategy.h"
 
 /* public */
 
+struct llcm_balancer;
+
+#define LLCM_SCHEDULER_POLL_BATCH_MAX_SIZE    64
+#define LLCM_SCHEDULER_MAX_NUM_LANES          4
+#define LLCM_SCHEDULER_DEFAULT_RUN_NEXT_LIMIT 16
+
+struct llcm_scheduler_config {
+    size_t capacity;
+    // LLCM_CONCURRENT_QUEUE_* flags, e.g. SINGLE_CONSUMER for one polling thread, which is then
+    // never stolen from. SINGLE_PRODUCER is rejected, the poller requeues while other threads
+    // schedule and resume routines
+    unsigned queue_flags;
+    // priority lanes, lane 0 is always drained first
+    size_t num_lanes;
+    // every this many polls a lower lane goes first, 0 disables the guard
+    uint64_t starvation_guard_interval;
+    // routines a poller may take from its run next slot in a row before the rest of the chain is
+    // queued behind the others, 0 queues them right away. see llcm_exec_handle_try_schedule_next
+    uint64_t run_next_limit;
+    // lanes grow by segments of capacity routines instead of failing to schedule when full
+    bool unbounded;
+    // spreads capacity reservations over this many per thread token caches instead of one
+    // counter that every schedule call hits, see llcm_reservation_cache. 0 keeps the counter,
+    // unbounded lanes ignore it
+    size_t num_reservation_shards;
+    // timestamps every queued routine to record schedule to run latency and poll time, costs
+    // two rdtsc per poll
+    bool record_latency;
+};
+
 struct llcm_scheduler {
-    struct llcm_concurrent_queue queue;
+    // one queue per lane, each sized for the full capacity so a routine can move between
+    // lanes, all reservations are accounted on lane 0
+    union {
+        struct llcm_concurrent_queue queues[LLCM_SCHEDULER_MAX_NUM_LANES];
+        struct llcm_segmented_queue segmented_queues[LLCM_SCHEDULER_MAX_NUM_LANES];
+    };
+    bool unbounded;
+    unsigned queue_flags;
+    // only initialized with num_reservation_shards
+    struct llcm_reservation_cache reservation_cache;
+    size_t num_lanes;
+    uint64_t starvation_guard_interval;
+    uint64_t run_next_limit;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_polls;
+    // pollers parked by llcm_scheduler_poll_or_wait, read by every schedule call
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint32_t num_parked;
+    uint32_t wake_sequence;
+    struct llcm_timer_wheel timer_wheel;
+    // in tsc ticks, only allocated with record_latency
+    bool record_latency;
+    struct llcm_histogram schedule_latency;
+    struct llcm_histogram poll_time;
+    // set by llcm_balancer_init, which may move a routine elsewhere when it is requeued
+    struct llcm_balancer *balancer;
+    size_t balancer_index;
+    void (*rebalance)(struct llcm_balancer *, struct llcm_exec_handle *);
+    // tsc ticks spent in polls, only counted with a balancer
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t busy_tsc;
 };
 
+struct llcm_scheduler_config llcm_scheduler_config_create_default(size_t capacity);
+
 void llcm_scheduler_init(struct llcm_scheduler *, size_t capacity);
 void llcm_scheduler_init_with_custom_allocate(struct llcm_scheduler *, size_t capacity,
                                               struct llcm_allocator);
+void llcm_scheduler_init_with_flags(struct llcm_scheduler *, size_t capacity, unsigned queue_flags,
+                                    struct llcm_allocator);
+void llcm_scheduler_init_with_config(struct llcm_scheduler *, struct llcm_scheduler_config,
+                                     struct llcm_allocator);
 void llcm_scheduler_uninit(struct llcm_scheduler *);
 
+size_t llcm_scheduler_get_num_lanes(struct llcm_scheduler const *);
+// routines waiting in any lane, only a snapshot under concurrent use
+size_t llcm_scheduler_get_num_queued_routines(struct llcm_scheduler const *);
+// every routine holding a reservation, whether queued, sleeping, parked or being polled. with
+// reservation shards it hands their cached tokens back to the queue first, see
+// llcm_reservation_cache_get_num_reserved, which writes to every shard's cache line
+size_t llcm_scheduler_get_num_routines(struct llcm_scheduler *);
+
+// schedules on lane 0
 bool llcm_scheduler_try_schedule_routine(struct llcm_scheduler *, struct llcm_routine *);
+// lanes past the last one are clamped to the last one
+bool llcm_scheduler_try_schedule_routine_on_lane(struct llcm_scheduler *, struct llcm_routine *,
+                                                 size_t lane);
 bool llcm_scheduler_poll(struct llcm_scheduler *, void *user_exec_arg);
+// polls once, and after an empty poll backs off as the waiter's strategy says: spin, yield,
+// then park until a routine is scheduled, a timer is due or max_park_nanos passes
+bool llcm_scheduler_poll_or_wait(struct llcm_scheduler *, void *user_exec_arg,
+                                 struct llcm_waiter *);
+
+// schedules all routines or none of them
+bool llcm_scheduler_try_schedule_routines(struct llcm_scheduler *, struct llcm_routine *const *,
+                                          size_t num_routines);
+// polls up to max_routines routines, returns the number polled
+size_t llcm_scheduler_poll_batch(struct llcm_scheduler *, void *user_exec_arg,
+                                 size_t max_routines);
+// the routine holds its capacity reservation while it waits for the delay
+bool llcm_scheduler_try_schedule_after(struct llcm_scheduler *, struct llcm_routine *,
+                                       uint64_t nanos);
+// polled once per period at a fixed rate until cancelled, the first poll is after one period
+bool llcm_scheduler_try_schedule_periodic(struct llcm_scheduler *, struct llcm_routine *,
+                                          uint64_t period_nanos);
+
+// NULL unless the scheduler records latency. the time from queueing a routine to polling it and
+// the time spent inside its poll, in tsc ticks, see llcm_tsc_ticks_to_nanos
+struct llcm_histogram *llcm_scheduler_get_schedule_latency(struct llcm_scheduler *);
+struct llcm_histogram *llcm_scheduler_get_poll_time(struct llcm_scheduler *);
+
+// moves up to max_routines queued routines from victim onto thief, returns the number moved.
+// always 0 for a SINGLE_CONSUMER victim
+size_t llcm_scheduler_try_steal_routines(struct llcm_scheduler *thief,
+                                         struct llcm_scheduler *victim, size_t max_routines);
 
 /* private */
 
@@ -24,47 +134,642 @@ bool llcm_scheduler_poll(struct llcm_scheduler *, void *user_exec_arg);
 bool llcm_scheduler_try_reserve_new_routine_(struct llcm_scheduler *);
 void llcm_scheduler_old_routine_available_(struct llcm_scheduler *);
 
+// every lane access goes through these, so bounded lanes keep the plain ring fast path
+bool llcm_scheduler_try_reserve_(struct llcm_scheduler *, size_t num_routines);
+void llcm_scheduler_unreserve_(struct llcm_scheduler *, size_t num_routines);
+size_t llcm_scheduler_get_lane_size_(struct llcm_scheduler const *, size_t lane);
+void llcm_scheduler_lane_push_(struct llcm_scheduler *, size_t lane, struct llcm_routine *);
+void llcm_scheduler_lane_push_n_(struct llcm_scheduler *, size_t lane,
+                                 struct llcm_routine *const *, size_t num_routines);
+struct llcm_routine *llcm_scheduler_lane_try_pop_(struct llcm_scheduler *, size_t lane);
+size_t llcm_scheduler_lane_try_pop_n_(struct llcm_scheduler *, size_t lane,
+                                      struct llcm_routine **, size_t max_routines);
+
+size_t llcm_scheduler_get_lane_(struct llcm_scheduler const *, struct llcm_routine const *);
+size_t llcm_scheduler_get_first_lane_(struct llcm_scheduler *);
+void llcm_scheduler_push_(struct llcm_scheduler *, struct llcm_routine *);
+// returns the poll start to pass to llcm_scheduler_record_poll_time_
+uint64_t llcm_scheduler_record_schedule_latency_(struct llcm_scheduler *,
+                                                 struct llcm_routine const *);
+void llcm_scheduler_record_poll_time_(struct llcm_scheduler *, uint64_t poll_start_tsc);
+// lets the balancer move a routine that stays on the polling scheduler
+void llcm_scheduler_rebalance_(struct llcm_scheduler *, struct llcm_exec_handle *);
+void llcm_scheduler_expire_timers_(struct llcm_scheduler *);
+bool llcm_scheduler_try_requeue_on_timer_(struct llcm_exec_handle *);
+bool llcm_scheduler_try_park_(struct llcm_exec_handle *);
+// pushes a parked routine back, it still holds its reservation so this always succeeds,
+// called by waitables like llcm_future from any thread
+void llcm_scheduler_resume_routine_(struct llcm_scheduler *, struct llcm_routine *);
+void llcm_scheduler_requeue_(struct llcm_scheduler *polling_scheduler, struct llcm_exec_handle *);
+// polls the routine and cancels, parks or requeues it, returns the routine to run next if any
+struct llcm_routine *llcm_scheduler_poll_routine_(struct llcm_scheduler *, struct llcm_routine *,
+                                                  void *user_exec_arg);
+// polls a chain of routines handed over through the run next slot, after run_next_limit of them
+// the rest is queued so a chain can not starve the queued routines
+void llcm_scheduler_poll_run_next_(struct llcm_scheduler *, struct llcm_routine *,
+                                   void *user_exec_arg);
+// like llcm_scheduler_resume_routine_, but into the run next slot of the handle if it polls the
+// same scheduler, so the woken routine runs on the waking thread right away. handle may be NULL
+void llcm_scheduler_resume_routine_next_(struct llcm_exec_handle *, struct llcm_scheduler *,
+                                         struct llcm_routine *);
+// backs off after an empty poll as the waiter's strategy says
+void llcm_scheduler_wait_(struct llcm_scheduler *, struct llcm_waiter *);
+void llcm_scheduler_park_(struct llcm_scheduler *, uint64_t max_park_nanos);
+void llcm_scheduler_wake_(struct llcm_scheduler *);
+
+struct llcm_scheduler_config llcm_scheduler_config_create_default(size_t capacity) {
+    return (struct llcm_scheduler_config){
+        .capacity = capacity,
+        .queue_flags = 0,
+        .num_lanes = 1,
+        .starvation_guard_interval = 0,
+        .run_next_limit = LLCM_SCHEDULER_DEFAULT_RUN_NEXT_LIMIT,
+        .unbounded = false,
+        .num_reservation_shards = 0,
+        .record_latency = false};
+}
+
 void llcm_scheduler_init(struct llcm_scheduler *scheduler, size_t capacity) {
     llcm_scheduler_init_with_custom_allocate(scheduler, capacity, llcm_allocator_create_default());
 }
 
 void llcm_scheduler_init_with_custom_allocate(struct llcm_scheduler *scheduler, size_t capacity,
                                               struct llcm_allocator allocator) {
-    llcm_concurrent_queue_init_with_custom_allocate(&scheduler->queue, capacity, allocator);
+    llcm_scheduler_init_with_flags(scheduler, capacity, 0, allocator);
+}
+
+void llcm_scheduler_init_with_flags(struct llcm_scheduler *scheduler, size_t capacity,
+                                    unsigned queue_flags, struct llcm_allocator allocator) {
+    struct llcm_scheduler_config config = llcm_scheduler_config_create_default(capacity);
+    config.queue_flags = queue_flags;
+    llcm_scheduler_init_with_config(scheduler, config, allocator);
+}
+
+void llcm_scheduler_init_with_config(struct llcm_scheduler *scheduler,
+                                     struct llcm_scheduler_config config,
+                                     struct llcm_allocator allocator) {
+    memset(scheduler, 0, sizeof(*scheduler));
+    assert(0 == (config.queue_flags & LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER));
+    // sleeps and timers convert nanos to ticks while polling
+    llcm_tsc_calibrate();
+    assert(config.num_lanes >= 1 && config.num_lanes <= LLCM_SCHEDULER_MAX_NUM_LANES);
+    for (size_t lane = 0; lane < config.num_lanes; lane++) {
+        if (config.unbounded) {
+            llcm_segmented_queue_init_with_flags(&scheduler->segmented_queues[lane],
+                                                 config.capacity, config.queue_flags, allocator);
+        } else {
+            llcm_concurrent_queue_init_with_flags(&scheduler->queues[lane], config.capacity,
+                                                  config.queue_flags, allocator);
+        }
+    }
+    scheduler->unbounded = config.unbounded;
+    scheduler->queue_flags = config.queue_flags;
+    if (!config.unbounded && 0 != config.num_reservation_shards) {
+        llcm_reservation_cache_init(&scheduler->reservation_cache, &scheduler->queues[0],
+                                    config.num_reservation_shards, 0, allocator);
+    }
+    scheduler->num_lanes = config.num_lanes;
+    scheduler->starvation_guard_interval = config.starvation_guard_interval;
+    scheduler->run_next_limit = config.run_next_limit;
+    llcm_timer_wheel_init(&scheduler->timer_wheel);
+    scheduler->record_latency = config.record_latency;
+    if (config.record_latency) {
+        llcm_histogram_init(&scheduler->schedule_latency, allocator);
+        llcm_histogram_init(&scheduler->poll_time, allocator);
+    }
 }
 
 void llcm_scheduler_uninit(struct llcm_scheduler *scheduler) {
-    llcm_concurrent_queue_uninit(&scheduler->queue);
+    if (0 != scheduler->reservation_cache.num_shards) {
+        llcm_reservation_cache_uninit(&scheduler->reservation_cache);
+    }
+    for (size_t lane = 0; lane < scheduler->num_lanes; lane++) {
+        if (scheduler->unbounded) {
+            llcm_segmented_queue_uninit(&scheduler->segmented_queues[lane]);
+        } else {
+            llcm_concurrent_queue_uninit(&scheduler->queues[lane]);
+        }
+    }
+    if (scheduler->record_latency) {
+        llcm_histogram_uninit(&scheduler->schedule_latency);
+        llcm_histogram_uninit(&scheduler->poll_time);
+    }
+}
+
+size_t llcm_scheduler_get_num_lanes(struct llcm_scheduler const *scheduler) {
+    return scheduler->num_lanes;
+}
+
+size_t llcm_scheduler_get_num_routines(struct llcm_scheduler *scheduler) {
+    if (scheduler->unbounded) {
+        return __atomic_load_n(&scheduler->segmented_queues[0].reserved_push_size,
+                               __ATOMIC_ACQUIRE);
+    }
+    if (0 != scheduler->reservation_cache.num_shards) {
+        return llcm_reservation_cache_get_num_reserved(&scheduler->reservation_cache);
+    }
+    return __atomic_load_n(&scheduler->queues[0].counters.reserved_push_size, __ATOMIC_ACQUIRE);
+}
+
+size_t llcm_scheduler_get_num_queued_routines(struct llcm_scheduler const *scheduler) {
+    size_t num_routines = 0;
+    for (size_t lane = 0; lane < scheduler->num_lanes; lane++) {
+        num_routines += llcm_scheduler_get_lane_size_(scheduler, lane);
+    }
+    return num_routines;
 }
 
 bool llcm_scheduler_try_schedule_routine(struct llcm_scheduler *scheduler,
                                          struct llcm_routine *routine) {
+    return llcm_scheduler_try_schedule_routine_on_lane(scheduler, routine, 0);
+}
+
+bool llcm_scheduler_try_schedule_routine_on_lane(struct llcm_scheduler *scheduler,
+                                                 struct llcm_routine *routine, size_t lane) {
     if (!llcm_scheduler_try_reserve_new_routine_(scheduler)) {
         return false;
     }
-    llcm_concurrent_queue_push(&scheduler->queue, routine);
+    routine->timer_period_ = 0;
+    routine->lane_ = lane;
+    LLCM_TRACE_(LLCM_TRACE_ROUTINE_SCHEDULED, routine, scheduler);
+    llcm_scheduler_push_(scheduler, routine);
+    llcm_scheduler_wake_(scheduler);
     return true;
 }
 
 bool llcm_scheduler_poll(struct llcm_scheduler *scheduler, void *user_exec_arg) {
-    struct llcm_routine *routine = llcm_concurrent_queue_try_pop(&scheduler->queue);
+    llcm_scheduler_expire_timers_(scheduler);
+    struct llcm_routine *routine = NULL;
+    size_t const first_lane = llcm_scheduler_get_first_lane_(scheduler);
+    for (size_t i = 0; i < scheduler->num_lanes && NULL == routine; i++) {
+        size_t const lane = (first_lane + i) % scheduler->num_lanes;
+        routine = llcm_scheduler_lane_try_pop_(scheduler, lane);
+    }
     if (NULL == routine) {
+        LLCM_STATS_INC_(scheduler_empty_polls);
         return false;
     }
+    LLCM_STATS_INC_(scheduler_productive_polls);
+    llcm_scheduler_poll_run_next_(
+        scheduler, llcm_scheduler_poll_routine_(scheduler, routine, user_exec_arg), user_exec_arg);
+    return true;
+}
+
+bool llcm_scheduler_poll_or_wait(struct llcm_scheduler *scheduler, void *user_exec_arg,
+                                 struct llcm_waiter *waiter) {
+    if (llcm_scheduler_poll(scheduler, user_exec_arg)) {
+        llcm_waiter_on_productive_poll_(waiter);
+        return true;
+    }
+    llcm_scheduler_wait_(scheduler, waiter);
+    return false;
+}
 
-    struct llcm_exec_handle exec_handle = {
-        .routine = routine, .scheduler = scheduler, .user_exec_arg = user_exec_arg};
-    routine->poll(routine->arg0, &exec_handle);
-    if (NULL != exec_handle.scheduler) {
-        llcm_concurrent_queue_push(&exec_handle.scheduler->queue, exec_handle.routine);
+void llcm_scheduler_wait_(struct llcm_scheduler *scheduler, struct llcm_waiter *waiter) {
+    switch (llcm_waiter_on_empty_poll_(waiter)) {
+    case LLCM_WAITER_ACTION_SPIN_:
+        llcm_cpu_relax();
+        break;
+    case LLCM_WAITER_ACTION_YIELD_:
+        sched_yield();
+        break;
+    case LLCM_WAITER_ACTION_PARK_:
+        llcm_scheduler_park_(scheduler, waiter->strategy.max_park_nanos);
+        break;
+    }
+}
+
+bool llcm_scheduler_try_schedule_routines(struct llcm_scheduler *scheduler,
+                                          struct llcm_routine *const *routines,
+                                          size_t num_routines) {
+    if (!llcm_scheduler_try_reserve_(scheduler, num_routines)) {
+        return false;
+    }
+    for (size_t i = 0; i < num_routines; i++) {
+        routines[i]->timer_period_ = 0;
+        routines[i]->lane_ = 0;
+        LLCM_TRACE_(LLCM_TRACE_ROUTINE_SCHEDULED, routines[i], scheduler);
+    }
+    llcm_scheduler_lane_push_n_(scheduler, 0, routines, num_routines);
+    llcm_scheduler_wake_(scheduler);
+    return true;
+}
+
+size_t llcm_scheduler_poll_batch(struct llcm_scheduler *scheduler, void *user_exec_arg,
+                                 size_t max_routines) {
+    if (max_routines > LLCM_SCHEDULER_POLL_BATCH_MAX_SIZE) {
+        max_routines = LLCM_SCHEDULER_POLL_BATCH_MAX_SIZE;
+    }
+    llcm_scheduler_expire_timers_(scheduler);
+    struct llcm_routine *routines[LLCM_SCHEDULER_POLL_BATCH_MAX_SIZE];
+    size_t num_routines = 0;
+    size_t const first_lane = llcm_scheduler_get_first_lane_(scheduler);
+    for (size_t i = 0; i < scheduler->num_lanes && num_routines < max_routines; i++) {
+        size_t const lane = (first_lane + i) % scheduler->num_lanes;
+        num_routines += llcm_scheduler_lane_try_pop_n_(scheduler, lane, routines + num_routines,
+                                                       max_routines - num_routines);
+    }
+    if (0 == num_routines) {
+        LLCM_STATS_INC_(scheduler_empty_polls);
+    } else {
+        LLCM_STATS_INC_(scheduler_productive_polls);
+    }
+
+    // with a single lane, routines that stay on this scheduler are requeued together at the end
+    bool const batch_requeue = 1 == scheduler->num_lanes;
+    size_t num_requeued = 0;
+    for (size_t i = 0; i < num_routines; i++) {
+        struct llcm_exec_handle exec_handle = {.routine = routines[i],
+                                               .scheduler = scheduler,
+                                               .user_exec_arg = user_exec_arg,
+                                               .polling_scheduler_ = scheduler};
+        uint64_t const poll_start_tsc =
+            llcm_scheduler_record_schedule_latency_(scheduler, routines[i]);
+        LLCM_TRACE_(LLCM_TRACE_POLL_BEGIN, routines[i], scheduler);
+        routines[i]->poll(routines[i]->arg0, &exec_handle);
+        LLCM_TRACE_(LLCM_TRACE_POLL_END, routines[i], scheduler);
+        llcm_scheduler_record_poll_time_(scheduler, poll_start_tsc);
+        if (NULL == exec_handle.scheduler) {
+            LLCM_TRACE_(LLCM_TRACE_CANCELLED, exec_handle.routine, scheduler);
+            llcm_routine_release_(exec_handle.routine);
+        } else if (!llcm_scheduler_try_park_(&exec_handle)) {
+            llcm_scheduler_rebalance_(scheduler, &exec_handle);
+            bool const stays_in_batch = batch_requeue && scheduler == exec_handle.scheduler;
+            if (!stays_in_batch) {
+                llcm_scheduler_requeue_(scheduler, &exec_handle);
+            } else if (!llcm_scheduler_try_requeue_on_timer_(&exec_handle)) {
+                routines[num_requeued++] = exec_handle.routine;
+            }
+        }
+        // a chain handed over by this routine runs before the rest of the batch
+        llcm_scheduler_poll_run_next_(scheduler, exec_handle.run_next_, user_exec_arg);
+    }
+    llcm_scheduler_lane_push_n_(scheduler, 0, routines, num_requeued);
+    return num_routines;
+}
+
+bool llcm_scheduler_try_schedule_after(struct llcm_scheduler *scheduler,
+                                       struct llcm_routine *routine, uint64_t nanos) {
+    if (!llcm_scheduler_try_reserve_new_routine_(scheduler)) {
+        return false;
+    }
+    routine->timer_period_ = 0;
+    routine->lane_ = 0;
+    routine->timer_deadline_ = llcm_rdtsc() + llcm_nanos_to_tsc_ticks(nanos);
+    LLCM_TRACE_(LLCM_TRACE_ROUTINE_SCHEDULED, routine, scheduler);
+    llcm_timer_wheel_insert(&scheduler->timer_wheel, routine);
+    llcm_scheduler_wake_(scheduler);
+    return true;
+}
+
+bool llcm_scheduler_try_schedule_periodic(struct llcm_scheduler *scheduler,
+                                          struct llcm_routine *routine, uint64_t period_nanos) {
+    if (!llcm_scheduler_try_reserve_new_routine_(scheduler)) {
+        return false;
     }
+    uint64_t const period_tsc_ticks = llcm_nanos_to_tsc_ticks(period_nanos);
+    routine->timer_period_ = 0 == period_tsc_ticks ? 1 : period_tsc_ticks;
+    routine->lane_ = 0;
+    routine->timer_deadline_ = llcm_rdtsc() + routine->timer_period_;
+    LLCM_TRACE_(LLCM_TRACE_ROUTINE_SCHEDULED, routine, scheduler);
+    llcm_timer_wheel_insert(&scheduler->timer_wheel, routine);
+    llcm_scheduler_wake_(scheduler);
     return true;
 }
 
+struct llcm_histogram *llcm_scheduler_get_schedule_latency(struct llcm_scheduler *scheduler) {
+    return scheduler->record_latency ? &scheduler->schedule_latency : NULL;
+}
+
+struct llcm_histogram *llcm_scheduler_get_poll_time(struct llcm_scheduler *scheduler) {
+    return scheduler->record_latency ? &scheduler->poll_time : NULL;
+}
+
+size_t llcm_scheduler_try_steal_routines(struct llcm_scheduler *thief,
+                                         struct llcm_scheduler *victim, size_t max_routines) {
+    if (max_routines > LLCM_SCHEDULER_POLL_BATCH_MAX_SIZE) {
+        max_routines = LLCM_SCHEDULER_POLL_BATCH_MAX_SIZE;
+    }
+    if (thief == victim || 0 == max_routines ||
+        (victim->queue_flags & LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER)) {
+        return 0;
+    }
+    // reserve on the thief first so every stolen routine is guaranteed a slot
+    if (!llcm_scheduler_try_reserve_(thief, max_routines)) {
+        return 0;
+    }
+    // higher lanes are stolen first, each routine keeps its lane on the thief
+    struct llcm_routine *routines[LLCM_SCHEDULER_POLL_BATCH_MAX_SIZE];
+    size_t num_routines = 0;
+    for (size_t lane = 0; lane < victim->num_lanes && num_routines < max_routines; lane++) {
+        num_routines += llcm_scheduler_lane_try_pop_n_(victim, lane, routines + num_routines,
+                                                       max_routines - num_routines);
+    }
+    for (size_t i = 0; i < num_routines; i++) {
+        llcm_scheduler_push_(thief, routines[i]);
+    }
+    llcm_scheduler_unreserve_(victim, num_routines);
+    llcm_scheduler_unreserve_(thief, max_routines - num_routines);
+    return num_routines;
+}
+
 bool llcm_scheduler_try_reserve_new_routine_(struct llcm_scheduler *scheduler) {
-    return llcm_concurrent_queue_try_reserve_size_before_push(&scheduler->queue, 1);
+    return llcm_scheduler_try_reserve_(scheduler, 1);
 }
 
 void llcm_scheduler_old_routine_available_(struct llcm_scheduler *scheduler) {
-    llcm_concurrent_queue_unreserve_size_after_pop(&scheduler->queue, 1);
+    llcm_scheduler_unreserve_(scheduler, 1);
+}
+
+bool llcm_scheduler_try_reserve_(struct llcm_scheduler *scheduler, size_t num_routines) {
+    if (scheduler->unbounded) {
+        return llcm_segmented_queue_try_reserve_size_before_push(&scheduler->segmented_queues[0],
+                                                                 num_routines);
+    }
+    bool const reserved =
+        0 != scheduler->reservation_cache.num_shards
+            ? llcm_reservation_cache_try_reserve(&scheduler->reservation_cache, num_routines)
+            : llcm_concurrent_queue_try_reserve_size_before_push(&scheduler->queues[0],
+                                                                 num_routines);
+    if (!reserved) {
+        LLCM_TRACE_(LLCM_TRACE_QUEUE_FULL, NULL, scheduler);
+        return false;
+    }
+    return true;
+}
+
+void llcm_scheduler_unreserve_(struct llcm_scheduler *scheduler, size_t num_routines) {
+    if (scheduler->unbounded) {
+        llcm_segmented_queue_unreserve_size_after_pop(&scheduler->segmented_queues[0],
+                                                      num_routines);
+        return;
+    }
+    if (0 != scheduler->reservation_cache.num_shards) {
+        llcm_reservation_cache_unreserve(&scheduler->reservation_cache, num_routines);
+        return;
+    }
+    llcm_concurrent_queue_unreserve_size_after_pop(&scheduler->queues[0], num_routines);
+}
+
+size_t llcm_scheduler_get_lane_size_(struct llcm_scheduler const *scheduler, size_t lane) {
+    if (scheduler->unbounded) {
+        return llcm_segmented_queue_get_size(&scheduler->segmented_queues[lane]);
+    }
+    return llcm_concurrent_queue_get_size(&scheduler->queues[lane]);
+}
+
+void llcm_scheduler_lane_push_(struct llcm_scheduler *scheduler, size_t lane,
+                               struct llcm_routine *routine) {
+    if (scheduler->record_latency) {
+        routine->queued_tsc_ = llcm_rdtsc();
+    }
+    if (scheduler->unbounded) {
+        llcm_segmented_queue_push(&scheduler->segmented_queues[lane], routine);
+        return;
+    }
+    llcm_concurrent_queue_push(&scheduler->queues[lane], routine);
+}
+
+void llcm_scheduler_lane_push_n_(struct llcm_scheduler *scheduler, size_t lane,
+                                 struct llcm_routine *const *routines, size_t num_routines) {
+    if (scheduler->record_latency) {
+        uint64_t const now_tsc = llcm_rdtsc();
+        for (size_t i = 0; i < num_routines; i++) {
+            routines[i]->queued_tsc_ = now_tsc;
+        }
+    }
+    if (scheduler->unbounded) {
+        llcm_segmented_queue_push_n(&scheduler->segmented_queues[lane], (void *const *) routines,
+                                    num_routines);
+        return;
+    }
+    llcm_concurrent_queue_push_n(&scheduler->queues[lane], (void *const *) routines,
+                                 num_routines);
+}
+
+struct llcm_routine *llcm_scheduler_lane_try_pop_(struct llcm_scheduler *scheduler, size_t lane) {
+    if (scheduler->unbounded) {
+        return llcm_segmented_queue_try_pop(&scheduler->segmented_queues[lane]);
+    }
+    return llcm_concurrent_queue_try_pop(&scheduler->queues[lane]);
+}
+
+size_t llcm_scheduler_lane_try_pop_n_(struct llcm_scheduler *scheduler, size_t lane,
+                                      struct llcm_routine **routines, size_t max_routines) {
+    if (scheduler->unbounded) {
+        return llcm_segmented_queue_try_pop_n(&scheduler->segmented_queues[lane],
+                                              (void **) routines, max_routines);
+    }
+    return llcm_concurrent_queue_try_pop_n(&scheduler->queues[lane], (void **) routines,
+                                           max_routines);
+}
+
+size_t llcm_scheduler_get_lane_(struct llcm_scheduler const *scheduler,
+                                struct llcm_routine const *routine) {
+    return routine->lane_ < scheduler->num_lanes ? routine->lane_ : scheduler->num_lanes - 1;
+}
+
+size_t llcm_scheduler_get_first_lane_(struct llcm_scheduler *scheduler) {
+    if (0 == scheduler->starvation_guard_interval) {
+        return 0;
+    }
+    // a lossy counter is good enough to give lower lanes a periodic turn
+    uint64_t const num_polls = __atomic_load_n(&scheduler->num_polls, __ATOMIC_RELAXED) + 1;
+    __atomic_store_n(&scheduler->num_polls, num_polls, __ATOMIC_RELAXED);
+    if (0 != num_polls % scheduler->starvation_guard_interval) {
+        return 0;
+    }
+    return (num_polls / scheduler->starvation_guard_interval) % scheduler->num_lanes;
+}
+
+void llcm_scheduler_push_(struct llcm_scheduler *scheduler, struct llcm_routine *routine) {
+    llcm_scheduler_lane_push_(scheduler, llcm_scheduler_get_lane_(scheduler, routine), routine);
+}
+
+uint64_t llcm_scheduler_record_schedule_latency_(struct llcm_scheduler *scheduler,
+                                                 struct llcm_routine const *routine) {
+    if (!scheduler->record_latency && NULL == scheduler->balancer) {
+        return 0;
+    }
+    uint64_t const now_tsc = llcm_rdtsc();
+    if (scheduler->record_latency) {
+        llcm_histogram_record(&scheduler->schedule_latency,
+                              now_tsc > routine->queued_tsc_ ? now_tsc - routine->queued_tsc_ : 0);
+    }
+    return now_tsc;
+}
+
+void llcm_scheduler_record_poll_time_(struct llcm_scheduler *scheduler, uint64_t poll_start_tsc) {
+    if (!scheduler->record_latency && NULL == scheduler->balancer) {
+        return;
+    }
+    uint64_t const now_tsc = llcm_rdtsc();
+    uint64_t const poll_tsc = now_tsc > poll_start_tsc ? now_tsc - poll_start_tsc : 0;
+    if (scheduler->record_latency) {
+        llcm_histogram_record(&scheduler->poll_time, poll_tsc);
+    }
+    if (NULL != scheduler->balancer) {
+        __atomic_fetch_add(&scheduler->busy_tsc, poll_tsc, __ATOMIC_RELAXED);
+    }
+}
+
+void llcm_scheduler_rebalance_(struct llcm_scheduler *scheduler,
+                               struct llcm_exec_handle *handle) {
+    // a routine that already switched scheduler chose its destination itself
+    if (NULL != scheduler->balancer && scheduler == handle->scheduler) {
+        scheduler->rebalance(scheduler->balancer, handle);
+    }
+}
+
+void llcm_scheduler_expire_timers_(struct llcm_scheduler *scheduler) {
+    struct llcm_timer_wheel *timer_wheel = &scheduler->timer_wheel;
+    if (llcm_timer_wheel_is_empty(timer_wheel)) {
+        return;
+    }
+    uint64_t const now_tsc = llcm_rdtsc();
+    if (!llcm_timer_wheel_is_due(timer_wheel, now_tsc)) {
+        return;
+    }
+    // expired routines kept their reservation, so they always fit in their lane
+    struct llcm_routine *routine = llcm_timer_wheel_try_expire(timer_wheel, now_tsc);
+    while (NULL != routine) {
+        struct llcm_routine *next = routine->timer_next_;
+        llcm_scheduler_push_(scheduler, routine);
+        routine = next;
+    }
+}
+
+bool llcm_scheduler_try_requeue_on_timer_(struct llcm_exec_handle *handle) {
+    struct llcm_routine *routine = handle->routine;
+    if (0 != handle->sleep_tsc_ticks_) {
+        routine->timer_deadline_ = llcm_rdtsc() + handle->sleep_tsc_ticks_;
+    } else if (0 != routine->timer_period_) {
+        routine->timer_deadline_ += routine->timer_period_;
+    } else {
+        return false;
+    }
+    llcm_timer_wheel_insert(&handle->scheduler->timer_wheel, routine);
+    return true;
+}
+
+bool llcm_scheduler_try_park_(struct llcm_exec_handle *handle) {
+    if (NULL == handle->try_park_) {
+        return false;
+    }
+    return handle->try_park_(handle->park_waitable_, handle->routine, handle->scheduler);
+}
+
+void llcm_scheduler_resume_routine_(struct llcm_scheduler *scheduler,
+                                    struct llcm_routine *routine) {
+    llcm_scheduler_push_(scheduler, routine);
+    llcm_scheduler_wake_(scheduler);
+}
+
+void llcm_scheduler_requeue_(struct llcm_scheduler *polling_scheduler,
+                             struct llcm_exec_handle *handle) {
+    if (!llcm_scheduler_try_requeue_on_timer_(handle)) {
+        llcm_scheduler_push_(handle->scheduler, handle->routine);
+    }
+    // the polling scheduler is obviously awake
+    if (polling_scheduler != handle->scheduler) {
+        llcm_scheduler_wake_(handle->scheduler);
+    }
+}
+
+struct llcm_routine *llcm_scheduler_poll_routine_(struct llcm_scheduler *scheduler,
+                                                  struct llcm_routine *routine,
+                                                  void *user_exec_arg) {
+    struct llcm_exec_handle exec_handle = {.routine = routine,
+                                           .scheduler = scheduler,
+                                           .user_exec_arg = user_exec_arg,
+                                           .polling_scheduler_ = scheduler};
+    uint64_t const poll_start_tsc = llcm_scheduler_record_schedule_latency_(scheduler, routine);
+    LLCM_TRACE_(LLCM_TRACE_POLL_BEGIN, routine, scheduler);
+    routine->poll(routine->arg0, &exec_handle);
+    LLCM_TRACE_(LLCM_TRACE_POLL_END, routine, scheduler);
+    llcm_scheduler_record_poll_time_(scheduler, poll_start_tsc);
+    if (NULL == exec_handle.scheduler) {
+        LLCM_TRACE_(LLCM_TRACE_CANCELLED, exec_handle.routine, scheduler);
+        llcm_routine_release_(exec_handle.routine);
+    } else if (!llcm_scheduler_try_park_(&exec_handle)) {
+        llcm_scheduler_rebalance_(scheduler, &exec_handle);
+        llcm_scheduler_requeue_(scheduler, &exec_handle);
+    }
+    return exec_handle.run_next_;
+}
+
+void llcm_scheduler_poll_run_next_(struct llcm_scheduler *scheduler, struct llcm_routine *routine,
+                                   void *user_exec_arg) {
+    // the routine that handed over was requeued first, so it waits behind the queued ones too
+    for (uint64_t i = 0; NULL != routine; i++) {
+        if (i == scheduler->run_next_limit) {
+            llcm_scheduler_push_(scheduler, routine);
+            return;
+        }
+        LLCM_STATS_INC_(scheduler_run_next_polls);
+        routine = llcm_scheduler_poll_routine_(scheduler, routine, user_exec_arg);
+    }
+}
+
+void llcm_scheduler_set_run_next_(struct llcm_exec_handle *handle, struct llcm_routine *routine) {
+    struct llcm_scheduler *scheduler = handle->polling_scheduler_;
+    if (0 == scheduler->run_next_limit) {
+        llcm_scheduler_resume_routine_(scheduler, routine);
+        return;
+    }
+    if (scheduler->record_latency) {
+        routine->queued_tsc_ = llcm_rdtsc();
+    }
+    // the displaced routine keeps its reservation, like a resumed one. the polling thread is
+    // awake, but another poller may take it sooner
+    if (NULL != handle->run_next_) {
+        llcm_scheduler_resume_routine_(scheduler, handle->run_next_);
+    }
+    handle->run_next_ = routine;
+}
+
+void llcm_scheduler_resume_routine_next_(struct llcm_exec_handle *handle,
+                                         struct llcm_scheduler *scheduler,
+                                         struct llcm_routine *routine) {
+    if (NULL == handle || scheduler != handle->polling_scheduler_) {
+        llcm_scheduler_resume_routine_(scheduler, routine);
+        return;
+    }
+    llcm_scheduler_set_run_next_(handle, routine);
+}
+
+void llcm_scheduler_park_(struct llcm_scheduler *scheduler, uint64_t max_park_nanos) {
+    uint32_t const wake_sequence = __atomic_load_n(&scheduler->wake_sequence, __ATOMIC_ACQUIRE);
+    __atomic_fetch_add(&scheduler->num_parked, 1, __ATOMIC_SEQ_CST);
+
+    // never sleep past the next timer
+    uint64_t park_nanos = max_park_nanos;
+    struct llcm_timer_wheel const *timer_wheel = &scheduler->timer_wheel;
+    if (!llcm_timer_wheel_is_empty(timer_wheel)) {
+        uint64_t const now_tsc = llcm_rdtsc();
+        uint64_t const due_tsc =
+            (__atomic_load_n(&timer_wheel->next_due_tick, __ATOMIC_RELAXED) + 1)
+            << LLCM_TIMER_WHEEL_TICK_SHIFT;
+        if (llcm_timer_wheel_is_due(timer_wheel, now_tsc)) {
+            park_nanos = 0;
+        } else if (due_tsc > now_tsc && llcm_tsc_ticks_to_nanos(due_tsc - now_tsc) < park_nanos) {
+            park_nanos = llcm_tsc_ticks_to_nanos(due_tsc - now_tsc);
+        }
+    }
+    // re-check after announcing the park, a schedule call either sees num_parked or its
+    // routine is visible here. pairs with the push in llcm_scheduler_wake_
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (0 != park_nanos && 0 == llcm_scheduler_get_num_queued_routines(scheduler)) {
+        llcm_futex_wait_(&scheduler->wake_sequence, wake_sequence, park_nanos);
+    }
+    __atomic_fetch_sub(&scheduler->num_parked, 1, __ATOMIC_SEQ_CST);
+}
+
+void llcm_scheduler_wake_(struct llcm_scheduler *scheduler) {
+    // the only cost on the schedule path when nobody is parked
+    if (0 == __atomic_load_n(&scheduler->num_parked, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+    __atomic_fetch_add(&scheduler->wake_sequence, 1, __ATOMIC_RELEASE);
+    llcm_futex_wake_one_(&scheduler->wake_sequence);
 }
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "lib/scheduler.h"
+
+/* public */
+
+#define LLCM_SCHEDULER_GROUP_STEAL_BATCH_MAX_SIZE 32
+
+// one scheduler per worker, a worker whose scheduler is empty steals from its siblings
+struct llcm_scheduler_group {
+    struct llcm_scheduler *schedulers;
+    size_t num_workers;
+    struct llcm_allocator allocator;
+};
+
+void llcm_scheduler_group_init(struct llcm_scheduler_group *, size_t num_workers,
+                               size_t capacity_per_worker);
+void llcm_scheduler_group_init_with_custom_allocate(struct llcm_scheduler_group *,
+                                                    size_t num_workers,
+                                                    size_t capacity_per_worker,
+                                                    struct llcm_allocator);
+void llcm_scheduler_group_uninit(struct llcm_scheduler_group *);
+
+struct llcm_scheduler *llcm_scheduler_group_get_scheduler(struct llcm_scheduler_group *,
+                                                          size_t worker_id);
+// polls the worker's own scheduler, stealing a batch from a sibling if it is empty
+bool llcm_scheduler_group_poll(struct llcm_scheduler_group *, size_t worker_id,
+                               void *user_exec_arg);
+
+/* private */
+
+size_t llcm_scheduler_group_try_steal_(struct llcm_scheduler_group *, size_t worker_id);
+
+void llcm_scheduler_group_init(struct llcm_scheduler_group *group, size_t num_workers,
+                               size_t capacity_per_worker) {
+    llcm_scheduler_group_init_with_custom_allocate(group, num_workers, capacity_per_worker,
+                                                   llcm_allocator_create_default());
+}
+
+void llcm_scheduler_group_init_with_custom_allocate(struct llcm_scheduler_group *group,
+                                                    size_t num_workers,
+                                                    size_t capacity_per_worker,
+                                                    struct llcm_allocator allocator) {
+    group->schedulers = (struct llcm_scheduler *) llcm_allocator_allocate(
+        allocator, alignof(struct llcm_scheduler), sizeof(struct llcm_scheduler) * num_workers);
+    for (size_t worker_id = 0; worker_id < num_workers; worker_id++) {
+        llcm_scheduler_init_with_custom_allocate(&group->schedulers[worker_id],
+                                                 capacity_per_worker, allocator);
+    }
+    group->num_workers = num_workers;
+    group->allocator = allocator;
+}
+
+void llcm_scheduler_group_uninit(struct llcm_scheduler_group *group) {
+    for (size_t worker_id = 0; worker_id < group->num_workers; worker_id++) {
+        llcm_scheduler_uninit(&group->schedulers[worker_id]);
+    }
+    llcm_allocator_free(group->allocator, group->schedulers,
+                        sizeof(struct llcm_scheduler) * group->num_workers);
+}
+
+struct llcm_scheduler *llcm_scheduler_group_get_scheduler(struct llcm_scheduler_group *group,
+                                                          size_t worker_id) {
+    return &group->schedulers[worker_id];
+}
+
+bool llcm_scheduler_group_poll(struct llcm_scheduler_group *group, size_t worker_id,
+                               void *user_exec_arg) {
+    struct llcm_scheduler *scheduler = &group->schedulers[worker_id];
+    if (llcm_scheduler_poll(scheduler, user_exec_arg)) {
+        return true;
+    }
+    if (0 == llcm_scheduler_group_try_steal_(group, worker_id)) {
+        return false;
+    }
+    return llcm_scheduler_poll(scheduler, user_exec_arg);
+}
+
+size_t llcm_scheduler_group_try_steal_(struct llcm_scheduler_group *group, size_t worker_id) {
+    struct llcm_scheduler *thief = &group->schedulers[worker_id];
+    // start at the next sibling so idle workers spread out over different victims
+    for (size_t i = 1; i < group->num_workers; i++) {
+        struct llcm_scheduler *victim = &group->schedulers[(worker_id + i) % group->num_workers];
+        // take half of the victim's queue so the two schedulers end up balanced
+        size_t num_routines = (llcm_scheduler_get_num_queued_routines(victim) + 1) / 2;
+        if (0 == num_routines) {
+            continue;
+        }
+        if (num_routines > LLCM_SCHEDULER_GROUP_STEAL_BATCH_MAX_SIZE) {
+            num_routines = LLCM_SCHEDULER_GROUP_STEAL_BATCH_MAX_SIZE;
+        }
+        size_t const num_stolen = llcm_scheduler_try_steal_routines(thief, victim, num_routines);
+        if (0 != num_stolen) {
+            return num_stolen;
+        }
+    }
+    return 0;
+}
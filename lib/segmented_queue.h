@@ -0,0 +1,433 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/concurrent_queue.h"
+#include "lib/utils.h"
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* public */
+
+// an unbounded queue made of a linked list of llcm_concurrent_queue rings, pushes go to the
+// tail segment and pops come from the head segment, so while the tail has room a push is
+// exactly a ring push. a full tail is closed and a new segment is appended after it with a CAS,
+// a closed segment is recycled once consumers have drained it and left it.
+//
+// a pop from a non empty head is a ring pop plus two loads, re-reading head after the ring's
+// write counter. only appending a segment and moving head past a drained one count the thread
+// in the segment with two seq_cst read-modify-writes, once per segment rather than per entry
+struct llcm_segmented_queue_segment;
+
+struct llcm_segmented_queue {
+    size_t segment_capacity;
+    unsigned flags;
+    struct llcm_allocator allocator;
+
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) struct llcm_segmented_queue_segment *head;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) struct llcm_segmented_queue_segment *tail;
+    // recycled segments, pushed one at a time and taken as a whole
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) struct llcm_segmented_queue_segment *pool;
+    size_t num_segments;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t reserved_push_size;
+};
+
+void llcm_segmented_queue_init(struct llcm_segmented_queue *, size_t segment_capacity);
+// LLCM_CONCURRENT_QUEUE_* flags apply to every segment
+void llcm_segmented_queue_init_with_flags(struct llcm_segmented_queue *, size_t segment_capacity,
+                                          unsigned flags, struct llcm_allocator);
+void llcm_segmented_queue_uninit(struct llcm_segmented_queue *);
+
+size_t llcm_segmented_queue_get_segment_capacity(struct llcm_segmented_queue const *);
+// segments allocated so far, drained segments are recycled so this is the high water mark
+size_t llcm_segmented_queue_get_num_segments(struct llcm_segmented_queue const *);
+// number of pushed entries not yet popped, only a snapshot under concurrent use
+size_t llcm_segmented_queue_get_size(struct llcm_segmented_queue const *);
+
+// always succeeds, only counts so the queue can stand in for llcm_concurrent_queue
+bool llcm_segmented_queue_try_reserve_size_before_push(struct llcm_segmented_queue *,
+                                                       size_t num_new_entries);
+void llcm_segmented_queue_unreserve_size_after_pop(struct llcm_segmented_queue *,
+                                                   size_t num_old_entries);
+
+// does not block and always succeeds, no reservation needed
+void llcm_segmented_queue_push(struct llcm_segmented_queue *, void *value);
+// returns NULL on failure
+void *llcm_segmented_queue_try_pop(struct llcm_segmented_queue *);
+
+void llcm_segmented_queue_push_n(struct llcm_segmented_queue *, void *const *values,
+                                 size_t num_values);
+// pops up to max_values entries from the head segment, returns the number popped
+size_t llcm_segmented_queue_try_pop_n(struct llcm_segmented_queue *, void **values,
+                                      size_t max_values);
+
+/* private */
+
+// set in a segment's ring reservation so no push can reserve in it again, every pushed
+// entry has been popped when only this bit is left
+#define LLCM_SEGMENTED_QUEUE_CLOSED_  (1ULL << 63)
+// set in num_users once head moved past the segment, the last user to leave recycles it
+#define LLCM_SEGMENTED_QUEUE_RETIRED_ (1ULL << 63)
+
+// segments are recycled instead of freed until uninit, so a thread still holding a stale
+// head or tail pointer only ever touches a valid ring. appenders and consumers advancing head
+// count themselves in num_users and then check the segment is still head or tail, so a segment
+// they work on is never recycled under them. pushes are covered by their ring reservation
+// instead, which keeps the segment from being drained. a pop loads the ring's write counter and
+// then checks the segment is still head, and claims only entries below that counter. until
+// those are unreserved the segment can not be drained, so the claim either lands in the head or
+// finds every entry below the counter taken, as the counters keep counting across a recycle
+struct llcm_segmented_queue_segment {
+    struct llcm_concurrent_queue ring;
+    struct llcm_segmented_queue_segment *next;
+    // links the pool, apart from next so a walk from a stale segment never leaves the queue
+    struct llcm_segmented_queue_segment *next_free;
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t num_users;
+};
+
+// returns an open segment that is not linked yet
+struct llcm_segmented_queue_segment *llcm_segmented_queue_acquire_segment_(
+    struct llcm_segmented_queue *);
+// closes the segment and pushes it to the pool, no thread may use it anymore
+void llcm_segmented_queue_release_segment_(struct llcm_segmented_queue *,
+                                           struct llcm_segmented_queue_segment *);
+void llcm_segmented_queue_push_free_(struct llcm_segmented_queue *,
+                                     struct llcm_segmented_queue_segment *first,
+                                     struct llcm_segmented_queue_segment *last);
+// returns false if the segment is no longer in slot, then it was not entered
+bool llcm_segmented_queue_try_enter_(struct llcm_segmented_queue *,
+                                     struct llcm_segmented_queue_segment *const *slot,
+                                     struct llcm_segmented_queue_segment *);
+void llcm_segmented_queue_leave_(struct llcm_segmented_queue *,
+                                 struct llcm_segmented_queue_segment *);
+void llcm_segmented_queue_retire_(struct llcm_segmented_queue *,
+                                  struct llcm_segmented_queue_segment *);
+void llcm_segmented_queue_try_recycle_(struct llcm_segmented_queue *,
+                                       struct llcm_segmented_queue_segment *);
+// returns SIZE_MAX if head moved on before anything was claimed
+size_t llcm_segmented_queue_try_pop_head_(struct llcm_segmented_queue *,
+                                          struct llcm_segmented_queue_segment *head,
+                                          void **values, size_t max_values);
+// returns false if num_new_entries were reserved in a segment that is not the tail anymore, or
+// not yet again, then the reservation was given back
+bool llcm_segmented_queue_check_reserved_tail_(struct llcm_segmented_queue *,
+                                               struct llcm_segmented_queue_segment *,
+                                               size_t num_new_entries);
+void llcm_segmented_queue_append_(struct llcm_segmented_queue *,
+                                  struct llcm_segmented_queue_segment *full_tail);
+// returns true if head moved past the drained segment and the pop should be retried
+bool llcm_segmented_queue_try_advance_head_(struct llcm_segmented_queue *,
+                                            struct llcm_segmented_queue_segment *head);
+
+void llcm_segmented_queue_init(struct llcm_segmented_queue *queue, size_t segment_capacity) {
+    llcm_segmented_queue_init_with_flags(queue, segment_capacity, 0,
+                                         llcm_allocator_create_default());
+}
+
+void llcm_segmented_queue_init_with_flags(struct llcm_segmented_queue *queue,
+                                          size_t segment_capacity, unsigned flags,
+                                          struct llcm_allocator allocator) {
+    memset(queue, 0, sizeof(*queue));
+    queue->segment_capacity = segment_capacity;
+    queue->flags = flags;
+    queue->allocator = allocator;
+    struct llcm_segmented_queue_segment *segment = llcm_segmented_queue_acquire_segment_(queue);
+    queue->segment_capacity = llcm_concurrent_queue_get_capacity(&segment->ring);
+    queue->head = segment;
+    queue->tail = segment;
+}
+
+void llcm_segmented_queue_uninit(struct llcm_segmented_queue *queue) {
+    // with no thread left inside, every segment is either linked from head or in the pool
+    for (struct llcm_segmented_queue_segment *segment = queue->head; NULL != segment;) {
+        struct llcm_segmented_queue_segment *next = segment->next;
+        llcm_concurrent_queue_uninit(&segment->ring);
+        llcm_allocator_free(queue->allocator, segment, sizeof(*segment));
+        segment = next;
+    }
+    for (struct llcm_segmented_queue_segment *segment = queue->pool; NULL != segment;) {
+        struct llcm_segmented_queue_segment *next = segment->next_free;
+        llcm_concurrent_queue_uninit(&segment->ring);
+        llcm_allocator_free(queue->allocator, segment, sizeof(*segment));
+        segment = next;
+    }
+}
+
+size_t llcm_segmented_queue_get_segment_capacity(struct llcm_segmented_queue const *queue) {
+    return queue->segment_capacity;
+}
+
+size_t llcm_segmented_queue_get_num_segments(struct llcm_segmented_queue const *queue) {
+    return __atomic_load_n(&queue->num_segments, __ATOMIC_RELAXED);
+}
+
+size_t llcm_segmented_queue_get_size(struct llcm_segmented_queue const *queue) {
+    // takes no lock and enters no segment. a walk racing a recycle still reads valid rings and
+    // at worst miscounts, stopping after as many segments as exist so it can not run in circles
+    size_t const num_segments = __atomic_load_n(&queue->num_segments, __ATOMIC_ACQUIRE);
+    size_t size = 0;
+    struct llcm_segmented_queue_segment *segment = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    for (size_t i = 0; i < num_segments && NULL != segment; i++) {
+        size += llcm_concurrent_queue_get_size(&segment->ring);
+        segment = __atomic_load_n(&segment->next, __ATOMIC_ACQUIRE);
+    }
+    return size;
+}
+
+bool llcm_segmented_queue_try_reserve_size_before_push(struct llcm_segmented_queue *queue,
+                                                       size_t num_new_entries) {
+    __atomic_fetch_add(&queue->reserved_push_size, num_new_entries, __ATOMIC_RELAXED);
+    return true;
+}
+
+void llcm_segmented_queue_unreserve_size_after_pop(struct llcm_segmented_queue *queue,
+                                                   size_t num_old_entries) {
+    __atomic_fetch_sub(&queue->reserved_push_size, num_old_entries, __ATOMIC_RELAXED);
+}
+
+void llcm_segmented_queue_push(struct llcm_segmented_queue *queue, void *value) {
+    for (;;) {
+        struct llcm_segmented_queue_segment *tail =
+            __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+        if (!llcm_concurrent_queue_try_reserve_size_before_push(&tail->ring, 1)) {
+            llcm_segmented_queue_append_(queue, tail);
+        } else if (llcm_segmented_queue_check_reserved_tail_(queue, tail, 1)) {
+            llcm_concurrent_queue_push(&tail->ring, value);
+            return;
+        }
+    }
+}
+
+void *llcm_segmented_queue_try_pop(struct llcm_segmented_queue *queue) {
+    void *value = NULL;
+    llcm_segmented_queue_try_pop_n(queue, &value, 1);
+    return value;
+}
+
+void llcm_segmented_queue_push_n(struct llcm_segmented_queue *queue, void *const *values,
+                                 size_t num_values) {
+    if (0 == num_values) {
+        return;
+    }
+    struct llcm_segmented_queue_segment *tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if (llcm_concurrent_queue_try_reserve_size_before_push(&tail->ring, num_values) &&
+        llcm_segmented_queue_check_reserved_tail_(queue, tail, num_values)) {
+        llcm_concurrent_queue_push_n(&tail->ring, values, num_values);
+        return;
+    }
+    // the batch straddles segments
+    for (size_t i = 0; i < num_values; i++) {
+        llcm_segmented_queue_push(queue, values[i]);
+    }
+}
+
+size_t llcm_segmented_queue_try_pop_n(struct llcm_segmented_queue *queue, void **values,
+                                      size_t max_values) {
+    if (0 == max_values) {
+        return 0;
+    }
+    for (;;) {
+        struct llcm_segmented_queue_segment *head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+        size_t const num_values =
+            llcm_segmented_queue_try_pop_head_(queue, head, values, max_values);
+        if (SIZE_MAX == num_values) {
+            continue;
+        }
+        if (0 != num_values) {
+            llcm_concurrent_queue_unreserve_size_after_pop(&head->ring, num_values);
+            return num_values;
+        }
+        if (!llcm_segmented_queue_try_advance_head_(queue, head)) {
+            return 0;
+        }
+    }
+}
+
+struct llcm_segmented_queue_segment *llcm_segmented_queue_acquire_segment_(
+    struct llcm_segmented_queue *queue) {
+    // taking the whole pool rules out the aba of popping a single segment, the rest goes back
+    struct llcm_segmented_queue_segment *segment =
+        __atomic_exchange_n(&queue->pool, NULL, __ATOMIC_ACQUIRE);
+    if (NULL != segment) {
+        struct llcm_segmented_queue_segment *rest = segment->next_free;
+        if (NULL != rest) {
+            struct llcm_segmented_queue_segment *last = rest;
+            while (NULL != last->next_free) {
+                last = last->next_free;
+            }
+            llcm_segmented_queue_push_free_(queue, rest, last);
+        }
+        __atomic_store_n(&segment->next, NULL, __ATOMIC_RELAXED);
+        // a drained ring keeps its counters, so it is reused without another init. release, so
+        // a push that reserves in it before it is linked also sees it is not the tail
+        __atomic_fetch_and(&segment->ring.counters.reserved_push_size,
+                           ~LLCM_SEGMENTED_QUEUE_CLOSED_, __ATOMIC_SEQ_CST);
+        return segment;
+    }
+    segment = (struct llcm_segmented_queue_segment *) llcm_allocator_allocate(
+        queue->allocator, alignof(struct llcm_segmented_queue_segment),
+        sizeof(struct llcm_segmented_queue_segment));
+    llcm_concurrent_queue_init_with_flags(&segment->ring, queue->segment_capacity, queue->flags,
+                                          queue->allocator);
+    segment->next = NULL;
+    segment->next_free = NULL;
+    segment->num_users = 0;
+    __atomic_fetch_add(&queue->num_segments, 1, __ATOMIC_RELEASE);
+    return segment;
+}
+
+void llcm_segmented_queue_release_segment_(struct llcm_segmented_queue *queue,
+                                           struct llcm_segmented_queue_segment *segment) {
+    __atomic_fetch_or(&segment->ring.counters.reserved_push_size, LLCM_SEGMENTED_QUEUE_CLOSED_,
+                      __ATOMIC_SEQ_CST);
+    llcm_segmented_queue_push_free_(queue, segment, segment);
+}
+
+void llcm_segmented_queue_push_free_(struct llcm_segmented_queue *queue,
+                                     struct llcm_segmented_queue_segment *first,
+                                     struct llcm_segmented_queue_segment *last) {
+    struct llcm_segmented_queue_segment *pool = __atomic_load_n(&queue->pool, __ATOMIC_RELAXED);
+    do {
+        last->next_free = pool;
+    } while (!__atomic_compare_exchange_n(&queue->pool, &pool, first, true, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+}
+
+bool llcm_segmented_queue_try_enter_(struct llcm_segmented_queue *queue,
+                                     struct llcm_segmented_queue_segment *const *slot,
+                                     struct llcm_segmented_queue_segment *segment) {
+    // seq_cst against llcm_segmented_queue_retire_, either this sees slot moved on or the
+    // retiring thread sees this user and leaves the recycling to it
+    __atomic_fetch_add(&segment->num_users, 1, __ATOMIC_SEQ_CST);
+    if (segment == __atomic_load_n(slot, __ATOMIC_SEQ_CST)) {
+        return true;
+    }
+    llcm_segmented_queue_leave_(queue, segment);
+    return false;
+}
+
+void llcm_segmented_queue_leave_(struct llcm_segmented_queue *queue,
+                                 struct llcm_segmented_queue_segment *segment) {
+    if (LLCM_SEGMENTED_QUEUE_RETIRED_ + 1 ==
+        __atomic_fetch_sub(&segment->num_users, 1, __ATOMIC_SEQ_CST)) {
+        llcm_segmented_queue_try_recycle_(queue, segment);
+    }
+}
+
+void llcm_segmented_queue_retire_(struct llcm_segmented_queue *queue,
+                                  struct llcm_segmented_queue_segment *segment) {
+    if (0 == __atomic_fetch_or(&segment->num_users, LLCM_SEGMENTED_QUEUE_RETIRED_,
+                               __ATOMIC_SEQ_CST)) {
+        llcm_segmented_queue_try_recycle_(queue, segment);
+    }
+}
+
+void llcm_segmented_queue_try_recycle_(struct llcm_segmented_queue *queue,
+                                       struct llcm_segmented_queue_segment *segment) {
+    // a late thread may still enter and leave a retired segment after finding it gone, only
+    // whoever clears the bit recycles it
+    uint64_t expected = LLCM_SEGMENTED_QUEUE_RETIRED_;
+    if (__atomic_compare_exchange_n(&segment->num_users, &expected, 0, false, __ATOMIC_ACQ_REL,
+                                    __ATOMIC_RELAXED)) {
+        llcm_segmented_queue_release_segment_(queue, segment);
+    }
+}
+
+size_t llcm_segmented_queue_try_pop_head_(struct llcm_segmented_queue *queue,
+                                          struct llcm_segmented_queue_segment *head,
+                                          void **values, size_t max_values) {
+    // the single consumer retires segments itself, so its head is never stale
+    if (queue->flags & LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER) {
+        return llcm_concurrent_queue_try_pop_n(&head->ring, values, max_values);
+    }
+    // a write counter of a later use of the recycled ring is only seen after head moved past
+    // it, which the acquire loads carry over to the check
+    uint64_t const write_counter =
+        __atomic_load_n(&head->ring.counters.write_counter, __ATOMIC_ACQUIRE);
+    if (head != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) {
+        return SIZE_MAX;
+    }
+    return llcm_concurrent_queue_try_pop_n_below_(&head->ring, values, max_values, write_counter);
+}
+
+bool llcm_segmented_queue_check_reserved_tail_(struct llcm_segmented_queue *queue,
+                                               struct llcm_segmented_queue_segment *tail,
+                                               size_t num_new_entries) {
+    // the tail may have been recycled and reopened since it was loaded. only read-modify-writes
+    // follow the reopening, so this acquire pairs with it and the tail loaded next is at least
+    // as new as the unlinked segment
+    (void) __atomic_load_n(&tail->ring.counters.reserved_push_size, __ATOMIC_ACQUIRE);
+    if (tail == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE)) {
+        return true;
+    }
+    llcm_concurrent_queue_unreserve_size_after_pop(&tail->ring, num_new_entries);
+    return false;
+}
+
+void llcm_segmented_queue_append_(struct llcm_segmented_queue *queue,
+                                  struct llcm_segmented_queue_segment *full_tail) {
+    // full_tail was a stale pointer, the caller retries with the new tail
+    if (!llcm_segmented_queue_try_enter_(queue, &queue->tail, full_tail)) {
+        return;
+    }
+    struct llcm_segmented_queue_segment *next =
+        __atomic_load_n(&full_tail->next, __ATOMIC_ACQUIRE);
+    if (NULL == next) {
+        __atomic_fetch_or(&full_tail->ring.counters.reserved_push_size,
+                          LLCM_SEGMENTED_QUEUE_CLOSED_, __ATOMIC_SEQ_CST);
+        struct llcm_segmented_queue_segment *segment =
+            llcm_segmented_queue_acquire_segment_(queue);
+        if (__atomic_compare_exchange_n(&full_tail->next, &next, segment, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE)) {
+            next = segment;
+        } else {
+            // another push appended first
+            llcm_segmented_queue_release_segment_(queue, segment);
+        }
+    }
+    // whoever appended may not have moved the tail yet, any push helps
+    struct llcm_segmented_queue_segment *expected = full_tail;
+    __atomic_compare_exchange_n(&queue->tail, &expected, next, false, __ATOMIC_SEQ_CST,
+                                __ATOMIC_RELAXED);
+    llcm_segmented_queue_leave_(queue, full_tail);
+}
+
+bool llcm_segmented_queue_try_advance_head_(struct llcm_segmented_queue *queue,
+                                            struct llcm_segmented_queue_segment *head) {
+    // an empty last segment is the common case, it is checked before entering. a stale head
+    // only makes the queue look empty, like a stale write counter in a single ring
+    if (NULL == __atomic_load_n(&head->next, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    bool const single_consumer = queue->flags & LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER;
+    if (!single_consumer && !llcm_segmented_queue_try_enter_(queue, &queue->head, head)) {
+        return true;
+    }
+    // the tail segment is never drained, and a closed segment still holding reservations has
+    // a push or unreserve in flight, which looks empty for now as it would in a single ring
+    bool advanced = false;
+    struct llcm_segmented_queue_segment *next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    if (NULL != next &&
+        LLCM_SEGMENTED_QUEUE_CLOSED_ ==
+            __atomic_load_n(&head->ring.counters.reserved_push_size, __ATOMIC_SEQ_CST)) {
+        // the tail may still be on head if its appender has not moved it, it must never be left
+        // on a retired segment
+        struct llcm_segmented_queue_segment *expected = head;
+        __atomic_compare_exchange_n(&queue->tail, &expected, next, false, __ATOMIC_SEQ_CST,
+                                    __ATOMIC_SEQ_CST);
+        expected = head;
+        if (__atomic_compare_exchange_n(&queue->head, &expected, next, false, __ATOMIC_SEQ_CST,
+                                        __ATOMIC_SEQ_CST)) {
+            llcm_segmented_queue_retire_(queue, head);
+        }
+        advanced = true;
+    }
+    if (!single_consumer) {
+        llcm_segmented_queue_leave_(queue, head);
+    }
+    return advanced;
+}
@@ -0,0 +1,311 @@
+#pragma once
+
+#include "lib/concurrent_queue.h"
+#include "lib/utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* public */
+
+// bumped whenever the layout of the shared region changes
+#define LLCM_SHM_QUEUE_VERSION  1
+#define LLCM_SHM_QUEUE_MAX_NAME 200
+
+struct llcm_shm_queue_header_;
+struct llcm_shm_queue_entry_;
+
+// a llcm_concurrent_queue of 64 bit values in a shared memory region, for lock free handoff
+// between processes. values are offsets into some other shared mapping or small handles, never
+// pointers, as every process maps the region at a different address. the region holds no
+// pointers either, it starts with a header carrying the version and capacity, followed by the
+// counters and the padded entries.
+//
+// a process that dies between claiming a slot and publishing it blocks that slot for good, like
+// a thread stalled there would
+struct llcm_shm_queue {
+    /* private */
+
+    // this process' view of the region
+    struct llcm_shm_queue_header_ *header_;
+    struct llcm_shm_queue_entry_ *entries_;
+    uint64_t mask_;
+    unsigned flags_;
+    int fd_;
+    size_t region_size_;
+};
+
+// creates /dev/shm/name like shm_open, failing if it exists. a NULL name creates an anonymous
+// memfd instead, which other processes inherit by fork or receive over a unix socket, see
+// llcm_shm_queue_get_fd. flags are the LLCM_CONCURRENT_QUEUE_SINGLE_* ones and hold across
+// every process. on failure errno tells why, EINVAL for a bad name or region
+bool llcm_shm_queue_create(struct llcm_shm_queue *, char const *name, size_t capacity,
+                           unsigned flags);
+// fails unless the region was created with the same version and fully initialized
+bool llcm_shm_queue_open(struct llcm_shm_queue *, char const *name);
+// takes ownership of fd on success only
+bool llcm_shm_queue_open_fd(struct llcm_shm_queue *, int fd);
+// unmaps this process' view, the region lives on until every process closed it and it is
+// unlinked
+void llcm_shm_queue_close(struct llcm_shm_queue *);
+bool llcm_shm_queue_unlink(char const *name);
+int llcm_shm_queue_get_fd(struct llcm_shm_queue const *);
+
+size_t llcm_shm_queue_get_capacity(struct llcm_shm_queue const *);
+// number of pushed entries not yet popped, only a snapshot under concurrent use
+size_t llcm_shm_queue_get_size(struct llcm_shm_queue const *);
+
+// the same contract as the llcm_concurrent_queue functions of the same names
+bool llcm_shm_queue_try_reserve_size_before_push(struct llcm_shm_queue *, size_t num_new_entries);
+void llcm_shm_queue_unreserve_size_after_pop(struct llcm_shm_queue *, size_t num_old_entries);
+void llcm_shm_queue_push(struct llcm_shm_queue *, uint64_t value);
+// returns false if the queue is empty, every value including 0 is valid
+bool llcm_shm_queue_try_pop(struct llcm_shm_queue *, uint64_t *value);
+void llcm_shm_queue_push_n(struct llcm_shm_queue *, uint64_t const *values, size_t num_values);
+size_t llcm_shm_queue_try_pop_n(struct llcm_shm_queue *, uint64_t *values, size_t max_values);
+
+/* private */
+
+#define LLCM_SHM_QUEUE_MAGIC_ UINT64_C(0x514d48534d434c4c)   // "LLCMSHMQ"
+
+// only fixed size fields, so every process reads the same layout
+struct llcm_shm_queue_header_ {
+    // stored last by the creator, a region without it is not ready
+    _Atomic uint64_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint64_t capacity;
+    uint64_t entry_size;
+    uint64_t region_size;
+
+    // the atomics are lock free, so the ring works the same across processes
+    struct llcm_concurrent_queue_counters_ counters;
+};
+
+struct llcm_shm_queue_entry_ {
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) _Atomic uint64_t aba_counter;
+    uint64_t value;
+};
+
+size_t llcm_shm_queue_get_region_size_(uint64_t capacity);
+bool llcm_shm_queue_get_path_(char *path, char const *name);
+// maps the region, false and nothing mapped on failure
+bool llcm_shm_queue_map_(struct llcm_shm_queue *, int fd, size_t region_size);
+void llcm_shm_queue_write_entry_(struct llcm_shm_queue *, uint64_t write_counter, uint64_t value);
+uint64_t llcm_shm_queue_read_entry_(struct llcm_shm_queue *, uint64_t read_counter);
+
+bool llcm_shm_queue_create(struct llcm_shm_queue *queue, char const *name, size_t capacity,
+                           unsigned flags) {
+    char path[sizeof("/dev/shm/") + LLCM_SHM_QUEUE_MAX_NAME];
+    int fd;
+    if (NULL == name) {
+        fd = memfd_create("llcm_shm_queue", MFD_CLOEXEC);
+    } else if (llcm_shm_queue_get_path_(path, name)) {
+        fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    } else {
+        return false;
+    }
+    if (fd < 0) {
+        return false;
+    }
+    capacity = llcm_round_up_pow2(capacity);
+    if (capacity < 2) {
+        capacity = 2;   // capacity must be at least 2 for aba_counter
+    }
+    size_t const region_size = llcm_shm_queue_get_region_size_(capacity);
+    if (0 != ftruncate(fd, region_size) || !llcm_shm_queue_map_(queue, fd, region_size)) {
+        int const error = errno;
+        close(fd);
+        if (NULL != name) {
+            unlink(path);
+        }
+        errno = error;
+        return false;
+    }
+
+    // a fresh file reads as zeroes, only the non zero fields need writing
+    struct llcm_shm_queue_header_ *header = queue->header_;
+    header->version = LLCM_SHM_QUEUE_VERSION;
+    header->flags = flags & (LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER |
+                             LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER);
+    header->capacity = capacity;
+    header->entry_size = sizeof(struct llcm_shm_queue_entry_);
+    header->region_size = region_size;
+    for (uint64_t i = 0; i < capacity; i++) {
+        atomic_init(&queue->entries_[i].aba_counter, i);
+    }
+    queue->mask_ = capacity - 1;
+    queue->flags_ = header->flags;
+    atomic_store_explicit(&header->magic, LLCM_SHM_QUEUE_MAGIC_, memory_order_release);
+    return true;
+}
+
+bool llcm_shm_queue_open(struct llcm_shm_queue *queue, char const *name) {
+    char path[sizeof("/dev/shm/") + LLCM_SHM_QUEUE_MAX_NAME];
+    if (!llcm_shm_queue_get_path_(path, name)) {
+        return false;
+    }
+    int const fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    if (!llcm_shm_queue_open_fd(queue, fd)) {
+        int const error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+bool llcm_shm_queue_open_fd(struct llcm_shm_queue *queue, int fd) {
+    struct stat file_stat;
+    if (0 != fstat(fd, &file_stat)) {
+        return false;
+    }
+    if ((size_t) file_stat.st_size < sizeof(struct llcm_shm_queue_header_)) {
+        errno = EINVAL;
+        return false;
+    }
+    if (!llcm_shm_queue_map_(queue, fd, file_stat.st_size)) {
+        return false;
+    }
+    // the creator's writes are visible once its magic is, so nothing else is read before it
+    struct llcm_shm_queue_header_ const *header = queue->header_;
+    bool valid =
+        LLCM_SHM_QUEUE_MAGIC_ == atomic_load_explicit(&header->magic, memory_order_acquire);
+    uint64_t const capacity = valid ? header->capacity : 0;
+    valid = valid && LLCM_SHM_QUEUE_VERSION == header->version &&
+            sizeof(struct llcm_shm_queue_entry_) == header->entry_size && capacity >= 2 &&
+            0 == (capacity & (capacity - 1)) &&
+            llcm_shm_queue_get_region_size_(capacity) == header->region_size &&
+            header->region_size <= (size_t) file_stat.st_size;
+    if (!valid) {
+        munmap(queue->header_, queue->region_size_);
+        errno = EINVAL;
+        return false;
+    }
+    queue->mask_ = capacity - 1;
+    queue->flags_ = header->flags;
+    return true;
+}
+
+void llcm_shm_queue_close(struct llcm_shm_queue *queue) {
+    munmap(queue->header_, queue->region_size_);
+    close(queue->fd_);
+}
+
+bool llcm_shm_queue_unlink(char const *name) {
+    char path[sizeof("/dev/shm/") + LLCM_SHM_QUEUE_MAX_NAME];
+    return llcm_shm_queue_get_path_(path, name) && 0 == unlink(path);
+}
+
+int llcm_shm_queue_get_fd(struct llcm_shm_queue const *queue) { return queue->fd_; }
+
+size_t llcm_shm_queue_get_capacity(struct llcm_shm_queue const *queue) {
+    return queue->mask_ + 1;
+}
+
+size_t llcm_shm_queue_get_size(struct llcm_shm_queue const *queue) {
+    return llcm_concurrent_queue_counters_get_size_(&queue->header_->counters);
+}
+
+bool llcm_shm_queue_try_reserve_size_before_push(struct llcm_shm_queue *queue,
+                                                 size_t num_new_entries) {
+    return llcm_concurrent_queue_counters_try_reserve_(&queue->header_->counters, queue->mask_ + 1,
+                                                       num_new_entries);
+}
+
+void llcm_shm_queue_unreserve_size_after_pop(struct llcm_shm_queue *queue,
+                                             size_t num_old_entries) {
+    llcm_concurrent_queue_counters_unreserve_(&queue->header_->counters, num_old_entries);
+}
+
+void llcm_shm_queue_push(struct llcm_shm_queue *queue, uint64_t value) {
+    llcm_shm_queue_push_n(queue, &value, 1);
+}
+
+bool llcm_shm_queue_try_pop(struct llcm_shm_queue *queue, uint64_t *value) {
+    return 1 == llcm_shm_queue_try_pop_n(queue, value, 1);
+}
+
+void llcm_shm_queue_push_n(struct llcm_shm_queue *queue, uint64_t const *values,
+                           size_t num_values) {
+    if (0 == num_values) {
+        return;
+    }
+    bool const single_producer = queue->flags_ & LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER;
+    uint64_t const write_counter = llcm_concurrent_queue_counters_begin_push_(
+        &queue->header_->counters, num_values, single_producer);
+    for (size_t i = 0; i < num_values; i++) {
+        llcm_shm_queue_write_entry_(queue, write_counter + i, values[i]);
+    }
+    llcm_concurrent_queue_counters_end_push_(&queue->header_->counters, write_counter, num_values,
+                                             single_producer);
+}
+
+size_t llcm_shm_queue_try_pop_n(struct llcm_shm_queue *queue, uint64_t *values,
+                                size_t max_values) {
+    uint64_t read_counter;
+    size_t const num_values = llcm_concurrent_queue_counters_claim_pop_(
+        &queue->header_->counters, max_values,
+        queue->flags_ & LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER, &read_counter);
+    for (size_t i = 0; i < num_values; i++) {
+        values[i] = llcm_shm_queue_read_entry_(queue, read_counter + i);
+    }
+    return num_values;
+}
+
+size_t llcm_shm_queue_get_region_size_(uint64_t capacity) {
+    return sizeof(struct llcm_shm_queue_header_) + capacity * sizeof(struct llcm_shm_queue_entry_);
+}
+
+bool llcm_shm_queue_get_path_(char *path, char const *name) {
+    // one file directly in /dev/shm, like shm_open
+    size_t const name_length = strlen(name);
+    if (0 == name_length || name_length > LLCM_SHM_QUEUE_MAX_NAME || NULL != strchr(name, '/')) {
+        errno = EINVAL;
+        return false;
+    }
+    snprintf(path, sizeof("/dev/shm/") + LLCM_SHM_QUEUE_MAX_NAME, "/dev/shm/%s", name);
+    return true;
+}
+
+bool llcm_shm_queue_map_(struct llcm_shm_queue *queue, int fd, size_t region_size) {
+    void *region = mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == region) {
+        return false;
+    }
+    memset(queue, 0, sizeof(*queue));
+    queue->header_ = region;
+    queue->entries_ = (struct llcm_shm_queue_entry_ *) (queue->header_ + 1);
+    queue->fd_ = fd;
+    queue->region_size_ = region_size;
+    return true;
+}
+
+void llcm_shm_queue_write_entry_(struct llcm_shm_queue *queue, uint64_t write_counter,
+                                 uint64_t value) {
+    struct llcm_shm_queue_entry_ *entry = &queue->entries_[write_counter & queue->mask_];
+    llcm_concurrent_queue_wait_to_write_(&entry->aba_counter, write_counter);
+    entry->value = value;
+    llcm_concurrent_queue_publish_write_(&entry->aba_counter, write_counter);
+}
+
+uint64_t llcm_shm_queue_read_entry_(struct llcm_shm_queue *queue, uint64_t read_counter) {
+    struct llcm_shm_queue_entry_ *entry = &queue->entries_[read_counter & queue->mask_];
+    llcm_concurrent_queue_wait_to_read_(&entry->aba_counter, read_counter);
+    uint64_t const value = entry->value;
+    llcm_concurrent_queue_publish_read_(&entry->aba_counter, read_counter, queue->mask_ + 1);
+    return value;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* public */
+
+// per thread counters of the queue and scheduler hot paths, only counted when built with
+// -DLLCM_STATS, otherwise every counter compiles away and snapshots stay zero
+struct llcm_stats {
+    // failed cas on read_counter in try_pop and try_pop_n
+    uint64_t queue_pop_cas_failures;
+    // iterations waiting for a slot's aba_counter
+    uint64_t queue_push_aba_spins;
+    uint64_t queue_pop_aba_spins;
+    uint64_t queue_reserve_failures;
+    // poll and poll_batch calls that found nothing or something to poll
+    uint64_t scheduler_empty_polls;
+    uint64_t scheduler_productive_polls;
+    // successful llcm_exec_handle_try_switch_scheduler calls
+    uint64_t scheduler_migrations;
+    // routines polled straight from a poller's run next slot
+    uint64_t scheduler_run_next_polls;
+};
+
+#ifdef LLCM_STATS
+#define LLCM_STATS_ENABLED true
+#else
+#define LLCM_STATS_ENABLED false
+#endif
+
+// sums the counters of every thread that ever counted, exited threads included, safe to call
+// from a monitoring thread while the others keep counting
+void llcm_stats_snapshot(struct llcm_stats *);
+// the counters of the calling thread only
+void llcm_stats_snapshot_thread(struct llcm_stats *);
+// after - before, for the rates between two periodic snapshots
+void llcm_stats_diff(struct llcm_stats *out, struct llcm_stats const *after,
+                     struct llcm_stats const *before);
+
+/* private */
+
+#define LLCM_STATS_NUM_COUNTERS_ (sizeof(struct llcm_stats) / sizeof(uint64_t))
+static_assert(sizeof(struct llcm_stats) == LLCM_STATS_NUM_COUNTERS_ * sizeof(uint64_t),
+              "llcm_stats must only hold uint64_t counters");
+
+#ifdef LLCM_STATS
+
+// one line per thread, never freed so a snapshot can still read threads that exited
+struct llcm_stats_thread_ {
+    struct llcm_stats stats;
+    struct llcm_stats_thread_ *next;
+};
+
+struct llcm_stats_thread_ *llcm_stats_threads_ = NULL;
+_Thread_local struct llcm_stats_thread_ *llcm_stats_local_ = NULL;
+
+struct llcm_stats_thread_ *llcm_stats_register_thread_(void);
+
+// only the owning thread writes its counters, so a plain increment published relaxed suffices
+#define LLCM_STATS_INC_(counter)                                                                   \
+    do {                                                                                           \
+        struct llcm_stats_thread_ *llcm_stats_thread = llcm_stats_local_;                          \
+        if (NULL == llcm_stats_thread) {                                                           \
+            llcm_stats_thread = llcm_stats_register_thread_();                                     \
+        }                                                                                          \
+        __atomic_store_n(&llcm_stats_thread->stats.counter,                                        \
+                         llcm_stats_thread->stats.counter + 1, __ATOMIC_RELAXED);                  \
+    } while (0)
+
+struct llcm_stats_thread_ *llcm_stats_register_thread_(void) {
+    size_t const size = (sizeof(struct llcm_stats_thread_) + 63) & ~(size_t) 63;
+    struct llcm_stats_thread_ *thread = aligned_alloc(64, size);
+    assert(NULL != thread);
+    memset(thread, 0, size);
+    thread->next = __atomic_load_n(&llcm_stats_threads_, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&llcm_stats_threads_, &thread->next, thread, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    llcm_stats_local_ = thread;
+    return thread;
+}
+
+#else
+
+#define LLCM_STATS_INC_(counter) ((void) 0)
+
+#endif
+
+void llcm_stats_snapshot(struct llcm_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+#ifdef LLCM_STATS
+    uint64_t *sums = (uint64_t *) stats;
+    struct llcm_stats_thread_ *thread = __atomic_load_n(&llcm_stats_threads_, __ATOMIC_ACQUIRE);
+    for (; NULL != thread; thread = thread->next) {
+        uint64_t const *counters = (uint64_t const *) &thread->stats;
+        for (size_t i = 0; i < LLCM_STATS_NUM_COUNTERS_; i++) {
+            sums[i] += __atomic_load_n(&counters[i], __ATOMIC_RELAXED);
+        }
+    }
+#endif
+}
+
+void llcm_stats_snapshot_thread(struct llcm_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+#ifdef LLCM_STATS
+    if (NULL != llcm_stats_local_) {
+        *stats = llcm_stats_local_->stats;
+    }
+#endif
+}
+
+void llcm_stats_diff(struct llcm_stats *out, struct llcm_stats const *after,
+                     struct llcm_stats const *before) {
+    uint64_t *out_counters = (uint64_t *) out;
+    uint64_t const *after_counters = (uint64_t const *) after;
+    uint64_t const *before_counters = (uint64_t const *) before;
+    for (size_t i = 0; i < LLCM_STATS_NUM_COUNTERS_; i++) {
+        out_counters[i] = after_counters[i] - before_counters[i];
+    }
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "lib/concurrent_queue.h"
+#include "lib/exec_handle.h"
+#include "lib/scheduler.h"
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* public */
+
+struct llcm_task_group;
+
+// a child routine of a llcm_task_group. it is polled until it cancels itself like any routine,
+// the group counts it done once that poll returns
+struct llcm_task {
+    void (*poll)(void *arg0, struct llcm_exec_handle *);
+    void *arg0;
+
+    /* private */
+
+    struct llcm_routine routine_;
+    struct llcm_task_group *group_;
+};
+
+// fork join over routines. children are spawned onto any schedulers, each finished child costs
+// a single compare and swap, and a routine awaiting the group is parked until the last child
+// is done instead of being requeued to check
+struct llcm_task_group {
+    /* private */
+
+    // pending children, or'ed with LLCM_TASK_GROUP_WAITING_ while a routine is parked on it
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint64_t state_;
+    // only read by the child that finishes last while the flag is set, before it clears the state
+    struct llcm_routine *waiter_;
+    struct llcm_scheduler *waiter_scheduler_;
+};
+
+void llcm_task_group_init(struct llcm_task_group *);
+uint64_t llcm_task_group_get_num_pending(struct llcm_task_group const *);
+// true once every spawned child is done, their writes are visible then
+bool llcm_task_group_is_done(struct llcm_task_group const *);
+
+// from the awaiting routine or the group's own children, which may spawn more children, and from
+// any thread before the group is awaited. the task must stay valid until it is done, returns
+// false if the scheduler is full
+bool llcm_task_group_try_spawn(struct llcm_task_group *, struct llcm_task *,
+                               struct llcm_scheduler *);
+
+// returns true if every child is done, otherwise the routine is parked when the current poll
+// returns, holding its reservation, and polled again once the last child is done. at most one
+// routine awaits a group at a time
+bool llcm_task_group_await(struct llcm_task_group *, struct llcm_exec_handle *);
+
+/* private */
+
+#define LLCM_TASK_GROUP_WAITING_ (UINT64_C(1) << 63)
+
+void llcm_task_release_(struct llcm_routine *);
+void llcm_task_group_finish_child_(struct llcm_task_group *);
+bool llcm_task_group_try_park_(void *group, struct llcm_routine *, struct llcm_scheduler *);
+
+void llcm_task_group_init(struct llcm_task_group *group) {
+    group->waiter_ = NULL;
+    group->waiter_scheduler_ = NULL;
+    __atomic_store_n(&group->state_, 0, __ATOMIC_RELEASE);
+}
+
+uint64_t llcm_task_group_get_num_pending(struct llcm_task_group const *group) {
+    return __atomic_load_n(&group->state_, __ATOMIC_ACQUIRE) & ~LLCM_TASK_GROUP_WAITING_;
+}
+
+bool llcm_task_group_is_done(struct llcm_task_group const *group) {
+    return 0 == llcm_task_group_get_num_pending(group);
+}
+
+bool llcm_task_group_try_spawn(struct llcm_task_group *group, struct llcm_task *task,
+                               struct llcm_scheduler *scheduler) {
+    // counted before it can run, so the count never drops to 0 while a child is pending
+    __atomic_fetch_add(&group->state_, 1, __ATOMIC_RELAXED);
+    task->group_ = group;
+    llcm_routine_init(&task->routine_, task->poll, task->arg0);
+    task->routine_.release_ = llcm_task_release_;
+    if (!llcm_scheduler_try_schedule_routine(scheduler, &task->routine_)) {
+        llcm_task_group_finish_child_(group);
+        return false;
+    }
+    return true;
+}
+
+bool llcm_task_group_await(struct llcm_task_group *group, struct llcm_exec_handle *handle) {
+    if (llcm_task_group_is_done(group)) {
+        return true;
+    }
+    llcm_exec_handle_park_(handle, llcm_task_group_try_park_, group);
+    return false;
+}
+
+void llcm_task_release_(struct llcm_routine *routine) {
+    struct llcm_task *task =
+        (struct llcm_task *) ((char *) routine - offsetof(struct llcm_task, routine_));
+    llcm_task_group_finish_child_(task->group_);
+}
+
+void llcm_task_group_finish_child_(struct llcm_task_group *group) {
+    // the last child takes the waiter and drops both the count and the flag in the same cas, the
+    // group is not touched after it, as its owner may free it as soon as it reads 0. acq_rel, so
+    // the last child carries every other child's writes over to the waiter
+    struct llcm_routine *waiter;
+    struct llcm_scheduler *waiter_scheduler;
+    uint64_t state = __atomic_load_n(&group->state_, __ATOMIC_ACQUIRE);
+    uint64_t next_state;
+    do {
+        waiter = NULL;
+        waiter_scheduler = NULL;
+        next_state = state - 1;
+        if ((LLCM_TASK_GROUP_WAITING_ | 1) == state) {
+            waiter = group->waiter_;
+            waiter_scheduler = group->waiter_scheduler_;
+            next_state = 0;
+        }
+    } while (!__atomic_compare_exchange_n(&group->state_, &state, next_state, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    if (NULL != waiter) {
+        llcm_scheduler_resume_routine_(waiter_scheduler, waiter);
+    }
+}
+
+bool llcm_task_group_try_park_(void *waitable, struct llcm_routine *routine,
+                               struct llcm_scheduler *scheduler) {
+    struct llcm_task_group *group = waitable;
+    group->waiter_ = routine;
+    group->waiter_scheduler_ = scheduler;
+    // only flags the wait while children are pending, fails if the last one finished since the
+    // routine checked, then it is requeued
+    uint64_t state = __atomic_load_n(&group->state_, __ATOMIC_ACQUIRE);
+    do {
+        if (0 == state) {
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(&group->state_, &state, state | LLCM_TASK_GROUP_WAITING_,
+                                          true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    return true;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "lib/concurrent_queue.h"
+#include "lib/routine.h"
+#include "lib/utils.h"
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* public */
+
+#define LLCM_TIMER_WHEEL_TICK_SHIFT 10   // 1024 tsc ticks per wheel tick
+#define LLCM_TIMER_WHEEL_SLOT_BITS  6
+#define LLCM_TIMER_WHEEL_NUM_SLOTS  (1 << LLCM_TIMER_WHEEL_SLOT_BITS)
+#define LLCM_TIMER_WHEEL_NUM_LEVELS 6
+
+// hierarchical timing wheel of intrusive routines keyed by tsc deadline,
+// any thread may insert, one thread at a time expires
+struct llcm_timer_wheel {
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) struct llcm_routine *inbox;
+
+    alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) uint32_t lock;
+    uint64_t current_tick;
+    uint64_t next_due_tick;
+    uint64_t num_timers;
+    uint64_t occupied_slots[LLCM_TIMER_WHEEL_NUM_LEVELS];
+    struct llcm_routine *overflow;
+    struct llcm_routine *slots[LLCM_TIMER_WHEEL_NUM_LEVELS][LLCM_TIMER_WHEEL_NUM_SLOTS];
+};
+
+void llcm_timer_wheel_init(struct llcm_timer_wheel *);
+
+// routine->timer_deadline_ must be set, does not allocate
+void llcm_timer_wheel_insert(struct llcm_timer_wheel *, struct llcm_routine *);
+// true if nothing is inserted, does not read the clock
+bool llcm_timer_wheel_is_empty(struct llcm_timer_wheel const *);
+// cheap check for whether llcm_timer_wheel_try_expire has any work to do
+bool llcm_timer_wheel_is_due(struct llcm_timer_wheel const *, uint64_t now_tsc);
+// returns expired routines linked through timer_next_, NULL if none or another thread is expiring
+struct llcm_routine *llcm_timer_wheel_try_expire(struct llcm_timer_wheel *, uint64_t now_tsc);
+
+/* private */
+
+void llcm_timer_wheel_place_(struct llcm_timer_wheel *, struct llcm_routine *,
+                             struct llcm_routine **expired);
+void llcm_timer_wheel_place_list_(struct llcm_timer_wheel *, struct llcm_routine *,
+                                  struct llcm_routine **expired);
+void llcm_timer_wheel_cascade_(struct llcm_timer_wheel *, struct llcm_routine **expired);
+uint64_t llcm_timer_wheel_get_next_event_tick_(struct llcm_timer_wheel const *);
+
+void llcm_timer_wheel_init(struct llcm_timer_wheel *wheel) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->current_tick = llcm_rdtsc() >> LLCM_TIMER_WHEEL_TICK_SHIFT;
+    wheel->next_due_tick = wheel->current_tick;
+}
+
+void llcm_timer_wheel_insert(struct llcm_timer_wheel *wheel, struct llcm_routine *routine) {
+    struct llcm_routine *head = __atomic_load_n(&wheel->inbox, __ATOMIC_RELAXED);
+    do {
+        routine->timer_next_ = head;
+    } while (!__atomic_compare_exchange_n(&wheel->inbox, &head, routine, true, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+}
+
+bool llcm_timer_wheel_is_empty(struct llcm_timer_wheel const *wheel) {
+    return NULL == __atomic_load_n(&wheel->inbox, __ATOMIC_RELAXED) &&
+           0 == __atomic_load_n(&wheel->num_timers, __ATOMIC_RELAXED);
+}
+
+bool llcm_timer_wheel_is_due(struct llcm_timer_wheel const *wheel, uint64_t now_tsc) {
+    if (NULL != __atomic_load_n(&wheel->inbox, __ATOMIC_RELAXED)) {
+        return true;
+    }
+    return 0 != __atomic_load_n(&wheel->num_timers, __ATOMIC_RELAXED) &&
+           (now_tsc >> LLCM_TIMER_WHEEL_TICK_SHIFT) >
+               __atomic_load_n(&wheel->next_due_tick, __ATOMIC_RELAXED);
+}
+
+struct llcm_routine *llcm_timer_wheel_try_expire(struct llcm_timer_wheel *wheel,
+                                                 uint64_t now_tsc) {
+    if (__atomic_exchange_n(&wheel->lock, 1, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    struct llcm_routine *expired = NULL;
+    llcm_timer_wheel_place_list_(wheel, __atomic_exchange_n(&wheel->inbox, NULL, __ATOMIC_ACQUIRE),
+                                 &expired);
+
+    uint64_t const now_tick = now_tsc >> LLCM_TIMER_WHEEL_TICK_SHIFT;
+    while (0 != wheel->num_timers) {
+        // jump straight to the next tick with anything to cascade or expire
+        uint64_t const next_tick = llcm_timer_wheel_get_next_event_tick_(wheel);
+        if (next_tick >= now_tick) {
+            break;
+        }
+        wheel->current_tick = next_tick;
+        llcm_timer_wheel_cascade_(wheel, &expired);
+
+        size_t const slot = wheel->current_tick & (LLCM_TIMER_WHEEL_NUM_SLOTS - 1);
+        struct llcm_routine *routine = wheel->slots[0][slot];
+        wheel->slots[0][slot] = NULL;
+        wheel->occupied_slots[0] &= ~(1ULL << slot);
+        while (NULL != routine) {
+            struct llcm_routine *next = routine->timer_next_;
+            routine->timer_next_ = expired;
+            expired = routine;
+            wheel->num_timers--;
+            routine = next;
+        }
+        wheel->current_tick++;
+    }
+    if (wheel->current_tick < now_tick) {
+        wheel->current_tick = now_tick;
+    }
+    __atomic_store_n(&wheel->next_due_tick, llcm_timer_wheel_get_next_event_tick_(wheel),
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&wheel->lock, 0, __ATOMIC_RELEASE);
+    return expired;
+}
+
+void llcm_timer_wheel_place_(struct llcm_timer_wheel *wheel, struct llcm_routine *routine,
+                             struct llcm_routine **expired) {
+    uint64_t const deadline_tick = routine->timer_deadline_ >> LLCM_TIMER_WHEEL_TICK_SHIFT;
+    if (deadline_tick <= wheel->current_tick) {
+        routine->timer_next_ = *expired;
+        *expired = routine;
+        return;
+    }
+    // the highest slot group where the deadline differs from now picks the level, so the
+    // routine is cascaded exactly when the wheel enters its slot
+    size_t const level =
+        (63 - __builtin_clzll(deadline_tick ^ wheel->current_tick)) / LLCM_TIMER_WHEEL_SLOT_BITS;
+    if (level >= LLCM_TIMER_WHEEL_NUM_LEVELS) {
+        routine->timer_next_ = wheel->overflow;
+        wheel->overflow = routine;
+        return;
+    }
+    size_t const slot = (deadline_tick >> (level * LLCM_TIMER_WHEEL_SLOT_BITS)) &
+                        (LLCM_TIMER_WHEEL_NUM_SLOTS - 1);
+    routine->timer_next_ = wheel->slots[level][slot];
+    wheel->slots[level][slot] = routine;
+    wheel->occupied_slots[level] |= 1ULL << slot;
+}
+
+void llcm_timer_wheel_place_list_(struct llcm_timer_wheel *wheel, struct llcm_routine *routine,
+                                  struct llcm_routine **expired) {
+    while (NULL != routine) {
+        struct llcm_routine *next = routine->timer_next_;
+        wheel->num_timers++;
+        llcm_timer_wheel_place_(wheel, routine, expired);
+        if (*expired == routine) {
+            wheel->num_timers--;
+        }
+        routine = next;
+    }
+}
+
+void llcm_timer_wheel_cascade_(struct llcm_timer_wheel *wheel, struct llcm_routine **expired) {
+    for (size_t level = 1; level <= LLCM_TIMER_WHEEL_NUM_LEVELS; level++) {
+        uint64_t const level_shift = level * LLCM_TIMER_WHEEL_SLOT_BITS;
+        if (0 != (wheel->current_tick & ((1ULL << level_shift) - 1))) {
+            return;
+        }
+        struct llcm_routine *routines;
+        if (level == LLCM_TIMER_WHEEL_NUM_LEVELS) {
+            routines = wheel->overflow;
+            wheel->overflow = NULL;
+        } else {
+            size_t const slot =
+                (wheel->current_tick >> level_shift) & (LLCM_TIMER_WHEEL_NUM_SLOTS - 1);
+            routines = wheel->slots[level][slot];
+            wheel->slots[level][slot] = NULL;
+            wheel->occupied_slots[level] &= ~(1ULL << slot);
+        }
+        // routines already counted in num_timers, only the expired ones leave
+        while (NULL != routines) {
+            struct llcm_routine *next = routines->timer_next_;
+            llcm_timer_wheel_place_(wheel, routines, expired);
+            if (*expired == routines) {
+                wheel->num_timers--;
+            }
+            routines = next;
+        }
+    }
+}
+
+// earliest tick at or after current_tick whose level 0 slot or cascade is not empty
+uint64_t llcm_timer_wheel_get_next_event_tick_(struct llcm_timer_wheel const *wheel) {
+    uint64_t const current_tick = wheel->current_tick;
+    for (size_t level = 0; level < LLCM_TIMER_WHEEL_NUM_LEVELS; level++) {
+        uint64_t const level_shift = level * LLCM_TIMER_WHEEL_SLOT_BITS;
+        uint64_t const level_tick = current_tick >> level_shift;
+        size_t const slot = level_tick & (LLCM_TIMER_WHEEL_NUM_SLOTS - 1);
+        // the current slot of a higher level was already cascaded unless this is its first tick
+        size_t const first_slot =
+            0 == level || 0 == (current_tick & ((1ULL << level_shift) - 1)) ? slot : slot + 1;
+        if (first_slot >= LLCM_TIMER_WHEEL_NUM_SLOTS) {
+            continue;
+        }
+        uint64_t const later_slots = wheel->occupied_slots[level] >> first_slot;
+        if (0 != later_slots) {
+            uint64_t const next_slot = first_slot + __builtin_ctzll(later_slots);
+            return (level_tick - slot + next_slot) << level_shift;
+        }
+    }
+    if (NULL != wheel->overflow) {
+        uint64_t const top_level_shift = LLCM_TIMER_WHEEL_NUM_LEVELS * LLCM_TIMER_WHEEL_SLOT_BITS;
+        uint64_t const rotation_mask = (1ULL << top_level_shift) - 1;
+        return 0 == (current_tick & rotation_mask) ? current_tick
+                                                   : (current_tick | rotation_mask) + 1;
+    }
+    return UINT64_MAX;
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "lib/utils.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* public */
+
+// events kept per thread, older ones are overwritten
+#ifndef LLCM_TRACE_RING_SIZE
+#define LLCM_TRACE_RING_SIZE 4096
+#endif
+
+enum llcm_trace_event_type {
+    LLCM_TRACE_ROUTINE_SCHEDULED = 1,
+    LLCM_TRACE_POLL_BEGIN,
+    LLCM_TRACE_POLL_END,
+    LLCM_TRACE_SWITCHED_SCHEDULER,
+    LLCM_TRACE_CANCELLED,
+    // a schedule failed as the scheduler had no capacity left
+    LLCM_TRACE_QUEUE_FULL,
+};
+
+struct llcm_trace_event {
+    uint64_t tsc;
+    uint64_t type;
+    void *routine;
+    void *scheduler;
+};
+
+#ifdef LLCM_TRACE
+#define LLCM_TRACE_ENABLED true
+#else
+#define LLCM_TRACE_ENABLED false
+#endif
+
+// names the calling thread in dumps, the name must outlive the dump
+void llcm_trace_set_thread_name(char const *);
+// copies up to max_events of the calling thread's most recent events, oldest first
+size_t llcm_trace_get_thread_events(struct llcm_trace_event *, size_t max_events);
+// writes every thread's recent events as chrome trace event json, loadable by chrome://tracing
+// and perfetto, safe to call while other threads keep tracing. returns false on a write error
+bool llcm_trace_dump_chrome_json(FILE *);
+
+/* private */
+
+static_assert(0 == (LLCM_TRACE_RING_SIZE & (LLCM_TRACE_RING_SIZE - 1)),
+              "LLCM_TRACE_RING_SIZE must be a power of two");
+
+// never freed so a dump still shows threads that exited
+struct llcm_trace_thread_ {
+    struct llcm_trace_event events[LLCM_TRACE_RING_SIZE];
+    // only written by the owning thread
+    uint64_t num_events;
+    uint64_t id;
+    char const *name;
+    struct llcm_trace_thread_ *next;
+};
+
+struct llcm_trace_thread_ *llcm_trace_threads_ = NULL;
+uint64_t llcm_trace_num_threads_ = 0;
+uint64_t llcm_trace_base_tsc_ = 0;
+_Thread_local struct llcm_trace_thread_ *llcm_trace_local_ = NULL;
+
+struct llcm_trace_thread_ *llcm_trace_get_thread_(void);
+void llcm_trace_record_(enum llcm_trace_event_type, void *routine, void *scheduler);
+// a consistent copy of the events that were not overwritten while copying
+size_t llcm_trace_copy_events_(struct llcm_trace_thread_ const *, struct llcm_trace_event *,
+                               size_t max_events);
+
+#ifdef LLCM_TRACE
+#define LLCM_TRACE_(type, routine, scheduler) llcm_trace_record_(type, routine, scheduler)
+#else
+#define LLCM_TRACE_(type, routine, scheduler) ((void) 0)
+#endif
+
+void llcm_trace_set_thread_name(char const *name) { llcm_trace_get_thread_()->name = name; }
+
+size_t llcm_trace_get_thread_events(struct llcm_trace_event *events, size_t max_events) {
+    return llcm_trace_copy_events_(llcm_trace_get_thread_(), events, max_events);
+}
+
+bool llcm_trace_dump_chrome_json(FILE *file) {
+    struct llcm_trace_event *events =
+        malloc(LLCM_TRACE_RING_SIZE * sizeof(struct llcm_trace_event));
+    if (NULL == events) {
+        return false;
+    }
+    uint64_t const base_tsc = __atomic_load_n(&llcm_trace_base_tsc_, __ATOMIC_RELAXED);
+    double const ticks_per_nano = llcm_tsc_ticks_per_nano();
+    char const *separator = "";
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    struct llcm_trace_thread_ *thread = __atomic_load_n(&llcm_trace_threads_, __ATOMIC_ACQUIRE);
+    for (; NULL != thread; thread = thread->next) {
+        char const *name = __atomic_load_n(&thread->name, __ATOMIC_RELAXED);
+        if (NULL != name) {
+            fprintf(file,
+                    "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%lu,"
+                    "\"args\":{\"name\":\"%s\"}}",
+                    separator, thread->id, name);
+            separator = ",";
+        }
+        size_t const num_events = llcm_trace_copy_events_(thread, events, LLCM_TRACE_RING_SIZE);
+        // a poll whose begin was overwritten has nothing to close
+        size_t depth = 0;
+        for (size_t i = 0; i < num_events; i++) {
+            struct llcm_trace_event const *event = &events[i];
+            char const *phase = "i";
+            char const *event_name = "";
+            switch (event->type) {
+            case LLCM_TRACE_ROUTINE_SCHEDULED:
+                event_name = "scheduled";
+                break;
+            case LLCM_TRACE_POLL_BEGIN:
+                phase = "B";
+                event_name = "poll";
+                depth++;
+                break;
+            case LLCM_TRACE_POLL_END:
+                if (0 == depth) {
+                    continue;
+                }
+                phase = "E";
+                event_name = "poll";
+                depth--;
+                break;
+            case LLCM_TRACE_SWITCHED_SCHEDULER:
+                event_name = "switched_scheduler";
+                break;
+            case LLCM_TRACE_CANCELLED:
+                event_name = "cancelled";
+                break;
+            case LLCM_TRACE_QUEUE_FULL:
+                event_name = "queue_full";
+                break;
+            }
+            double const micros =
+                (event->tsc > base_tsc ? event->tsc - base_tsc : 0) / ticks_per_nano / 1000.0;
+            fprintf(file,
+                    "%s\n{\"ph\":\"%s\",\"name\":\"%s\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,%s"
+                    "\"args\":{\"routine\":\"%p\",\"scheduler\":\"%p\"}}",
+                    separator, phase, event_name, thread->id, micros,
+                    'i' == phase[0] ? "\"s\":\"t\"," : "", event->routine, event->scheduler);
+            separator = ",";
+        }
+    }
+    fprintf(file, "\n]}\n");
+    free(events);
+    return 0 == ferror(file);
+}
+
+struct llcm_trace_thread_ *llcm_trace_get_thread_(void) {
+    if (NULL != llcm_trace_local_) {
+        return llcm_trace_local_;
+    }
+    struct llcm_trace_thread_ *thread = calloc(1, sizeof(struct llcm_trace_thread_));
+    assert(NULL != thread);
+    thread->id = __atomic_add_fetch(&llcm_trace_num_threads_, 1, __ATOMIC_RELAXED);
+    uint64_t expected = 0;
+    __atomic_compare_exchange_n(&llcm_trace_base_tsc_, &expected, llcm_rdtsc(), false,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    thread->next = __atomic_load_n(&llcm_trace_threads_, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&llcm_trace_threads_, &thread->next, thread, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    llcm_trace_local_ = thread;
+    return thread;
+}
+
+void llcm_trace_record_(enum llcm_trace_event_type type, void *routine, void *scheduler) {
+    struct llcm_trace_thread_ *thread = llcm_trace_get_thread_();
+    uint64_t const num_events = thread->num_events;
+    struct llcm_trace_event *event = &thread->events[num_events & (LLCM_TRACE_RING_SIZE - 1)];
+    // keeps the slot writes after the previous publish, for llcm_trace_copy_events_
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&event->tsc, llcm_rdtsc(), __ATOMIC_RELAXED);
+    __atomic_store_n(&event->type, type, __ATOMIC_RELAXED);
+    __atomic_store_n(&event->routine, routine, __ATOMIC_RELAXED);
+    __atomic_store_n(&event->scheduler, scheduler, __ATOMIC_RELAXED);
+    __atomic_store_n(&thread->num_events, num_events + 1, __ATOMIC_RELEASE);
+}
+
+size_t llcm_trace_copy_events_(struct llcm_trace_thread_ const *thread,
+                               struct llcm_trace_event *events, size_t max_events) {
+    uint64_t const end = __atomic_load_n(&thread->num_events, __ATOMIC_ACQUIRE);
+    uint64_t begin = end > LLCM_TRACE_RING_SIZE ? end - LLCM_TRACE_RING_SIZE : 0;
+    if (end - begin > max_events) {
+        begin = end - max_events;
+    }
+    for (uint64_t i = begin; i < end; i++) {
+        struct llcm_trace_event const *event = &thread->events[i & (LLCM_TRACE_RING_SIZE - 1)];
+        events[i - begin] = (struct llcm_trace_event){
+            .tsc = __atomic_load_n(&event->tsc, __ATOMIC_RELAXED),
+            .type = __atomic_load_n(&event->type, __ATOMIC_RELAXED),
+            .routine = __atomic_load_n(&event->routine, __ATOMIC_RELAXED),
+            .scheduler = __atomic_load_n(&event->scheduler, __ATOMIC_RELAXED)};
+    }
+    // the owner kept writing while this copied, drop every slot it may have reused including the
+    // one it may be writing right now
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint64_t const new_end = __atomic_load_n(&thread->num_events, __ATOMIC_RELAXED) + 1;
+    uint64_t const first_valid =
+        new_end > LLCM_TRACE_RING_SIZE ? new_end - LLCM_TRACE_RING_SIZE : 0;
+    if (first_valid <= begin) {
+        return end - begin;
+    }
+    if (first_valid >= end) {
+        return 0;
+    }
+    memmove(events, events + (first_valid - begin),
+            (end - first_valid) * sizeof(struct llcm_trace_event));
+    return end - first_valid;
+}
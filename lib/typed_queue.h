@@ -0,0 +1,134 @@
+#pragma once
+
+#include "lib/concurrent_queue.h"
+#include "lib/utils.h"
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* public */
+
+// LLCM_DEFINE_QUEUE(name, T, CAPACITY) generates struct name, a llcm_concurrent_queue specialized
+// for values of type T and a compile time capacity, which must be a power of two and at least 2.
+// values are copied into and out of their slot instead of being passed by pointer, and the slots
+// live inside the struct, so the mask folds into a constant and no operation loads an array
+// pointer. every slot is padded to a cache line anyway, a T of up to
+// LLCM_TYPED_QUEUE_MAX_INLINE_SIZE bytes fills its spare bytes for free.
+//
+// the generated functions mirror the llcm_concurrent_queue ones:
+//   void name_init(struct name *);
+//   void name_uninit(struct name *);
+//   size_t name_get_capacity(struct name const *);
+//   size_t name_get_size(struct name const *);
+//   bool name_try_reserve_size_before_push(struct name *, size_t num_new_entries);
+//   void name_unreserve_size_after_pop(struct name *, size_t num_old_entries);
+//   void name_push(struct name *, T const *value);
+//   bool name_try_pop(struct name *, T *value);
+//   void name_push_n(struct name *, T const *values, size_t num_values);
+//   size_t name_try_pop_n(struct name *, T *values, size_t max_values);
+//
+// the struct is CAPACITY cache lines large, allocate it with llcm_allocator_allocate and
+// alignof(struct name) rather than on the stack
+#define LLCM_DEFINE_QUEUE(name, T, CAPACITY) LLCM_DEFINE_QUEUE_WITH_FLAGS(name, T, CAPACITY, 0u)
+
+// the same with LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER and LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER
+// known at compile time, so the unused paths compile away. the compact layout does not apply,
+// inline values need the padding
+#define LLCM_DEFINE_QUEUE_WITH_FLAGS(name, T, CAPACITY, FLAGS)                                     \
+    LLCM_DEFINE_QUEUE_TYPES_(name, T, CAPACITY, FLAGS)                                             \
+    LLCM_DEFINE_QUEUE_FUNCTIONS_(name, T, CAPACITY, FLAGS)
+
+#define LLCM_TYPED_QUEUE_MAX_INLINE_SIZE                                                           \
+    (LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE - sizeof(uint64_t))
+
+/* private */
+
+// the slot follows struct llcm_concurrent_queue_entry, the counters are the same ring
+#define LLCM_DEFINE_QUEUE_TYPES_(name, T, CAPACITY, FLAGS)                                         \
+    static_assert((CAPACITY) >= 2 && 0 == ((CAPACITY) & ((CAPACITY) - 1)),                         \
+                  #name " capacity must be a power of two and at least 2");                        \
+    static_assert(0 == ((FLAGS) & LLCM_CONCURRENT_QUEUE_COMPACT_LAYOUT),                           \
+                  #name " can not use the compact layout");                                        \
+                                                                                                   \
+    struct name##_entry_ {                                                                         \
+        alignas(LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE) _Atomic uint64_t aba_counter;               \
+        T value;                                                                                   \
+    };                                                                                             \
+                                                                                                   \
+    struct name {                                                                                  \
+        struct llcm_concurrent_queue_counters_ counters_;                                          \
+        struct name##_entry_ entries_[CAPACITY];                                                   \
+    };
+
+#define LLCM_DEFINE_QUEUE_FUNCTIONS_(name, T, CAPACITY, FLAGS)                                     \
+    void name##_write_entry_(struct name *queue, uint64_t write_counter, T const *value) {         \
+        struct name##_entry_ *entry = &queue->entries_[write_counter & ((CAPACITY) - 1)];          \
+        llcm_concurrent_queue_wait_to_write_(&entry->aba_counter, write_counter);                  \
+        entry->value = *value;                                                                     \
+        llcm_concurrent_queue_publish_write_(&entry->aba_counter, write_counter);                  \
+    }                                                                                              \
+                                                                                                   \
+    void name##_read_entry_(struct name *queue, uint64_t read_counter, T *value) {                 \
+        struct name##_entry_ *entry = &queue->entries_[read_counter & ((CAPACITY) - 1)];           \
+        llcm_concurrent_queue_wait_to_read_(&entry->aba_counter, read_counter);                    \
+        *value = entry->value;                                                                     \
+        llcm_concurrent_queue_publish_read_(&entry->aba_counter, read_counter, (CAPACITY));        \
+    }                                                                                              \
+                                                                                                   \
+    void name##_init(struct name *queue) {                                                         \
+        for (uint64_t i = 0; i < (CAPACITY); i++) {                                                \
+            atomic_init(&queue->entries_[i].aba_counter, i);                                       \
+        }                                                                                          \
+        llcm_concurrent_queue_counters_init_(&queue->counters_);                                   \
+    }                                                                                              \
+                                                                                                   \
+    void name##_uninit(struct name *queue) {}                                                      \
+                                                                                                   \
+    size_t name##_get_capacity(struct name const *queue) {                                         \
+        return (CAPACITY);                                                                         \
+    }                                                                                              \
+                                                                                                   \
+    size_t name##_get_size(struct name const *queue) {                                             \
+        return llcm_concurrent_queue_counters_get_size_(&queue->counters_);                        \
+    }                                                                                              \
+                                                                                                   \
+    bool name##_try_reserve_size_before_push(struct name *queue, size_t num_new_entries) {         \
+        return llcm_concurrent_queue_counters_try_reserve_(&queue->counters_, (CAPACITY),          \
+                                                           num_new_entries);                       \
+    }                                                                                              \
+                                                                                                   \
+    void name##_unreserve_size_after_pop(struct name *queue, size_t num_old_entries) {             \
+        llcm_concurrent_queue_counters_unreserve_(&queue->counters_, num_old_entries);             \
+    }                                                                                              \
+                                                                                                   \
+    void name##_push_n(struct name *queue, T const *values, size_t num_values) {                   \
+        bool const single_producer = (FLAGS) & LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER;              \
+        uint64_t const write_counter = llcm_concurrent_queue_counters_begin_push_(                 \
+            &queue->counters_, num_values, single_producer);                                       \
+        for (size_t i = 0; i < num_values; i++) {                                                  \
+            name##_write_entry_(queue, write_counter + i, &values[i]);                             \
+        }                                                                                          \
+        llcm_concurrent_queue_counters_end_push_(&queue->counters_, write_counter, num_values,     \
+                                                 single_producer);                                 \
+    }                                                                                              \
+                                                                                                   \
+    void name##_push(struct name *queue, T const *value) { name##_push_n(queue, value, 1); }       \
+                                                                                                   \
+    size_t name##_try_pop_n(struct name *queue, T *values, size_t max_values) {                    \
+        uint64_t read_counter;                                                                     \
+        size_t const num_values = llcm_concurrent_queue_counters_claim_pop_(                       \
+            &queue->counters_, max_values, (FLAGS) & LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER,        \
+            &read_counter);                                                                        \
+        for (size_t i = 0; i < num_values; i++) {                                                  \
+            name##_read_entry_(queue, read_counter + i, &values[i]);                               \
+        }                                                                                          \
+        return num_values;                                                                         \
+    }                                                                                              \
+                                                                                                   \
+    bool name##_try_pop(struct name *queue, T *value) {                                            \
+        return 1 == name##_try_pop_n(queue, value, 1);                                             \
+    }
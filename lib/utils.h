@@ -1,8 +1,97 @@
 #pragma once
 
+// the headers use glibc extensions such as syscall and pthread_setaffinity_np, so _GNU_SOURCE
+// must be defined before the first system header is included, e.g. with -D_GNU_SOURCE
+#ifndef _GNU_SOURCE
+#error "llcm needs _GNU_SOURCE defined before any system header is included"
+#endif
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <time.h>
 
 /* public */
 
-uint64_t llcm_round_up_pow2(uint64_t x) { return x == 1 ? 1 : 1 << (64 - __builtin_clzl(x - 1)); }
\ No newline at end of file
+uint64_t llcm_round_up_pow2(uint64_t x) { return x == 1 ? 1 : 1 << (64 - __builtin_clzl(x - 1)); }
+
+uint64_t llcm_rdtsc(void);
+// spin loop hint, lets the sibling hyperthread run and avoids memory order mis-speculation
+void llcm_cpu_relax(void);
+// measures the tsc against CLOCK_MONOTONIC, busy waiting for about 10ms. the scheduler init
+// calls it, so no hot path pays for it, later calls return right away
+void llcm_tsc_calibrate(void);
+// calibrates on first use if llcm_tsc_calibrate was never called
+double llcm_tsc_ticks_per_nano(void);
+uint64_t llcm_nanos_to_tsc_ticks(uint64_t nanos);
+uint64_t llcm_tsc_ticks_to_nanos(uint64_t tsc_ticks);
+
+// pins the calling thread to cpu, returns false if the cpu is out of range or not allowed
+bool llcm_thread_set_affinity(int cpu);
+// runs the calling thread under SCHED_FIFO at the highest priority, usually needs privileges
+bool llcm_thread_set_realtime_priority(void);
+
+/* private */
+
+#define LLCM_TSC_CALIBRATION_NANOS 10000000
+
+double llcm_tsc_ticks_per_nano_ = 0;
+
+uint64_t llcm_timespec_to_nanos_(struct timespec const *ts) {
+    return (uint64_t) ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+uint64_t llcm_rdtsc(void) {
+    unsigned int lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t) hi << 32) | lo;
+}
+
+void llcm_cpu_relax(void) { __asm__ __volatile__("pause" ::: "memory"); }
+
+void llcm_tsc_calibrate(void) { llcm_tsc_ticks_per_nano(); }
+
+double llcm_tsc_ticks_per_nano(void) {
+    double ticks_per_nano;
+    __atomic_load(&llcm_tsc_ticks_per_nano_, &ticks_per_nano, __ATOMIC_RELAXED);
+    if (0 != ticks_per_nano) {
+        return ticks_per_nano;
+    }
+    // racing calibrations all produce a usable value, the last one wins. the monotonic clock is
+    // never stepped, so the elapsed time can not wrap
+    struct timespec ts_start;
+    struct timespec ts_now;
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    uint64_t const tsc_start = llcm_rdtsc();
+    uint64_t elapsed_nanos = 0;
+    while (elapsed_nanos < LLCM_TSC_CALIBRATION_NANOS) {
+        clock_gettime(CLOCK_MONOTONIC, &ts_now);
+        elapsed_nanos = llcm_timespec_to_nanos_(&ts_now) - llcm_timespec_to_nanos_(&ts_start);
+    }
+    ticks_per_nano = (double) (llcm_rdtsc() - tsc_start) / elapsed_nanos;
+    __atomic_store(&llcm_tsc_ticks_per_nano_, &ticks_per_nano, __ATOMIC_RELAXED);
+    return ticks_per_nano;
+}
+
+uint64_t llcm_nanos_to_tsc_ticks(uint64_t nanos) { return nanos * llcm_tsc_ticks_per_nano(); }
+
+uint64_t llcm_tsc_ticks_to_nanos(uint64_t tsc_ticks) {
+    return tsc_ticks / llcm_tsc_ticks_per_nano();
+}
+
+bool llcm_thread_set_affinity(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    return 0 == pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+}
+
+bool llcm_thread_set_realtime_priority(void) {
+    struct sched_param param = {.sched_priority = sched_get_priority_max(SCHED_FIFO)};
+    return 0 == pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "lib/utils.h"
+
+#include <linux/futex.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/* public */
+
+// how a poller backs off after consecutive empty polls
+struct llcm_wait_strategy {
+    // empty polls that spin with a pause hint
+    uint32_t num_spins;
+    // empty polls after the spins that yield the cpu
+    uint32_t num_yields;
+    // afterwards park on a futex for at most this long, 0 keeps yielding instead
+    uint64_t max_park_nanos;
+};
+
+// per poller state, not shared between threads
+struct llcm_waiter {
+    struct llcm_wait_strategy strategy;
+    uint32_t num_empty_polls;
+};
+
+struct llcm_wait_strategy llcm_wait_strategy_create_default(void);
+void llcm_waiter_init(struct llcm_waiter *, struct llcm_wait_strategy);
+
+/* private */
+
+enum llcm_waiter_action_ {
+    LLCM_WAITER_ACTION_SPIN_,
+    LLCM_WAITER_ACTION_YIELD_,
+    LLCM_WAITER_ACTION_PARK_,
+};
+
+enum llcm_waiter_action_ llcm_waiter_on_empty_poll_(struct llcm_waiter *);
+void llcm_waiter_on_productive_poll_(struct llcm_waiter *);
+
+long llcm_futex_(uint32_t *address, int op, uint32_t value, struct timespec const *timeout);
+void llcm_futex_wait_(uint32_t *address, uint32_t expected_value, uint64_t timeout_nanos);
+void llcm_futex_wake_one_(uint32_t *address);
+
+struct llcm_wait_strategy llcm_wait_strategy_create_default(void) {
+    return (struct llcm_wait_strategy){
+        .num_spins = 1024, .num_yields = 64, .max_park_nanos = 1000000};
+}
+
+void llcm_waiter_init(struct llcm_waiter *waiter, struct llcm_wait_strategy strategy) {
+    waiter->strategy = strategy;
+    waiter->num_empty_polls = 0;
+}
+
+enum llcm_waiter_action_ llcm_waiter_on_empty_poll_(struct llcm_waiter *waiter) {
+    uint32_t const num_empty_polls = waiter->num_empty_polls;
+    if (num_empty_polls < waiter->strategy.num_spins) {
+        waiter->num_empty_polls++;
+        return LLCM_WAITER_ACTION_SPIN_;
+    }
+    if (num_empty_polls - waiter->strategy.num_spins < waiter->strategy.num_yields ||
+        0 == waiter->strategy.max_park_nanos) {
+        waiter->num_empty_polls++;
+        return LLCM_WAITER_ACTION_YIELD_;
+    }
+    // stays saturated so an idle poller parks again right after a timeout
+    return LLCM_WAITER_ACTION_PARK_;
+}
+
+void llcm_waiter_on_productive_poll_(struct llcm_waiter *waiter) { waiter->num_empty_polls = 0; }
+
+long llcm_futex_(uint32_t *address, int op, uint32_t value, struct timespec const *timeout) {
+    // glibc has no futex wrapper
+    return syscall(SYS_futex, address, op, value, timeout, NULL, 0);
+}
+
+void llcm_futex_wait_(uint32_t *address, uint32_t expected_value, uint64_t timeout_nanos) {
+    struct timespec const timeout = {.tv_sec = timeout_nanos / 1000000000,
+                                     .tv_nsec = timeout_nanos % 1000000000};
+    llcm_futex_(address, FUTEX_WAIT_PRIVATE, expected_value, &timeout);
+}
+
+void llcm_futex_wake_one_(uint32_t *address) {
+    llcm_futex_(address, FUTEX_WAKE_PRIVATE, 1, NULL);
+}
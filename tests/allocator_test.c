@@ -0,0 +1,102 @@
+#define _GNU_SOURCE
+
+#include "lib/allocator.h"
+#include "lib/scheduler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void check_allocator(struct llcm_allocator allocator, size_t alignment, size_t size) {
+    char *pointer = llcm_allocator_allocate(allocator, alignment, size);
+    assert(NULL != pointer);
+    assert(0 == (size_t) pointer % alignment);
+    memset(pointer, 0xab, size);
+    llcm_allocator_free(allocator, pointer, size);
+}
+
+void allocators_test() {
+    size_t const sizes[] = {24, 4096, LLCM_ALLOCATOR_HUGEPAGE_SIZE + 64};
+    for (size_t i = 0; i < 3; i++) {
+        check_allocator(llcm_allocator_create_default(), 64, sizes[i]);
+        check_allocator(llcm_allocator_create_hugepage(), 64, sizes[i]);
+        check_allocator(llcm_allocator_create_numa(LLCM_ALLOCATOR_NUMA_NODE_LOCAL), 64, sizes[i]);
+        check_allocator(llcm_allocator_create_numa(0), 64, sizes[i]);
+    }
+    // the policy really is set where the kernel supports mempolicies
+    int mode = -1;
+    unsigned long node_mask = 0;
+    char *numa_pointer = llcm_allocator_allocate(llcm_allocator_create_numa(0), 64, 4096);
+    if (0 == syscall(SYS_get_mempolicy, &mode, &node_mask, LLCM_ALLOCATOR_NUMA_MAX_NODES + 1,
+                     numa_pointer, MPOL_F_ADDR)) {
+        assert(MPOL_PREFERRED == mode && 1 == node_mask);
+    }
+    llcm_allocator_free(llcm_allocator_create_numa(0), numa_pointer, 4096);
+    // large hugepage allocations start on a huge page boundary whichever way they were mapped
+    void *pointer = llcm_allocator_allocate(llcm_allocator_create_hugepage(), 64,
+                                            LLCM_ALLOCATOR_HUGEPAGE_SIZE);
+    assert(0 == (size_t) pointer % LLCM_ALLOCATOR_HUGEPAGE_SIZE);
+    llcm_allocator_free(llcm_allocator_create_hugepage(), pointer, LLCM_ALLOCATOR_HUGEPAGE_SIZE);
+    printf("PASSED allocators_test\n");
+}
+
+void arena_test() {
+    struct llcm_arena arena;
+    assert(llcm_arena_init(&arena, 1024, llcm_allocator_create_default()));
+    struct llcm_allocator allocator = llcm_allocator_create_arena(&arena);
+
+    char *first = llcm_allocator_allocate(allocator, 1, 3);
+    char *second = llcm_allocator_allocate(allocator, 64, 64);
+    assert(first == arena.base);
+    assert(0 == (size_t) second % 64 && second > first);
+    assert(second + 64 == arena.base + llcm_arena_get_used_size(&arena));
+    // exhausted arenas fail instead of growing, and free gives nothing back
+    assert(NULL == llcm_allocator_allocate(allocator, 1, 1024));
+    llcm_allocator_free(allocator, second, 64);
+    assert(second + 64 == arena.base + llcm_arena_get_used_size(&arena));
+
+    llcm_arena_reset(&arena);
+    assert(0 == llcm_arena_get_used_size(&arena));
+    assert(first == llcm_allocator_allocate(allocator, 1, 1024));
+    llcm_arena_uninit(&arena);
+    printf("PASSED arena_test\n");
+}
+
+void *counting_allocate(void *context, size_t alignment, size_t size) {
+    size_t *num_allocated_bytes = context;
+    *num_allocated_bytes += size;
+    return llcm_allocator_default_allocate_(NULL, alignment, size);
+}
+
+void counting_free(void *context, void *pointer, size_t size) {
+    size_t *num_allocated_bytes = context;
+    *num_allocated_bytes -= size;
+    free(pointer);
+}
+
+void stateful_allocator_test() {
+    // a scheduler hands every allocation back with its context and size
+    size_t num_allocated_bytes = 0;
+    struct llcm_allocator allocator = {
+        .allocate = counting_allocate, .free = counting_free, .context = &num_allocated_bytes};
+    struct llcm_scheduler_config config = llcm_scheduler_config_create_default(64);
+    config.num_lanes = 2;
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init_with_config(&scheduler, config, allocator);
+    assert(2 * 64 * LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE == num_allocated_bytes);
+    llcm_scheduler_uninit(&scheduler);
+    assert(0 == num_allocated_bytes);
+
+    struct llcm_arena arena;
+    assert(llcm_arena_init(&arena, 1 << 16, llcm_allocator_create_default()));
+    llcm_scheduler_init_with_config(&scheduler, config, llcm_allocator_create_arena(&arena));
+    assert(2 * 64 * LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE == llcm_arena_get_used_size(&arena));
+    llcm_scheduler_uninit(&scheduler);
+    llcm_arena_uninit(&arena);
+    printf("PASSED stateful_allocator_test\n");
+}
+
+int main() {
+    allocators_test();
+    arena_test();
+    stateful_allocator_test();
+}
@@ -0,0 +1,156 @@
+#define _GNU_SOURCE
+
+#include "lib/balancer.h"
+#include "lib/executor.h"
+#include "lib/scheduler.h"
+
+#include <stdio.h>
+
+struct spinning_state {
+    uint64_t num_polls;
+    uint64_t max_polls;
+    uint64_t spin_tsc_ticks;
+};
+
+void spinning_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct spinning_state *state = arg0;
+    uint64_t const start_tsc = llcm_rdtsc();
+    while (llcm_rdtsc() - start_tsc < state->spin_tsc_ticks) {
+    }
+    if (++state->num_polls == state->max_polls) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+#define NUM_ROUTINES 16
+
+void schedule_all(struct llcm_scheduler *scheduler, struct spinning_state *states,
+                  struct llcm_routine *routines, uint64_t spin_nanos) {
+    for (size_t i = 0; i < NUM_ROUTINES; i++) {
+        states[i] = (struct spinning_state){.spin_tsc_ticks = llcm_nanos_to_tsc_ticks(spin_nanos)};
+        llcm_routine_init(&routines[i], spinning_poll, &states[i]);
+        assert(llcm_scheduler_try_schedule_routine(scheduler, &routines[i]));
+    }
+}
+
+void hysteresis_test() {
+    struct llcm_scheduler schedulers[2];
+    llcm_scheduler_init(&schedulers[0], NUM_ROUTINES);
+    llcm_scheduler_init(&schedulers[1], NUM_ROUTINES);
+    struct llcm_balancer_config config = llcm_balancer_config_create_default();
+    // sample on every requeue and balance on queue depth alone
+    config.interval_nanos = 0;
+    config.high_watermark = 4;
+    config.low_watermark = 1;
+    config.min_busy_fraction = 0;
+    struct llcm_balancer balancer;
+    llcm_balancer_init(&balancer, schedulers, 2, config);
+    struct spinning_state states[NUM_ROUTINES];
+    struct llcm_routine routines[NUM_ROUTINES];
+    schedule_all(&schedulers[0], states, routines, 0);
+
+    // only the overloaded scheduler is polled, it sheds until the gap is down to the low
+    // watermark, well past the high watermark it started at
+    for (size_t i = 0; i < NUM_ROUTINES; i++) {
+        assert(llcm_scheduler_poll(&schedulers[0], NULL));
+    }
+    uint64_t const num_migrations = llcm_balancer_get_num_migrations(&balancer);
+    size_t const num_first = llcm_scheduler_get_num_routines(&schedulers[0]);
+    size_t const num_second = llcm_scheduler_get_num_routines(&schedulers[1]);
+    assert(NUM_ROUTINES == num_first + num_second);
+    assert(num_migrations == num_second);
+    assert(num_first - num_second <= 2);
+    assert(!llcm_balancer_is_shedding(&balancer, 0));
+
+    // a gap below the high watermark moves nothing, in either direction
+    for (size_t i = 0; i < 4 * NUM_ROUTINES; i++) {
+        assert(llcm_scheduler_poll(&schedulers[i % 3 == 0], NULL));
+    }
+    assert(num_migrations == llcm_balancer_get_num_migrations(&balancer));
+
+    llcm_balancer_uninit(&balancer);
+    assert(NULL == schedulers[0].balancer);
+    llcm_scheduler_uninit(&schedulers[0]);
+    llcm_scheduler_uninit(&schedulers[1]);
+    printf("PASSED hysteresis_test\n");
+}
+
+void busy_fraction_test() {
+    struct llcm_balancer_config config = llcm_balancer_config_create_default();
+    config.interval_nanos = 1000000;
+    config.high_watermark = 4;
+    config.low_watermark = 1;
+    for (int busy = 0; busy < 2; busy++) {
+        struct llcm_scheduler schedulers[2];
+        llcm_scheduler_init(&schedulers[0], NUM_ROUTINES);
+        llcm_scheduler_init(&schedulers[1], NUM_ROUTINES);
+        struct llcm_balancer balancer;
+        llcm_balancer_init(&balancer, schedulers, 2, config);
+        struct spinning_state states[NUM_ROUTINES];
+        struct llcm_routine routines[NUM_ROUTINES];
+        // the same deep queue, but only a scheduler that spends its time polling sheds
+        schedule_all(&schedulers[0], states, routines, busy ? 20000 : 0);
+        uint64_t const idle_tsc_ticks = llcm_nanos_to_tsc_ticks(busy ? 0 : 50000);
+        uint64_t const end_tsc = llcm_rdtsc() + llcm_nanos_to_tsc_ticks(5000000);
+        while (llcm_rdtsc() < end_tsc) {
+            assert(llcm_scheduler_poll(&schedulers[0], NULL));
+            uint64_t const idle_start_tsc = llcm_rdtsc();
+            while (llcm_rdtsc() - idle_start_tsc < idle_tsc_ticks) {
+            }
+        }
+        if (busy) {
+            assert(llcm_balancer_get_num_migrations(&balancer) > 0);
+            assert(llcm_balancer_get_busy_fraction(&balancer, 0) >= 0.5);
+        } else {
+            assert(0 == llcm_balancer_get_num_migrations(&balancer));
+            assert(llcm_balancer_get_busy_fraction(&balancer, 0) < 0.5);
+        }
+        llcm_balancer_uninit(&balancer);
+        llcm_scheduler_uninit(&schedulers[0]);
+        llcm_scheduler_uninit(&schedulers[1]);
+    }
+    printf("PASSED busy_fraction_test\n");
+}
+
+#define EXECUTOR_TEST_NUM_ROUTINES 64
+
+void executor_test() {
+    // without stealing only the balancer moves routines off the first worker
+    struct llcm_executor_config config =
+        llcm_executor_config_create_default(2, EXECUTOR_TEST_NUM_ROUTINES);
+    config.steal = false;
+    struct llcm_executor executor;
+    llcm_executor_init(&executor, config);
+    struct llcm_balancer balancer;
+    llcm_balancer_init(&balancer, executor.group.schedulers, 2,
+                       llcm_balancer_config_create_default());
+
+    struct spinning_state states[EXECUTOR_TEST_NUM_ROUTINES];
+    struct llcm_routine routines[EXECUTOR_TEST_NUM_ROUTINES];
+    for (size_t i = 0; i < EXECUTOR_TEST_NUM_ROUTINES; i++) {
+        states[i] = (struct spinning_state){.max_polls = 200,
+                                            .spin_tsc_ticks = llcm_nanos_to_tsc_ticks(2000)};
+        llcm_routine_init(&routines[i], spinning_poll, &states[i]);
+        assert(llcm_scheduler_try_schedule_routine(llcm_executor_get_scheduler(&executor, 0),
+                                                   &routines[i]));
+    }
+    assert(llcm_executor_start(&executor));
+    llcm_executor_drain(&executor);
+    for (size_t i = 0; i < EXECUTOR_TEST_NUM_ROUTINES; i++) {
+        assert(200 == states[i].num_polls);
+    }
+    struct llcm_executor_worker_stats stats;
+    llcm_executor_get_worker_stats(&executor, 1, &stats);
+    assert(llcm_balancer_get_num_migrations(&balancer) > 0);
+    assert(stats.num_polls > 0);
+
+    llcm_balancer_uninit(&balancer);
+    llcm_executor_uninit(&executor);
+    printf("PASSED executor_test\n");
+}
+
+int main() {
+    hysteresis_test();
+    busy_fraction_test();
+    executor_test();
+}
@@ -0,0 +1,218 @@
+#define _GNU_SOURCE
+
+#include "lib/channel.h"
+#include "lib/scheduler.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+struct sender_state {
+    struct llcm_channel *channel;
+    uint64_t num_polls;
+    uint64_t next_value;
+    uint64_t num_values;
+};
+
+void sender_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct sender_state *state = arg0;
+    state->num_polls++;
+    while (state->next_value <= state->num_values) {
+        if (!llcm_channel_send(state->channel, (void *) state->next_value, handle)) {
+            return;
+        }
+        state->next_value++;
+    }
+    llcm_exec_handle_cancel_routine(handle);
+}
+
+struct receiver_state {
+    struct llcm_channel *channel;
+    uint64_t num_polls;
+    uint64_t num_values;
+    uint64_t sum;
+};
+
+void receiver_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct receiver_state *state = arg0;
+    state->num_polls++;
+    void *value;
+    while (NULL != (value = llcm_channel_receive(state->channel, handle))) {
+        state->sum += (uint64_t) value;
+        if (0 == --state->num_values) {
+            llcm_exec_handle_cancel_routine(handle);
+            return;
+        }
+    }
+}
+
+void park_receiver_test() {
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 1);
+    struct llcm_channel channel;
+    llcm_channel_init(&channel, 4);
+    struct receiver_state state = {.channel = &channel, .num_values = 2};
+    struct llcm_routine routine = {.poll = receiver_poll, .arg0 = &state};
+    assert(llcm_scheduler_try_schedule_routine(&scheduler, &routine));
+
+    // parked on the empty channel instead of being re-polled
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(!llcm_scheduler_poll(&scheduler, NULL));
+    assert(1 == state.num_polls);
+    assert(0 == llcm_scheduler_get_num_queued_routines(&scheduler));
+
+    // the send that fills the empty channel puts it back on its scheduler
+    assert(llcm_channel_try_send(&channel, (void *) 5));
+    assert(1 == llcm_scheduler_get_num_queued_routines(&scheduler));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(2 == state.num_polls);
+    assert(5 == state.sum);
+    assert(!llcm_scheduler_poll(&scheduler, NULL));
+
+    assert(llcm_channel_try_send(&channel, (void *) 6));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(11 == state.sum);
+    assert(0 == scheduler.queues[0].counters.reserved_push_size);
+
+    llcm_channel_uninit(&channel);
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED park_receiver_test\n");
+}
+
+void park_sender_test() {
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 1);
+    struct llcm_channel channel;
+    llcm_channel_init(&channel, 2);
+    struct sender_state state = {.channel = &channel, .next_value = 1, .num_values = 3};
+    struct llcm_routine routine = {.poll = sender_poll, .arg0 = &state};
+    assert(llcm_scheduler_try_schedule_routine(&scheduler, &routine));
+
+    // parked on the full channel after two sends
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(!llcm_scheduler_poll(&scheduler, NULL));
+    assert(2 == llcm_channel_get_size(&channel));
+    assert(0 == llcm_scheduler_get_num_queued_routines(&scheduler));
+
+    // the receive that makes room wakes it
+    assert((void *) 1 == llcm_channel_try_receive(&channel));
+    assert(1 == llcm_scheduler_get_num_queued_routines(&scheduler));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(2 == state.num_polls);
+    assert(0 == scheduler.queues[0].counters.reserved_push_size);
+    assert((void *) 2 == llcm_channel_try_receive(&channel));
+    assert((void *) 3 == llcm_channel_try_receive(&channel));
+    assert(NULL == llcm_channel_try_receive(&channel));
+
+    llcm_channel_uninit(&channel);
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED park_sender_test\n");
+}
+
+void handoff_test() {
+    for (uint64_t run_next_limit = 0; run_next_limit < 2; run_next_limit++) {
+        struct llcm_scheduler_config config = llcm_scheduler_config_create_default(4);
+        config.run_next_limit = run_next_limit;
+        struct llcm_scheduler scheduler;
+        llcm_scheduler_init_with_config(&scheduler, config, llcm_allocator_create_default());
+        struct llcm_channel channel;
+        struct llcm_channel other_channel;
+        llcm_channel_init(&channel, 4);
+        llcm_channel_init(&other_channel, 4);
+        struct receiver_state receiver_state = {.channel = &channel, .num_values = 2};
+        struct sender_state sender_state = {.channel = &channel, .next_value = 1, .num_values = 1};
+        struct sender_state other_state = {
+            .channel = &other_channel, .next_value = 1, .num_values = 1};
+        struct llcm_routine receiver = {.poll = receiver_poll, .arg0 = &receiver_state};
+        struct llcm_routine sender = {.poll = sender_poll, .arg0 = &sender_state};
+        struct llcm_routine other = {.poll = sender_poll, .arg0 = &other_state};
+        assert(llcm_scheduler_try_schedule_routine(&scheduler, &receiver));
+        assert(llcm_scheduler_poll(&scheduler, NULL));
+        assert(llcm_scheduler_try_schedule_routine(&scheduler, &sender));
+        assert(llcm_scheduler_try_schedule_routine(&scheduler, &other));
+
+        // the receiver woken by the send runs in the same poll, ahead of the queued routine,
+        // unless the run next slot is disabled
+        assert(llcm_scheduler_poll(&scheduler, NULL));
+        assert(1 == sender_state.num_polls);
+        assert(run_next_limit + 1 == receiver_state.num_polls);
+        assert(0 == other_state.num_polls);
+        assert(llcm_scheduler_poll(&scheduler, NULL));
+        assert(1 == other_state.num_polls);
+        while (llcm_scheduler_poll(&scheduler, NULL)) {
+        }
+        assert(2 == receiver_state.num_polls);
+        assert(1 == receiver_state.sum);
+
+        // parked again on the drained channel
+        assert(1 == llcm_scheduler_get_num_routines(&scheduler));
+        assert(llcm_channel_try_send(&channel, (void *) 2));
+        assert(llcm_scheduler_poll(&scheduler, NULL));
+        assert(3 == receiver_state.sum);
+        assert(0 == llcm_scheduler_get_num_routines(&scheduler));
+
+        llcm_channel_uninit(&other_channel);
+        llcm_channel_uninit(&channel);
+        llcm_scheduler_uninit(&scheduler);
+    }
+    printf("PASSED handoff_test\n");
+}
+
+#define CROSS_THREAD_TEST_NUM_VALUES 100000
+
+struct poll_thread_args {
+    struct llcm_scheduler *scheduler;
+};
+
+void *poll_thread_exec(void *arg0) {
+    struct poll_thread_args *args = arg0;
+    while (0 != __atomic_load_n(&args->scheduler->queues[0].counters.reserved_push_size,
+                                __ATOMIC_ACQUIRE)) {
+        // a parked routine leaves nothing to poll, so let the other end run
+        if (!llcm_scheduler_poll(args->scheduler, NULL)) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+void cross_thread_test() {
+    // the sender and the receiver each live on their own scheduler and thread
+    struct llcm_scheduler sender_scheduler;
+    struct llcm_scheduler receiver_scheduler;
+    llcm_scheduler_init(&sender_scheduler, 1);
+    llcm_scheduler_init(&receiver_scheduler, 1);
+    struct llcm_channel channel;
+    llcm_channel_init(&channel, 8);
+    struct sender_state sender = {
+        .channel = &channel, .next_value = 1, .num_values = CROSS_THREAD_TEST_NUM_VALUES};
+    struct receiver_state receiver = {.channel = &channel,
+                                      .num_values = CROSS_THREAD_TEST_NUM_VALUES};
+    struct llcm_routine sender_routine = {.poll = sender_poll, .arg0 = &sender};
+    struct llcm_routine receiver_routine = {.poll = receiver_poll, .arg0 = &receiver};
+    assert(llcm_scheduler_try_schedule_routine(&sender_scheduler, &sender_routine));
+    assert(llcm_scheduler_try_schedule_routine(&receiver_scheduler, &receiver_routine));
+
+    struct poll_thread_args args = {.scheduler = &sender_scheduler};
+    pthread_t thread;
+    int rc = pthread_create(&thread, NULL, poll_thread_exec, &args);
+    assert(rc == 0);
+    struct poll_thread_args receiver_args = {.scheduler = &receiver_scheduler};
+    poll_thread_exec(&receiver_args);
+    pthread_join(thread, NULL);
+
+    uint64_t const n = CROSS_THREAD_TEST_NUM_VALUES;
+    assert(n * (n + 1) / 2 == receiver.sum);
+    assert(0 == llcm_channel_get_size(&channel));
+    llcm_channel_uninit(&channel);
+    llcm_scheduler_uninit(&sender_scheduler);
+    llcm_scheduler_uninit(&receiver_scheduler);
+    printf("PASSED cross_thread_test\n");
+}
+
+int main() {
+    park_receiver_test();
+    park_sender_test();
+    handoff_test();
+    cross_thread_test();
+}
@@ -0,0 +1,231 @@
+#define _GNU_SOURCE
+
+#include "lib/concurrent_queue.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STRESS_MAX_THREADS    8
+#define STRESS_NUM_VALUES     40000
+#define STRESS_MAX_BATCH_SIZE 8
+
+// every value pushed is a pointer to its record. the producer fills in payload right before the
+// push, so a consumer that reads a stale payload catches a missing release or acquire, also under
+// ThreadSanitizer. the ticks bracket the push and pop with a global clock, for the
+// linearizability check
+struct stress_record {
+    uint64_t payload;
+    uint64_t num_pops;
+    uint64_t push_start;
+    uint64_t push_end;
+    uint64_t pop_start;
+    uint64_t pop_end;
+};
+
+struct stress_test {
+    struct llcm_concurrent_queue queue;
+    size_t num_producers;
+    size_t num_consumers;
+    bool batches;
+    struct stress_record *records[STRESS_MAX_THREADS];
+    _Atomic uint64_t clock;
+    _Atomic uint64_t num_popped;
+};
+
+struct stress_thread {
+    struct stress_test *test;
+    size_t id;
+    uint64_t seed;
+};
+
+uint64_t stress_payload(size_t producer, uint64_t index) {
+    return ((uint64_t) producer << 32 | index) * 0x9e3779b97f4a7c15u;
+}
+
+uint64_t stress_random(uint64_t *seed) {
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    return *seed;
+}
+
+// seq_cst ticks, so an operation that took its end tick before another took its start tick
+// happened before it
+uint64_t stress_tick(struct stress_test *test) {
+    return atomic_fetch_add_explicit(&test->clock, 1, memory_order_seq_cst);
+}
+
+void *stress_produce(void *arg0) {
+    struct stress_thread *thread = arg0;
+    struct stress_test *test = thread->test;
+    struct stress_record *records = test->records[thread->id];
+    // a batch reservation larger than the ring never succeeds
+    size_t const capacity = llcm_concurrent_queue_get_capacity(&test->queue);
+    size_t const max_batch_size =
+        capacity < STRESS_MAX_BATCH_SIZE ? capacity : STRESS_MAX_BATCH_SIZE;
+    void *batch[STRESS_MAX_BATCH_SIZE];
+    for (uint64_t i = 0; i < STRESS_NUM_VALUES;) {
+        size_t batch_size = 1;
+        if (test->batches) {
+            batch_size = 1 + stress_random(&thread->seed) % max_batch_size;
+            if (batch_size > STRESS_NUM_VALUES - i) {
+                batch_size = STRESS_NUM_VALUES - i;
+            }
+        }
+        while (!llcm_concurrent_queue_try_reserve_size_before_push(&test->queue, batch_size)) {
+            sched_yield();
+        }
+        uint64_t const push_start = stress_tick(test);
+        for (size_t j = 0; j < batch_size; j++) {
+            records[i + j].payload = stress_payload(thread->id, i + j);
+            records[i + j].push_start = push_start;
+            batch[j] = &records[i + j];
+        }
+        if (1 == batch_size) {
+            llcm_concurrent_queue_push(&test->queue, batch[0]);
+        } else {
+            llcm_concurrent_queue_push_n(&test->queue, batch, batch_size);
+        }
+        uint64_t const push_end = stress_tick(test);
+        for (size_t j = 0; j < batch_size; j++) {
+            records[i + j].push_end = push_end;
+        }
+        i += batch_size;
+    }
+    return NULL;
+}
+
+void *stress_consume(void *arg0) {
+    struct stress_thread *thread = arg0;
+    struct stress_test *test = thread->test;
+    uint64_t const total = STRESS_NUM_VALUES * test->num_producers;
+    void *batch[STRESS_MAX_BATCH_SIZE];
+    while (atomic_load_explicit(&test->num_popped, memory_order_relaxed) < total) {
+        size_t num_values = 0;
+        uint64_t const pop_start = stress_tick(test);
+        if (test->batches && 0 == stress_random(&thread->seed) % 2) {
+            size_t const max_values = 1 + stress_random(&thread->seed) % STRESS_MAX_BATCH_SIZE;
+            num_values = llcm_concurrent_queue_try_pop_n(&test->queue, batch, max_values);
+        } else {
+            batch[0] = llcm_concurrent_queue_try_pop(&test->queue);
+            num_values = NULL != batch[0];
+        }
+        uint64_t const pop_end = stress_tick(test);
+        if (0 == num_values) {
+            sched_yield();
+            continue;
+        }
+        for (size_t j = 0; j < num_values; j++) {
+            struct stress_record *record = batch[j];
+            size_t const producer = (record - test->records[0]) / STRESS_NUM_VALUES;
+            assert(record->payload == stress_payload(producer, record - test->records[producer]));
+            record->num_pops++;
+            record->pop_start = pop_start;
+            record->pop_end = pop_end;
+        }
+        llcm_concurrent_queue_unreserve_size_after_pop(&test->queue, num_values);
+        atomic_fetch_add_explicit(&test->num_popped, num_values, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+int stress_compare_push_end(void const *lhs, void const *rhs) {
+    uint64_t const lhs_end = (*(struct stress_record *const *) lhs)->push_end;
+    uint64_t const rhs_end = (*(struct stress_record *const *) rhs)->push_end;
+    return lhs_end < rhs_end ? -1 : lhs_end > rhs_end;
+}
+
+// a fifo queue must pop x no later than y whenever x's push finished before y's push started,
+// so y's pop can not finish before x's pop started
+void stress_check_linearizable(struct stress_test *test) {
+    size_t const num_records = STRESS_NUM_VALUES * test->num_producers;
+    struct stress_record **sorted = malloc(num_records * sizeof(struct stress_record *));
+    uint64_t *max_pop_start = malloc(num_records * sizeof(uint64_t));
+    for (size_t i = 0; i < num_records; i++) {
+        sorted[i] = &test->records[0][i];
+    }
+    qsort(sorted, num_records, sizeof(struct stress_record *), stress_compare_push_end);
+    for (size_t i = 0; i < num_records; i++) {
+        uint64_t const pop_start = sorted[i]->pop_start;
+        max_pop_start[i] = 0 == i || pop_start > max_pop_start[i - 1] ? pop_start
+                                                                      : max_pop_start[i - 1];
+    }
+    for (size_t i = 0; i < num_records; i++) {
+        struct stress_record const *record = &test->records[0][i];
+        // the number of records whose push ended before this one's push started
+        size_t low = 0;
+        size_t high = num_records;
+        while (low < high) {
+            size_t const middle = low + (high - low) / 2;
+            if (sorted[middle]->push_end < record->push_start) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        assert(0 == low || max_pop_start[low - 1] < record->pop_end);
+    }
+    free(max_pop_start);
+    free(sorted);
+}
+
+void stress_test(char const *name, unsigned flags, size_t capacity, size_t num_producers,
+                 size_t num_consumers, bool batches) {
+    struct stress_test test = {
+        .num_producers = num_producers, .num_consumers = num_consumers, .batches = batches};
+    llcm_concurrent_queue_init_with_flags(&test.queue, capacity, flags,
+                                          llcm_allocator_create_default());
+    atomic_init(&test.clock, 1);
+    atomic_init(&test.num_popped, 0);
+    // one allocation, so a record's producer follows from its address
+    test.records[0] = calloc(STRESS_NUM_VALUES * num_producers, sizeof(struct stress_record));
+    for (size_t p = 1; p < num_producers; p++) {
+        test.records[p] = test.records[0] + p * STRESS_NUM_VALUES;
+    }
+
+    pthread_t threads[2 * STRESS_MAX_THREADS];
+    struct stress_thread args[2 * STRESS_MAX_THREADS];
+    size_t const num_threads = num_producers + num_consumers;
+    for (size_t t = 0; t < num_threads; t++) {
+        bool const producer = t < num_producers;
+        args[t] = (struct stress_thread){
+            .test = &test, .id = producer ? t : t - num_producers, .seed = 0x2545f4914f6cdd1du + t};
+        int rc = pthread_create(&threads[t], NULL, producer ? stress_produce : stress_consume,
+                                &args[t]);
+        assert(rc == 0);
+    }
+    for (size_t t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    // each value popped exactly once, by whichever consumer, and the queue is left empty
+    for (size_t i = 0; i < STRESS_NUM_VALUES * num_producers; i++) {
+        assert(1 == test.records[0][i].num_pops);
+    }
+    stress_check_linearizable(&test);
+    assert(NULL == llcm_concurrent_queue_try_pop(&test.queue));
+    assert(0 == llcm_concurrent_queue_get_size(&test.queue));
+    assert(0 == atomic_load(&test.queue.counters.reserved_push_size));
+    free(test.records[0]);
+    llcm_concurrent_queue_uninit(&test.queue);
+    printf("PASSED stress_test %s capacity(%lu) producers(%lu) consumers(%lu) batches(%d)\n", name,
+           capacity, num_producers, num_consumers, batches);
+}
+
+int main() {
+    unsigned const sp = LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER;
+    unsigned const sc = LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER;
+    unsigned const compact = LLCM_CONCURRENT_QUEUE_COMPACT_LAYOUT;
+    // small rings wrap constantly, so every slot's aba_counter is handed over many times
+    for (int batches = 0; batches < 2; batches++) {
+        stress_test("mpmc", 0, 4, 4, 4, batches);
+        stress_test("mpmc", 0, 64, 2, 3, batches);
+        stress_test("mpmc compact", compact, 8, 3, 3, batches);
+        stress_test("spsc", sp | sc, 4, 1, 1, batches);
+        stress_test("mpsc", sc, 8, 4, 1, batches);
+        stress_test("spmc", sp, 8, 1, 4, batches);
+        stress_test("spsc compact", sp | sc | compact, 16, 1, 1, batches);
+    }
+}
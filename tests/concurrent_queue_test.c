@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include "lib/concurrent_queue.h"
 
 #include <pthread.h>
@@ -52,6 +54,45 @@ void basic_queue_test() {
     printf("PASSED basic_queue_test\n");
 }
 
+void batch_queue_test() {
+    size_t const capacity = 16;
+    struct llcm_concurrent_queue queue;
+    llcm_concurrent_queue_init(&queue, capacity);
+    bool const reserve_result =
+        llcm_concurrent_queue_try_reserve_size_before_push(&queue, capacity);
+    assert(reserve_result);
+
+    // a batch reservation fails if it does not fit entirely
+    assert(!llcm_concurrent_queue_try_reserve_size_before_push(&queue, 1));
+    llcm_concurrent_queue_unreserve_size_after_pop(&queue, capacity / 2);
+    assert(!llcm_concurrent_queue_try_reserve_size_before_push(&queue, capacity));
+    assert(llcm_concurrent_queue_try_reserve_size_before_push(&queue, capacity / 2));
+
+    void *values[16];
+    for (uint64_t round = 0; round < 4; round++) {
+        for (uint64_t i = 0; i < capacity; i++) {
+            values[i] = (void *) (round * capacity + i + 1);
+        }
+        llcm_concurrent_queue_push_n(&queue, values, capacity / 2);
+        llcm_concurrent_queue_push_n(&queue, values + capacity / 2, capacity / 2);
+
+        // pops are capped by max_values and by the number of available entries
+        void *popped[16];
+        size_t num_popped = llcm_concurrent_queue_try_pop_n(&queue, popped, 3);
+        assert(3 == num_popped);
+        num_popped += llcm_concurrent_queue_try_pop_n(&queue, popped + 3, capacity);
+        assert(capacity == num_popped);
+        for (uint64_t i = 0; i < capacity; i++) {
+            assert(popped[i] == values[i]);
+        }
+        assert(0 == llcm_concurrent_queue_try_pop_n(&queue, popped, capacity));
+    }
+
+    llcm_concurrent_queue_unreserve_size_after_pop(&queue, capacity);
+    llcm_concurrent_queue_uninit(&queue);
+    printf("PASSED batch_queue_test\n");
+}
+
 #define MULTITHREADED_TEST_NUM_THREADS  32
 #define MULTITHREADED_TEST_MAX_SEQUENCE 1024
 
@@ -118,7 +159,140 @@ void multithreaded_test() {
     printf("PASSED multithreaded_test\n");
 }
 
+#define VARIANT_TEST_MAX_THREADS  4
+#define VARIANT_TEST_NUM_ELEMENTS 1024
+#define VARIANT_TEST_CAPACITY     64
+
+struct variant_test_args {
+    struct llcm_concurrent_queue *queue;
+    uint64_t producer_id;
+    uint64_t num_elements;
+    uint64_t *num_observations;
+    bool check_order;
+};
+
+// elements are (producer_id << 32 | sequence_number), sequence numbers start at 1
+void *variant_test_produce(void *arg0) {
+    struct variant_test_args *args = arg0;
+    for (uint64_t sequence_number = 1; sequence_number <= args->num_elements; sequence_number++) {
+        while (!llcm_concurrent_queue_try_reserve_size_before_push(args->queue, 1)) {
+        }
+        uint64_t const element = args->producer_id << 32 | sequence_number;
+        llcm_concurrent_queue_push(args->queue, (void *) element);
+    }
+    return NULL;
+}
+
+void *variant_test_consume(void *arg0) {
+    struct variant_test_args *args = arg0;
+    uint64_t last_sequence_numbers[VARIANT_TEST_MAX_THREADS] = {0};
+    for (uint64_t i = 0; i < args->num_elements; i++) {
+        void *pop_result = NULL;
+        while (NULL == pop_result) {
+            pop_result = llcm_concurrent_queue_try_pop(args->queue);
+        }
+        llcm_concurrent_queue_unreserve_size_after_pop(args->queue, 1);
+        uint64_t const producer_id = (uint64_t) pop_result >> 32;
+        uint64_t const sequence_number = (uint64_t) pop_result & 0xffffffff;
+        // a single consumer observes each producer's elements in order
+        assert(!args->check_order || last_sequence_numbers[producer_id] + 1 == sequence_number);
+        last_sequence_numbers[producer_id] = sequence_number;
+        __atomic_fetch_add(&args->num_observations[producer_id * VARIANT_TEST_NUM_ELEMENTS +
+                                                   sequence_number - 1],
+                           1, __ATOMIC_SEQ_CST);
+    }
+    return NULL;
+}
+
+void variant_test(unsigned flags, size_t num_producers, size_t num_consumers) {
+    struct llcm_concurrent_queue queue;
+    llcm_concurrent_queue_init_with_flags(&queue, VARIANT_TEST_CAPACITY, flags,
+                                          llcm_allocator_create_default());
+    uint64_t *num_observations =
+        calloc(VARIANT_TEST_MAX_THREADS * VARIANT_TEST_NUM_ELEMENTS, sizeof(uint64_t));
+    uint64_t const num_elements = VARIANT_TEST_NUM_ELEMENTS * num_producers;
+
+    pthread_t threads[VARIANT_TEST_MAX_THREADS * 2];
+    struct variant_test_args args[VARIANT_TEST_MAX_THREADS * 2];
+    for (size_t tid = 0; tid < num_producers + num_consumers; tid++) {
+        bool const is_producer = tid < num_producers;
+        args[tid] = (struct variant_test_args){
+            .queue = &queue,
+            .producer_id = tid,
+            .num_elements = is_producer ? VARIANT_TEST_NUM_ELEMENTS : num_elements / num_consumers,
+            .num_observations = num_observations,
+            .check_order = 1 == num_consumers,
+        };
+        int rc = pthread_create(&threads[tid], NULL,
+                                is_producer ? variant_test_produce : variant_test_consume,
+                                &args[tid]);
+        assert(rc == 0);
+    }
+    for (size_t tid = 0; tid < num_producers + num_consumers; tid++) {
+        pthread_join(threads[tid], NULL);
+    }
+
+    assert(NULL == llcm_concurrent_queue_try_pop(&queue));
+    for (size_t i = 0; i < num_producers * VARIANT_TEST_NUM_ELEMENTS; i++) {
+        assert(1 == num_observations[i]);
+    }
+    free(num_observations);
+    llcm_concurrent_queue_uninit(&queue);
+    printf("PASSED variant_test flags(%u) producers(%lu) consumers(%lu)\n", flags, num_producers,
+           num_consumers);
+}
+
+void compact_layout_test() {
+    for (size_t capacity = 2; capacity <= 64; capacity *= 2) {
+        struct llcm_concurrent_queue queue;
+        llcm_concurrent_queue_init_with_flags(&queue, capacity,
+                                              LLCM_CONCURRENT_QUEUE_COMPACT_LAYOUT,
+                                              llcm_allocator_create_default());
+        assert(capacity == llcm_concurrent_queue_get_capacity(&queue));
+
+        // every slot is used exactly once, and consecutive slots avoid sharing a line
+        // whenever the queue spans more than one line
+        size_t const num_lines = capacity * 16 / LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE;
+        for (uint64_t i = 0; i < capacity; i++) {
+            char *entry = (char *) llcm_concurrent_queue_get_entry_(&queue, i);
+            assert(entry >= (char *) queue.array && entry < (char *) queue.array + capacity * 16);
+            for (uint64_t j = 0; j < i; j++) {
+                assert(entry != (char *) llcm_concurrent_queue_get_entry_(&queue, j));
+            }
+            if (i > 0 && num_lines > 1) {
+                char *previous = (char *) llcm_concurrent_queue_get_entry_(&queue, i - 1);
+                assert((entry - (char *) queue.array) / LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE !=
+                       (previous - (char *) queue.array) / LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE);
+            }
+        }
+
+        assert(llcm_concurrent_queue_try_reserve_size_before_push(&queue, capacity));
+        for (uint64_t round = 0; round < 3; round++) {
+            for (uint64_t i = 1; i <= capacity; i++) {
+                llcm_concurrent_queue_push(&queue, (void *) i);
+            }
+            for (uint64_t i = 1; i <= capacity; i++) {
+                assert((uint64_t) llcm_concurrent_queue_try_pop(&queue) == i);
+            }
+        }
+        llcm_concurrent_queue_unreserve_size_after_pop(&queue, capacity);
+        llcm_concurrent_queue_uninit(&queue);
+    }
+    printf("PASSED compact_layout_test\n");
+}
+
 int main() {
     basic_queue_test();
+    batch_queue_test();
     multithreaded_test();
+    variant_test(LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER | LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER, 1,
+                 1);
+    variant_test(LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER, 4, 1);
+    variant_test(LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER, 1, 4);
+    variant_test(0, 4, 4);
+    variant_test(LLCM_CONCURRENT_QUEUE_COMPACT_LAYOUT, 4, 4);
+    variant_test(LLCM_CONCURRENT_QUEUE_COMPACT_LAYOUT | LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER |
+                     LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER,
+                 1, 1);
+    compact_layout_test();
 }
\ No newline at end of file
@@ -0,0 +1,167 @@
+#define _GNU_SOURCE
+
+#include "lib/executor.h"
+#include "lib/scheduler.h"
+
+#include <stdio.h>
+
+#define DRAIN_TEST_NUM_WORKERS  2
+#define DRAIN_TEST_NUM_ROUTINES 64
+#define DRAIN_TEST_NUM_POLLS    1000
+
+struct counting_state {
+    uint64_t num_polls;
+    uint64_t *num_done;
+};
+
+void counting_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct counting_state *state = arg0;
+    if (++state->num_polls == DRAIN_TEST_NUM_POLLS) {
+        __atomic_fetch_add(state->num_done, 1, __ATOMIC_RELAXED);
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+void counting_hook(void *hook_arg, size_t worker_id) {
+    uint64_t *num_calls = hook_arg;
+    __atomic_fetch_add(&num_calls[worker_id], 1, __ATOMIC_RELAXED);
+}
+
+void drain_test() {
+    uint64_t num_hook_calls[DRAIN_TEST_NUM_WORKERS] = {0};
+    struct llcm_executor_config config =
+        llcm_executor_config_create_default(DRAIN_TEST_NUM_WORKERS, DRAIN_TEST_NUM_ROUTINES);
+    config.poll_budget = 16;
+    config.hook = counting_hook;
+    config.hook_arg = num_hook_calls;
+    struct llcm_executor executor;
+    llcm_executor_init(&executor, config);
+
+    uint64_t num_done = 0;
+    struct counting_state states[DRAIN_TEST_NUM_ROUTINES];
+    struct llcm_routine routines[DRAIN_TEST_NUM_ROUTINES];
+    for (size_t i = 0; i < DRAIN_TEST_NUM_ROUTINES; i++) {
+        states[i] = (struct counting_state){.num_done = &num_done};
+        llcm_routine_init(&routines[i], counting_poll, &states[i]);
+        // all on one scheduler, the other worker has to steal
+        assert(llcm_scheduler_try_schedule_routine(llcm_executor_get_scheduler(&executor, 0),
+                                                   &routines[i]));
+    }
+    assert(llcm_executor_start(&executor));
+    llcm_executor_drain(&executor);
+    assert(DRAIN_TEST_NUM_ROUTINES == num_done);
+    for (size_t i = 0; i < DRAIN_TEST_NUM_ROUTINES; i++) {
+        assert(DRAIN_TEST_NUM_POLLS == states[i].num_polls);
+    }
+
+    uint64_t total_polls = 0;
+    for (size_t worker_id = 0; worker_id < DRAIN_TEST_NUM_WORKERS; worker_id++) {
+        assert(num_hook_calls[worker_id] > 0);
+        struct llcm_executor_worker_stats stats;
+        llcm_executor_get_worker_stats(&executor, worker_id, &stats);
+        assert(stats.busy_nanos <= stats.elapsed_nanos);
+        total_polls += stats.num_polls;
+        double const utilization = llcm_executor_get_utilization(&executor, worker_id);
+        assert(utilization >= 0 && utilization <= 1);
+    }
+    assert(DRAIN_TEST_NUM_ROUTINES * DRAIN_TEST_NUM_POLLS == total_polls);
+
+    llcm_executor_uninit(&executor);
+    printf("PASSED drain_test\n");
+}
+
+void endless_poll(void *arg0, struct llcm_exec_handle *handle) {
+    (void) handle;
+    __atomic_fetch_add((uint64_t *) arg0, 1, __ATOMIC_RELAXED);
+}
+
+void shutdown_test() {
+    struct llcm_executor executor;
+    llcm_executor_init(&executor, llcm_executor_config_create_default(2, 4));
+    uint64_t num_polls = 0;
+    struct llcm_routine routine = {.poll = endless_poll, .arg0 = &num_polls};
+    assert(llcm_scheduler_try_schedule_routine(llcm_executor_get_scheduler(&executor, 1),
+                                               &routine));
+    assert(llcm_executor_start(&executor));
+    while (__atomic_load_n(&num_polls, __ATOMIC_RELAXED) < 100) {
+        sched_yield();
+    }
+    llcm_executor_shutdown(&executor);
+    // the routine is left on a scheduler for the caller
+    size_t num_routines = 0;
+    for (size_t worker_id = 0; worker_id < 2; worker_id++) {
+        num_routines +=
+            llcm_scheduler_get_num_routines(llcm_executor_get_scheduler(&executor, worker_id));
+    }
+    assert(1 == num_routines);
+    llcm_executor_uninit(&executor);
+    printf("PASSED shutdown_test\n");
+}
+
+void wake_thief_test() {
+    struct llcm_executor_config config = llcm_executor_config_create_default(2, 8);
+    // a worker parks right away and for longer than the test may take
+    config.wait_strategy = (struct llcm_wait_strategy){
+        .num_spins = 0, .num_yields = 0, .max_park_nanos = 60ULL * 1000 * 1000 * 1000};
+    struct llcm_executor executor;
+    llcm_executor_init(&executor, config);
+    assert(llcm_executor_start(&executor));
+    struct llcm_scheduler *thief = llcm_executor_get_scheduler(&executor, 1);
+    while (0 == __atomic_load_n(&thief->num_parked, __ATOMIC_RELAXED)) {
+        sched_yield();
+    }
+
+    // only worker 0 is woken by the schedule, it has to wake worker 1 to steal
+    uint64_t num_polls = 0;
+    struct llcm_routine routines[8];
+    for (size_t i = 0; i < 8; i++) {
+        llcm_routine_init(&routines[i], endless_poll, &num_polls);
+        assert(llcm_scheduler_try_schedule_routine(llcm_executor_get_scheduler(&executor, 0),
+                                                   &routines[i]));
+    }
+    // well below max_park_nanos
+    uint64_t const deadline_tsc =
+        llcm_rdtsc() + llcm_nanos_to_tsc_ticks(10ULL * 1000 * 1000 * 1000);
+    struct llcm_executor_worker_stats stats = {0};
+    while (0 == stats.num_polls && llcm_rdtsc() < deadline_tsc) {
+        sched_yield();
+        llcm_executor_get_worker_stats(&executor, 1, &stats);
+    }
+    assert(0 != stats.num_polls);
+    llcm_executor_shutdown(&executor);
+    llcm_executor_uninit(&executor);
+    printf("PASSED wake_thief_test\n");
+}
+
+void pinning_test() {
+    int cpus[LLCM_EXECUTOR_MAX_CPUS];
+    size_t const num_cpus = llcm_executor_get_topology_cpus(cpus, LLCM_EXECUTOR_MAX_CPUS);
+    assert(num_cpus >= 1);
+    for (size_t i = 1; i < num_cpus; i++) {
+        assert(cpus[i - 1] < cpus[i]);
+    }
+
+    struct llcm_executor_config config = llcm_executor_config_create_default(1, 4);
+    config.cpus = cpus;
+    struct llcm_executor executor;
+    llcm_executor_init(&executor, config);
+    assert(llcm_executor_start(&executor));
+    llcm_executor_drain(&executor);
+    llcm_executor_uninit(&executor);
+
+    // a start that can not pin every worker starts none of them
+    int const bad_cpus[] = {cpus[0], LLCM_EXECUTOR_MAX_CPUS - 1};
+    config = llcm_executor_config_create_default(2, 4);
+    config.cpus = bad_cpus;
+    llcm_executor_init(&executor, config);
+    assert(!llcm_executor_start(&executor));
+    llcm_executor_uninit(&executor);
+    printf("PASSED pinning_test\n");
+}
+
+int main() {
+    drain_test();
+    shutdown_test();
+    wake_thief_test();
+    pinning_test();
+}
@@ -0,0 +1,139 @@
+#define _GNU_SOURCE
+
+#include "lib/future.h"
+#include "lib/scheduler.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+struct waiting_routine_state {
+    struct llcm_future *future;
+    uint64_t num_polls;
+    void *value;
+    // fulfils the future itself between the check and the park
+    bool fulfil_while_polled;
+};
+
+void waiting_routine_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct waiting_routine_state *state = arg0;
+    state->num_polls++;
+    if (!llcm_future_await(state->future, handle)) {
+        if (state->fulfil_while_polled) {
+            llcm_promise_set_value(llcm_future_get_promise(state->future), (void *) 7);
+        }
+        return;
+    }
+    state->value = llcm_future_get_value(state->future);
+    llcm_exec_handle_cancel_routine(handle);
+}
+
+void park_until_ready_test() {
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 1);
+    struct llcm_future future;
+    llcm_future_init(&future);
+    struct waiting_routine_state state = {.future = &future};
+    struct llcm_routine routine = {.poll = waiting_routine_poll, .arg0 = &state};
+    assert(llcm_scheduler_try_schedule_routine(&scheduler, &routine));
+
+    // parked after one poll, off the queue but still holding its slot
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(!llcm_scheduler_poll(&scheduler, NULL));
+    assert(1 == state.num_polls);
+    assert(0 == llcm_scheduler_get_num_queued_routines(&scheduler));
+    assert(1 == scheduler.queues[0].counters.reserved_push_size);
+
+    llcm_promise_set_value(llcm_future_get_promise(&future), (void *) 42);
+    assert(llcm_future_is_ready(&future));
+    assert(1 == llcm_scheduler_get_num_queued_routines(&scheduler));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(2 == state.num_polls);
+    assert((void *) 42 == state.value);
+    assert(0 == scheduler.queues[0].counters.reserved_push_size);
+
+    // a ready future does not park at all
+    state.num_polls = 0;
+    assert(llcm_scheduler_try_schedule_routine(&scheduler, &routine));
+    assert(1 == llcm_scheduler_poll_batch(&scheduler, NULL, 4));
+    assert(1 == state.num_polls);
+
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED park_until_ready_test\n");
+}
+
+void ready_before_park_test() {
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 1);
+    struct llcm_future future;
+    llcm_future_init(&future);
+    struct waiting_routine_state state = {.future = &future, .fulfil_while_polled = true};
+    struct llcm_routine routine = {.poll = waiting_routine_poll, .arg0 = &state};
+    assert(llcm_scheduler_try_schedule_routine(&scheduler, &routine));
+
+    // the park fails as the future became ready, so the routine is requeued instead of lost
+    assert(1 == llcm_scheduler_poll_batch(&scheduler, NULL, 4));
+    assert(1 == llcm_scheduler_get_num_queued_routines(&scheduler));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert((void *) 7 == state.value);
+    assert(0 == scheduler.queues[0].counters.reserved_push_size);
+
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED ready_before_park_test\n");
+}
+
+#define CROSS_THREAD_TEST_NUM_ROUTINES 64
+
+struct fulfil_thread_args {
+    struct llcm_future *futures;
+    uint64_t *start;
+};
+
+void *fulfil_thread_exec(void *arg0) {
+    struct fulfil_thread_args *args = arg0;
+    while (0 == __atomic_load_n(args->start, __ATOMIC_ACQUIRE)) {
+    }
+    for (uint64_t i = 0; i < CROSS_THREAD_TEST_NUM_ROUTINES; i++) {
+        llcm_promise_set_value(llcm_future_get_promise(&args->futures[i]), (void *) (i + 1));
+    }
+    return NULL;
+}
+
+void cross_thread_test() {
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, CROSS_THREAD_TEST_NUM_ROUTINES);
+    struct llcm_future futures[CROSS_THREAD_TEST_NUM_ROUTINES];
+    struct waiting_routine_state states[CROSS_THREAD_TEST_NUM_ROUTINES];
+    struct llcm_routine routines[CROSS_THREAD_TEST_NUM_ROUTINES];
+    for (size_t i = 0; i < CROSS_THREAD_TEST_NUM_ROUTINES; i++) {
+        llcm_future_init(&futures[i]);
+        states[i] = (struct waiting_routine_state){.future = &futures[i]};
+        llcm_routine_init(&routines[i], waiting_routine_poll, &states[i]);
+        assert(llcm_scheduler_try_schedule_routine(&scheduler, &routines[i]));
+    }
+
+    // promises race with the polls that park their routines
+    uint64_t start = 0;
+    struct fulfil_thread_args args = {.futures = futures, .start = &start};
+    pthread_t thread;
+    int rc = pthread_create(&thread, NULL, fulfil_thread_exec, &args);
+    assert(rc == 0);
+    __atomic_store_n(&start, 1, __ATOMIC_RELEASE);
+    while (0 !=
+           __atomic_load_n(&scheduler.queues[0].counters.reserved_push_size, __ATOMIC_ACQUIRE)) {
+        llcm_scheduler_poll(&scheduler, NULL);
+    }
+    pthread_join(thread, NULL);
+
+    for (size_t i = 0; i < CROSS_THREAD_TEST_NUM_ROUTINES; i++) {
+        assert((void *) (i + 1) == states[i].value);
+        assert(states[i].num_polls <= 2);
+    }
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED cross_thread_test\n");
+}
+
+int main() {
+    park_until_ready_test();
+    ready_before_park_test();
+    cross_thread_test();
+}
@@ -0,0 +1,144 @@
+#define _GNU_SOURCE
+
+#include "lib/histogram.h"
+#include "lib/scheduler.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+void percentile_test() {
+    struct llcm_histogram histogram;
+    llcm_histogram_init(&histogram, llcm_allocator_create_default());
+    assert(0 == llcm_histogram_get_percentile(&histogram, 50.0));
+
+    // small values are exact
+    for (uint64_t value = 1; value <= 10; value++) {
+        llcm_histogram_record(&histogram, value);
+    }
+    assert(10 == llcm_histogram_get_count(&histogram));
+    assert(5 == llcm_histogram_get_percentile(&histogram, 50.0));
+    assert(10 == llcm_histogram_get_percentile(&histogram, 100.0));
+
+    // large values are within 1 / 16 and never reported above the max
+    llcm_histogram_reset(&histogram);
+    for (uint64_t value = 1; value <= 100000; value++) {
+        llcm_histogram_record(&histogram, value * 1000);
+    }
+    struct llcm_histogram_summary summary;
+    llcm_histogram_get_summary(&histogram, &summary);
+    assert(100000 == summary.count);
+    assert(summary.p50 >= 50000000 && summary.p50 <= 50000000 + 50000000 / 16);
+    assert(summary.p99 >= 99000000 && summary.p99 <= 99000000 + 99000000 / 16);
+    assert(summary.p999 >= 99900000 && summary.p999 <= 100000000);
+    assert(100000000 == summary.max);
+
+    // every bucket bound is consistent with the index it came from
+    for (uint64_t value = 1; value < (1ULL << 20); value = value * 3 / 2 + 1) {
+        size_t const index = llcm_histogram_get_bucket_index_(value);
+        assert(index < LLCM_HISTOGRAM_NUM_BUCKETS);
+        assert(value <= llcm_histogram_get_bucket_upper_bound_(index));
+        assert(0 == index || value > llcm_histogram_get_bucket_upper_bound_(index - 1));
+    }
+    assert(LLCM_HISTOGRAM_NUM_BUCKETS - 1 == llcm_histogram_get_bucket_index_(UINT64_MAX));
+
+    llcm_histogram_uninit(&histogram);
+    printf("PASSED percentile_test\n");
+}
+
+#define CONCURRENT_TEST_NUM_THREADS 4
+#define CONCURRENT_TEST_NUM_VALUES  100000
+
+void *record_thread_exec(void *arg0) {
+    struct llcm_histogram *histogram = arg0;
+    for (uint64_t value = 0; value < CONCURRENT_TEST_NUM_VALUES; value++) {
+        llcm_histogram_record(histogram, value);
+    }
+    return NULL;
+}
+
+void concurrent_record_test() {
+    struct llcm_histogram histogram;
+    llcm_histogram_init(&histogram, llcm_allocator_create_default());
+    pthread_t threads[CONCURRENT_TEST_NUM_THREADS];
+    for (size_t i = 0; i < CONCURRENT_TEST_NUM_THREADS; i++) {
+        int rc = pthread_create(&threads[i], NULL, record_thread_exec, &histogram);
+        assert(rc == 0);
+    }
+    for (size_t i = 0; i < CONCURRENT_TEST_NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    assert(CONCURRENT_TEST_NUM_THREADS * CONCURRENT_TEST_NUM_VALUES ==
+           llcm_histogram_get_count(&histogram));
+    assert(CONCURRENT_TEST_NUM_VALUES - 1 == llcm_histogram_get_max(&histogram));
+
+    // merging keeps every percentile, as each value lands in the same bucket
+    struct llcm_histogram merged;
+    llcm_histogram_init(&merged, llcm_allocator_create_default());
+    llcm_histogram_record(&merged, 1ULL << 40);
+    llcm_histogram_merge(&merged, &histogram);
+    assert(CONCURRENT_TEST_NUM_THREADS * CONCURRENT_TEST_NUM_VALUES + 1 ==
+           llcm_histogram_get_count(&merged));
+    assert(llcm_histogram_get_percentile(&histogram, 50.0) ==
+           llcm_histogram_get_percentile(&merged, 50.0));
+    assert(1ULL << 40 == llcm_histogram_get_max(&merged));
+    llcm_histogram_uninit(&merged);
+    llcm_histogram_uninit(&histogram);
+    printf("PASSED concurrent_record_test\n");
+}
+
+struct spinning_state {
+    uint64_t num_polls;
+    uint64_t spin_tsc_ticks;
+};
+
+void spinning_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct spinning_state *state = arg0;
+    uint64_t const start_tsc = llcm_rdtsc();
+    while (llcm_rdtsc() - start_tsc < state->spin_tsc_ticks) {
+    }
+    if (++state->num_polls == 100) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+void scheduler_latency_test() {
+    struct llcm_scheduler plain;
+    llcm_scheduler_init(&plain, 4);
+    assert(NULL == llcm_scheduler_get_schedule_latency(&plain));
+    assert(NULL == llcm_scheduler_get_poll_time(&plain));
+    llcm_scheduler_uninit(&plain);
+
+    struct llcm_scheduler_config config = llcm_scheduler_config_create_default(4);
+    config.record_latency = true;
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init_with_config(&scheduler, config, llcm_allocator_create_default());
+    struct spinning_state state = {.spin_tsc_ticks = 10000};
+    struct llcm_routine routine = {.poll = spinning_poll, .arg0 = &state};
+    assert(llcm_scheduler_try_schedule_routine(&scheduler, &routine));
+    while (llcm_scheduler_poll(&scheduler, NULL) ||
+           0 != llcm_scheduler_poll_batch(&scheduler, NULL, 4)) {
+    }
+
+    struct llcm_histogram_summary poll_time;
+    llcm_histogram_get_summary(llcm_scheduler_get_poll_time(&scheduler), &poll_time);
+    assert(100 == poll_time.count);
+    assert(poll_time.p50 >= 10000);
+    assert(poll_time.max >= poll_time.p999 && poll_time.p999 >= poll_time.p99 &&
+           poll_time.p99 >= poll_time.p50);
+    struct llcm_histogram *schedule_latency = llcm_scheduler_get_schedule_latency(&scheduler);
+    assert(100 == llcm_histogram_get_count(schedule_latency));
+    // requeued right after its poll, so it waits far less than it runs
+    assert(llcm_histogram_get_percentile(schedule_latency, 50.0) < poll_time.p50);
+
+    llcm_histogram_reset(schedule_latency);
+    assert(0 == llcm_histogram_get_count(schedule_latency));
+    assert(0 == llcm_histogram_get_max(schedule_latency));
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED scheduler_latency_test\n");
+}
+
+int main() {
+    percentile_test();
+    concurrent_record_test();
+    scheduler_latency_test();
+}
@@ -0,0 +1,211 @@
+#define _GNU_SOURCE
+
+#include "lib/executor.h"
+#include "lib/reactor.h"
+#include "lib/scheduler.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+struct pipe_reader_state {
+    struct llcm_io io;
+    int write_fd;
+    uint64_t num_polls;
+    size_t num_bytes;
+    bool closed;
+    // writes itself between the failed read and the park
+    bool write_while_polled;
+};
+
+void pipe_reader_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct pipe_reader_state *state = arg0;
+    state->num_polls++;
+    char buffer[16];
+    ssize_t const size = read(state->io.fd, buffer, sizeof(buffer));
+    if (size > 0) {
+        state->num_bytes += size;
+        return;
+    }
+    if (0 == size) {
+        state->closed = true;
+        llcm_exec_handle_cancel_routine(handle);
+        return;
+    }
+    assert(EAGAIN == errno);
+    llcm_io_await(&state->io, EPOLLIN, handle);
+    if (state->write_while_polled) {
+        state->write_while_polled = false;
+        assert(1 == write(state->write_fd, "x", 1));
+    }
+}
+
+void pipe_test() {
+    struct llcm_reactor reactor;
+    assert(llcm_reactor_init(&reactor));
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 1);
+    int fds[2];
+    assert(0 == pipe(fds));
+    assert(0 == fcntl(fds[0], F_SETFL, O_NONBLOCK));
+    struct pipe_reader_state state = {.write_fd = fds[1]};
+    llcm_io_init(&state.io, &reactor, fds[0]);
+    struct llcm_routine routine = {.poll = pipe_reader_poll, .arg0 = &state};
+    assert(llcm_scheduler_try_schedule_routine(&scheduler, &routine));
+
+    // parked on the empty pipe, off the queue but still holding its slot
+    assert(0 == llcm_reactor_poll(&reactor));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(!llcm_scheduler_poll(&scheduler, NULL));
+    assert(1 == llcm_reactor_get_num_waiting(&reactor));
+    assert(0 == llcm_reactor_poll(&reactor));
+    assert(1 == llcm_scheduler_get_num_routines(&scheduler));
+
+    assert(3 == write(fds[1], "abc", 3));
+    assert(1 == llcm_reactor_poll(&reactor));
+    assert(EPOLLIN & llcm_io_get_ready_events(&state.io));
+    assert(0 == llcm_reactor_get_num_waiting(&reactor));
+    // reads, then parks again on the next poll
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(!llcm_scheduler_poll(&scheduler, NULL));
+    assert(3 == state.num_bytes);
+    assert(3 == state.num_polls);
+
+    // data that arrives between the read and the park is not lost
+    assert(4 == write(fds[1], "defg", 4));
+    assert(1 == llcm_reactor_poll(&reactor));
+    state.write_while_polled = true;
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(1 == llcm_reactor_poll(&reactor));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(8 == state.num_bytes);
+
+    // closing the writer wakes the reader with a hang up
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    close(fds[1]);
+    assert(1 == llcm_reactor_poll(&reactor));
+    assert(EPOLLHUP & llcm_io_get_ready_events(&state.io));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(state.closed);
+    assert(0 == llcm_scheduler_get_num_routines(&scheduler));
+
+    llcm_io_uninit(&state.io);
+    close(fds[0]);
+    llcm_scheduler_uninit(&scheduler);
+    llcm_reactor_uninit(&reactor);
+    printf("PASSED pipe_test\n");
+}
+
+void unwatchable_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct llcm_io *io = arg0;
+    if (EPOLLERR == llcm_io_get_ready_events(io)) {
+        llcm_exec_handle_cancel_routine(handle);
+        return;
+    }
+    llcm_io_await(io, EPOLLIN, handle);
+}
+
+void unwatchable_fd_test() {
+    struct llcm_reactor reactor;
+    assert(llcm_reactor_init(&reactor));
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 1);
+    // epoll refuses regular files, the routine is requeued instead of parked forever
+    FILE *file = tmpfile();
+    assert(NULL != file);
+    struct llcm_io io;
+    llcm_io_init(&io, &reactor, fileno(file));
+    struct llcm_routine routine = {.poll = unwatchable_poll, .arg0 = &io};
+    assert(llcm_scheduler_try_schedule_routine(&scheduler, &routine));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(0 == llcm_reactor_get_num_waiting(&reactor));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(0 == llcm_scheduler_get_num_routines(&scheduler));
+    llcm_io_uninit(&io);
+    fclose(file);
+    llcm_scheduler_uninit(&scheduler);
+    llcm_reactor_uninit(&reactor);
+    printf("PASSED unwatchable_fd_test\n");
+}
+
+#define EXECUTOR_TEST_NUM_WORKERS  2
+#define EXECUTOR_TEST_NUM_ROUTINES 16
+#define EXECUTOR_TEST_NUM_ROUNDS   200
+
+struct eventfd_reader_state {
+    struct llcm_io io;
+    uint64_t total;
+};
+
+void eventfd_reader_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct eventfd_reader_state *state = arg0;
+    uint64_t value;
+    while (sizeof(value) == read(state->io.fd, &value, sizeof(value))) {
+        state->total += value;
+    }
+    if (EXECUTOR_TEST_NUM_ROUNDS == state->total) {
+        llcm_exec_handle_cancel_routine(handle);
+        return;
+    }
+    llcm_io_await(&state->io, EPOLLIN, handle);
+}
+
+void reactor_hook(void *hook_arg, size_t worker_id) {
+    (void) worker_id;
+    llcm_reactor_poll(hook_arg);
+}
+
+void executor_test() {
+    struct llcm_reactor reactor;
+    assert(llcm_reactor_init(&reactor));
+    struct llcm_executor_config config = llcm_executor_config_create_default(
+        EXECUTOR_TEST_NUM_WORKERS, EXECUTOR_TEST_NUM_ROUTINES);
+    config.hook = reactor_hook;
+    config.hook_arg = &reactor;
+    struct llcm_executor executor;
+    llcm_executor_init(&executor, config);
+
+    struct eventfd_reader_state states[EXECUTOR_TEST_NUM_ROUTINES];
+    struct llcm_routine routines[EXECUTOR_TEST_NUM_ROUTINES];
+    for (size_t i = 0; i < EXECUTOR_TEST_NUM_ROUTINES; i++) {
+        int const fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        assert(fd >= 0);
+        states[i].total = 0;
+        llcm_io_init(&states[i].io, &reactor, fd);
+        llcm_routine_init(&routines[i], eventfd_reader_poll, &states[i]);
+        struct llcm_scheduler *scheduler =
+            llcm_executor_get_scheduler(&executor, i % EXECUTOR_TEST_NUM_WORKERS);
+        assert(llcm_scheduler_try_schedule_routine(scheduler, &routines[i]));
+    }
+    assert(llcm_executor_start(&executor));
+    // the routines move between workers through stealing while they wait on their fds
+    for (size_t round = 0; round < EXECUTOR_TEST_NUM_ROUNDS; round++) {
+        for (size_t i = 0; i < EXECUTOR_TEST_NUM_ROUTINES; i++) {
+            uint64_t const one = 1;
+            assert(sizeof(one) == write(states[i].io.fd, &one, sizeof(one)));
+        }
+        if (0 == round % 16) {
+            sched_yield();
+        }
+    }
+    llcm_executor_drain(&executor);
+    assert(0 == llcm_reactor_get_num_waiting(&reactor));
+    for (size_t i = 0; i < EXECUTOR_TEST_NUM_ROUTINES; i++) {
+        assert(EXECUTOR_TEST_NUM_ROUNDS == states[i].total);
+        llcm_io_uninit(&states[i].io);
+        close(states[i].io.fd);
+    }
+    llcm_executor_uninit(&executor);
+    llcm_reactor_uninit(&reactor);
+    printf("PASSED executor_test\n");
+}
+
+int main() {
+    pipe_test();
+    unwatchable_fd_test();
+    executor_test();
+}
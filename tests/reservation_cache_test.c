@@ -0,0 +1,178 @@
+#define _GNU_SOURCE
+
+#include "lib/reservation_cache.h"
+#include "lib/scheduler.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#define CAPACITY           16
+#define NUM_SHARDS         4
+#define CHUNK_SIZE         2
+#define CONCURRENT_THREADS 4
+#define CONCURRENT_ROUNDS  100000
+
+uint64_t get_queue_reserved(struct llcm_reservation_cache const *cache) {
+    return atomic_load(&cache->queue->counters.reserved_push_size);
+}
+
+struct borrower_args {
+    struct llcm_reservation_cache *cache;
+};
+
+// leaves the spare tokens of its borrow in its own shard
+void *borrower_exec(void *arg0) {
+    struct borrower_args *args = arg0;
+    assert(llcm_reservation_cache_try_reserve(args->cache, 1));
+    llcm_reservation_cache_unreserve(args->cache, 1);
+    return NULL;
+}
+
+void single_thread_test() {
+    struct llcm_concurrent_queue queue;
+    llcm_concurrent_queue_init(&queue, CAPACITY);
+    struct llcm_reservation_cache cache;
+    llcm_reservation_cache_init(&cache, &queue, NUM_SHARDS, CHUNK_SIZE,
+                                llcm_allocator_create_default());
+    assert(CHUNK_SIZE == cache.chunk_size);
+
+    // the first reservation borrows a chunk more, the next ones come from the shard alone
+    assert(llcm_reservation_cache_try_reserve(&cache, 1));
+    assert(1 + CHUNK_SIZE == get_queue_reserved(&cache));
+    assert(llcm_reservation_cache_try_reserve(&cache, CHUNK_SIZE));
+    assert(1 + CHUNK_SIZE == get_queue_reserved(&cache));
+    // unreserved tokens stay in the shard up to two chunks, the rest goes back
+    llcm_reservation_cache_unreserve(&cache, 1 + CHUNK_SIZE);
+    assert(1 + CHUNK_SIZE == get_queue_reserved(&cache));
+    assert(0 == llcm_reservation_cache_get_num_reserved(&cache));
+    assert(0 == get_queue_reserved(&cache));
+
+    // tokens cached by another thread's shard do not make the queue look full
+    struct borrower_args args = {.cache = &cache};
+    pthread_t borrower;
+    assert(0 == pthread_create(&borrower, NULL, borrower_exec, &args));
+    pthread_join(borrower, NULL);
+    assert(0 != get_queue_reserved(&cache));
+    for (size_t i = 0; i < CAPACITY; i++) {
+        assert(llcm_reservation_cache_try_reserve(&cache, 1));
+        assert(get_queue_reserved(&cache) <= CAPACITY);
+    }
+    assert(!llcm_reservation_cache_try_reserve(&cache, 1));
+    assert(CAPACITY == get_queue_reserved(&cache));
+    assert(CAPACITY == llcm_reservation_cache_get_num_reserved(&cache));
+    for (size_t i = 0; i < CAPACITY; i++) {
+        llcm_reservation_cache_unreserve(&cache, 1);
+    }
+    assert(0 == llcm_reservation_cache_get_num_reserved(&cache));
+
+    llcm_reservation_cache_uninit(&cache);
+    llcm_concurrent_queue_uninit(&queue);
+    printf("PASSED single_thread_test\n");
+}
+
+struct concurrent_args {
+    struct llcm_reservation_cache *cache;
+    _Atomic uint64_t *num_outstanding;
+    uint64_t seed;
+};
+
+// counts what it holds next to the cache, the reservations never add up to more than the
+// capacity. the queue's own count is not checked, a failing reservation briefly overshoots it
+void *concurrent_exec(void *arg0) {
+    struct concurrent_args *args = arg0;
+    size_t num_held = 0;
+    for (size_t round = 0; round < CONCURRENT_ROUNDS; round++) {
+        args->seed ^= args->seed << 13;
+        args->seed ^= args->seed >> 7;
+        args->seed ^= args->seed << 17;
+        size_t const num_entries = 1 + args->seed % 4;
+        if (llcm_reservation_cache_try_reserve(args->cache, num_entries)) {
+            uint64_t const num_outstanding =
+                atomic_fetch_add(args->num_outstanding, num_entries) + num_entries;
+            assert(num_outstanding <= CAPACITY);
+            num_held += num_entries;
+        } else {
+            sched_yield();
+        }
+        // gives back a random part, like pops on this thread
+        size_t const num_released = (args->seed >> 8) % (num_held + 1);
+        atomic_fetch_sub(args->num_outstanding, num_released);
+        llcm_reservation_cache_unreserve(args->cache, num_released);
+        num_held -= num_released;
+    }
+    atomic_fetch_sub(args->num_outstanding, num_held);
+    llcm_reservation_cache_unreserve(args->cache, num_held);
+    return NULL;
+}
+
+void concurrent_test() {
+    struct llcm_concurrent_queue queue;
+    llcm_concurrent_queue_init(&queue, CAPACITY);
+    struct llcm_reservation_cache cache;
+    llcm_reservation_cache_init(&cache, &queue, NUM_SHARDS, 0, llcm_allocator_create_default());
+    assert(1 == cache.chunk_size);
+    _Atomic uint64_t num_outstanding = 0;
+    pthread_t threads[CONCURRENT_THREADS];
+    struct concurrent_args args[CONCURRENT_THREADS];
+    for (size_t i = 0; i < CONCURRENT_THREADS; i++) {
+        args[i] = (struct concurrent_args){.cache = &cache,
+                                           .num_outstanding = &num_outstanding,
+                                           .seed = 0x9e3779b97f4a7c15u * (i + 1)};
+        assert(0 == pthread_create(&threads[i], NULL, concurrent_exec, &args[i]));
+    }
+    for (size_t i = 0; i < CONCURRENT_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    assert(0 == num_outstanding);
+    assert(0 == llcm_reservation_cache_get_num_reserved(&cache));
+    llcm_reservation_cache_uninit(&cache);
+    llcm_concurrent_queue_uninit(&queue);
+    printf("PASSED concurrent_test\n");
+}
+
+void cancel_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct llcm_scheduler *other = arg0;
+    // the first poll moves over, the second one ends it
+    if (!llcm_exec_handle_try_switch_scheduler(handle, other)) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+void scheduler_test() {
+    struct llcm_scheduler_config config = llcm_scheduler_config_create_default(CAPACITY);
+    config.num_reservation_shards = NUM_SHARDS;
+    struct llcm_scheduler schedulers[2];
+    for (size_t i = 0; i < 2; i++) {
+        llcm_scheduler_init_with_config(&schedulers[i], config, llcm_allocator_create_default());
+    }
+    struct llcm_routine routines[CAPACITY + 1];
+    for (size_t i = 0; i <= CAPACITY; i++) {
+        llcm_routine_init(&routines[i], cancel_poll, &schedulers[1]);
+    }
+    for (size_t i = 0; i < CAPACITY; i++) {
+        assert(llcm_scheduler_try_schedule_routine(&schedulers[0], &routines[i]));
+    }
+    assert(!llcm_scheduler_try_schedule_routine(&schedulers[0], &routines[CAPACITY]));
+    assert(CAPACITY == llcm_scheduler_get_num_routines(&schedulers[0]));
+
+    // every routine moves to the other scheduler, carrying its reservation along
+    while (llcm_scheduler_poll(&schedulers[0], NULL)) {
+    }
+    assert(0 == llcm_scheduler_get_num_routines(&schedulers[0]));
+    assert(CAPACITY == llcm_scheduler_get_num_routines(&schedulers[1]));
+    while (llcm_scheduler_poll(&schedulers[1], NULL)) {
+    }
+    assert(0 == llcm_scheduler_get_num_routines(&schedulers[1]));
+    for (size_t i = 0; i < 2; i++) {
+        llcm_scheduler_uninit(&schedulers[i]);
+        assert(0 == schedulers[i].queues[0].counters.reserved_push_size);
+    }
+    printf("PASSED scheduler_test\n");
+}
+
+int main() {
+    single_thread_test();
+    concurrent_test();
+    scheduler_test();
+}
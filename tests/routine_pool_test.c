@@ -0,0 +1,122 @@
+#define _GNU_SOURCE
+
+#include "lib/routine_pool.h"
+#include "lib/scheduler.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+struct counter_state {
+    uint64_t num_polls;
+    uint64_t max_polls;
+    char padding[40];
+};
+
+void counter_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct counter_state *state = arg0;
+    if (++state->num_polls == state->max_polls) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+void basic_routine_pool_test() {
+    struct llcm_routine_pool pool;
+    llcm_routine_pool_init(&pool, sizeof(struct counter_state), 8, llcm_allocator_create_default());
+    struct llcm_routine_pool_cache cache;
+    llcm_routine_pool_cache_init(&cache, &pool);
+
+    struct llcm_routine *routines[8];
+    for (size_t i = 0; i < 8; i++) {
+        routines[i] = llcm_routine_pool_allocate(&cache, counter_poll);
+        assert(NULL != routines[i]);
+        // the state is inline and every routine starts on its own cache line
+        assert((char *) routines[i]->arg0 > (char *) routines[i]);
+        assert((char *) routines[i]->arg0 + sizeof(struct counter_state) <=
+               (char *) routines[i] + pool.object_size);
+        assert(0 == (size_t) routines[i] % LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE);
+        assert(0 == (size_t) routines[i]->arg0 % 16);
+    }
+    assert(1 == llcm_routine_pool_get_num_slabs(&pool));
+
+    // freed routines are reused before a new slab is allocated
+    llcm_routine_pool_free(routines[3]);
+    assert(routines[3] == llcm_routine_pool_allocate(&cache, counter_poll));
+    assert(NULL != llcm_routine_pool_allocate(&cache, counter_poll));
+    assert(2 == llcm_routine_pool_get_num_slabs(&pool));
+
+    llcm_routine_pool_uninit(&pool);
+    printf("PASSED basic_routine_pool_test\n");
+}
+
+#define REMOTE_FREE_TEST_NUM_ROUTINES 64
+
+void *remote_free_thread_exec(void *arg0) {
+    struct llcm_routine **routines = arg0;
+    for (size_t i = 0; i < REMOTE_FREE_TEST_NUM_ROUTINES; i++) {
+        llcm_routine_pool_free(routines[i]);
+    }
+    return NULL;
+}
+
+void remote_free_test() {
+    struct llcm_routine_pool pool;
+    llcm_routine_pool_init(&pool, sizeof(struct counter_state), REMOTE_FREE_TEST_NUM_ROUTINES,
+                           llcm_allocator_create_default());
+    struct llcm_routine_pool_cache cache;
+    llcm_routine_pool_cache_init(&cache, &pool);
+
+    struct llcm_routine *routines[REMOTE_FREE_TEST_NUM_ROUTINES];
+    for (size_t i = 0; i < REMOTE_FREE_TEST_NUM_ROUTINES; i++) {
+        routines[i] = llcm_routine_pool_allocate(&cache, counter_poll);
+    }
+    pthread_t thread;
+    int rc = pthread_create(&thread, NULL, remote_free_thread_exec, routines);
+    assert(rc == 0);
+    pthread_join(thread, NULL);
+
+    // the owner takes the remote frees back as one batch instead of growing
+    assert(NULL == cache.free_list);
+    for (size_t i = 0; i < REMOTE_FREE_TEST_NUM_ROUTINES; i++) {
+        assert(NULL != llcm_routine_pool_allocate(&cache, counter_poll));
+    }
+    assert(NULL == cache.remote_list);
+    assert(1 == llcm_routine_pool_get_num_slabs(&pool));
+
+    llcm_routine_pool_uninit(&pool);
+    printf("PASSED remote_free_test\n");
+}
+
+void cancel_returns_to_pool_test() {
+    struct llcm_routine_pool pool;
+    llcm_routine_pool_init(&pool, sizeof(struct counter_state), 16,
+                           llcm_allocator_create_default());
+    struct llcm_routine_pool_cache cache;
+    llcm_routine_pool_cache_init(&cache, &pool);
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 16);
+
+    // spawning far more routines than fit in a slab only needs the one slab, as each
+    // cancelled routine is handed back before the next spawn
+    for (size_t round = 0; round < 8; round++) {
+        for (size_t i = 0; i < 16; i++) {
+            struct llcm_routine *routine = llcm_routine_pool_allocate(&cache, counter_poll);
+            *(struct counter_state *) routine->arg0 =
+                (struct counter_state){.num_polls = 0, .max_polls = 1 + i % 3};
+            assert(llcm_scheduler_try_schedule_routine(&scheduler, routine));
+        }
+        while (0 != llcm_scheduler_poll_batch(&scheduler, NULL, 4) ||
+               llcm_scheduler_poll(&scheduler, NULL)) {
+        }
+    }
+    assert(1 == llcm_routine_pool_get_num_slabs(&pool));
+
+    llcm_scheduler_uninit(&scheduler);
+    llcm_routine_pool_uninit(&pool);
+    printf("PASSED cancel_returns_to_pool_test\n");
+}
+
+int main() {
+    basic_routine_pool_test();
+    remote_free_test();
+    cancel_returns_to_pool_test();
+}
@@ -0,0 +1,516 @@
+#define _GNU_SOURCE
+
+#include "lib/scheduler.h"
+#include "lib/scheduler_group.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+struct counting_routine_state {
+    uint64_t num_polls;
+    uint64_t max_polls;
+};
+
+// requeues itself until it has been polled max_polls times
+void counting_routine_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct counting_routine_state *state = arg0;
+    state->num_polls++;
+    if (state->num_polls == state->max_polls) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+void basic_scheduler_test() {
+    size_t const capacity = 16;
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, capacity);
+
+    struct counting_routine_state states[16];
+    struct llcm_routine routines[16];
+    // stale memory, llcm_routine_init must not leave any of it behind
+    memset(routines, 0xff, sizeof(routines));
+    for (size_t i = 0; i < capacity; i++) {
+        states[i] = (struct counting_routine_state){.num_polls = 0, .max_polls = 4};
+        llcm_routine_init(&routines[i], counting_routine_poll, &states[i]);
+        bool const schedule_result = llcm_scheduler_try_schedule_routine(&scheduler, &routines[i]);
+        assert(schedule_result);
+    }
+    assert(!llcm_scheduler_try_schedule_routine(&scheduler, &routines[0]));
+
+    for (size_t i = 0; i < capacity * 4; i++) {
+        assert(llcm_scheduler_poll(&scheduler, NULL));
+    }
+    assert(!llcm_scheduler_poll(&scheduler, NULL));
+    for (size_t i = 0; i < capacity; i++) {
+        assert(4 == states[i].num_polls);
+    }
+
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED basic_scheduler_test\n");
+}
+
+void batch_scheduler_test() {
+    size_t const capacity = 16;
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, capacity);
+
+    struct counting_routine_state states[16];
+    struct llcm_routine routines[16];
+    struct llcm_routine *routine_ptrs[16];
+    for (size_t i = 0; i < capacity; i++) {
+        states[i] = (struct counting_routine_state){.num_polls = 0, .max_polls = 3};
+        llcm_routine_init(&routines[i], counting_routine_poll, &states[i]);
+        routine_ptrs[i] = &routines[i];
+    }
+    assert(llcm_scheduler_try_schedule_routines(&scheduler, routine_ptrs, capacity / 2));
+    assert(!llcm_scheduler_try_schedule_routines(&scheduler, routine_ptrs, capacity));
+    assert(llcm_scheduler_try_schedule_routines(&scheduler, routine_ptrs + capacity / 2,
+                                                capacity / 2));
+
+    size_t num_polled = 0;
+    for (size_t i = 0; i < 3; i++) {
+        num_polled += llcm_scheduler_poll_batch(&scheduler, NULL, capacity);
+    }
+    assert(capacity * 3 == num_polled);
+    assert(0 == llcm_scheduler_poll_batch(&scheduler, NULL, capacity));
+    for (size_t i = 0; i < capacity; i++) {
+        assert(3 == states[i].num_polls);
+    }
+
+    // all routines were cancelled, so the full capacity is available again
+    assert(llcm_scheduler_try_schedule_routines(&scheduler, routine_ptrs, capacity));
+
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED batch_scheduler_test\n");
+}
+
+struct timer_routine_state {
+    uint64_t num_polls;
+    uint64_t max_polls;
+    uint64_t sleep_nanos;
+    uint64_t last_poll_tsc;
+    uint64_t min_poll_interval_tsc;
+};
+
+void timer_routine_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct timer_routine_state *state = arg0;
+    uint64_t const now_tsc = llcm_rdtsc();
+    if (0 != state->num_polls && now_tsc - state->last_poll_tsc < state->min_poll_interval_tsc) {
+        state->min_poll_interval_tsc = now_tsc - state->last_poll_tsc;
+    }
+    state->last_poll_tsc = now_tsc;
+    if (++state->num_polls == state->max_polls) {
+        llcm_exec_handle_cancel_routine(handle);
+    } else if (0 != state->sleep_nanos) {
+        llcm_exec_handle_sleep(handle, state->sleep_nanos);
+    }
+}
+
+void timer_scheduler_test() {
+    uint64_t const delay_nanos = 200000;
+    uint64_t const delay_tsc = llcm_nanos_to_tsc_ticks(delay_nanos);
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 4);
+
+    struct timer_routine_state states[3];
+    struct llcm_routine routines[3];
+    for (size_t i = 0; i < 3; i++) {
+        states[i] =
+            (struct timer_routine_state){.max_polls = 4, .min_poll_interval_tsc = UINT64_MAX};
+        llcm_routine_init(&routines[i], timer_routine_poll, &states[i]);
+    }
+    states[0].max_polls = 1;
+    states[2].sleep_nanos = delay_nanos;
+
+    uint64_t const start_tsc = llcm_rdtsc();
+    assert(llcm_scheduler_try_schedule_after(&scheduler, &routines[0], delay_nanos));
+    assert(llcm_scheduler_try_schedule_periodic(&scheduler, &routines[1], delay_nanos));
+    assert(llcm_scheduler_try_schedule_routine(&scheduler, &routines[2]));
+    // waiting routines hold their reservation
+    assert(llcm_concurrent_queue_try_reserve_size_before_push(&scheduler.queues[0], 1));
+    assert(!llcm_concurrent_queue_try_reserve_size_before_push(&scheduler.queues[0], 1));
+    llcm_concurrent_queue_unreserve_size_after_pop(&scheduler.queues[0], 1);
+
+    while (states[0].num_polls < states[0].max_polls || states[1].num_polls < states[1].max_polls ||
+           states[2].num_polls < states[2].max_polls) {
+        llcm_scheduler_poll(&scheduler, NULL);
+    }
+    assert(!llcm_scheduler_poll(&scheduler, NULL));
+    assert(llcm_timer_wheel_is_empty(&scheduler.timer_wheel));
+    assert(0 == scheduler.queues[0].counters.reserved_push_size);
+
+    // timers never fire early, a wheel tick of slack is allowed for rounding
+    uint64_t const slack_tsc = 1 << LLCM_TIMER_WHEEL_TICK_SHIFT;
+    assert(states[0].last_poll_tsc - start_tsc + slack_tsc >= delay_tsc);
+    assert(states[1].last_poll_tsc - start_tsc + slack_tsc >= delay_tsc * 4);
+    assert(states[2].min_poll_interval_tsc + slack_tsc >= delay_tsc);
+
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED timer_scheduler_test\n");
+}
+
+struct lane_routine_state {
+    size_t id;
+    size_t requeue_lane;
+    size_t *poll_order;
+    size_t *num_polled;
+};
+
+// records its id, then requeues on requeue_lane once and cancels on the next poll
+void lane_routine_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct lane_routine_state *state = arg0;
+    state->poll_order[(*state->num_polled)++] = state->id;
+    if (llcm_exec_handle_get_lane(handle) == state->requeue_lane) {
+        llcm_exec_handle_cancel_routine(handle);
+    } else {
+        llcm_exec_handle_set_lane(handle, state->requeue_lane);
+    }
+}
+
+void priority_lane_test() {
+    struct llcm_scheduler_config config = llcm_scheduler_config_create_default(8);
+    config.num_lanes = 3;
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init_with_config(&scheduler, config, llcm_allocator_create_default());
+    assert(3 == llcm_scheduler_get_num_lanes(&scheduler));
+
+    size_t poll_order[8];
+    size_t num_polled = 0;
+    struct lane_routine_state states[3];
+    struct llcm_routine routines[3];
+    for (size_t i = 0; i < 3; i++) {
+        states[i] = (struct lane_routine_state){
+            .id = i, .requeue_lane = 2, .poll_order = poll_order, .num_polled = &num_polled};
+        llcm_routine_init(&routines[i], lane_routine_poll, &states[i]);
+    }
+    // routine 2 is demoted from the critical lane to background after its first poll
+    assert(llcm_scheduler_try_schedule_routine_on_lane(&scheduler, &routines[0], 2));
+    assert(llcm_scheduler_try_schedule_routine_on_lane(&scheduler, &routines[1], 1));
+    assert(llcm_scheduler_try_schedule_routine_on_lane(&scheduler, &routines[2], 0));
+    assert(3 == llcm_scheduler_get_num_queued_routines(&scheduler));
+
+    while (llcm_scheduler_poll(&scheduler, NULL)) {
+    }
+    size_t const expected_order[] = {2, 1, 0, 2, 1};
+    assert(5 == num_polled);
+    for (size_t i = 0; i < num_polled; i++) {
+        assert(expected_order[i] == poll_order[i]);
+    }
+    assert(0 == scheduler.queues[0].counters.reserved_push_size);
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED priority_lane_test\n");
+}
+
+void starvation_guard_test() {
+    struct llcm_scheduler_config config = llcm_scheduler_config_create_default(4);
+    config.num_lanes = 2;
+    config.starvation_guard_interval = 4;
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init_with_config(&scheduler, config, llcm_allocator_create_default());
+
+    // a routine that never leaves lane 0 would starve lane 1 without the guard
+    struct counting_routine_state busy_state = {.num_polls = 0, .max_polls = 1000};
+    struct counting_routine_state background_state = {.num_polls = 0, .max_polls = 1};
+    struct llcm_routine busy = {.poll = counting_routine_poll, .arg0 = &busy_state};
+    struct llcm_routine background = {.poll = counting_routine_poll, .arg0 = &background_state};
+    assert(llcm_scheduler_try_schedule_routine_on_lane(&scheduler, &busy, 0));
+    assert(llcm_scheduler_try_schedule_routine_on_lane(&scheduler, &background, 1));
+
+    for (size_t i = 0; i < config.starvation_guard_interval * 2; i++) {
+        assert(llcm_scheduler_poll(&scheduler, NULL));
+    }
+    assert(1 == background_state.num_polls);
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED starvation_guard_test\n");
+}
+
+#define RUN_NEXT_TEST_MAX_POLLS 64
+
+struct run_next_state {
+    char *log;
+    size_t *log_size;
+    char name;
+    // handed over to the run next slot on the first poll, or on every poll with chain
+    struct llcm_routine *next;
+    struct llcm_routine *second_next;
+    bool chain;
+    uint64_t num_polls;
+};
+
+void run_next_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct run_next_state *state = arg0;
+    state->log[(*state->log_size)++] = state->name;
+    if (NULL != state->next && (0 == state->num_polls || state->chain)) {
+        assert(llcm_exec_handle_try_schedule_next(handle, state->next));
+        if (NULL != state->second_next) {
+            assert(llcm_exec_handle_try_schedule_next(handle, state->second_next));
+        }
+    }
+    if (++state->num_polls == 1 || state->chain) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+void run_next_test() {
+    char log[RUN_NEXT_TEST_MAX_POLLS + 1];
+    size_t log_size = 0;
+    struct run_next_state states[5];
+    struct llcm_routine routines[5];
+    for (size_t i = 0; i < 5; i++) {
+        states[i] = (struct run_next_state){.log = log, .log_size = &log_size, .name = 'a' + i};
+        llcm_routine_init(&routines[i], run_next_poll, &states[i]);
+    }
+    struct llcm_scheduler_config config = llcm_scheduler_config_create_default(4);
+    struct llcm_scheduler scheduler;
+
+    // a runs c right after itself, ahead of the queued b. when it hands over d too, the newest
+    // runs next and c is queued
+    for (int second_next = 0; second_next < 2; second_next++) {
+        llcm_scheduler_init_with_config(&scheduler, config, llcm_allocator_create_default());
+        log_size = 0;
+        for (size_t i = 0; i < 4; i++) {
+            states[i].num_polls = 0;
+        }
+        states[0].next = &routines[2];
+        states[0].second_next = second_next ? &routines[3] : NULL;
+        assert(llcm_scheduler_try_schedule_routine(&scheduler, &routines[0]));
+        assert(llcm_scheduler_try_schedule_routine(&scheduler, &routines[1]));
+        assert(llcm_scheduler_poll(&scheduler, NULL));
+        while (llcm_scheduler_poll(&scheduler, NULL)) {
+        }
+        log[log_size] = '\0';
+        assert(0 == strcmp(second_next ? "adbc" : "acb", log));
+        assert(0 == llcm_scheduler_get_num_routines(&scheduler));
+        llcm_scheduler_uninit(&scheduler);
+    }
+    states[0].second_next = NULL;
+
+    // a chain of c and d handing over to each other is cut after run_next_limit polls, then the
+    // queued b goes first. with the slot disabled every hand over is queued
+    for (uint64_t run_next_limit = 0; run_next_limit < 4; run_next_limit += 3) {
+        config.run_next_limit = run_next_limit;
+        llcm_scheduler_init_with_config(&scheduler, config, llcm_allocator_create_default());
+        log_size = 0;
+        for (size_t i = 0; i < 4; i++) {
+            states[i].num_polls = 0;
+        }
+        states[2] = (struct run_next_state){
+            .log = log, .log_size = &log_size, .name = 'c', .next = &routines[3], .chain = true};
+        states[3] = (struct run_next_state){
+            .log = log, .log_size = &log_size, .name = 'd', .next = &routines[2], .chain = true};
+        states[1].next = NULL;
+        assert(llcm_scheduler_try_schedule_routine(&scheduler, &routines[0]));
+        assert(llcm_scheduler_try_schedule_routine(&scheduler, &routines[1]));
+        for (size_t i = 0; i < 3; i++) {
+            assert(llcm_scheduler_poll(&scheduler, NULL));
+        }
+        log[log_size] = '\0';
+        assert(0 == strcmp(0 == run_next_limit ? "abc" : "acdcbdcdc", log));
+        // the chain never ends, it is still holding one reservation
+        assert(1 == llcm_scheduler_get_num_routines(&scheduler));
+        llcm_scheduler_uninit(&scheduler);
+    }
+
+    // a full scheduler has no room for the next routine either
+    config.run_next_limit = LLCM_SCHEDULER_DEFAULT_RUN_NEXT_LIMIT;
+    config.capacity = 2;
+    llcm_scheduler_init_with_config(&scheduler, config, llcm_allocator_create_default());
+    struct llcm_exec_handle handle = {.scheduler = &scheduler, .polling_scheduler_ = &scheduler};
+    assert(llcm_scheduler_try_schedule_routine(&scheduler, &routines[0]));
+    assert(llcm_exec_handle_try_schedule_next(&handle, &routines[1]));
+    assert(!llcm_exec_handle_try_schedule_next(&handle, &routines[2]));
+    assert(&routines[1] == handle.run_next_);
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED run_next_test\n");
+}
+
+void unbounded_scheduler_test() {
+    size_t const capacity = 4;
+    struct llcm_scheduler_config config = llcm_scheduler_config_create_default(capacity);
+    config.unbounded = true;
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init_with_config(&scheduler, config, llcm_allocator_create_default());
+
+    // a burst many times the capacity is absorbed instead of failing
+    struct counting_routine_state states[64];
+    struct llcm_routine routines[64];
+    struct llcm_routine *routine_ptrs[64];
+    for (size_t i = 0; i < 64; i++) {
+        states[i] = (struct counting_routine_state){.num_polls = 0, .max_polls = 3};
+        llcm_routine_init(&routines[i], counting_routine_poll, &states[i]);
+        routine_ptrs[i] = &routines[i];
+    }
+    for (size_t i = 0; i < 32; i++) {
+        assert(llcm_scheduler_try_schedule_routine(&scheduler, &routines[i]));
+    }
+    assert(llcm_scheduler_try_schedule_routines(&scheduler, routine_ptrs + 32, 32));
+    assert(64 == llcm_scheduler_get_num_queued_routines(&scheduler));
+
+    while (0 != llcm_scheduler_poll_batch(&scheduler, NULL, 8)) {
+    }
+    for (size_t i = 0; i < 64; i++) {
+        assert(3 == states[i].num_polls);
+    }
+    assert(0 == scheduler.segmented_queues[0].reserved_push_size);
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED unbounded_scheduler_test\n");
+}
+
+struct park_test_args {
+    struct llcm_scheduler *scheduler;
+    uint64_t *num_finished_polls;
+};
+
+void *park_test_thread_exec(void *arg0) {
+    struct park_test_args *args = arg0;
+    // park right away, with a timeout long enough that only a wake up ends it in time
+    struct llcm_waiter waiter;
+    llcm_waiter_init(&waiter, (struct llcm_wait_strategy){
+                                  .num_spins = 0, .num_yields = 0, .max_park_nanos = 10000000000});
+    while (0 == __atomic_load_n(args->num_finished_polls, __ATOMIC_SEQ_CST)) {
+        if (llcm_scheduler_poll_or_wait(args->scheduler, NULL, &waiter)) {
+            __atomic_fetch_add(args->num_finished_polls, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+    return NULL;
+}
+
+void park_test() {
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 4);
+    uint64_t num_finished_polls = 0;
+    struct park_test_args args = {.scheduler = &scheduler,
+                                  .num_finished_polls = &num_finished_polls};
+    pthread_t thread;
+    int rc = pthread_create(&thread, NULL, park_test_thread_exec, &args);
+    assert(rc == 0);
+    while (0 == __atomic_load_n(&scheduler.num_parked, __ATOMIC_SEQ_CST)) {
+    }
+
+    struct counting_routine_state state = {.num_polls = 0, .max_polls = 1};
+    struct llcm_routine routine = {.poll = counting_routine_poll, .arg0 = &state};
+    struct timespec ts_start;
+    struct timespec ts_end;
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    assert(llcm_scheduler_try_schedule_routine(&scheduler, &routine));
+    pthread_join(thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+
+    assert(1 == state.num_polls);
+    assert(ts_end.tv_sec - ts_start.tv_sec < 5);
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED park_test\n");
+}
+
+#define GROUP_TEST_NUM_WORKERS  4
+#define GROUP_TEST_NUM_ROUTINES 64
+#define GROUP_TEST_MAX_POLLS    64
+
+struct group_test_args {
+    struct llcm_scheduler_group *group;
+    size_t worker_id;
+    uint64_t *num_finished_polls;
+};
+
+void *group_test_thread_exec(void *arg0) {
+    struct group_test_args *args = arg0;
+    while (__atomic_load_n(args->num_finished_polls, __ATOMIC_SEQ_CST) !=
+           GROUP_TEST_NUM_ROUTINES * GROUP_TEST_MAX_POLLS) {
+        if (llcm_scheduler_group_poll(args->group, args->worker_id, NULL)) {
+            __atomic_fetch_add(args->num_finished_polls, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+    return NULL;
+}
+
+void scheduler_group_test() {
+    struct llcm_scheduler_group group;
+    llcm_scheduler_group_init(&group, GROUP_TEST_NUM_WORKERS, GROUP_TEST_NUM_ROUTINES);
+
+    // all routines start on worker 0, the other workers only get work by stealing
+    struct counting_routine_state states[GROUP_TEST_NUM_ROUTINES];
+    struct llcm_routine routines[GROUP_TEST_NUM_ROUTINES];
+    for (size_t i = 0; i < GROUP_TEST_NUM_ROUTINES; i++) {
+        states[i] =
+            (struct counting_routine_state){.num_polls = 0, .max_polls = GROUP_TEST_MAX_POLLS};
+        llcm_routine_init(&routines[i], counting_routine_poll, &states[i]);
+        bool const schedule_result = llcm_scheduler_try_schedule_routine(
+            llcm_scheduler_group_get_scheduler(&group, 0), &routines[i]);
+        assert(schedule_result);
+    }
+
+    uint64_t num_finished_polls = 0;
+    pthread_t threads[GROUP_TEST_NUM_WORKERS];
+    struct group_test_args args[GROUP_TEST_NUM_WORKERS];
+    for (size_t worker_id = 0; worker_id < GROUP_TEST_NUM_WORKERS; worker_id++) {
+        args[worker_id] = (struct group_test_args){
+            .group = &group, .worker_id = worker_id, .num_finished_polls = &num_finished_polls};
+        int rc =
+            pthread_create(&threads[worker_id], NULL, group_test_thread_exec, &args[worker_id]);
+        assert(rc == 0);
+    }
+    for (size_t worker_id = 0; worker_id < GROUP_TEST_NUM_WORKERS; worker_id++) {
+        pthread_join(threads[worker_id], NULL);
+    }
+
+    for (size_t i = 0; i < GROUP_TEST_NUM_ROUTINES; i++) {
+        assert(GROUP_TEST_MAX_POLLS == states[i].num_polls);
+    }
+    // stealing must hand back every reservation it borrowed
+    for (size_t worker_id = 0; worker_id < GROUP_TEST_NUM_WORKERS; worker_id++) {
+        struct llcm_scheduler *scheduler = llcm_scheduler_group_get_scheduler(&group, worker_id);
+        assert(0 == scheduler->queues[0].counters.reserved_push_size);
+        assert(0 == llcm_scheduler_get_num_queued_routines(scheduler));
+    }
+
+    llcm_scheduler_group_uninit(&group);
+    printf("PASSED scheduler_group_test\n");
+}
+
+void switch_poll(void *arg0, struct llcm_exec_handle *handle) {
+    bool *switched = arg0;
+    *switched = llcm_exec_handle_try_switch_scheduler(
+        handle, (struct llcm_scheduler *) handle->user_exec_arg);
+}
+
+void single_consumer_steal_test() {
+    struct llcm_scheduler mpsc;
+    struct llcm_scheduler mpmc;
+    llcm_scheduler_init_with_flags(&mpsc, 16, LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER,
+                                   llcm_allocator_create_default());
+    llcm_scheduler_init(&mpmc, 16);
+    bool switched = false;
+    struct llcm_routine routines[2];
+    for (size_t i = 0; i < 2; i++) {
+        llcm_routine_init(&routines[i], switch_poll, &switched);
+    }
+    assert(llcm_scheduler_try_schedule_routine(&mpsc, &routines[0]));
+    assert(llcm_scheduler_try_schedule_routine(&mpmc, &routines[1]));
+
+    // only the poller of a single consumer scheduler pops from it, other threads still push
+    assert(0 == llcm_scheduler_try_steal_routines(&mpmc, &mpsc, 1));
+    assert(1 == llcm_scheduler_get_num_queued_routines(&mpmc));
+
+    assert(llcm_scheduler_poll(&mpmc, &mpsc));
+    assert(switched);
+    assert(0 == llcm_scheduler_get_num_routines(&mpmc));
+    assert(2 == llcm_scheduler_get_num_routines(&mpsc));
+
+    llcm_scheduler_uninit(&mpsc);
+    llcm_scheduler_uninit(&mpmc);
+    printf("PASSED single_consumer_steal_test\n");
+}
+
+int main() {
+    basic_scheduler_test();
+    batch_scheduler_test();
+    timer_scheduler_test();
+    priority_lane_test();
+    starvation_guard_test();
+    run_next_test();
+    unbounded_scheduler_test();
+    park_test();
+    scheduler_group_test();
+    single_consumer_steal_test();
+}
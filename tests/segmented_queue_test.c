@@ -0,0 +1,201 @@
+#define _GNU_SOURCE
+
+#include "lib/segmented_queue.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+void basic_segmented_queue_test() {
+    size_t const segment_capacity = 8;
+    struct llcm_segmented_queue queue;
+    llcm_segmented_queue_init(&queue, segment_capacity);
+    assert(segment_capacity == llcm_segmented_queue_get_segment_capacity(&queue));
+    assert(NULL == llcm_segmented_queue_try_pop(&queue));
+
+    // grows past any single segment and stays in order
+    for (uint64_t i = 1; i <= segment_capacity * 5; i++) {
+        llcm_segmented_queue_push(&queue, (void *) i);
+    }
+    assert(segment_capacity * 5 == llcm_segmented_queue_get_size(&queue));
+    assert(5 == llcm_segmented_queue_get_num_segments(&queue));
+    for (uint64_t i = 1; i <= segment_capacity * 5; i++) {
+        assert((uint64_t) llcm_segmented_queue_try_pop(&queue) == i);
+    }
+    assert(NULL == llcm_segmented_queue_try_pop(&queue));
+    assert(0 == llcm_segmented_queue_get_size(&queue));
+
+    // drained segments are recycled instead of allocating new ones
+    for (uint64_t round = 0; round < 8; round++) {
+        for (uint64_t i = 1; i <= segment_capacity * 3; i++) {
+            llcm_segmented_queue_push(&queue, (void *) i);
+        }
+        for (uint64_t i = 1; i <= segment_capacity * 3; i++) {
+            assert((uint64_t) llcm_segmented_queue_try_pop(&queue) == i);
+        }
+    }
+    assert(5 == llcm_segmented_queue_get_num_segments(&queue));
+
+    llcm_segmented_queue_uninit(&queue);
+    printf("PASSED basic_segmented_queue_test\n");
+}
+
+void batch_segmented_queue_test() {
+    size_t const segment_capacity = 8;
+    struct llcm_segmented_queue queue;
+    llcm_segmented_queue_init(&queue, segment_capacity);
+
+    void *values[20];
+    for (uint64_t i = 0; i < 20; i++) {
+        values[i] = (void *) (i + 1);
+    }
+    // the first batch fits the tail segment, the second one straddles two more
+    llcm_segmented_queue_push_n(&queue, values, 6);
+    llcm_segmented_queue_push_n(&queue, values + 6, 14);
+
+    void *popped[20];
+    size_t num_popped = 0;
+    while (num_popped < 20) {
+        size_t const num_values =
+            llcm_segmented_queue_try_pop_n(&queue, popped + num_popped, 20 - num_popped);
+        assert(0 != num_values && num_values <= segment_capacity);
+        num_popped += num_values;
+    }
+    for (uint64_t i = 0; i < 20; i++) {
+        assert(popped[i] == values[i]);
+    }
+    assert(0 == llcm_segmented_queue_try_pop_n(&queue, popped, 20));
+
+    llcm_segmented_queue_uninit(&queue);
+    printf("PASSED batch_segmented_queue_test\n");
+}
+
+#define MULTITHREADED_TEST_NUM_THREADS  4
+#define MULTITHREADED_TEST_NUM_ELEMENTS 4096
+
+struct thread_args {
+    struct llcm_segmented_queue *queue;
+    uint64_t producer_id;
+    uint64_t *num_observations;
+};
+
+// elements are (producer_id << 32 | sequence_number), sequence numbers start at 1
+void *thread_exec(void *arg0) {
+    struct thread_args *args = arg0;
+    // bursts larger than a segment, so appends and recycling race with pops
+    for (uint64_t burst = 0; burst < MULTITHREADED_TEST_NUM_ELEMENTS / 64; burst++) {
+        for (uint64_t i = 1; i <= 64; i++) {
+            uint64_t const element = args->producer_id << 32 | (burst * 64 + i);
+            llcm_segmented_queue_push(args->queue, (void *) element);
+        }
+        for (uint64_t i = 0; i < 64; i++) {
+            void *pop_result = NULL;
+            while (NULL == pop_result) {
+                pop_result = llcm_segmented_queue_try_pop(args->queue);
+            }
+            uint64_t const producer_id = (uint64_t) pop_result >> 32;
+            uint64_t const sequence_number = (uint64_t) pop_result & 0xffffffff;
+            __atomic_fetch_add(&args->num_observations[producer_id *
+                                                           MULTITHREADED_TEST_NUM_ELEMENTS +
+                                                       sequence_number - 1],
+                               1, __ATOMIC_SEQ_CST);
+        }
+    }
+    return NULL;
+}
+
+void multithreaded_segmented_queue_test() {
+    struct llcm_segmented_queue queue;
+    llcm_segmented_queue_init(&queue, 16);
+    uint64_t *num_observations =
+        calloc(MULTITHREADED_TEST_NUM_THREADS * MULTITHREADED_TEST_NUM_ELEMENTS, sizeof(uint64_t));
+
+    pthread_t threads[MULTITHREADED_TEST_NUM_THREADS];
+    struct thread_args args[MULTITHREADED_TEST_NUM_THREADS];
+    for (size_t tid = 0; tid < MULTITHREADED_TEST_NUM_THREADS; tid++) {
+        args[tid] = (struct thread_args){
+            .queue = &queue, .producer_id = tid, .num_observations = num_observations};
+        int rc = pthread_create(&threads[tid], NULL, thread_exec, &args[tid]);
+        assert(rc == 0);
+    }
+    for (size_t tid = 0; tid < MULTITHREADED_TEST_NUM_THREADS; tid++) {
+        pthread_join(threads[tid], NULL);
+    }
+
+    assert(NULL == llcm_segmented_queue_try_pop(&queue));
+    for (size_t i = 0; i < MULTITHREADED_TEST_NUM_THREADS * MULTITHREADED_TEST_NUM_ELEMENTS; i++) {
+        assert(1 == num_observations[i]);
+    }
+    // recycling bounds the segments by the bursts in flight, not by the elements pushed
+    assert(llcm_segmented_queue_get_num_segments(&queue) <
+           MULTITHREADED_TEST_NUM_THREADS * MULTITHREADED_TEST_NUM_ELEMENTS / 16 / 4);
+    free(num_observations);
+    llcm_segmented_queue_uninit(&queue);
+    printf("PASSED multithreaded_segmented_queue_test\n");
+}
+
+#define ORDER_TEST_NUM_CONSUMERS 3
+#define ORDER_TEST_NUM_ELEMENTS  200000
+
+struct order_test_args {
+    struct llcm_segmented_queue *queue;
+    uint64_t *num_popped;
+};
+
+// a consumer still holding a head that was recycled into the tail would pop newer elements
+// ahead of older ones, so every consumer must see one producer's elements in order
+void *order_test_consumer_exec(void *arg0) {
+    struct order_test_args *args = arg0;
+    uint64_t last_element = 0;
+    while (__atomic_load_n(args->num_popped, __ATOMIC_SEQ_CST) != ORDER_TEST_NUM_ELEMENTS) {
+        void *values[4];
+        size_t num_values = 0;
+        if (last_element % 2 == 0) {
+            num_values = llcm_segmented_queue_try_pop_n(args->queue, values, 4);
+        } else if (NULL != (values[0] = llcm_segmented_queue_try_pop(args->queue))) {
+            num_values = 1;
+        }
+        for (size_t i = 0; i < num_values; i++) {
+            assert((uint64_t) values[i] > last_element);
+            last_element = (uint64_t) values[i];
+        }
+        if (0 == num_values) {
+            sched_yield();
+        }
+        __atomic_fetch_add(args->num_popped, num_values, __ATOMIC_SEQ_CST);
+    }
+    return NULL;
+}
+
+void multi_consumer_order_test() {
+    // tiny segments, so heads are retired and recycled all the time
+    struct llcm_segmented_queue queue;
+    llcm_segmented_queue_init(&queue, 2);
+    uint64_t num_popped = 0;
+    struct order_test_args args = {.queue = &queue, .num_popped = &num_popped};
+    pthread_t threads[ORDER_TEST_NUM_CONSUMERS];
+    for (size_t tid = 0; tid < ORDER_TEST_NUM_CONSUMERS; tid++) {
+        int rc = pthread_create(&threads[tid], NULL, order_test_consumer_exec, &args);
+        assert(rc == 0);
+    }
+    for (uint64_t i = 1; i <= ORDER_TEST_NUM_ELEMENTS; i++) {
+        llcm_segmented_queue_push(&queue, (void *) i);
+        if (i % 64 == 0) {
+            sched_yield();
+        }
+    }
+    for (size_t tid = 0; tid < ORDER_TEST_NUM_CONSUMERS; tid++) {
+        pthread_join(threads[tid], NULL);
+    }
+    assert(NULL == llcm_segmented_queue_try_pop(&queue));
+    assert(0 == llcm_segmented_queue_get_size(&queue));
+    llcm_segmented_queue_uninit(&queue);
+    printf("PASSED multi_consumer_order_test\n");
+}
+
+int main() {
+    basic_segmented_queue_test();
+    batch_segmented_queue_test();
+    multithreaded_segmented_queue_test();
+    multi_consumer_order_test();
+}
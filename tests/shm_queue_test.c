@@ -0,0 +1,154 @@
+#define _GNU_SOURCE
+
+#include "lib/shm_queue.h"
+
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define NUM_VALUES 100000
+
+void get_name(char *name, size_t size, char const *test) {
+    snprintf(name, size, "llcm_shm_queue_test_%d_%s", (int) getpid(), test);
+}
+
+void create_open_test() {
+    char name[64];
+    get_name(name, sizeof(name), "create_open");
+    struct llcm_shm_queue creator;
+    struct llcm_shm_queue opener;
+    assert(!llcm_shm_queue_open(&opener, name));
+    assert(llcm_shm_queue_create(&creator, name, 5, 0));
+    // the name is taken until it is unlinked
+    assert(!llcm_shm_queue_create(&opener, name, 8, 0));
+    assert(llcm_shm_queue_open(&opener, name));
+    assert(8 == llcm_shm_queue_get_capacity(&creator));
+    assert(8 == llcm_shm_queue_get_capacity(&opener));
+
+    // two mappings at different addresses see the same entries
+    assert(creator.header_ != opener.header_);
+    for (uint64_t round = 0; round < 3; round++) {
+        assert(llcm_shm_queue_try_reserve_size_before_push(&creator, 8));
+        assert(!llcm_shm_queue_try_reserve_size_before_push(&opener, 1));
+        for (uint64_t i = 0; i < 8; i++) {
+            llcm_shm_queue_push(&creator, round * 8 + i);
+        }
+        assert(8 == llcm_shm_queue_get_size(&opener));
+        uint64_t values[8];
+        assert(8 == llcm_shm_queue_try_pop_n(&opener, values, 8));
+        for (uint64_t i = 0; i < 8; i++) {
+            assert(round * 8 + i == values[i]);
+        }
+        llcm_shm_queue_unreserve_size_after_pop(&opener, 8);
+    }
+    uint64_t value;
+    assert(!llcm_shm_queue_try_pop(&creator, &value));
+
+    llcm_shm_queue_close(&opener);
+    llcm_shm_queue_close(&creator);
+    assert(llcm_shm_queue_unlink(name));
+    assert(!llcm_shm_queue_unlink(name));
+    assert(!llcm_shm_queue_open(&opener, name));
+    printf("PASSED create_open_test\n");
+}
+
+void invalid_test() {
+    struct llcm_shm_queue queue;
+    // names are a single path component
+    assert(!llcm_shm_queue_create(&queue, "", 8, 0));
+    assert(!llcm_shm_queue_create(&queue, "../llcm_shm_queue_test", 8, 0));
+    assert(!llcm_shm_queue_open(&queue, "llcm_shm_queue_test_missing"));
+
+    // a region of another version or not fully created is rejected
+    assert(llcm_shm_queue_create(&queue, NULL, 8, 0));
+    int const fd = dup(llcm_shm_queue_get_fd(&queue));
+    struct llcm_shm_queue other;
+    assert(llcm_shm_queue_open_fd(&other, dup(fd)));
+    llcm_shm_queue_close(&other);
+    queue.header_->version = LLCM_SHM_QUEUE_VERSION + 1;
+    assert(!llcm_shm_queue_open_fd(&other, fd));
+    queue.header_->version = LLCM_SHM_QUEUE_VERSION;
+    atomic_store(&queue.header_->magic, 0);
+    assert(!llcm_shm_queue_open_fd(&other, fd));
+    llcm_shm_queue_close(&queue);
+
+    // and so is a file too small to hold a header
+    int const small_fd = memfd_create("llcm_shm_queue_test", MFD_CLOEXEC);
+    assert(small_fd >= 0);
+    assert(!llcm_shm_queue_open_fd(&other, small_fd));
+    assert(0 == ftruncate(small_fd, 64));
+    assert(!llcm_shm_queue_open_fd(&other, small_fd));
+    close(small_fd);
+    close(fd);
+    printf("PASSED invalid_test\n");
+}
+
+void consume(struct llcm_shm_queue *queue) {
+    uint64_t expected = 0;
+    uint64_t values[16];
+    while (expected < NUM_VALUES) {
+        size_t const num_values = llcm_shm_queue_try_pop_n(queue, values, 16);
+        if (0 == num_values) {
+            sched_yield();
+            continue;
+        }
+        for (size_t i = 0; i < num_values; i++) {
+            assert(expected++ == values[i]);
+        }
+        llcm_shm_queue_unreserve_size_after_pop(queue, num_values);
+    }
+}
+
+void produce(struct llcm_shm_queue *queue) {
+    for (uint64_t i = 0; i < NUM_VALUES; i++) {
+        while (!llcm_shm_queue_try_reserve_size_before_push(queue, 1)) {
+            sched_yield();
+        }
+        llcm_shm_queue_push(queue, i);
+    }
+}
+
+void cross_process_test() {
+    for (int by_name = 0; by_name < 2; by_name++) {
+        for (unsigned flags = 0; flags < 4; flags++) {
+            char name[64];
+            get_name(name, sizeof(name), "cross_process");
+            struct llcm_shm_queue queue;
+            assert(llcm_shm_queue_create(&queue, by_name ? name : NULL, 64, flags));
+            pid_t const pid = fork();
+            assert(pid >= 0);
+            if (0 == pid) {
+                // the child maps its own view, by name or through the inherited fd
+                struct llcm_shm_queue child_queue;
+                if (by_name) {
+                    assert(llcm_shm_queue_open(&child_queue, name));
+                } else {
+                    assert(llcm_shm_queue_open_fd(&child_queue,
+                                                  dup(llcm_shm_queue_get_fd(&queue))));
+                }
+                consume(&child_queue);
+                llcm_shm_queue_close(&child_queue);
+                _exit(0);
+            }
+            produce(&queue);
+            int status;
+            assert(pid == waitpid(pid, &status, 0));
+            assert(WIFEXITED(status) && 0 == WEXITSTATUS(status));
+            assert(0 == llcm_shm_queue_get_size(&queue));
+            llcm_shm_queue_close(&queue);
+            if (by_name) {
+                assert(llcm_shm_queue_unlink(name));
+            }
+        }
+    }
+    printf("PASSED cross_process_test\n");
+}
+
+int main() {
+    create_open_test();
+    invalid_test();
+    cross_process_test();
+}
@@ -0,0 +1,102 @@
+#define _GNU_SOURCE
+
+#include "lib/scheduler.h"
+#include "lib/stats.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+static_assert(LLCM_STATS_ENABLED, "stats_test must be built with -DLLCM_STATS");
+
+struct migrating_state {
+    struct llcm_scheduler *target;
+};
+
+void migrating_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct migrating_state *state = arg0;
+    if (!llcm_exec_handle_try_switch_scheduler(handle, state->target)) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+void thread_counters_test() {
+    struct llcm_stats before;
+    llcm_stats_snapshot_thread(&before);
+
+    struct llcm_concurrent_queue queue;
+    llcm_concurrent_queue_init(&queue, 2);
+    assert(llcm_concurrent_queue_try_reserve_size_before_push(&queue, 2));
+    assert(!llcm_concurrent_queue_try_reserve_size_before_push(&queue, 1));
+    llcm_concurrent_queue_uninit(&queue);
+
+    struct llcm_scheduler first;
+    struct llcm_scheduler second;
+    llcm_scheduler_init(&first, 4);
+    llcm_scheduler_init(&second, 4);
+    struct migrating_state state = {.target = &second};
+    struct llcm_routine routine = {.poll = migrating_poll, .arg0 = &state};
+    assert(!llcm_scheduler_poll(&first, NULL));
+    assert(llcm_scheduler_try_schedule_routine(&first, &routine));
+    assert(llcm_scheduler_poll(&first, NULL));
+    assert(0 == llcm_scheduler_poll_batch(&first, NULL, 4));
+    assert(1 == llcm_scheduler_poll_batch(&second, NULL, 4));
+
+    struct llcm_stats after;
+    llcm_stats_snapshot_thread(&after);
+    struct llcm_stats delta;
+    llcm_stats_diff(&delta, &after, &before);
+    assert(1 == delta.queue_reserve_failures);
+    assert(2 == delta.scheduler_empty_polls);
+    assert(2 == delta.scheduler_productive_polls);
+    assert(1 == delta.scheduler_migrations);
+    // uncontended, so nothing ever waits on a slot or loses a cas
+    assert(0 == delta.queue_pop_cas_failures);
+    assert(0 == delta.queue_push_aba_spins);
+    assert(0 == delta.queue_pop_aba_spins);
+
+    llcm_scheduler_uninit(&first);
+    llcm_scheduler_uninit(&second);
+    printf("PASSED thread_counters_test\n");
+}
+
+#define AGGREGATE_TEST_NUM_THREADS 4
+
+void *empty_poll_thread_exec(void *arg0) {
+    struct llcm_scheduler *scheduler = arg0;
+    for (size_t i = 0; i < 100; i++) {
+        assert(!llcm_scheduler_poll(scheduler, NULL));
+    }
+    return NULL;
+}
+
+void aggregate_test() {
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 4);
+    struct llcm_stats before;
+    llcm_stats_snapshot(&before);
+
+    // counters of exited threads are still part of the snapshot
+    pthread_t threads[AGGREGATE_TEST_NUM_THREADS];
+    for (size_t i = 0; i < AGGREGATE_TEST_NUM_THREADS; i++) {
+        int rc = pthread_create(&threads[i], NULL, empty_poll_thread_exec, &scheduler);
+        assert(rc == 0);
+    }
+    for (size_t i = 0; i < AGGREGATE_TEST_NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    struct llcm_stats after;
+    llcm_stats_snapshot(&after);
+    struct llcm_stats delta;
+    llcm_stats_diff(&delta, &after, &before);
+    assert(100 * AGGREGATE_TEST_NUM_THREADS == delta.scheduler_empty_polls);
+    assert(0 == delta.scheduler_productive_polls);
+
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED aggregate_test\n");
+}
+
+int main() {
+    thread_counters_test();
+    aggregate_test();
+}
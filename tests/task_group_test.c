@@ -0,0 +1,230 @@
+#define _GNU_SOURCE
+
+#include "lib/executor.h"
+#include "lib/parallel_for.h"
+#include "lib/scheduler.h"
+#include "lib/task_group.h"
+
+#include <stdio.h>
+
+#define NUM_CHILDREN 8
+
+struct child_state {
+    struct llcm_task_group *group;
+    struct llcm_scheduler *grandchild_scheduler;
+    struct llcm_task grandchild;
+    uint64_t num_polls;
+    uint64_t max_polls;
+};
+
+void child_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct child_state *state = arg0;
+    // a child may fork further into the same group
+    if (0 == state->num_polls && NULL != state->grandchild_scheduler) {
+        assert(llcm_task_group_try_spawn(state->group, &state->grandchild,
+                                         state->grandchild_scheduler));
+    }
+    if (++state->num_polls == state->max_polls) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+struct parent_state {
+    struct llcm_task_group group;
+    struct llcm_scheduler *schedulers;
+    size_t num_schedulers;
+    struct llcm_task children[NUM_CHILDREN];
+    struct child_state child_states[NUM_CHILDREN];
+    struct child_state grandchild_states[NUM_CHILDREN];
+    uint64_t num_polls;
+    bool nested;
+};
+
+void parent_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct parent_state *state = arg0;
+    if (0 == state->num_polls++) {
+        llcm_task_group_init(&state->group);
+        for (size_t i = 0; i < NUM_CHILDREN; i++) {
+            struct llcm_scheduler *scheduler = &state->schedulers[i % state->num_schedulers];
+            state->grandchild_states[i] = (struct child_state){.max_polls = 2};
+            state->child_states[i] = (struct child_state){
+                .group = &state->group,
+                .grandchild_scheduler = state->nested ? scheduler : NULL,
+                .grandchild = {.poll = child_poll, .arg0 = &state->grandchild_states[i]},
+                .max_polls = 1 + i % 4};
+            state->children[i] =
+                (struct llcm_task){.poll = child_poll, .arg0 = &state->child_states[i]};
+            assert(llcm_task_group_try_spawn(&state->group, &state->children[i], scheduler));
+        }
+    }
+    if (!llcm_task_group_await(&state->group, handle)) {
+        return;
+    }
+    // every child and grandchild ran to completion before the parent is polled again
+    for (size_t i = 0; i < NUM_CHILDREN; i++) {
+        assert(state->child_states[i].num_polls == state->child_states[i].max_polls);
+        assert(state->grandchild_states[i].num_polls == (state->nested ? 2 : 0));
+    }
+    llcm_exec_handle_cancel_routine(handle);
+}
+
+void spawn_await_test() {
+    for (int nested = 0; nested < 2; nested++) {
+        struct llcm_scheduler scheduler;
+        llcm_scheduler_init(&scheduler, 4 * NUM_CHILDREN);
+        struct parent_state state = {.schedulers = &scheduler, .num_schedulers = 1,
+                                     .nested = nested};
+        struct llcm_routine parent = {.poll = parent_poll, .arg0 = &state};
+        assert(llcm_scheduler_try_schedule_routine(&scheduler, &parent));
+        while (llcm_scheduler_poll(&scheduler, NULL)) {
+        }
+        // polled once to fork and once when resumed by the last child, never to check
+        assert(2 == state.num_polls);
+        assert(llcm_task_group_is_done(&state.group));
+        assert(0 == llcm_scheduler_get_num_routines(&scheduler));
+        llcm_scheduler_uninit(&scheduler);
+    }
+    printf("PASSED spawn_await_test\n");
+}
+
+void spawn_failure_test() {
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 2);
+    struct llcm_task_group group;
+    llcm_task_group_init(&group);
+    struct child_state states[3];
+    struct llcm_task tasks[3];
+    for (size_t i = 0; i < 3; i++) {
+        states[i] = (struct child_state){.max_polls = 1};
+        tasks[i] = (struct llcm_task){.poll = child_poll, .arg0 = &states[i]};
+    }
+    assert(llcm_task_group_try_spawn(&group, &tasks[0], &scheduler));
+    assert(llcm_task_group_try_spawn(&group, &tasks[1], &scheduler));
+    // a child that did not fit is not counted
+    assert(!llcm_task_group_try_spawn(&group, &tasks[2], &scheduler));
+    assert(2 == llcm_task_group_get_num_pending(&group));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(llcm_scheduler_poll(&scheduler, NULL));
+    assert(llcm_task_group_is_done(&group));
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED spawn_failure_test\n");
+}
+
+#define RANGE_SIZE 10000
+
+struct range_state {
+    uint32_t visits[RANGE_SIZE];
+    uint64_t max_chunk_size;
+    uint64_t num_chunks;
+};
+
+void visit_range(void *arg, size_t begin, size_t end) {
+    struct range_state *state = arg;
+    for (size_t i = begin; i < end; i++) {
+        __atomic_fetch_add(&state->visits[i], 1, __ATOMIC_RELAXED);
+    }
+    uint64_t const chunk_size = end - begin;
+    uint64_t max_chunk_size = __atomic_load_n(&state->max_chunk_size, __ATOMIC_RELAXED);
+    while (chunk_size > max_chunk_size &&
+           !__atomic_compare_exchange_n(&state->max_chunk_size, &max_chunk_size, chunk_size,
+                                        true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    __atomic_fetch_add(&state->num_chunks, 1, __ATOMIC_RELAXED);
+}
+
+void assert_visited_once(struct range_state const *state, size_t begin, size_t end) {
+    for (size_t i = 0; i < RANGE_SIZE; i++) {
+        assert(state->visits[i] == (i >= begin && i < end));
+    }
+}
+
+void parallel_for_test() {
+    struct llcm_scheduler schedulers[3];
+    for (size_t i = 0; i < 3; i++) {
+        llcm_scheduler_init(&schedulers[i], 64);
+    }
+    struct llcm_parallel_for parallel_for;
+    llcm_parallel_for_init(&parallel_for, schedulers, 3, 0);
+    static struct range_state state;
+
+    // idle schedulers pull halves of the range, each polled chunk stays within the grain
+    memset(&state, 0, sizeof(state));
+    assert(llcm_parallel_for_try_start(&parallel_for, 100, RANGE_SIZE, 64, visit_range, &state));
+    while (!llcm_parallel_for_is_done(&parallel_for)) {
+        for (size_t i = 0; i < 3; i++) {
+            llcm_scheduler_poll(&schedulers[i], NULL);
+        }
+    }
+    assert_visited_once(&state, 100, RANGE_SIZE);
+    assert(state.max_chunk_size <= 64);
+    size_t const num_tasks = llcm_parallel_for_get_num_tasks(&parallel_for);
+    assert(num_tasks >= 3 && num_tasks <= 3 * LLCM_PARALLEL_FOR_TASKS_PER_SCHEDULER);
+
+    // busy schedulers get nothing, the range is not split at all
+    memset(&state, 0, sizeof(state));
+    struct child_state busy_states[2] = {{.max_polls = UINT64_MAX}, {.max_polls = UINT64_MAX}};
+    struct llcm_routine busy[2] = {{.poll = child_poll, .arg0 = &busy_states[0]},
+                                   {.poll = child_poll, .arg0 = &busy_states[1]}};
+    assert(llcm_scheduler_try_schedule_routine(&schedulers[1], &busy[0]));
+    assert(llcm_scheduler_try_schedule_routine(&schedulers[2], &busy[1]));
+    assert(llcm_parallel_for_try_start(&parallel_for, 0, 1000, 100, visit_range, &state));
+    while (!llcm_parallel_for_is_done(&parallel_for)) {
+        llcm_scheduler_poll(&schedulers[0], NULL);
+    }
+    assert_visited_once(&state, 0, 1000);
+    assert(1 == llcm_parallel_for_get_num_tasks(&parallel_for));
+    assert(10 == state.num_chunks);
+
+    // an empty range is done right away
+    assert(llcm_parallel_for_try_start(&parallel_for, 5, 5, 1, visit_range, &state));
+    assert(llcm_parallel_for_is_done(&parallel_for));
+
+    llcm_parallel_for_uninit(&parallel_for);
+    for (size_t i = 0; i < 3; i++) {
+        llcm_scheduler_uninit(&schedulers[i]);
+    }
+    printf("PASSED parallel_for_test\n");
+}
+
+struct executor_parent_state {
+    struct llcm_parallel_for parallel_for;
+    struct range_state range;
+    uint64_t num_polls;
+};
+
+void executor_parent_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct executor_parent_state *state = arg0;
+    if (0 == state->num_polls++) {
+        assert(llcm_parallel_for_try_start(&state->parallel_for, 0, RANGE_SIZE, 16, visit_range,
+                                           &state->range));
+    }
+    if (llcm_parallel_for_await(&state->parallel_for, handle)) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+void executor_test() {
+    // a routine on one worker forks over both and is resumed on its own worker
+    struct llcm_executor executor;
+    llcm_executor_init(&executor, llcm_executor_config_create_default(2, 256));
+    static struct executor_parent_state state;
+    llcm_parallel_for_init(&state.parallel_for, executor.group.schedulers, 2, 0);
+    struct llcm_routine parent = {.poll = executor_parent_poll, .arg0 = &state};
+    assert(llcm_scheduler_try_schedule_routine(llcm_executor_get_scheduler(&executor, 0),
+                                               &parent));
+    assert(llcm_executor_start(&executor));
+    llcm_executor_drain(&executor);
+    // once more after the resume, unless a stealing worker finished everything before the await
+    assert(state.num_polls >= 1 && state.num_polls <= 2);
+    assert_visited_once(&state.range, 0, RANGE_SIZE);
+    llcm_parallel_for_uninit(&state.parallel_for);
+    llcm_executor_uninit(&executor);
+    printf("PASSED executor_test\n");
+}
+
+int main() {
+    spawn_await_test();
+    spawn_failure_test();
+    parallel_for_test();
+    executor_test();
+}
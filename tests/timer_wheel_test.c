@@ -0,0 +1,85 @@
+#define _GNU_SOURCE
+
+#include "lib/scheduler.h"
+#include "lib/timer_wheel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TIMER_WHEEL_TEST_NUM_ROUTINES 512
+
+// deadlines spread across every level of the wheel, expired with a synthetic clock
+void expiry_order_test() {
+    struct llcm_timer_wheel wheel;
+    llcm_timer_wheel_init(&wheel);
+    uint64_t const start_tick = wheel.current_tick;
+    assert(llcm_timer_wheel_is_empty(&wheel));
+
+    struct llcm_routine routines[TIMER_WHEEL_TEST_NUM_ROUTINES];
+    uint64_t deadline_ticks[TIMER_WHEEL_TEST_NUM_ROUTINES];
+    srand(42);
+    for (size_t i = 0; i < TIMER_WHEEL_TEST_NUM_ROUTINES; i++) {
+        // exponentially distributed distances up to 2^26 ticks
+        uint64_t const distance = (uint64_t) rand() & ((1ULL << (i % 27)) - 1);
+        deadline_ticks[i] = start_tick + distance;
+        routines[i] = (struct llcm_routine){
+            .timer_deadline_ = deadline_ticks[i] << LLCM_TIMER_WHEEL_TICK_SHIFT};
+        llcm_timer_wheel_insert(&wheel, &routines[i]);
+    }
+    assert(!llcm_timer_wheel_is_empty(&wheel));
+
+    bool expired[TIMER_WHEEL_TEST_NUM_ROUTINES] = {false};
+    size_t num_expired = 0;
+    uint64_t now_tick = start_tick;
+    while (num_expired < TIMER_WHEEL_TEST_NUM_ROUTINES) {
+        // advance by irregular, growing steps to exercise both single ticks and skipped rotations
+        now_tick += rand() % 2 ? 1 : 1 + (uint64_t) rand() % (1 + (now_tick - start_tick) / 4);
+        uint64_t const now_tsc = now_tick << LLCM_TIMER_WHEEL_TICK_SHIFT;
+        if (!llcm_timer_wheel_is_due(&wheel, now_tsc)) {
+            continue;
+        }
+        struct llcm_routine *routine = llcm_timer_wheel_try_expire(&wheel, now_tsc);
+        for (; NULL != routine; routine = routine->timer_next_) {
+            size_t const i = routine - routines;
+            assert(!expired[i]);
+            assert(deadline_ticks[i] < now_tick);
+            expired[i] = true;
+            num_expired++;
+        }
+        // nothing that is due may be left behind
+        for (size_t i = 0; i < TIMER_WHEEL_TEST_NUM_ROUTINES; i++) {
+            assert(expired[i] || deadline_ticks[i] >= now_tick);
+        }
+    }
+    assert(llcm_timer_wheel_is_empty(&wheel));
+    printf("PASSED expiry_order_test\n");
+}
+
+void overflow_test() {
+    struct llcm_timer_wheel wheel;
+    llcm_timer_wheel_init(&wheel);
+    uint64_t const start_tick = wheel.current_tick;
+
+    // further away than the top level of the wheel covers
+    uint64_t const distance = 1ULL << (LLCM_TIMER_WHEEL_SLOT_BITS * LLCM_TIMER_WHEEL_NUM_LEVELS);
+    struct llcm_routine routine = {
+        .timer_deadline_ = (start_tick + distance) << LLCM_TIMER_WHEEL_TICK_SHIFT};
+    llcm_timer_wheel_insert(&wheel, &routine);
+    assert(NULL == llcm_timer_wheel_try_expire(&wheel, start_tick << LLCM_TIMER_WHEEL_TICK_SHIFT));
+
+    uint64_t const step = distance / 16;
+    for (uint64_t now_tick = start_tick + step; now_tick <= start_tick + distance;
+         now_tick += step) {
+        uint64_t const now_tsc = now_tick << LLCM_TIMER_WHEEL_TICK_SHIFT;
+        assert(NULL == llcm_timer_wheel_try_expire(&wheel, now_tsc));
+    }
+    uint64_t const now_tsc = (start_tick + distance + 1) << LLCM_TIMER_WHEEL_TICK_SHIFT;
+    assert(&routine == llcm_timer_wheel_try_expire(&wheel, now_tsc));
+    assert(llcm_timer_wheel_is_empty(&wheel));
+    printf("PASSED overflow_test\n");
+}
+
+int main() {
+    expiry_order_test();
+    overflow_test();
+}
@@ -0,0 +1,127 @@
+#define _GNU_SOURCE
+
+#include "lib/scheduler.h"
+#include "lib/trace.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+static_assert(LLCM_TRACE_ENABLED, "trace_test must be built with -DLLCM_TRACE");
+
+struct migrating_state {
+    struct llcm_scheduler *target;
+};
+
+void migrating_poll(void *arg0, struct llcm_exec_handle *handle) {
+    struct migrating_state *state = arg0;
+    if (!llcm_exec_handle_try_switch_scheduler(handle, state->target)) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+void event_order_test() {
+    struct llcm_scheduler first;
+    struct llcm_scheduler second;
+    llcm_scheduler_init(&first, 1);
+    llcm_scheduler_init(&second, 1);
+    struct migrating_state state = {.target = &second};
+    struct llcm_routine routine = {.poll = migrating_poll, .arg0 = &state};
+    struct llcm_routine *too_many[] = {&routine, &routine, &routine};
+    assert(llcm_scheduler_try_schedule_routine(&first, &routine));
+    assert(!llcm_scheduler_try_schedule_routines(&first, too_many, 3));
+    assert(llcm_scheduler_poll(&first, NULL));
+    assert(1 == llcm_scheduler_poll_batch(&second, NULL, 4));
+
+    struct llcm_trace_event events[16];
+    size_t const num_events = llcm_trace_get_thread_events(events, 16);
+    struct llcm_trace_event const expected[] = {
+        {.type = LLCM_TRACE_ROUTINE_SCHEDULED, .routine = &routine, .scheduler = &first},
+        {.type = LLCM_TRACE_QUEUE_FULL, .routine = NULL, .scheduler = &first},
+        {.type = LLCM_TRACE_POLL_BEGIN, .routine = &routine, .scheduler = &first},
+        {.type = LLCM_TRACE_SWITCHED_SCHEDULER, .routine = &routine, .scheduler = &second},
+        {.type = LLCM_TRACE_POLL_END, .routine = &routine, .scheduler = &first},
+        {.type = LLCM_TRACE_POLL_BEGIN, .routine = &routine, .scheduler = &second},
+        {.type = LLCM_TRACE_POLL_END, .routine = &routine, .scheduler = &second},
+        {.type = LLCM_TRACE_CANCELLED, .routine = &routine, .scheduler = &second},
+    };
+    size_t const num_expected = sizeof(expected) / sizeof(expected[0]);
+    assert(num_expected == num_events);
+    for (size_t i = 0; i < num_events; i++) {
+        assert(expected[i].type == events[i].type);
+        assert(expected[i].routine == events[i].routine);
+        assert(expected[i].scheduler == events[i].scheduler);
+        assert(0 == i || events[i].tsc >= events[i - 1].tsc);
+    }
+
+    llcm_scheduler_uninit(&first);
+    llcm_scheduler_uninit(&second);
+    printf("PASSED event_order_test\n");
+}
+
+void counting_poll(void *arg0, struct llcm_exec_handle *handle) {
+    uint64_t *num_polls = arg0;
+    if (0 == --*num_polls) {
+        llcm_exec_handle_cancel_routine(handle);
+    }
+}
+
+void *tracing_thread_exec(void *arg0) {
+    llcm_trace_set_thread_name("tracing_thread");
+    struct llcm_scheduler *scheduler = arg0;
+    // far more events than the ring holds
+    uint64_t num_polls = 3 * LLCM_TRACE_RING_SIZE;
+    struct llcm_routine routine = {.poll = counting_poll, .arg0 = &num_polls};
+    assert(llcm_scheduler_try_schedule_routine(scheduler, &routine));
+    while (llcm_scheduler_poll(scheduler, NULL)) {
+    }
+    return NULL;
+}
+
+void chrome_json_test() {
+    struct llcm_scheduler scheduler;
+    llcm_scheduler_init(&scheduler, 1);
+    pthread_t thread;
+    int rc = pthread_create(&thread, NULL, tracing_thread_exec, &scheduler);
+    assert(rc == 0);
+    // dumping while the other thread traces only ever drops events, it never tears them
+    FILE *file = tmpfile();
+    assert(NULL != file);
+    assert(llcm_trace_dump_chrome_json(file));
+    fclose(file);
+    pthread_join(thread, NULL);
+
+    file = tmpfile();
+    assert(NULL != file);
+    assert(llcm_trace_dump_chrome_json(file));
+    long const size = ftell(file);
+    char *json = malloc(size + 1);
+    rewind(file);
+    assert(size == (long) fread(json, 1, size, file));
+    json[size] = '\0';
+    fclose(file);
+
+    assert(0 == strncmp(json, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 39));
+    assert(NULL != strstr(json, "\"name\":\"tracing_thread\""));
+    assert(NULL != strstr(json, "\"ph\":\"B\",\"name\":\"poll\""));
+    assert(NULL != strstr(json, "\"ph\":\"E\",\"name\":\"poll\""));
+    assert(NULL != strstr(json, "\"ph\":\"i\",\"name\":\"cancelled\""));
+    assert(0 == strcmp(json + size - 4, "\n]}\n"));
+    // every begin that made it into the dump is closed
+    size_t num_begins = 0;
+    size_t num_ends = 0;
+    for (char const *event = json; NULL != (event = strstr(event, "\"ph\":\"")); event++) {
+        num_begins += 'B' == event[6];
+        num_ends += 'E' == event[6];
+    }
+    assert(num_begins > 0 && num_begins == num_ends);
+
+    free(json);
+    llcm_scheduler_uninit(&scheduler);
+    printf("PASSED chrome_json_test\n");
+}
+
+int main() {
+    event_order_test();
+    chrome_json_test();
+}
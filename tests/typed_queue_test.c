@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+
+#include "lib/typed_queue.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+// a 48 byte message, it fits the spare bytes of its slot
+struct message {
+    uint64_t sequence;
+    uint32_t producer;
+    uint32_t kind;
+    double price;
+    uint64_t quantity;
+    uint64_t checksum;
+    uint64_t timestamp;
+};
+static_assert(sizeof(struct message) <= LLCM_TYPED_QUEUE_MAX_INLINE_SIZE, "");
+
+LLCM_DEFINE_QUEUE(message_queue, struct message, 16)
+LLCM_DEFINE_QUEUE_WITH_FLAGS(spsc_message_queue, struct message, 8,
+                             LLCM_CONCURRENT_QUEUE_SINGLE_PRODUCER |
+                                 LLCM_CONCURRENT_QUEUE_SINGLE_CONSUMER)
+LLCM_DEFINE_QUEUE(u64_queue, uint64_t, 4)
+
+struct message create_message(uint32_t producer, uint64_t sequence) {
+    struct message message = {.sequence = sequence,
+                              .producer = producer,
+                              .kind = sequence % 3,
+                              .price = sequence * 0.25,
+                              .quantity = sequence * 7,
+                              .timestamp = sequence + producer};
+    message.checksum = message.sequence ^ message.quantity ^ message.timestamp;
+    return message;
+}
+
+bool is_valid_message(struct message const *message) {
+    return message->checksum == (message->sequence ^ message->quantity ^ message->timestamp) &&
+           message->price == message->sequence * 0.25;
+}
+
+void basic_queue_test() {
+    // one padded cache line per slot, whatever the payload
+    assert(sizeof(struct message_queue_entry_) == LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE);
+    assert(sizeof(struct u64_queue_entry_) == LLCM_CONCURRENT_QUEUE_CACHE_LINE_SIZE);
+
+    struct message_queue *queue = llcm_allocator_allocate(
+        llcm_allocator_create_default(), alignof(struct message_queue), sizeof(*queue));
+    message_queue_init(queue);
+    assert(16 == message_queue_get_capacity(queue));
+
+    for (uint64_t i = 1; i <= 16 * 4; i++) {
+        assert(message_queue_try_reserve_size_before_push(queue, 1));
+        struct message const pushed = create_message(0, i);
+        message_queue_push(queue, &pushed);
+        assert(1 == message_queue_get_size(queue));
+        struct message popped;
+        assert(message_queue_try_pop(queue, &popped));
+        assert(popped.sequence == i && is_valid_message(&popped));
+        message_queue_unreserve_size_after_pop(queue, 1);
+    }
+    struct message popped;
+    assert(!message_queue_try_pop(queue, &popped));
+
+    // reservations are capped by the capacity, batch or not
+    assert(message_queue_try_reserve_size_before_push(queue, 16));
+    assert(!message_queue_try_reserve_size_before_push(queue, 1));
+    message_queue_unreserve_size_after_pop(queue, 16);
+
+    // batches wrap around the ring and pops are capped by what is there
+    struct message values[16];
+    for (uint64_t round = 0; round < 4; round++) {
+        assert(message_queue_try_reserve_size_before_push(queue, 10));
+        for (uint64_t i = 0; i < 10; i++) {
+            values[i] = create_message(0, round * 10 + i);
+        }
+        message_queue_push_n(queue, values, 10);
+        assert(3 == message_queue_try_pop_n(queue, values, 3));
+        assert(7 == message_queue_try_pop_n(queue, values + 3, 16));
+        assert(0 == message_queue_try_pop_n(queue, values, 16));
+        for (uint64_t i = 0; i < 10; i++) {
+            assert(values[i].sequence == round * 10 + i && is_valid_message(&values[i]));
+        }
+        message_queue_unreserve_size_after_pop(queue, 10);
+    }
+
+    message_queue_uninit(queue);
+    llcm_allocator_free(llcm_allocator_create_default(), queue, sizeof(*queue));
+    printf("PASSED basic_queue_test\n");
+}
+
+void small_payload_test() {
+    struct u64_queue *queue = llcm_allocator_allocate(llcm_allocator_create_default(),
+                                                      alignof(struct u64_queue), sizeof(*queue));
+    u64_queue_init(queue);
+    // zero is an ordinary value here, there is no NULL to reserve
+    for (uint64_t i = 0; i < 64; i++) {
+        assert(u64_queue_try_reserve_size_before_push(queue, 1));
+        u64_queue_push(queue, &i);
+        uint64_t popped = UINT64_MAX;
+        assert(u64_queue_try_pop(queue, &popped));
+        assert(popped == i);
+        u64_queue_unreserve_size_after_pop(queue, 1);
+    }
+    u64_queue_uninit(queue);
+    llcm_allocator_free(llcm_allocator_create_default(), queue, sizeof(*queue));
+    printf("PASSED small_payload_test\n");
+}
+
+#define NUM_MESSAGES  100000
+#define NUM_PRODUCERS 3
+#define NUM_CONSUMERS 3
+
+struct multithreaded_test_state {
+    struct message_queue *queue;
+    uint64_t num_popped;
+    uint64_t next_sequence[NUM_CONSUMERS][NUM_PRODUCERS];
+};
+
+struct thread_args {
+    struct multithreaded_test_state *state;
+    uint32_t id;
+};
+
+void *producer_exec(void *arg0) {
+    struct thread_args *args = arg0;
+    struct message_queue *queue = args->state->queue;
+    for (uint64_t i = 0; i < NUM_MESSAGES; i++) {
+        while (!message_queue_try_reserve_size_before_push(queue, 1)) {
+            sched_yield();
+        }
+        struct message const message = create_message(args->id, i);
+        message_queue_push(queue, &message);
+    }
+    return NULL;
+}
+
+void *consumer_exec(void *arg0) {
+    struct thread_args *args = arg0;
+    struct multithreaded_test_state *state = args->state;
+    uint64_t *next_sequence = state->next_sequence[args->id];
+    struct message messages[4];
+    while (__atomic_load_n(&state->num_popped, __ATOMIC_RELAXED) < NUM_PRODUCERS * NUM_MESSAGES) {
+        size_t const num_popped = message_queue_try_pop_n(state->queue, messages, 4);
+        if (0 == num_popped) {
+            sched_yield();
+            continue;
+        }
+        for (size_t i = 0; i < num_popped; i++) {
+            // each consumer sees every producer's messages in order, and never a torn one
+            assert(is_valid_message(&messages[i]));
+            assert(messages[i].sequence >= next_sequence[messages[i].producer]);
+            next_sequence[messages[i].producer] = messages[i].sequence + 1;
+        }
+        message_queue_unreserve_size_after_pop(state->queue, num_popped);
+        __atomic_fetch_add(&state->num_popped, num_popped, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+void multithreaded_test() {
+    struct multithreaded_test_state state = {
+        .queue = llcm_allocator_allocate(llcm_allocator_create_default(),
+                                         alignof(struct message_queue),
+                                         sizeof(struct message_queue))};
+    message_queue_init(state.queue);
+    pthread_t threads[NUM_PRODUCERS + NUM_CONSUMERS];
+    struct thread_args args[NUM_PRODUCERS + NUM_CONSUMERS];
+    for (uint32_t i = 0; i < NUM_PRODUCERS + NUM_CONSUMERS; i++) {
+        bool const producer = i < NUM_PRODUCERS;
+        args[i] = (struct thread_args){.state = &state, .id = producer ? i : i - NUM_PRODUCERS};
+        int rc =
+            pthread_create(&threads[i], NULL, producer ? producer_exec : consumer_exec, &args[i]);
+        assert(rc == 0);
+    }
+    for (uint32_t i = 0; i < NUM_PRODUCERS + NUM_CONSUMERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    assert(NUM_PRODUCERS * NUM_MESSAGES == state.num_popped);
+    assert(0 == message_queue_get_size(state.queue));
+    message_queue_uninit(state.queue);
+    llcm_allocator_free(llcm_allocator_create_default(), state.queue,
+                        sizeof(struct message_queue));
+    printf("PASSED multithreaded_test\n");
+}
+
+void *spsc_producer_exec(void *arg0) {
+    struct spsc_message_queue *queue = arg0;
+    struct message batch[3];
+    for (uint64_t i = 0; i < NUM_MESSAGES; i += 3) {
+        while (!spsc_message_queue_try_reserve_size_before_push(queue, 3)) {
+            sched_yield();
+        }
+        for (uint64_t j = 0; j < 3; j++) {
+            batch[j] = create_message(0, i + j);
+        }
+        spsc_message_queue_push_n(queue, batch, 3);
+    }
+    return NULL;
+}
+
+void spsc_test() {
+    struct spsc_message_queue *queue =
+        llcm_allocator_allocate(llcm_allocator_create_default(),
+                                alignof(struct spsc_message_queue), sizeof(*queue));
+    spsc_message_queue_init(queue);
+    pthread_t producer;
+    int rc = pthread_create(&producer, NULL, spsc_producer_exec, queue);
+    assert(rc == 0);
+    uint64_t const num_messages = (NUM_MESSAGES + 2) / 3 * 3;
+    for (uint64_t next_sequence = 0; next_sequence < num_messages;) {
+        struct message message;
+        if (!spsc_message_queue_try_pop(queue, &message)) {
+            sched_yield();
+            continue;
+        }
+        assert(message.sequence == next_sequence && is_valid_message(&message));
+        spsc_message_queue_unreserve_size_after_pop(queue, 1);
+        next_sequence++;
+    }
+    pthread_join(producer, NULL);
+    spsc_message_queue_uninit(queue);
+    llcm_allocator_free(llcm_allocator_create_default(), queue, sizeof(*queue));
+    printf("PASSED spsc_test\n");
+}
+
+int main() {
+    basic_queue_test();
+    small_payload_test();
+    multithreaded_test();
+    spsc_test();
+}